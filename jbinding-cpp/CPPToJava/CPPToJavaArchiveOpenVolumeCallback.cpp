@@ -65,8 +65,7 @@ STDMETHODIMP CPPToJavaArchiveOpenVolumeCallback::GetStream(const wchar_t *name,
 		*inStream = NULL;
 	}
 
-	jstring nameString = env->NewString(UnicodeHelper(name), (jsize) wcslen(
-			name));
+	jstring nameString = UnicodeHelper(name).newString(env);
 
 	jniInstance.PrepareCall();
 	jobject inStreamImpl = env->CallObjectMethod(_javaImplementation,
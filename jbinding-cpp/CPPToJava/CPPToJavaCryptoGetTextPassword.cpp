@@ -30,7 +30,11 @@ STDMETHODIMP CPPToJavaCryptoGetTextPassword::CryptoGetTextPassword(BSTR * passwo
 
         //printf("PASSWORD: '%S'\n", (BSTR)passwordBSTR);
         //fflush(stdout);
-        StringToBstr(UString(UnicodeHelper(passwordJChars)), password);//passwordBSTR.MyCopy();
+        unsigned passwordLength = (unsigned) env->GetStringLength(passwordString);
+        UString passwordUString;
+        UnicodeHelper::toCodeUnits(passwordUString.GetBuffer(passwordLength), passwordJChars, passwordLength);
+        passwordUString.ReleaseBuffer(passwordLength);
+        StringToBstr(passwordUString, password);//passwordBSTR.MyCopy();
         env->ReleaseStringChars(passwordString, passwordJChars);
     }
 
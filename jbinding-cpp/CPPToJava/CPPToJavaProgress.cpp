@@ -3,23 +3,110 @@
 #include "JNITools.h"
 #include "CPPToJavaProgress.h"
 
+#include "Windows/Synchronization.h"
 
-STDMETHODIMP CPPToJavaProgress::SetCompleted(const UInt64 * completeValue)
+#ifndef MINGW
+#include <sys/time.h>
+#endif
+
+static UInt32 g_minIntervalMillis = 0;
+static UInt64 g_minBytes = 0;
+
+#ifdef COMPRESS_MT
+// SetThrottling() is called from java, while other java threads create progress objects.
+// SetCompleted() reads only the copy in the object.
+static NWindows::NSynchronization::CCriticalSection g_throttlingCriticalSection;
+	#define ENTER_CRITICAL_SECTION   {g_throttlingCriticalSection.Enter();}
+	#define LEAVE_CRITICAL_SECTION   {g_throttlingCriticalSection.Leave();}
+#else
+	#define ENTER_CRITICAL_SECTION   {}
+	#define LEAVE_CRITICAL_SECTION   {}
+#endif
+
+static UInt64 GetTimeMillis()
 {
-    TRACE_OBJECT_CALL("SetCompleted");
+#ifdef MINGW
+    return GetTickCount();
+#else
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (UInt64)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+#endif
+}
 
+HRESULT CPPToJavaProgress::CallSetCompleted(UInt64 completeValue)
+{
     JNIInstance jniInstance(_nativeMethodContext);
 
     jniInstance.PrepareCall();
-    jniInstance.GetEnv()->CallVoidMethod(_javaImplementation, _setCompletedMethodID, (jlong)(*completeValue));
+    jniInstance.GetEnv()->CallVoidMethod(_javaImplementation, _setCompletedMethodID, (jlong)completeValue);
 
     return jniInstance.IsExceptionOccurs() ? S_FALSE : S_OK;
 }
 
+STDMETHODIMP CPPToJavaProgress::SetCompleted(const UInt64 * completeValue)
+{
+    TRACE_OBJECT_CALL("SetCompleted");
+
+    UInt64 value = *completeValue;
+
+    if (!_throttling)
+        return CallSetCompleted(value);
+
+    // The final call and the call that moves the progress back are always forwarded
+    if ((!_totalDefined || value < _total) && value >= _lastCompleted)
+    {
+        UInt64 time = GetTimeMillis();
+        if (time - _lastCompletedTime < _minIntervalMillis
+                || value - _lastCompleted < _minBytes)
+        {
+            _pendingCompleted = value;
+            _completedPending = true;
+            return S_OK;
+        }
+        _lastCompletedTime = time;
+    }
+    _lastCompleted = value;
+    _completedPending = false;
+
+    return CallSetCompleted(value);
+}
+
+void CPPToJavaProgress::SetThrottling(UInt32 minIntervalMillis, UInt64 minBytes)
+{
+    ENTER_CRITICAL_SECTION
+    g_minIntervalMillis = minIntervalMillis;
+    g_minBytes = minBytes;
+    LEAVE_CRITICAL_SECTION
+}
+
+void CPPToJavaProgress::GetThrottling(UInt32 & minIntervalMillis, UInt64 & minBytes)
+{
+    ENTER_CRITICAL_SECTION
+    minIntervalMillis = g_minIntervalMillis;
+    minBytes = g_minBytes;
+    LEAVE_CRITICAL_SECTION
+}
+
+HRESULT CPPToJavaProgress::FlushProgress()
+{
+    TRACE_OBJECT_CALL("FlushProgress");
+
+    if (!_completedPending)
+        return S_OK;
+    _lastCompleted = _pendingCompleted;
+    _completedPending = false;
+
+    return CallSetCompleted(_pendingCompleted);
+}
+
 STDMETHODIMP CPPToJavaProgress::SetTotal(UINT64 total)
 {
     TRACE_OBJECT_CALL("SetTotal");
 
+    _total = total;
+    _totalDefined = true;
+
     JNIInstance jniInstance(_nativeMethodContext);
 
     jniInstance.PrepareCall();
@@ -27,4 +114,3 @@ STDMETHODIMP CPPToJavaProgress::SetTotal(UINT64 total)
 
     return jniInstance.IsExceptionOccurs() ? S_FALSE : S_OK ;
 }
-
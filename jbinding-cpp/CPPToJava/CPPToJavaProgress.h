@@ -11,6 +11,20 @@ private:
 	jmethodID _setTotalMethodID;
 	jmethodID _setCompletedMethodID;
 
+	// Throttling of SetCompleted() calls, copied from SetThrottling() settings on creation
+	UInt32 _minIntervalMillis;
+	UInt64 _minBytes;
+	bool _throttling;
+
+	UInt64 _total;
+	bool _totalDefined;
+	UInt64 _lastCompleted;
+	UInt64 _lastCompletedTime;
+	UInt64 _pendingCompleted;
+	bool _completedPending;
+
+	HRESULT CallSetCompleted(UInt64 completeValue);
+
 public:
 	MY_UNKNOWN_IMP
 /*
@@ -40,8 +54,34 @@ public:
 	    classname = "CPPToJavaProgress";
 		_setTotalMethodID = GetMethodId(initEnv, "setTotal", "(J)V");
 		_setCompletedMethodID = GetMethodId(initEnv, "setCompleted", "(J)V");
+
+		_total = 0;
+		_totalDefined = false;
+		_lastCompleted = 0;
+		_lastCompletedTime = 0;
+		_pendingCompleted = 0;
+		_completedPending = false;
+
+		GetThrottling(_minIntervalMillis, _minBytes);
+		_throttling = _minIntervalMillis != 0 || _minBytes != 0;
 	}
 
+	/**
+	 * Sets process-wide minimums between two forwarded SetCompleted() calls.
+	 * Intermediate calls get swallowed, until both the interval <code>minIntervalMillis</code>
+	 * elapses and the progress grows by <code>minBytes</code>. The final call
+	 * (progress reaches the total) and a call with lower value than the last forwarded one
+	 * are always forwarded. <code>0, 0</code> - no throttling. Thread safe.
+	 * Takes effect for the progress objects created afterwards.
+	 */
+	static void SetThrottling(UInt32 minIntervalMillis, UInt64 minBytes);
+	static void GetThrottling(UInt32 & minIntervalMillis, UInt64 & minBytes);
+
+	/**
+	 * Forwards the last swallowed SetCompleted() call, if any.
+	 */
+	HRESULT FlushProgress();
+
 	STDMETHOD(SetTotal)(UInt64 total) PURE;
 	STDMETHOD(SetCompleted)(const UInt64 *completeValue) PURE;
 };
@@ -200,8 +200,10 @@ jobject DoubleToObject(JNIEnv * env, double value) {
 jobject BSTRToObject(JNIEnv * env, BSTR value) {
 	localinit(env);
 
-	CMyComBSTR str(value);
-	return env->NewString(UnicodeHelper(str), str.Len());
+	if (!value) {
+		return UnicodeHelper(L"", 0).newString(env);
+	}
+	return UnicodeHelper(value, SysStringLen(value)).newString(env);
 }
 
 /**
@@ -227,7 +229,7 @@ jobject FILETIMEToObject(JNIEnv * env, FILETIME filetime) {
 jstring PropVariantToString(JNIEnv * env, PROPID propID, const PROPVARIANT &propVariant) {
 	UString string;
 	ConvertPropertyToString(string, propVariant, propID, true);
-	return env->NewString(UnicodeHelper(string), string.Len());
+	return UnicodeHelper(string, string.Len()).newString(env);
 }
 
 void ObjectToPropVariant(JNIInstance * jniInstance, jobject object,
@@ -244,7 +246,7 @@ void ObjectToPropVariant(JNIInstance * jniInstance, jobject object,
 		} else if (env->IsInstanceOf(object, g_StringClass)) {
 	        const jchar * jChars = env->GetStringChars((jstring)object, NULL);
 			BSTR bstr;
-	        StringToBstr(UnicodeHelper(jChars), &bstr);
+	        StringToBstr(UnicodeHelper(jChars, env->GetStringLength((jstring)object)), &bstr);
 			cPropVariant = bstr;
 	        env->ReleaseStringChars((jstring)object, jChars);
 		} else {
@@ -91,16 +91,29 @@ static CPPToJavaInStream * GetInStream(JNIEnv * env, jobject thiz)
 
 	pointer = env->GetLongField(thiz, g_InStreamAttributeFieldID);
 
-	if (!pointer)
-	{
-        throw SevenZipException("Can't perform action. InStream==NULL.");
-	}
+	// pointer is NULL, if the archive was opened from native volumes (no java stream)
 
 //    TRACE1("Getting STREAM: 0x%08X", (unsigned int)(Object *)(CPPToJavaInStream *)(void *)pointer);
 
     return (CPPToJavaInStream *)(void *)(size_t)pointer;
 }
 
+static void SetInStreamNativeMethodContext(CPPToJavaInStream * inStream, NativeMethodContext * nativeMethodContext)
+{
+	if (inStream)
+	{
+		inStream->SetNativMethodContext(nativeMethodContext);
+	}
+}
+
+static void ClearInStreamNativeMethodContext(CPPToJavaInStream * inStream)
+{
+	if (inStream)
+	{
+		inStream->ClearNativeMethodContext();
+	}
+}
+
 static void SetArchive(JNIEnv * env, jobject thiz, size_t pointer)
 {
 	localinit(env, thiz);
@@ -140,7 +153,7 @@ JBINDING_JNIEXPORT void JNICALL Java_net_sf_sevenzipjbinding_impl_InArchiveImpl_
 	}
 
 	CPPToJavaInStream * inStream = GetInStream(env, thiz);
-	inStream->SetNativMethodContext(&nativeMethodContext);
+	SetInStreamNativeMethodContext(inStream, &nativeMethodContext);
 
 	jint * indices = NULL;
 	UInt32 indicesCount = (UInt32)-1;
@@ -151,7 +164,7 @@ JBINDING_JNIEXPORT void JNICALL Java_net_sf_sevenzipjbinding_impl_InArchiveImpl_
 	{
 	    TRACE1("Error getting number of items from archive. Result: 0x%08X", result);
 		nativeMethodContext.ThrowSevenZipException(result, "Error getting number of items from archive");
-	    inStream->ClearNativeMethodContext();
+	    ClearInStreamNativeMethodContext(inStream);
 	    return;
 	}
 	if (indicesArray)
@@ -171,7 +184,7 @@ JBINDING_JNIEXPORT void JNICALL Java_net_sf_sevenzipjbinding_impl_InArchiveImpl_
 				nativeMethodContext.ThrowSevenZipException(result,
 						"Passed index for the extraction is incorrect: %i (Count of items in archive: %i)",
 						indices[i], numberOfItems);
-			    inStream->ClearNativeMethodContext();
+			    ClearInStreamNativeMethodContext(inStream);
 			    return;
 			}
 			if (lastIndex > indices[i])
@@ -182,12 +195,17 @@ JBINDING_JNIEXPORT void JNICALL Java_net_sf_sevenzipjbinding_impl_InArchiveImpl_
 			qsort(indices, indicesCount, 4, &CompareIndicies);
 	}
 
-	CMyComPtr<IArchiveExtractCallback> archiveExtractCallback = new CPPToJavaArchiveExtractCallback(&nativeMethodContext, env, archiveExtractCallbackObject);
+	CPPToJavaArchiveExtractCallback * archiveExtractCallbackSpec = new CPPToJavaArchiveExtractCallback(&nativeMethodContext, env, archiveExtractCallbackObject);
+	CMyComPtr<IArchiveExtractCallback> archiveExtractCallback = archiveExtractCallbackSpec;
 
 	TRACE1("Extracting %i items", indicesCount)
 	result = archive->Extract((UInt32*)indices, indicesCount, (Int32)testMode,
 	        archiveExtractCallback);
 
+	// Forward the last progress, that was swallowed by the progress throttling
+	if (result == S_OK)
+		result = archiveExtractCallbackSpec->FlushProgress();
+
 	archiveExtractCallback.Release();
 
 	if (indicesArray)
@@ -195,7 +213,7 @@ JBINDING_JNIEXPORT void JNICALL Java_net_sf_sevenzipjbinding_impl_InArchiveImpl_
 	else
 		delete [] indices;
 
-    inStream->ClearNativeMethodContext();
+    ClearInStreamNativeMethodContext(inStream);
 
 	if (result)
 	{
@@ -231,7 +249,7 @@ JBINDING_JNIEXPORT jint JNICALL Java_net_sf_sevenzipjbinding_impl_InArchiveImpl_
 
 	CMyComPtr<CPPToJavaInStream> inStream(p);
 
-    inStream->SetNativMethodContext(&nativeMethodContext);
+    SetInStreamNativeMethodContext(inStream, &nativeMethodContext);
 
     if (archive == NULL)
     {
@@ -243,7 +261,7 @@ JBINDING_JNIEXPORT jint JNICALL Java_net_sf_sevenzipjbinding_impl_InArchiveImpl_
 
 	CHECK_HRESULT(nativeMethodContext, archive->GetNumberOfItems(&result), "Error getting number of items from archive");
 
-	inStream->ClearNativeMethodContext();
+	ClearInStreamNativeMethodContext(inStream);
 
 	TRACE1("Returning: %u", result)
 
@@ -270,7 +288,7 @@ JBINDING_JNIEXPORT void JNICALL Java_net_sf_sevenzipjbinding_impl_InArchiveImpl_
 	CMyComPtr<IInArchive> archive(GetArchive(env, thiz));
 	CMyComPtr<CPPToJavaInStream> inStream(GetInStream(env, thiz));
 
-	inStream->SetNativMethodContext(&nativeMethodContext);
+	SetInStreamNativeMethodContext(inStream, &nativeMethodContext);
 
     if (archive == NULL)
     {
@@ -281,7 +299,10 @@ JBINDING_JNIEXPORT void JNICALL Java_net_sf_sevenzipjbinding_impl_InArchiveImpl_
     CHECK_HRESULT(nativeMethodContext, archive->Close(), "Error closing archive");
 
     archive->Release();
-    inStream->Release();
+    if (inStream)
+    {
+        inStream->Release();
+    }
 
     SetArchive(env, thiz, 0);
 
@@ -307,7 +328,7 @@ JBINDING_JNIEXPORT jint JNICALL Java_net_sf_sevenzipjbinding_impl_InArchiveImpl_
     CMyComPtr<IInArchive> archive(GetArchive(env, thiz));
     CMyComPtr<CPPToJavaInStream> inStream(GetInStream(env, thiz));
 
-    inStream->SetNativMethodContext(&nativeMethodContext);
+    SetInStreamNativeMethodContext(inStream, &nativeMethodContext);
 
     if (archive == NULL)
 	{
@@ -319,7 +340,7 @@ JBINDING_JNIEXPORT jint JNICALL Java_net_sf_sevenzipjbinding_impl_InArchiveImpl_
 
 	CHECK_HRESULT(nativeMethodContext, archive->GetNumberOfArchiveProperties(&result), "Error getting number of archive properties");
 
-	inStream->ClearNativeMethodContext();
+	ClearInStreamNativeMethodContext(inStream);
 
 	return result;
 
@@ -344,7 +365,7 @@ JBINDING_JNIEXPORT jobject JNICALL Java_net_sf_sevenzipjbinding_impl_InArchiveIm
     CMyComPtr<IInArchive> archive(GetArchive(env, thiz));
     CMyComPtr<CPPToJavaInStream> inStream(GetInStream(env, thiz));
 
-    inStream->SetNativMethodContext(&nativeMethodContext);
+    SetInStreamNativeMethodContext(inStream, &nativeMethodContext);
 
     if (archive == NULL)
     {
@@ -377,7 +398,7 @@ JBINDING_JNIEXPORT jobject JNICALL Java_net_sf_sevenzipjbinding_impl_InArchiveIm
 	env->SetObjectField(propertInfo, g_PropertyInfo_name, javaName);
 	env->SetObjectField(propertInfo, g_PropertyInfo_varType, javaType);
 
-	inStream->ClearNativeMethodContext();
+	ClearInStreamNativeMethodContext(inStream);
 
 	return propertInfo;
 
@@ -402,7 +423,7 @@ JBINDING_JNIEXPORT jobject JNICALL Java_net_sf_sevenzipjbinding_impl_InArchiveIm
     CMyComPtr<IInArchive> archive(GetArchive(env, thiz));
     CMyComPtr<CPPToJavaInStream> inStream(GetInStream(env, thiz));
 
-    inStream->SetNativMethodContext(&nativeMethodContext);
+    SetInStreamNativeMethodContext(inStream, &nativeMethodContext);
 
     if (archive == NULL)
     {
@@ -414,7 +435,7 @@ JBINDING_JNIEXPORT jobject JNICALL Java_net_sf_sevenzipjbinding_impl_InArchiveIm
 
 	CHECK_HRESULT1(nativeMethodContext, archive->GetArchiveProperty(propID, &PropVariant), "Error getting property mit Id: %lu", propID);
 
-	inStream->ClearNativeMethodContext();
+	ClearInStreamNativeMethodContext(inStream);
 
 	return PropVariantToObject(&jniInstance, &PropVariant);
 
@@ -439,7 +460,7 @@ JBINDING_JNIEXPORT jstring JNICALL Java_net_sf_sevenzipjbinding_impl_InArchiveIm
     CMyComPtr<IInArchive> archive(GetArchive(env, thiz));
     CMyComPtr<CPPToJavaInStream> inStream(GetInStream(env, thiz));
 
-    inStream->SetNativMethodContext(&nativeMethodContext);
+    SetInStreamNativeMethodContext(inStream, &nativeMethodContext);
 
     if (archive == NULL)
     {
@@ -451,7 +472,7 @@ JBINDING_JNIEXPORT jstring JNICALL Java_net_sf_sevenzipjbinding_impl_InArchiveIm
 
     CHECK_HRESULT1(nativeMethodContext, archive->GetArchiveProperty(propID, &PropVariant), "Error getting property mit Id: %lu", propID);
 
-    inStream->ClearNativeMethodContext();
+    ClearInStreamNativeMethodContext(inStream);
 
     return PropVariantToString(env, propID, PropVariant);
 
@@ -476,7 +497,7 @@ JBINDING_JNIEXPORT jint JNICALL Java_net_sf_sevenzipjbinding_impl_InArchiveImpl_
     CMyComPtr<IInArchive> archive(GetArchive(env, thiz));
     CMyComPtr<CPPToJavaInStream> inStream(GetInStream(env, thiz));
 
-    inStream->SetNativMethodContext(&nativeMethodContext);
+    SetInStreamNativeMethodContext(inStream, &nativeMethodContext);
 
     if (archive == NULL)
     {
@@ -488,7 +509,7 @@ JBINDING_JNIEXPORT jint JNICALL Java_net_sf_sevenzipjbinding_impl_InArchiveImpl_
 
 	CHECK_HRESULT(nativeMethodContext, archive->GetNumberOfProperties(&result), "Error getting number of properties");
 
-	inStream->ClearNativeMethodContext();
+	ClearInStreamNativeMethodContext(inStream);
 
 	return result;
 
@@ -513,7 +534,7 @@ JBINDING_JNIEXPORT jobject JNICALL Java_net_sf_sevenzipjbinding_impl_InArchiveIm
     CMyComPtr<IInArchive> archive(GetArchive(env, thiz));
     CMyComPtr<CPPToJavaInStream> inStream(GetInStream(env, thiz));
 
-    inStream->SetNativMethodContext(&nativeMethodContext);
+    SetInStreamNativeMethodContext(inStream, &nativeMethodContext);
 
     if (archive == NULL)
     {
@@ -526,7 +547,7 @@ JBINDING_JNIEXPORT jobject JNICALL Java_net_sf_sevenzipjbinding_impl_InArchiveIm
 //    TRACE3("Index: %i, PropID: %i, archive: 0x%08X", index, propID, (unsigned int)(Object *)(CPPToJavaInStream *)(void*)(*(&archive)))
     CHECK_HRESULT2(nativeMethodContext, archive->GetProperty(index, propID, &propVariant), "Error getting property with propID=%lu for item %i", propID, index);
 
-    inStream->ClearNativeMethodContext();
+    ClearInStreamNativeMethodContext(inStream);
 
 	return PropVariantToObject(&jniInstance, &propVariant);
 
@@ -551,7 +572,7 @@ JBINDING_JNIEXPORT jstring JNICALL Java_net_sf_sevenzipjbinding_impl_InArchiveIm
     CMyComPtr<IInArchive> archive(GetArchive(env, thiz));
     CMyComPtr<CPPToJavaInStream> inStream(GetInStream(env, thiz));
 
-    inStream->SetNativMethodContext(&nativeMethodContext);
+    SetInStreamNativeMethodContext(inStream, &nativeMethodContext);
 
     if (archive == NULL)
     {
@@ -563,7 +584,7 @@ JBINDING_JNIEXPORT jstring JNICALL Java_net_sf_sevenzipjbinding_impl_InArchiveIm
 
     CHECK_HRESULT2(nativeMethodContext, archive->GetProperty(index, propID, &propVariant), "Error getting property with propID=%lu for item %i", propID, index);
 
-    inStream->ClearNativeMethodContext();
+    ClearInStreamNativeMethodContext(inStream);
 
     return PropVariantToString(env, propID, propVariant);
 
@@ -588,7 +609,7 @@ JBINDING_JNIEXPORT jobject JNICALL Java_net_sf_sevenzipjbinding_impl_InArchiveIm
     CMyComPtr<IInArchive> archive(GetArchive(env, thiz));
     CMyComPtr<CPPToJavaInStream> inStream(GetInStream(env, thiz));
 
-    inStream->SetNativMethodContext(&nativeMethodContext);
+    SetInStreamNativeMethodContext(inStream, &nativeMethodContext);
 
     if (archive == NULL)
     {
@@ -621,7 +642,7 @@ JBINDING_JNIEXPORT jobject JNICALL Java_net_sf_sevenzipjbinding_impl_InArchiveIm
 	env->SetObjectField(propertInfo, g_PropertyInfo_name, javaName);
 	env->SetObjectField(propertInfo, g_PropertyInfo_varType, javaType);
 
-	inStream->ClearNativeMethodContext();
+	ClearInStreamNativeMethodContext(inStream);
 
 	return propertInfo;
 
@@ -8,7 +8,11 @@
 
 #include "net_sf_sevenzipjbinding_SevenZip.h"
 #include "CPPToJava/CPPToJavaInStream.h"
+#include "CPPToJava/CPPToJavaProgress.h"
 #include "UniversalArchiveOpenCallback.h"
+#include "7zip/Archive/Common/MultiVolumeInStream.h"
+#include "7zip/Common/DicPool.h"
+#include "../C/Alloc.h"
 
 #include "JNICallState.h"
 
@@ -65,29 +69,21 @@ void setArchiveFormat(JNIEnv * env, jobject inArchiveImplObject, const UString &
 	jclass c = env->GetObjectClass(inArchiveImplObject);
 	jmethodID methodId = env->GetMethodID(c, "setArchiveFormat", "(Ljava/lang/String;)V");
 
-	jstring jstring = env->NewString(UnicodeHelper(formatNameString), formatNameString.Len());
+	jstring jstring = UnicodeHelper(formatNameString, formatNameString.Len()).newString(env);
 	env->CallVoidMethod(inArchiveImplObject, methodId, jstring);
 	env->ExceptionClear();
 	return ;
 }
 
 
-/*
- * Class:     net_sf_sevenzip_SevenZip
- * Method:    nativeOpenArchive
- * Signature: (ILnet/sf/sevenzip/IInStream;Lnet/sf/sevenzip/IArchiveOpenCallback;)Lnet/sf/sevenzip/IInArchive;
+/**
+ * Open archive from the <code>stream</code> using format <code>formatName</code> or trying
+ * all registered formats, if <code>formatName</code> is NULL. Returns opened archive or NULL,
+ * if an exception will be thrown.
  */
-JBINDING_JNIEXPORT jobject JNICALL Java_net_sf_sevenzipjbinding_SevenZip_nativeOpenArchive(JNIEnv * env,
-		jclass thiz, jstring formatName, jobject inStream,
-		jobject archiveOpenCallbackImpl) {
-	TRACE("SevenZip.nativeOpenArchive()")
-
-	NativeMethodContext nativeMethodContext(env);
-
-	TRY
-
-	JNIInstance jniInstance(&nativeMethodContext);
-
+static IInArchive * OpenArchive(JNIEnv * env, NativeMethodContext & nativeMethodContext, JNIInstance & jniInstance,
+		jstring formatName, IInStream * stream, UniversalArchiveOpencallback * universalArchiveOpencallback,
+		UString & formatNameString) {
 	CCodecs *codecs = new CCodecs;
 
 	CMyComPtr<
@@ -119,11 +115,10 @@ JBINDING_JNIEXPORT jobject JNICALL Java_net_sf_sevenzipjbinding_SevenZip_nativeO
 	//}
 
 	int index = -1;
-	UString formatNameString;
 	if (formatName)
 	{
 		const jchar * formatNameJChars = env->GetStringChars(formatName, NULL);
-		formatNameString = UnicodeHelper(formatNameJChars);
+		formatNameString = UnicodeHelper(formatNameJChars, env->GetStringLength(formatName));
 		env->ReleaseStringChars(formatName, formatNameJChars);
 
 		TRACE1("Format: '%S'", (const wchar_t*)formatNameString)
@@ -135,9 +130,6 @@ JBINDING_JNIEXPORT jobject JNICALL Java_net_sf_sevenzipjbinding_SevenZip_nativeO
 	}
 
 	CMyComPtr<IInArchive> archive;
-	CMyComPtr<CPPToJavaInStream> stream = new CPPToJavaInStream(&nativeMethodContext, env, inStream);
-
-    UniversalArchiveOpencallback * universalArchiveOpencallback = new UniversalArchiveOpencallback(&nativeMethodContext, env, archiveOpenCallbackImpl, (CPPToJavaInStream *)stream);
 	CMyComPtr<IArchiveOpenCallback> archiveOpenCallback = universalArchiveOpencallback;
 
 	UInt64 maxCheckStartPosition = 4 * 1024 * 1024; // Advice from Igor Pavlov
@@ -196,6 +188,59 @@ JBINDING_JNIEXPORT jobject JNICALL Java_net_sf_sevenzipjbinding_SevenZip_nativeO
 
 	}
 
+	if (nativeMethodContext.WillExceptionBeThrown()){
+		archive->Close();
+		return NULL;
+	}
+
+	TRACE("Archive opened")
+
+	return archive.Detach();
+}
+
+static jobject CreateInArchiveImplObject(JNIEnv * env, IInArchive * archive, CPPToJavaInStream * stream,
+		const UString & formatNameString) {
+	jobject InArchiveImplObject = GetSimpleInstance(env, IN_ARCHIVE_IMPL);
+
+	setArchiveFormat(env, InArchiveImplObject, formatNameString);
+
+	SetLongAttribute(env, InArchiveImplObject, IN_ARCHIVE_IMPL_OBJ_ATTRIBUTE,
+			(jlong)(size_t)(void*)(archive));
+
+	SetLongAttribute(env, InArchiveImplObject, IN_STREAM_IMPL_OBJ_ATTRIBUTE,
+			(jlong)(size_t)(void*)(stream));
+
+	return InArchiveImplObject;
+}
+
+/*
+ * Class:     net_sf_sevenzip_SevenZip
+ * Method:    nativeOpenArchive
+ * Signature: (ILnet/sf/sevenzip/IInStream;Lnet/sf/sevenzip/IArchiveOpenCallback;)Lnet/sf/sevenzip/IInArchive;
+ */
+JBINDING_JNIEXPORT jobject JNICALL Java_net_sf_sevenzipjbinding_SevenZip_nativeOpenArchive(JNIEnv * env,
+		jclass thiz, jstring formatName, jobject inStream,
+		jobject archiveOpenCallbackImpl) {
+	TRACE("SevenZip.nativeOpenArchive()")
+
+	NativeMethodContext nativeMethodContext(env);
+
+	TRY
+
+	JNIInstance jniInstance(&nativeMethodContext);
+
+	CMyComPtr<CPPToJavaInStream> stream = new CPPToJavaInStream(&nativeMethodContext, env, inStream);
+
+    UniversalArchiveOpencallback * universalArchiveOpencallback = new UniversalArchiveOpencallback(&nativeMethodContext, env, archiveOpenCallbackImpl, (CPPToJavaInStream *)stream);
+	CMyComPtr<IArchiveOpenCallback> archiveOpenCallback = universalArchiveOpencallback;
+
+	UString formatNameString;
+	IInArchive * archive = OpenArchive(env, nativeMethodContext, jniInstance, formatName, stream,
+			universalArchiveOpencallback, formatNameString);
+	if (!archive) {
+		return NULL;
+	}
+
 /*
 	if (CreateArchiver(&guids[format], &IID_IInArchive, (void **)&archive) != S_OK)
 	{
@@ -228,29 +273,156 @@ JBINDING_JNIEXPORT jobject JNICALL Java_net_sf_sevenzipjbinding_SevenZip_nativeO
 	}
 */
 
-	if (nativeMethodContext.WillExceptionBeThrown()){
-		archive->Close();
+	jobject InArchiveImplObject = CreateInArchiveImplObject(env, archive, stream, formatNameString);
+
+	stream->ClearNativeMethodContext();
+
+	stream.Detach();
+
+	return InArchiveImplObject;
+
+	CATCH_SEVEN_ZIP_EXCEPTION(nativeMethodContext, NULL);
+}
+
+/*
+ * Class:     net_sf_sevenzip_SevenZip
+ * Method:    nativeOpenMultiVolumeArchive
+ * Signature: (Ljava/lang/String;Ljava/lang/String;Lnet/sf/sevenzipjbinding/IArchiveOpenCallback;)Lnet/sf/sevenzipjbinding/ISevenZipInArchive;
+ */
+JBINDING_JNIEXPORT jobject JNICALL Java_net_sf_sevenzipjbinding_SevenZip_nativeOpenMultiVolumeArchive(JNIEnv * env,
+		jclass thiz, jstring formatName, jstring firstVolumePath,
+		jobject archiveOpenCallbackImpl) {
+	TRACE("SevenZip.nativeOpenMultiVolumeArchive()")
+
+	NativeMethodContext nativeMethodContext(env);
+
+	TRY
+
+	JNIInstance jniInstance(&nativeMethodContext);
+
+	const jchar * firstVolumePathJChars = env->GetStringChars(firstVolumePath, NULL);
+	UString firstVolumePathString;
+	firstVolumePathString = UnicodeHelper(firstVolumePathJChars, env->GetStringLength(firstVolumePath));
+	env->ReleaseStringChars(firstVolumePath, firstVolumePathJChars);
+
+	CMultiVolumeInStream * volumes = new CMultiVolumeInStream;
+	CMyComPtr<IInStream> volumesStream = volumes;
+
+	HRESULT result = volumes->Open(firstVolumePathString);
+	if (result != S_OK) {
+		nativeMethodContext.ThrowSevenZipException(result, "Can't open volumes of the archive '%S'",
+				(const wchar_t *)firstVolumePathString);
 		return NULL;
 	}
 
-	TRACE("Archive opened")
+	TRACE1("Volumes found: %i", (int)volumes->Streams.Size())
 
+    UniversalArchiveOpencallback * universalArchiveOpencallback = new UniversalArchiveOpencallback(&nativeMethodContext, env, archiveOpenCallbackImpl, NULL);
+	CMyComPtr<IArchiveOpenCallback> archiveOpenCallback = universalArchiveOpencallback;
 
-	jobject InArchiveImplObject = GetSimpleInstance(env, IN_ARCHIVE_IMPL);
+	// Volumes of the byte level splits get concatenated. Other volumes
+	// (RAR) get requested by the archive handler by name.
+	CMyComPtr<IInStream> stream = volumesStream;
+	if (!volumes->IsConcatenated()) {
+		stream = volumes->Streams[0].Stream;
+		CMyComPtr<IArchiveOpenVolumeCallback> volumeCallback = new CMultiVolumeOpenCallback(volumes);
+		universalArchiveOpencallback->setArchiveOpenVolumeCallback(volumeCallback);
+	}
 
-	setArchiveFormat(env, InArchiveImplObject, formatNameString);
+	UString formatNameString;
+	IInArchive * archive = OpenArchive(env, nativeMethodContext, jniInstance, formatName, stream,
+			universalArchiveOpencallback, formatNameString);
+	if (!archive) {
+		return NULL;
+	}
 
-	SetLongAttribute(env, InArchiveImplObject, IN_ARCHIVE_IMPL_OBJ_ATTRIBUTE,
-			(jlong)(size_t)(void*)(archive.Detach()));
+	// The archive holds references to the volume streams it needs. There is no java stream
+	// to attach the native method context to.
+	return CreateInArchiveImplObject(env, archive, NULL, formatNameString);
 
-	SetLongAttribute(env, InArchiveImplObject, IN_STREAM_IMPL_OBJ_ATTRIBUTE,
-			(jlong)(size_t)(void*)(stream));
+	CATCH_SEVEN_ZIP_EXCEPTION(nativeMethodContext, NULL);
+}
 
-	stream->ClearNativeMethodContext();
+/*
+ * Class:     net_sf_sevenzip_SevenZip
+ * Method:    nativeGetDecoderPoolStats
+ * Signature: ([J)V
+ */
+JBINDING_JNIEXPORT void JNICALL Java_net_sf_sevenzipjbinding_SevenZip_nativeGetDecoderPoolStats(JNIEnv * env,
+		jclass thiz, jlongArray statsArray) {
+	TRACE("SevenZip.nativeGetDecoderPoolStats()")
+
+	NDicPool::CStats stats;
+	NDicPool::GetStats(stats);
+
+	// The order must match SevenZip.getDecoderPoolStats()
+	jlong values[7];
+	values[0] = (jlong)stats.Limit;
+	values[1] = (jlong)stats.CachedSize;
+	values[2] = (jlong)stats.UsedSize;
+	values[3] = (jlong)stats.NumCached;
+	values[4] = (jlong)stats.NumHits;
+	values[5] = (jlong)stats.NumMisses;
+	values[6] = (jlong)stats.NumTrimmed;
+	env->SetLongArrayRegion(statsArray, 0, 7, values);
+}
 
-	stream.Detach();
+/*
+ * Class:     net_sf_sevenzip_SevenZip
+ * Method:    nativeSetDecoderPoolLimit
+ * Signature: (J)V
+ */
+JBINDING_JNIEXPORT void JNICALL Java_net_sf_sevenzipjbinding_SevenZip_nativeSetDecoderPoolLimit(JNIEnv * env,
+		jclass thiz, jlong limit) {
+	TRACE1("SevenZip.nativeSetDecoderPoolLimit(%lli)", (long long)limit)
 
-	return InArchiveImplObject;
+	NDicPool::SetLimit((UInt64)limit);
+}
 
-	CATCH_SEVEN_ZIP_EXCEPTION(nativeMethodContext, NULL);
+/*
+ * Class:     net_sf_sevenzip_SevenZip
+ * Method:    nativeTrimDecoderPool
+ * Signature: (J)V
+ */
+JBINDING_JNIEXPORT void JNICALL Java_net_sf_sevenzipjbinding_SevenZip_nativeTrimDecoderPool(JNIEnv * env,
+		jclass thiz, jlong maxCachedSize) {
+	TRACE1("SevenZip.nativeTrimDecoderPool(%lli)", (long long)maxCachedSize)
+
+	NDicPool::Trim((UInt64)maxCachedSize);
+}
+
+/*
+ * Class:     net_sf_sevenzip_SevenZip
+ * Method:    nativeSetHugePagesThreshold
+ * Signature: (J)V
+ */
+JBINDING_JNIEXPORT void JNICALL Java_net_sf_sevenzipjbinding_SevenZip_nativeSetHugePagesThreshold(JNIEnv * env,
+		jclass thiz, jlong threshold) {
+	TRACE1("SevenZip.nativeSetHugePagesThreshold(%lli)", (long long)threshold)
+
+	SetHugePagesThreshold((size_t)threshold);
+}
+
+/*
+ * Class:     net_sf_sevenzip_SevenZip
+ * Method:    nativeSetNumaLocalAllocation
+ * Signature: (Z)V
+ */
+JBINDING_JNIEXPORT void JNICALL Java_net_sf_sevenzipjbinding_SevenZip_nativeSetNumaLocalAllocation(JNIEnv * env,
+		jclass thiz, jboolean enable) {
+	TRACE1("SevenZip.nativeSetNumaLocalAllocation(%i)", (int)enable)
+
+	SetNumaLocalAlloc(enable ? 1 : 0);
+}
+
+/*
+ * Class:     net_sf_sevenzip_SevenZip
+ * Method:    nativeSetProgressThrottling
+ * Signature: (JJ)V
+ */
+JBINDING_JNIEXPORT void JNICALL Java_net_sf_sevenzipjbinding_SevenZip_nativeSetProgressThrottling(JNIEnv * env,
+		jclass thiz, jlong minIntervalMillis, jlong minBytes) {
+	TRACE2("SevenZip.nativeSetProgressThrottling(%lli, %lli)", (long long)minIntervalMillis, (long long)minBytes)
+
+	CPPToJavaProgress::SetThrottling((UInt32)minIntervalMillis, (UInt64)minBytes);
 }
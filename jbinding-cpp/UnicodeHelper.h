@@ -3,55 +3,89 @@
 
 #include "SevenZipJBinding.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define UNICODEHELPER_SSE2
+#include <emmintrin.h>
+#endif
+
 /**
  * Helper class to convert between wchar_t and jchar.
  * On some machines sizeof(wchar_t) != sizeof(jchar)
  *
- * TODO Write a C++ test for this class
+ * A 4-byte wchar_t holds UTF-32, while jchar is UTF-16: characters above U+FFFF
+ * are converted to and from surrogate pairs. Short strings are converted into
+ * a buffer inside the object, so the helper should live on the stack.
+ *
+ * Passwords must not be joined: see toCodeUnits().
+ * Tests: test/NativeTests/UnicodeHelperTest.cpp
  */
 class UnicodeHelper {
 private:
+	enum {
+		STACK_BUFFER_SIZE = 256 // in wchar_t
+	};
+
 	const wchar_t * _unicodeString;
 	wchar_t * _unicodeBuffer;
 
 	const jchar * _jcharString;
 	jchar * _jcharBuffer;
 
+	// Length of the source string or (size_t)-1, if it is NUL terminated
+	size_t _length;
+	size_t _jcharLength;
+
+	union {
+		wchar_t _unicodeStackBuffer[STACK_BUFFER_SIZE];
+		jchar _jcharStackBuffer[STACK_BUFFER_SIZE * sizeof(wchar_t) / sizeof(jchar)];
+	};
+
+	void init() {
+		_unicodeBuffer = NULL;
+		_jcharBuffer = NULL;
+		_jcharLength = 0;
+	}
+
 public:
 	UnicodeHelper(const wchar_t * unicodeString) {
 		_unicodeString = unicodeString;
 		_jcharString = NULL;
-		_jcharBuffer = NULL;
-		_unicodeBuffer = NULL;
+		_length = (size_t)-1;
+		init();
+	}
+
+	UnicodeHelper(const wchar_t * unicodeString, size_t length) {
+		_unicodeString = unicodeString;
+		_jcharString = NULL;
+		_length = length;
+		init();
 	}
 
 	UnicodeHelper(const jchar * jcharString) {
 		_jcharString = jcharString;
 		_unicodeString = NULL;
-		_jcharBuffer = NULL;
-		_unicodeBuffer = NULL;
+		_length = (size_t)-1;
+		init();
+	}
+
+	/**
+	 * Strings from GetStringChars() are not NUL terminated:
+	 * pass GetStringLength() as length.
+	 */
+	UnicodeHelper(const jchar * jcharString, size_t length) {
+		_jcharString = jcharString;
+		_unicodeString = NULL;
+		_length = length;
+		init();
 	}
 
 	~UnicodeHelper() {
-//		TRACE("~UnicodeHelper()");
-		if (_jcharBuffer) {
-//			TRACE("Freeing jchar string");
-#ifndef _DEBUG
-			size_t len = wcslen(_unicodeString);
-			memset(_jcharBuffer, 0, sizeof(jchar) * (len + 1));
-#endif // _DEBUG
+		if (_jcharBuffer != _jcharStackBuffer) {
 			delete[] _jcharBuffer;
 		}
-
-		if (_unicodeBuffer) {
-//			TRACE("Freeing unicode string");
-#ifndef _DEBUG
-			size_t len = jcharlen(_jcharString);
-			memset(_unicodeBuffer, 0, sizeof(wchar_t) * (len + 1));
-#endif // _DEBUG
+		if (_unicodeBuffer != _unicodeStackBuffer) {
 			delete[] _unicodeBuffer;
 		}
-
 	}
 
 	operator const jchar *() {
@@ -60,16 +94,20 @@ public:
 		}
 
 		TRACE1("Converting wchar_t=>jchar: \"%S\"", _unicodeString)
+		size_t len = _length != (size_t)-1 ? _length : wcslen(_unicodeString);
 		if (sizeof(wchar_t) == sizeof(jchar)) {
+			_jcharLength = len;
 			_jcharString = (const jchar *)( _unicodeString);
 			return _jcharString;
 		}
-		size_t len = wcslen(_unicodeString);
-		_jcharBuffer = new jchar[len + 1];
-		for (size_t i = 0; i < len; i++) {
-			_jcharBuffer[i] = (jchar) _unicodeString[i];
+		// Each wchar_t needs one or two jchar
+		if (len < sizeof(_jcharStackBuffer) / sizeof(jchar) / 2) {
+			_jcharBuffer = _jcharStackBuffer;
+		} else {
+			_jcharBuffer = new jchar[len * 2 + 1];
 		}
-		_jcharBuffer[len] = 0;
+		_jcharLength = toJChars(_jcharBuffer, _unicodeString, len);
+		_jcharBuffer[_jcharLength] = 0;
 
 		return _jcharString = _jcharBuffer;
 	}
@@ -79,22 +117,51 @@ public:
 			return _unicodeString;
 		}
 //		TRACE("Converting jchar=>wchar_t ...")
-		if (sizeof(wchar_t) == sizeof(jchar)) {
+		if (sizeof(wchar_t) == sizeof(jchar) && _length == (size_t)-1) {
 			_unicodeString = (wchar_t*) (_jcharString);
 			return _unicodeString;
 		}
-		size_t len = jcharlen(_jcharString);
+		size_t len = _length != (size_t)-1 ? _length : jcharlen(_jcharString);
 //		TRACE1("len: %i" , len)
-		_unicodeBuffer = new wchar_t[len + 1];
-		for (size_t i = 0; i < len; i++) {
-			_unicodeBuffer[i] = (wchar_t) _jcharString[i];
+		if (len < STACK_BUFFER_SIZE) {
+			_unicodeBuffer = _unicodeStackBuffer;
+		} else {
+			_unicodeBuffer = new wchar_t[len + 1];
 		}
-		_unicodeBuffer[len] = 0;
+		_unicodeBuffer[toUnicode(_unicodeBuffer, _jcharString, len)] = 0;
 
 		TRACE1("Converting jchar=>wchar_t done: \"%S\"", _unicodeBuffer);
 		return _unicodeString = _unicodeBuffer;
 	}
 
+	/**
+	 * Length of the string returned by <code>operator const jchar *()</code>.
+	 * With 4-byte wchar_t it may be longer than the source string.
+	 */
+	size_t getJCharLength() {
+		operator const jchar *();
+		return _jcharLength;
+	}
+
+	/**
+	 * Copy UTF-16 code units to wchar_t one by one without joining surrogate pairs.
+	 * 7z and RAR handlers build the AES key from the password by writing each wchar_t
+	 * as two bytes, so the password must stay UTF-16 like on Windows.
+	 */
+	static void toCodeUnits(wchar_t * dest, const jchar * src, size_t len) {
+		for (size_t i = 0; i < len; i++) {
+			dest[i] = (wchar_t) src[i];
+		}
+	}
+
+	/**
+	 * Create java.lang.String from the wchar_t string
+	 */
+	jstring newString(JNIEnv * env) {
+		const jchar * jcharString = *this;
+		return env->NewString(jcharString, (jsize) _jcharLength);
+	}
+
 private:
 	static size_t jcharlen(const jchar * jcharString) {
 		size_t len = 0;
@@ -105,6 +172,85 @@ private:
 		return len;
 	}
 
+	/**
+	 * Convert UTF-32 to UTF-16. Returns the number of written jchar (up to len * 2).
+	 * Code points above U+10FFFF are replaced with U+FFFD.
+	 */
+	static size_t toJChars(jchar * dest, const wchar_t * src, size_t len) {
+		jchar * start = dest;
+		size_t i = 0;
+#ifdef UNICODEHELPER_SSE2
+		if (sizeof(wchar_t) == 4) {
+			// packs_epi32 saturates signed values, so the range is shifted by 0x8000
+			const __m128i bias32 = _mm_set1_epi32(0x8000);
+			const __m128i bias16 = _mm_set1_epi16((short)0x8000);
+			const __m128i zero = _mm_setzero_si128();
+			for (; i + 8 <= len; i += 8) {
+				__m128i v0 = _mm_loadu_si128((const __m128i *)(const void *)(src + i));
+				__m128i v1 = _mm_loadu_si128((const __m128i *)(const void *)(src + i + 4));
+				__m128i hi = _mm_srli_epi32(_mm_or_si128(v0, v1), 16);
+				if (_mm_movemask_epi8(_mm_cmpeq_epi32(hi, zero)) != 0xFFFF) {
+					break;
+				}
+				__m128i v = _mm_packs_epi32(_mm_sub_epi32(v0, bias32), _mm_sub_epi32(v1, bias32));
+				_mm_storeu_si128((__m128i *)(void *)dest, _mm_add_epi16(v, bias16));
+				dest += 8;
+			}
+		}
+#endif
+		for (; i < len; i++) {
+			UInt32 c = (UInt32) src[i];
+			if (c < 0x10000) {
+				*dest++ = (jchar) c;
+			} else if (c < 0x110000) {
+				c -= 0x10000;
+				*dest++ = (jchar) (0xD800 + (c >> 10));
+				*dest++ = (jchar) (0xDC00 + (c & 0x3FF));
+			} else {
+				*dest++ = 0xFFFD;
+			}
+		}
+		return (size_t)(dest - start);
+	}
+
+	/**
+	 * Convert UTF-16 to UTF-32 (or copy to 2-byte wchar_t).
+	 * Returns the number of written wchar_t (up to len).
+	 * Unpaired surrogates are copied as is.
+	 */
+	static size_t toUnicode(wchar_t * dest, const jchar * src, size_t len) {
+		if (sizeof(wchar_t) == sizeof(jchar)) {
+			memcpy(dest, src, len * sizeof(jchar));
+			return len;
+		}
+		wchar_t * start = dest;
+		size_t i = 0;
+#ifdef UNICODEHELPER_SSE2
+		if (sizeof(wchar_t) == 4) {
+			const __m128i mask = _mm_set1_epi16((short)0xF800);
+			const __m128i surrogate = _mm_set1_epi16((short)0xD800);
+			const __m128i zero = _mm_setzero_si128();
+			for (; i + 8 <= len; i += 8) {
+				__m128i v = _mm_loadu_si128((const __m128i *)(const void *)(src + i));
+				if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(v, mask), surrogate)) != 0) {
+					break;
+				}
+				_mm_storeu_si128((__m128i *)(void *)dest, _mm_unpacklo_epi16(v, zero));
+				_mm_storeu_si128((__m128i *)(void *)(dest + 4), _mm_unpackhi_epi16(v, zero));
+				dest += 8;
+			}
+		}
+#endif
+		for (; i < len; i++) {
+			UInt32 c = src[i];
+			if (c >= 0xD800 && c < 0xDC00 && i + 1 < len
+					&& src[i + 1] >= 0xDC00 && src[i + 1] < 0xE000) {
+				c = 0x10000 + ((c - 0xD800) << 10) + (src[++i] - 0xDC00);
+			}
+			*dest++ = (wchar_t) c;
+		}
+		return (size_t)(dest - start);
+	}
 };
 
 #endif // UNICODEHELPER_
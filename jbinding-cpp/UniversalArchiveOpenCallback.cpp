@@ -32,7 +32,8 @@ void UniversalArchiveOpencallback::Init(NativeMethodContext * nativeMethodContex
         _cryptoGetTextPassword = cryptoGetTextPasswordComPtr.Detach();
     }
 
-    if (initEnv->IsInstanceOf(archiveOpenCallbackImpl, archiveOpenVolumeCallbackClass))
+    // lastVolume is NULL, if the volumes are opened natively
+    if (lastVolume && initEnv->IsInstanceOf(archiveOpenCallbackImpl, archiveOpenVolumeCallbackClass))
     {
     	TRACE("implements IArchiveOpenVolumeCallback")
         CMyComPtr<IArchiveOpenVolumeCallback> archiveOpenVolumeCallbackComPtr =
@@ -52,6 +52,18 @@ public:
         _simulateArchiveOpenVolumeCallback = value;
     }
 
+    /**
+     * Replace volume callback implemented in java with the native one.
+     */
+    void setArchiveOpenVolumeCallback(IArchiveOpenVolumeCallback * archiveOpenVolumeCallback) {
+        archiveOpenVolumeCallback->AddRef();
+        if (_archiveOpenVolumeCallback)
+        {
+            _archiveOpenVolumeCallback->Release();
+        }
+        _archiveOpenVolumeCallback = archiveOpenVolumeCallback;
+    }
+
     STDMETHOD(QueryInterface)(REFGUID iid, void **outObject);
 
     STDMETHOD_(ULONG, AddRef)()
@@ -95,6 +95,12 @@ package net.sf.sevenzipjbinding;
  * <td>{@link #LZH}</td>
  * </tr>
  * <tr align="center">
+ * <td>Lz4</td>
+ * <td>X</td>
+ * <td>-</td>
+ * <td>{@link #LZ4}</td>
+ * </tr>
+ * <tr align="center">
  * <td>Lzma</td>
  * <td>X</td>
  * <td>X</td>
@@ -178,6 +184,12 @@ package net.sf.sevenzipjbinding;
  * <td>X</td>
  * <td>{@link #ZIP}</td>
  * </tr>
+ * <tr align="center">
+ * <td>Zstd</td>
+ * <td>X</td>
+ * <td>-</td>
+ * <td>{@link #ZSTD}</td>
+ * </tr>
  * </table>
  * <blockquote> <br>
  *
@@ -293,7 +305,17 @@ public enum ArchiveFormat {
     /**
      * Xar
      */
-	XAR("Xar");
+	XAR("Xar"),
+
+	/**
+	 * Zstandard format
+	 */
+	ZSTD("zstd"),
+
+	/**
+	 * LZ4 frame format
+	 */
+	LZ4("lz4");
 
 	private String methodName;
 
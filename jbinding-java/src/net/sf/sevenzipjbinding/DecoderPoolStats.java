@@ -0,0 +1,57 @@
+package net.sf.sevenzipjbinding;
+
+/**
+ * Statistics of the native pool of decoder dictionaries and buffers. The pool is shared by all threads and all
+ * opened archives. Dictionaries of the LZMA, LZMA2 and PPMd decoders released at the end of an extraction are kept in
+ * the pool to be reused by the next extraction with a dictionary of the same size.
+ *
+ * @see SevenZip#getDecoderPoolStats()
+ * @see SevenZip#setDecoderPoolLimit(long)
+ * @see SevenZip#trimDecoderPool(long)
+ */
+public class DecoderPoolStats {
+	/**
+	 * Maximal size of the cached buffers in bytes. <code>0</code> - pool is disabled.
+	 */
+	public long limit;
+
+	/**
+	 * Size of the released buffers cached in the pool in bytes.
+	 */
+	public long cachedSize;
+
+	/**
+	 * Size of the pooled buffers currently used by decoders in bytes.
+	 */
+	public long usedSize;
+
+	/**
+	 * Count of the released buffers cached in the pool.
+	 */
+	public long cachedCount;
+
+	/**
+	 * Count of the allocations satisfied from the pool.
+	 */
+	public long hitCount;
+
+	/**
+	 * Count of the allocations of new buffers.
+	 */
+	public long missCount;
+
+	/**
+	 * Count of the buffers freed due to the pool limit or trimming.
+	 */
+	public long trimmedCount;
+
+	/**
+	 * {@inheritDoc}
+	 */
+	@Override
+	public String toString() {
+		return "limit=" + limit + "; cachedSize=" + cachedSize + "; usedSize=" + usedSize + "; cachedCount="
+				+ cachedCount + "; hitCount=" + hitCount + "; missCount=" + missCount + "; trimmedCount="
+				+ trimmedCount;
+	}
+}
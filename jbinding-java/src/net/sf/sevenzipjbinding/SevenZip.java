@@ -652,6 +652,175 @@ public class SevenZip {
 		return callNativeOpenArchive(null, inStream, new DummyOpenArchiveCallback());
 	}
 
+	/**
+	 * Open multi-volume archive of type <code>archiveFormat</code> from the file system. All volumes of the archive get
+	 * opened natively by the naming pattern of the first volume out of the directory of the first volume. Supported
+	 * naming patterns:
+	 * <ul>
+	 * <li><code>name.7z.001</code>, <code>name.7z.002</code>, ... - byte level splits (concatenated)</li>
+	 * <li><code>name.z01</code>, <code>name.z02</code>, ..., <code>name.zip</code> - zip split sets (concatenated)</li>
+	 * <li><code>name.part1.rar</code>, <code>name.part2.rar</code>, ... - RAR volumes</li>
+	 * <li><code>name.rar</code>, <code>name.r00</code>, <code>name.r01</code>, ... - RAR volumes (old naming)</li>
+	 * </ul>
+	 * All volumes stay open until the archive is closed. No calls to java get made to access the volumes.
+	 *
+	 * @param archiveFormat
+	 *            (optional) format of archive. If <code>null</code> archive format will be auto-detected.
+	 * @param firstVolumePath
+	 *            path to the first volume of the archive
+	 * @param archiveOpenCallback
+	 *            archive open call back listener to use. You can optionally implement {@link ICryptoGetTextPassword} to
+	 *            specify password to use. Implementation of {@link IArchiveOpenVolumeCallback} will be ignored.
+	 * @return implementation of {@link ISevenZipInArchive} which represents opened archive.
+	 *
+	 * @throws SevenZipException
+	 *             7-Zip or 7-Zip-JBinding intern error occur. Check exception message for more information.
+	 * @throws NullPointerException
+	 *             is thrown, if firstVolumePath is null
+	 *
+	 * @see #openMultiVolumeInArchive(ArchiveFormat, String)
+	 */
+	public static ISevenZipInArchive openMultiVolumeInArchive(ArchiveFormat archiveFormat, String firstVolumePath,
+			IArchiveOpenCallback archiveOpenCallback) throws SevenZipException {
+		ensureLibraryIsInitialized();
+		if (firstVolumePath == null) {
+			throw new NullPointerException("SevenZip.openMultiVolumeInArchive(...): firstVolumePath parameter is null");
+		}
+		if (archiveFormat != null) {
+			return nativeOpenMultiVolumeArchive(archiveFormat.getMethodName(), firstVolumePath, archiveOpenCallback);
+		}
+		return nativeOpenMultiVolumeArchive(null, firstVolumePath, archiveOpenCallback);
+	}
+
+	/**
+	 * Open multi-volume archive of type <code>archiveFormat</code> from the file system. See
+	 * {@link #openMultiVolumeInArchive(ArchiveFormat, String, IArchiveOpenCallback)} for details.
+	 *
+	 * @param archiveFormat
+	 *            (optional) format of archive. If <code>null</code> archive format will be auto-detected.
+	 * @param firstVolumePath
+	 *            path to the first volume of the archive
+	 * @return implementation of {@link ISevenZipInArchive} which represents opened archive.
+	 *
+	 * @throws SevenZipException
+	 *             7-Zip or 7-Zip-JBinding intern error occur. Check exception message for more information.
+	 * @throws NullPointerException
+	 *             is thrown, if firstVolumePath is null
+	 *
+	 * @see #openMultiVolumeInArchive(ArchiveFormat, String, IArchiveOpenCallback)
+	 */
+	public static ISevenZipInArchive openMultiVolumeInArchive(ArchiveFormat archiveFormat, String firstVolumePath)
+			throws SevenZipException {
+		return openMultiVolumeInArchive(archiveFormat, firstVolumePath, new DummyOpenArchiveCallback());
+	}
+
+	/**
+	 * Returns statistics of the native pool of decoder dictionaries and buffers. See {@link DecoderPoolStats}.
+	 *
+	 * @return current statistics of the pool
+	 */
+	public static DecoderPoolStats getDecoderPoolStats() {
+		ensureLibraryIsInitialized();
+		long[] values = new long[7];
+		nativeGetDecoderPoolStats(values);
+		DecoderPoolStats stats = new DecoderPoolStats();
+		stats.limit = values[0];
+		stats.cachedSize = values[1];
+		stats.usedSize = values[2];
+		stats.cachedCount = values[3];
+		stats.hitCount = values[4];
+		stats.missCount = values[5];
+		stats.trimmedCount = values[6];
+		return stats;
+	}
+
+	/**
+	 * Sets the maximal size of the released decoder dictionaries and buffers kept in the native pool for reuse. The
+	 * least recently released buffers get freed, if the limit is exceeded. The default limit is 512 MB (128 MB on 32
+	 * bit platforms).
+	 *
+	 * @param limit
+	 *            maximal size of the cached buffers in bytes. <code>0</code> disables the pool and frees all cached
+	 *            buffers.
+	 */
+	public static void setDecoderPoolLimit(long limit) {
+		ensureLibraryIsInitialized();
+		if (limit < 0) {
+			throw new IllegalArgumentException("SevenZip.setDecoderPoolLimit(...): limit is negative: " + limit);
+		}
+		nativeSetDecoderPoolLimit(limit);
+	}
+
+	/**
+	 * Frees the least recently released buffers of the native decoder pool, until the size of the cached buffers
+	 * doesn't exceed <code>maxCachedSize</code>. Buffers in use by decoders are not affected.
+	 *
+	 * @param maxCachedSize
+	 *            size of the cached buffers to keep in bytes. <code>0</code> frees all cached buffers.
+	 */
+	public static void trimDecoderPool(long maxCachedSize) {
+		ensureLibraryIsInitialized();
+		if (maxCachedSize < 0) {
+			throw new IllegalArgumentException("SevenZip.trimDecoderPool(...): maxCachedSize is negative: "
+					+ maxCachedSize);
+		}
+		nativeTrimDecoderPool(maxCachedSize);
+	}
+
+	/**
+	 * Sets the minimal size of the native dictionary and match finder buffers, for which transparent huge pages get
+	 * requested (Linux only). Huge pages reduce TLB misses on random access to big dictionaries. The default threshold
+	 * is 4 MB.
+	 *
+	 * @param threshold
+	 *            minimal size of the buffer in bytes. <code>0</code> disables transparent huge pages.
+	 */
+	public static void setHugePagesThreshold(long threshold) {
+		ensureLibraryIsInitialized();
+		if (threshold < 0) {
+			throw new IllegalArgumentException("SevenZip.setHugePagesThreshold(...): threshold is negative: "
+					+ threshold);
+		}
+		nativeSetHugePagesThreshold(threshold);
+	}
+
+	/**
+	 * Enables or disables NUMA local allocation (Linux only). If enabled, big native buffers get bound to the NUMA node
+	 * of the allocating thread and the native worker threads of the match finder and of multi-threaded coders get
+	 * pinned to the CPUs of that node. Disabled by default.
+	 *
+	 * @param enable
+	 *            <code>true</code> - enable NUMA local allocation
+	 */
+	public static void setNumaLocalAllocation(boolean enable) {
+		ensureLibraryIsInitialized();
+		nativeSetNumaLocalAllocation(enable);
+	}
+
+	/**
+	 * Sets the throttling of the progress notifications {@link IProgress#setCompleted(long)} for all extractions.
+	 * Intermediate notifications get swallowed natively without a call to java, until both the interval
+	 * <code>minIntervalMillis</code> elapsed and the progress grew by <code>minBytes</code> since the last forwarded
+	 * notification. The final notification (progress reaches the total) is always forwarded. By default, there is no
+	 * throttling. The settings apply to the extractions started after the call.
+	 *
+	 * @param minIntervalMillis
+	 *            minimal interval between two notifications in milliseconds. <code>0</code> - no limit.
+	 * @param minBytes
+	 *            minimal growth of the progress between two notifications. <code>0</code> - no limit.
+	 */
+	public static void setProgressThrottling(long minIntervalMillis, long minBytes) {
+		ensureLibraryIsInitialized();
+		if (minIntervalMillis < 0 || minIntervalMillis > Integer.MAX_VALUE) {
+			throw new IllegalArgumentException("SevenZip.setProgressThrottling(...): minIntervalMillis is out of range: "
+					+ minIntervalMillis);
+		}
+		if (minBytes < 0) {
+			throw new IllegalArgumentException("SevenZip.setProgressThrottling(...): minBytes is negative: " + minBytes);
+		}
+		nativeSetProgressThrottling(minIntervalMillis, minBytes);
+	}
+
 	private static void ensureLibraryIsInitialized() {
 		if (autoInitializationWillOccur) {
 			autoInitializationWillOccur = false;
@@ -765,8 +934,23 @@ public class SevenZip {
 	private static native ISevenZipInArchive nativeOpenArchive(String formatName, IInStream inStream,
 			IArchiveOpenCallback archiveOpenCallback) throws SevenZipException;
 
+	private static native ISevenZipInArchive nativeOpenMultiVolumeArchive(String formatName, String firstVolumePath,
+			IArchiveOpenCallback archiveOpenCallback) throws SevenZipException;
+
 	private static native String nativeInitSevenZipLibrary();
 
+	private static native void nativeGetDecoderPoolStats(long[] values);
+
+	private static native void nativeSetDecoderPoolLimit(long limit);
+
+	private static native void nativeTrimDecoderPool(long maxCachedSize);
+
+	private static native void nativeSetHugePagesThreshold(long threshold);
+
+	private static native void nativeSetNumaLocalAllocation(boolean enable);
+
+	private static native void nativeSetProgressThrottling(long minIntervalMillis, long minBytes);
+
 	private static class DummyOpenArchiveCallback implements IArchiveOpenCallback, ICryptoGetTextPassword {
 		/**
 		 * {@inheritDoc}
@@ -3,12 +3,27 @@
 Igor Pavlov
 Public domain */
 
+#if !defined(_WIN32) && defined(__linux__)
+#define _7ZIP_THP
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#endif
+
 #ifdef _WIN32
 #include <windows.h>
 #endif
 #include <stdio.h>
 #include <stdlib.h>
 
+#ifdef _7ZIP_THP
+#include <sched.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
 #ifdef _7ZIP_LARGE_PAGES
 #ifdef __linux__
 #ifndef _7ZIP_ST
@@ -92,6 +107,144 @@ void MyFree(void *address)
   align_free(address);
 }
 
+#ifdef _7ZIP_THP
+
+/* Transparent huge pages and NUMA for Linux:
+   the blocks of (size >= g_HugePagesThreshold) are aligned to 2 MB, so the kernel
+   can map them with huge pages after madvise(MADV_HUGEPAGE). It reduces TLB misses
+   for random access to dictionaries and hash tables of match finders.
+   If g_NumaLocalAlloc is set, the big blocks are bound to NUMA node of
+   the calling thread (preferred policy, so the allocation doesn't fail, if node is full). */
+
+#define THP_ALIGN ((size_t)1 << 21)
+#define NUMA_MIN_SIZE ((size_t)1 << 18)
+#define NUMA_MAX_NODES 1024
+#define MPOL_PREFERRED_ 1
+
+static size_t g_HugePagesThreshold = (size_t)1 << 22;
+static int g_NumaLocalAlloc = 0;
+
+static int GetCurrentNumaNode()
+{
+  unsigned cpu = 0, node = 0;
+  #ifdef SYS_getcpu
+  if (syscall(SYS_getcpu, &cpu, &node, NULL) == 0)
+    return (int)node;
+  #endif
+  return -1;
+}
+
+static void BindToNumaNode(void *address, size_t size, int node)
+{
+  #ifdef SYS_mbind
+  unsigned long mask[NUMA_MAX_NODES / (sizeof(unsigned long) * 8)];
+  const unsigned numBits = sizeof(unsigned long) * 8;
+  if (node < 0 || node >= NUMA_MAX_NODES)
+    return;
+  memset(mask, 0, sizeof(mask));
+  mask[node / numBits] = (unsigned long)1 << (node % numBits);
+  syscall(SYS_mbind, address, size, MPOL_PREFERRED_, mask, (unsigned long)NUMA_MAX_NODES + 1, 0);
+  #endif
+}
+
+static int IsThpAllocSize(size_t size)
+{
+  return (g_HugePagesThreshold != 0 && size >= g_HugePagesThreshold)
+      || (g_NumaLocalAlloc && size >= NUMA_MIN_SIZE);
+}
+
+/* the block is allocated with posix_memalign(), so it's freed with free() in align_free() */
+
+static void *ThpAlloc(size_t size)
+{
+  void *address;
+  size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+  size_t size2 = size & ~(pageSize - 1);
+  if (posix_memalign(&address, THP_ALIGN, size) != 0)
+    return NULL;
+  #ifdef MADV_HUGEPAGE
+  if (g_HugePagesThreshold != 0 && size >= g_HugePagesThreshold)
+    madvise(address, size2, MADV_HUGEPAGE);
+  #endif
+  if (g_NumaLocalAlloc)
+    BindToNumaNode(address, size2, GetCurrentNumaNode());
+  return address;
+}
+
+#endif
+
+void SetHugePagesThreshold(size_t threshold)
+{
+  #ifdef _7ZIP_THP
+  g_HugePagesThreshold = threshold;
+  #endif
+}
+
+size_t GetHugePagesThreshold()
+{
+  #ifdef _7ZIP_THP
+  return g_HugePagesThreshold;
+  #else
+  return 0;
+  #endif
+}
+
+void SetNumaLocalAlloc(int enable)
+{
+  #ifdef _7ZIP_THP
+  g_NumaLocalAlloc = enable;
+  #endif
+}
+
+int GetNumaLocalNode()
+{
+  #ifdef _7ZIP_THP
+  if (g_NumaLocalAlloc)
+    return GetCurrentNumaNode();
+  #endif
+  return -1;
+}
+
+void PinThreadToNumaNode(int node)
+{
+  #ifdef _7ZIP_THP
+  char path[64];
+  char list[1024];
+  FILE *fp;
+  const char *s;
+  cpu_set_t set;
+  if (node < 0)
+    return;
+  snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+  fp = fopen(path, "r");
+  if (!fp)
+    return;
+  s = fgets(list, sizeof(list), fp);
+  fclose(fp);
+  if (!s)
+    return;
+
+  /* cpulist is like "0-7,16-23" */
+  CPU_ZERO(&set);
+  while (*s >= '0' && *s <= '9')
+  {
+    char *end;
+    unsigned long first = strtoul(s, &end, 10), last = first, i;
+    if (*end == '-')
+      last = strtoul(end + 1, &end, 10);
+    for (i = first; i <= last && i < CPU_SETSIZE; i++)
+      CPU_SET(i, &set);
+    s = end;
+    if (*s == ',')
+      s++;
+  }
+  if (CPU_COUNT(&set) != 0)
+    sched_setaffinity(0, sizeof(set), &set);
+  #else
+  (void)node;
+  #endif
+}
+
 #ifndef _WIN32
 
 #ifdef _7ZIP_LARGE_PAGES
@@ -198,6 +351,10 @@ void *MidAlloc(size_t size)
 #ifdef _WIN32
   return VirtualAlloc(0, size, MEM_COMMIT, PAGE_READWRITE);
 #else
+  #ifdef _7ZIP_THP
+  if (IsThpAllocSize(size))
+    return ThpAlloc(size);
+  #endif
   return VirtualAlloc(size, 0);
 #endif
 }
@@ -319,6 +476,10 @@ void *BigAlloc(size_t size)
 #ifdef _WIN32
   return VirtualAlloc(0, size, MEM_COMMIT, PAGE_READWRITE);
 #else
+  #ifdef _7ZIP_THP
+  if (IsThpAllocSize(size))
+    return ThpAlloc(size);
+  #endif
   return VirtualAlloc(size, 0);
 #endif
 }
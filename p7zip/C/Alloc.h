@@ -20,6 +20,20 @@ void MidFree(void *address);
 void *BigAlloc(size_t size);
 void BigFree(void *address);
 
+/* Linux: MidAlloc() and BigAlloc() request transparent huge pages for
+   blocks of (size >= threshold). (threshold == 0) disables it.
+   The default threshold is 4 MB. */
+void SetHugePagesThreshold(size_t threshold);
+size_t GetHugePagesThreshold();
+
+/* Linux: if NUMA local allocation is enabled, big blocks are bound to
+   NUMA node of the allocating thread. GetNumaLocalNode() returns that node,
+   or -1, if it's disabled. Worker threads call PinThreadToNumaNode()
+   to run on the CPUs of the node of their data. It does nothing for (node < 0). */
+void SetNumaLocalAlloc(int enable);
+int GetNumaLocalNode();
+void PinThreadToNumaNode(int node);
+
 #ifdef __cplusplus
 }
 #endif
@@ -4,6 +4,34 @@
 #include "Precomp.h"
 
 #include "Bra.h"
+#include "CpuArch.h"
+
+#if defined(MY_CPU_AMD64) || (defined(MY_CPU_X86) && defined(__SSE2__)) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BRA_SSE2
+#include <emmintrin.h>
+#endif
+
+/* BRA_SKIP(test, posMask) skips 16-byte blocks of (data), where (test) doesn't find
+   any candidate instruction. (posMask) selects the bytes of (test) result that are checked:
+   the bytes with opcode at the positions allowed by instruction alignment. */
+
+#ifdef BRA_SSE2
+
+#define BRA_LOAD(i) _mm_loadu_si128((const __m128i *)(const void *)(data + (i)))
+#define BRA_TEST_EQ(i, val) _mm_cmpeq_epi8(BRA_LOAD(i), _mm_set1_epi8((char)(val)))
+#define BRA_TEST_MASK(i, mask, val) \
+    _mm_cmpeq_epi8(_mm_and_si128(BRA_LOAD(i), _mm_set1_epi8((char)(mask))), _mm_set1_epi8((char)(val)))
+
+#define BRA_SKIP(test, posMask) \
+    for (; i + 12 <= size; i += 16) \
+      if (((unsigned)_mm_movemask_epi8(test) & (posMask)) != 0) \
+        break;
+
+#else
+
+#define BRA_SKIP(test, posMask)
+
+#endif
 
 SizeT ARM_Convert(Byte *data, SizeT size, UInt32 ip, int encoding)
 {
@@ -12,8 +40,11 @@ SizeT ARM_Convert(Byte *data, SizeT size, UInt32 ip, int encoding)
     return 0;
   size -= 4;
   ip += 8;
-  for (i = 0; i <= size; i += 4)
+  for (i = 0;; i += 4)
   {
+    BRA_SKIP(BRA_TEST_EQ(i, 0xEB), 0x8888)
+    if (i > size)
+      break;
     if (data[i + 3] == 0xEB)
     {
       UInt32 dest;
@@ -39,8 +70,11 @@ SizeT ARMT_Convert(Byte *data, SizeT size, UInt32 ip, int encoding)
     return 0;
   size -= 4;
   ip += 4;
-  for (i = 0; i <= size; i += 2)
+  for (i = 0;; i += 2)
   {
+    BRA_SKIP(BRA_TEST_MASK(i, 0xF8, 0xF0), 0xAAAA)
+    if (i > size)
+      break;
     if ((data[i + 1] & 0xF8) == 0xF0 &&
         (data[i + 3] & 0xF8) == 0xF8)
     {
@@ -68,6 +102,53 @@ SizeT ARMT_Convert(Byte *data, SizeT size, UInt32 ip, int encoding)
   return i;
 }
 
+/* ARM64 converter converts the offsets in BL instructions and
+   the page offsets in ADRP instructions in the range of +-512 MiB.
+   It's compatible with ARM64 filter of 7-Zip and XZ (filter ID 0xA). */
+
+SizeT ARM64_Convert(Byte *data, SizeT size, UInt32 ip, int encoding)
+{
+  SizeT i;
+  if (size < 4)
+    return 0;
+  size -= 4;
+  for (i = 0;; i += 4)
+  {
+    UInt32 v, pc;
+    /* (data[i + 3] & 0x98) == 0x90 for both BL (0x94-0x97) and ADRP (0x90, 0xB0, 0xD0, 0xF0) */
+    BRA_SKIP(BRA_TEST_MASK(i, 0x98, 0x90), 0x8888)
+    if (i > size)
+      break;
+    v = GetUi32(data + i);
+    pc = ip + (UInt32)i;
+    if ((v >> 26) == 0x25)
+    {
+      pc >>= 2;
+      if (!encoding)
+        pc = 0 - pc;
+      v = 0x94000000 | ((v + pc) & 0x03FFFFFF);
+    }
+    else if ((v & 0x9F000000) == 0x90000000)
+    {
+      UInt32 src = ((v >> 29) & 3) | ((v >> 3) & 0x001FFFFC);
+      if (((src + 0x00020000) & 0x001C0000) != 0)
+        continue;
+      pc >>= 12;
+      if (!encoding)
+        pc = 0 - pc;
+      src += pc;
+      v &= 0x9000001F;
+      v |= (src & 3) << 29;
+      v |= (src & 0x0003FFFC) << 3;
+      v |= (0 - (src & 0x00020000)) & 0x00E00000;
+    }
+    else
+      continue;
+    SetUi32(data + i, v);
+  }
+  return i;
+}
+
 SizeT PPC_Convert(Byte *data, SizeT size, UInt32 ip, int encoding)
 {
   SizeT i;
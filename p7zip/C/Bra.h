@@ -31,6 +31,7 @@ in CALL instructions to increase the compression ratio.
   x86    little      1          4
   ARMT   little      2          2
   ARM    little      4          0
+  ARM64  little      4          0
   PPC     big        4          0
   SPARC   big        4          0
   IA64   little     16          0
@@ -54,6 +55,7 @@ in CALL instructions to increase the compression ratio.
 #define x86_Convert_Init(state) { state = 0; }
 SizeT x86_Convert(Byte *data, SizeT size, UInt32 ip, UInt32 *state, int encoding);
 SizeT ARM_Convert(Byte *data, SizeT size, UInt32 ip, int encoding);
+SizeT ARM64_Convert(Byte *data, SizeT size, UInt32 ip, int encoding);
 SizeT ARMT_Convert(Byte *data, SizeT size, UInt32 ip, int encoding);
 SizeT PPC_Convert(Byte *data, SizeT size, UInt32 ip, int encoding);
 SizeT SPARC_Convert(Byte *data, SizeT size, UInt32 ip, int encoding);
@@ -4,6 +4,15 @@
 #include "Precomp.h"
 
 #include "Bra.h"
+#include "CpuArch.h"
+
+#if defined(MY_CPU_AMD64) || (defined(MY_CPU_X86) && defined(__SSE2__)) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BRA_SSE2
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
 
 #define Test86MSByte(b) ((((b) + 1) & 0xFE) == 0)
 
@@ -20,6 +29,35 @@ SizeT x86_Convert(Byte *data, SizeT size, UInt32 ip, UInt32 *state, int encoding
   {
     Byte *p = data + pos;
     const Byte *limit = data + size;
+
+    #ifdef BRA_SSE2
+    /* we look for E8 / E9 opcodes in 16-byte blocks.
+       If an opcode is found, the scalar loop below stops at it immediately. */
+    if (limit - p >= 16)
+    {
+      const __m128i kMask = _mm_set1_epi8((char)0xFE);
+      const __m128i kOpcode = _mm_set1_epi8((char)0xE8);
+      do
+      {
+        unsigned m = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(kOpcode,
+            _mm_and_si128(kMask, _mm_loadu_si128((const __m128i *)(const void *)p))));
+        if (m != 0)
+        {
+          #ifdef _MSC_VER
+          unsigned long index;
+          _BitScanForward(&index, m);
+          p += index;
+          #else
+          p += __builtin_ctz(m);
+          #endif
+          break;
+        }
+        p += 16;
+      }
+      while (limit - p >= 16);
+    }
+    #endif
+
     for (; p < limit; p++)
       if ((*p & 0xFE) == 0xE8)
         break;
@@ -3,8 +3,14 @@
 
 #include "Precomp.h"
 
+#include "CpuArch.h"
 #include "Delta.h"
 
+#if defined(MY_CPU_AMD64) || (defined(MY_CPU_X86) && defined(__SSE2__)) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define DELTA_SSE2
+#include <emmintrin.h>
+#endif
+
 void Delta_Init(Byte *state)
 {
   unsigned i;
@@ -19,46 +25,121 @@ static void MyMemCpy(Byte *dest, const Byte *src, unsigned size)
     dest[i] = src[i];
 }
 
+/* (state) contains (delta) bytes that precede (data).
+   Delta_UpdateState() replaces it with (delta) last bytes of (state + data). */
+
+static void Delta_UpdateState(Byte *state, unsigned delta, const Byte *data, SizeT size)
+{
+  if (size >= delta)
+    MyMemCpy(state, data + size - delta, delta);
+  else
+  {
+    unsigned i;
+    for (i = 0; i < delta - (unsigned)size; i++)
+      state[i] = state[i + (unsigned)size];
+    MyMemCpy(state + i, data, (unsigned)size);
+  }
+}
+
 void Delta_Encode(Byte *state, unsigned delta, Byte *data, SizeT size)
 {
   Byte buf[DELTA_STATE_SIZE];
-  unsigned j = 0;
+  SizeT i = size;
   MyMemCpy(buf, state, delta);
+  Delta_UpdateState(state, delta, data, size);
+
+  /* we go backward, so (data[i - delta]) is not changed yet,
+     and all bytes of a 16-byte block can be processed at once */
+  #ifdef DELTA_SSE2
+  while (i >= delta + 16)
+  {
+    i -= 16;
+    _mm_storeu_si128((__m128i *)(void *)(data + i), _mm_sub_epi8(
+        _mm_loadu_si128((const __m128i *)(const void *)(data + i)),
+        _mm_loadu_si128((const __m128i *)(const void *)(data + i - delta))));
+  }
+  #endif
+  for (; i > delta; )
   {
-    SizeT i;
-    for (i = 0; i < size;)
-    {
-      for (j = 0; j < delta && i < size; i++, j++)
-      {
-        Byte b = data[i];
-        data[i] = (Byte)(b - buf[j]);
-        buf[j] = b;
-      }
-    }
+    i--;
+    data[i] = (Byte)(data[i] - data[i - delta]);
+  }
+  while (i != 0)
+  {
+    i--;
+    data[i] = (Byte)(data[i] - buf[i]);
   }
-  if (j == delta)
-    j = 0;
-  MyMemCpy(state, buf + j, delta - j);
-  MyMemCpy(state + delta - j, buf, j);
 }
 
+#ifdef DELTA_SSE2
+
+/* Delta_Decode_Pow2() decodes (data) with (delta = 1, 2, 4, 8) from (pos) to (lim).
+   The prefix sums of 16-byte block are calculated with shifts and additions,
+   and then the last (delta) decoded bytes of previous block, that are
+   broadcasted to all lanes in (prev), are added. */
+
+#define DELTA_DECODE_POW2(delta, broadcast) \
+  for (; pos + 16 <= lim; pos += 16) \
+  { \
+    __m128i v = _mm_loadu_si128((const __m128i *)(const void *)(data + pos)); \
+    if ((delta) <= 1) v = _mm_add_epi8(v, _mm_slli_si128(v, 1)); \
+    if ((delta) <= 2) v = _mm_add_epi8(v, _mm_slli_si128(v, 2)); \
+    if ((delta) <= 4) v = _mm_add_epi8(v, _mm_slli_si128(v, 4)); \
+    v = _mm_add_epi8(v, _mm_slli_si128(v, 8)); \
+    v = _mm_add_epi8(v, prev); \
+    _mm_storeu_si128((__m128i *)(void *)(data + pos), v); \
+    prev = broadcast; \
+  }
+
+static SizeT Delta_Decode_Pow2(unsigned delta, Byte *data, SizeT pos, SizeT lim)
+{
+  __m128i prev;
+  switch (delta)
+  {
+    default:
+    case 1:
+      prev = _mm_set1_epi8((char)data[pos - 1]);
+      DELTA_DECODE_POW2(1, _mm_shuffle_epi32(_mm_shufflehi_epi16(_mm_unpackhi_epi8(v, v), 0xFF), 0xFF))
+      break;
+    case 2:
+      prev = _mm_set1_epi16((short)GetUi16(data + pos - 2));
+      DELTA_DECODE_POW2(2, _mm_shuffle_epi32(_mm_shufflehi_epi16(v, 0xFF), 0xFF))
+      break;
+    case 4:
+      prev = _mm_set1_epi32((int)GetUi32(data + pos - 4));
+      DELTA_DECODE_POW2(4, _mm_shuffle_epi32(v, 0xFF))
+      break;
+    case 8:
+      prev = _mm_loadl_epi64((const __m128i *)(const void *)(data + pos - 8));
+      prev = _mm_unpacklo_epi64(prev, prev);
+      DELTA_DECODE_POW2(8, _mm_unpackhi_epi64(v, v))
+      break;
+  }
+  return pos;
+}
+
+#endif
+
 void Delta_Decode(Byte *state, unsigned delta, Byte *data, SizeT size)
 {
-  Byte buf[DELTA_STATE_SIZE];
-  unsigned j = 0;
-  MyMemCpy(buf, state, delta);
+  SizeT i;
+  for (i = 0; i < size && i < delta; i++)
+    data[i] = (Byte)(data[i] + state[i]);
+
+  #ifdef DELTA_SSE2
+  if (delta >= 16)
   {
-    SizeT i;
-    for (i = 0; i < size;)
-    {
-      for (j = 0; j < delta && i < size; i++, j++)
-      {
-        buf[j] = data[i] = (Byte)(buf[j] + data[i]);
-      }
-    }
+    for (; i + 16 <= size; i += 16)
+      _mm_storeu_si128((__m128i *)(void *)(data + i), _mm_add_epi8(
+          _mm_loadu_si128((const __m128i *)(const void *)(data + i)),
+          _mm_loadu_si128((const __m128i *)(const void *)(data + i - delta))));
   }
-  if (j == delta)
-    j = 0;
-  MyMemCpy(state, buf + j, delta - j);
-  MyMemCpy(state + delta - j, buf, j);
+  else if ((delta & (delta - 1)) == 0 && i < size)
+    i = Delta_Decode_Pow2(delta, data, i, size);
+  #endif
+
+  for (; i < size; i++)
+    data[i] = (Byte)(data[i] + data[i - delta]);
+
+  Delta_UpdateState(state, delta, data, size);
 }
@@ -0,0 +1,175 @@
+/* Lz4.c -- LZ4 format
+2026-10-18 : Public domain */
+
+#include "Precomp.h"
+
+#include <string.h>
+
+#include "CpuArch.h"
+#include "Lz4.h"
+
+/* ---------- XXH32 ---------- */
+
+#define XXH_P1 0x9E3779B1
+#define XXH_P2 0x85EBCA77
+#define XXH_P3 0xC2B2AE3D
+#define XXH_P4 0x27D4EB2F
+#define XXH_P5 0x165667B1
+
+#define XXH_ROTL(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+#define XXH_ROUND(acc, v) { acc += (v) * XXH_P2; acc = XXH_ROTL(acc, 13); acc *= XXH_P1; }
+
+void Xxh32_Init(CXxh32 *p)
+{
+  p->v[0] = XXH_P1 + XXH_P2;
+  p->v[1] = XXH_P2;
+  p->v[2] = 0;
+  p->v[3] = (UInt32)0 - XXH_P1;
+  p->totalSize = 0;
+  p->bufSize = 0;
+}
+
+static const Byte *Xxh32_Process(UInt32 *v, const Byte *data, const Byte *lim)
+{
+  UInt32 v0 = v[0], v1 = v[1], v2 = v[2], v3 = v[3];
+  for (; (size_t)(lim - data) >= 16; data += 16)
+  {
+    XXH_ROUND(v0, GetUi32(data));
+    XXH_ROUND(v1, GetUi32(data + 4));
+    XXH_ROUND(v2, GetUi32(data + 8));
+    XXH_ROUND(v3, GetUi32(data + 12));
+  }
+  v[0] = v0; v[1] = v1; v[2] = v2; v[3] = v3;
+  return data;
+}
+
+void Xxh32_Update(CXxh32 *p, const void *data, size_t size)
+{
+  const Byte *d = (const Byte *)data;
+  p->totalSize += size;
+  if (p->bufSize != 0)
+  {
+    unsigned rem = 16 - p->bufSize;
+    if (size < rem)
+    {
+      memcpy(p->buf + p->bufSize, d, size);
+      p->bufSize += (unsigned)size;
+      return;
+    }
+    memcpy(p->buf + p->bufSize, d, rem);
+    Xxh32_Process(p->v, p->buf, p->buf + 16);
+    d += rem;
+    size -= rem;
+    p->bufSize = 0;
+  }
+  {
+    const Byte *lim = d + size;
+    d = Xxh32_Process(p->v, d, lim);
+    p->bufSize = (unsigned)(lim - d);
+    memcpy(p->buf, d, p->bufSize);
+  }
+}
+
+UInt32 Xxh32_Digest(const CXxh32 *p)
+{
+  UInt32 h;
+  const Byte *d = p->buf;
+  unsigned rem = p->bufSize;
+  if (p->totalSize >= 16)
+    h = XXH_ROTL(p->v[0], 1) + XXH_ROTL(p->v[1], 7) + XXH_ROTL(p->v[2], 12) + XXH_ROTL(p->v[3], 18);
+  else
+    h = XXH_P5;
+  h += (UInt32)p->totalSize;
+  for (; rem >= 4; rem -= 4, d += 4)
+  {
+    h += GetUi32(d) * XXH_P3;
+    h = XXH_ROTL(h, 17) * XXH_P4;
+  }
+  for (; rem != 0; rem--, d++)
+  {
+    h += (UInt32)*d * XXH_P5;
+    h = XXH_ROTL(h, 11) * XXH_P1;
+  }
+  h ^= h >> 15;
+  h *= XXH_P2;
+  h ^= h >> 13;
+  h *= XXH_P3;
+  h ^= h >> 16;
+  return h;
+}
+
+UInt32 Xxh32_Calc(const void *data, size_t size)
+{
+  CXxh32 xxh;
+  Xxh32_Init(&xxh);
+  Xxh32_Update(&xxh, data, size);
+  return Xxh32_Digest(&xxh);
+}
+
+/* ---------- Frame header ---------- */
+
+unsigned Lz4FrameHeader_GetSize(Byte flg)
+{
+  return LZ4_FRAME_HEADER_SIZE_MIN
+      + ((flg & LZ4_FLG_CONTENT_SIZE) ? 8 : 0)
+      + ((flg & LZ4_FLG_DICT_ID) ? 4 : 0);
+}
+
+SRes Lz4FrameHeader_Parse(CLz4FrameHeader *p, const Byte *buf)
+{
+  const Byte flg = buf[4];
+  const Byte bd = buf[5];
+  unsigned pos = 6;
+  unsigned blockSizeId;
+
+  if (GetUi32(buf) != LZ4_MAGIC)
+    return SZ_ERROR_NO_ARCHIVE;
+  if ((flg & LZ4_FLG_VERSION_MASK) != LZ4_FLG_VERSION || (flg & LZ4_FLG_RESERVED) != 0 || (bd & 0x8F) != 0)
+    return SZ_ERROR_UNSUPPORTED;
+  blockSizeId = bd >> 4;
+  if (blockSizeId < LZ4_BLOCK_SIZE_ID_MIN)
+    return SZ_ERROR_UNSUPPORTED;
+
+  p->flags = flg;
+  p->blockSizeMax = Lz4_GetBlockSizeMax(blockSizeId);
+  p->contentSize = LZ4_CONTENT_SIZE_UNKNOWN;
+  p->dictId = 0;
+  if (flg & LZ4_FLG_CONTENT_SIZE)
+  {
+    p->contentSize = GetUi64(buf + pos);
+    pos += 8;
+  }
+  if (flg & LZ4_FLG_DICT_ID)
+  {
+    p->dictId = GetUi32(buf + pos);
+    pos += 4;
+  }
+  if (buf[pos] != (Byte)(Xxh32_Calc(buf + 4, pos - 4) >> 8))
+    return SZ_ERROR_CRC;
+  // we don't support external dictionaries
+  if (flg & LZ4_FLG_DICT_ID)
+    return SZ_ERROR_UNSUPPORTED;
+  return SZ_OK;
+}
+
+unsigned Lz4FrameHeader_Write(Byte *buf, const CLz4FrameHeader *p)
+{
+  unsigned pos = 6;
+  unsigned blockSizeId = LZ4_BLOCK_SIZE_ID_MIN;
+  Byte flg = (Byte)(p->flags & ~(LZ4_FLG_VERSION_MASK | LZ4_FLG_RESERVED | LZ4_FLG_CONTENT_SIZE | LZ4_FLG_DICT_ID));
+  while (blockSizeId < LZ4_BLOCK_SIZE_ID_MAX && Lz4_GetBlockSizeMax(blockSizeId) < p->blockSizeMax)
+    blockSizeId++;
+  if (p->contentSize != LZ4_CONTENT_SIZE_UNKNOWN)
+    flg |= LZ4_FLG_CONTENT_SIZE;
+  SetUi32(buf, LZ4_MAGIC);
+  buf[4] = (Byte)(flg | LZ4_FLG_VERSION);
+  buf[5] = (Byte)(blockSizeId << 4);
+  if (flg & LZ4_FLG_CONTENT_SIZE)
+  {
+    SetUi64(buf + pos, p->contentSize);
+    pos += 8;
+  }
+  buf[pos] = (Byte)(Xxh32_Calc(buf + 4, pos - 4) >> 8);
+  return pos + 1;
+}
@@ -0,0 +1,122 @@
+/* Lz4.h -- LZ4 format
+2026-10-18 : Public domain */
+
+#ifndef __LZ4_H
+#define __LZ4_H
+
+#include "7zTypes.h"
+
+EXTERN_C_BEGIN
+
+#define LZ4_MAGIC 0x184D2204
+#define LZ4_SKIP_MAGIC 0x184D2A50
+#define LZ4_SKIP_MAGIC_MASK 0xFFFFFFF0
+
+#define LZ4_SIG_SIZE 4
+#define LZ4_SKIP_HEADER_SIZE 8
+#define LZ4_FRAME_HEADER_SIZE_MIN 7
+#define LZ4_FRAME_HEADER_SIZE_MAX 19
+#define LZ4_BLOCK_HEADER_SIZE 4
+#define LZ4_CHECKSUM_SIZE 4
+
+/* FLG byte of frame descriptor */
+
+#define LZ4_FLG_VERSION_MASK 0xC0
+#define LZ4_FLG_VERSION 0x40
+#define LZ4_FLG_BLOCK_INDEP (1 << 5)
+#define LZ4_FLG_BLOCK_CHECKSUM (1 << 4)
+#define LZ4_FLG_CONTENT_SIZE (1 << 3)
+#define LZ4_FLG_CONTENT_CHECKSUM (1 << 2)
+#define LZ4_FLG_RESERVED (1 << 1)
+#define LZ4_FLG_DICT_ID (1 << 0)
+
+/* BD byte of frame descriptor: bits 4-6 contain block maximum size id (4 - 64 KiB ... 7 - 4 MiB) */
+
+#define LZ4_BLOCK_SIZE_ID_MIN 4
+#define LZ4_BLOCK_SIZE_ID_MAX 7
+#define Lz4_GetBlockSizeMax(id) ((UInt32)1 << (8 + (id) * 2))
+
+/* the highest bit of block size means that the block is stored without compression.
+   Zero block size is EndMark of frame */
+
+#define LZ4_BLOCK_UNCOMPRESSED_FLAG ((UInt32)1 << 31)
+
+#define LZ4_MATCH_LEN_MIN 4
+#define LZ4_WINDOW_SIZE (1 << 16)
+
+#define LZ4_CONTENT_SIZE_UNKNOWN ((UInt64)(Int64)-1)
+
+/* the block decoder copies literals and matches by 16-byte chunks,
+   so it can read and write up to LZ4_PADDING_SIZE bytes after the end of input and output data */
+
+#define LZ4_PADDING_SIZE 32
+
+/* ---------- XXH32 (frame and block checksums) ---------- */
+
+typedef struct
+{
+  UInt32 v[4];
+  UInt64 totalSize;
+  Byte buf[16];
+  unsigned bufSize;
+} CXxh32;
+
+void Xxh32_Init(CXxh32 *p);
+void Xxh32_Update(CXxh32 *p, const void *data, size_t size);
+UInt32 Xxh32_Digest(const CXxh32 *p);
+UInt32 Xxh32_Calc(const void *data, size_t size);
+
+/* ---------- Frame header ---------- */
+
+typedef struct
+{
+  UInt64 contentSize;
+  UInt32 blockSizeMax;
+  UInt32 dictId;
+  Byte flags;
+} CLz4FrameHeader;
+
+#define Lz4FrameHeader_IsBlockIndep(p) (((p)->flags & LZ4_FLG_BLOCK_INDEP) != 0)
+#define Lz4FrameHeader_HasBlockChecksum(p) (((p)->flags & LZ4_FLG_BLOCK_CHECKSUM) != 0)
+#define Lz4FrameHeader_HasChecksum(p) (((p)->flags & LZ4_FLG_CONTENT_CHECKSUM) != 0)
+
+/* Lz4FrameHeader_GetSize() returns the size of frame header (including signature)
+   from FLG byte (buf[4]). */
+
+unsigned Lz4FrameHeader_GetSize(Byte flg);
+
+/*
+Lz4FrameHeader_Parse()
+  buf must contain full frame header (Lz4FrameHeader_GetSize(buf[4]) bytes).
+Returns:
+  SZ_OK
+  SZ_ERROR_NO_ARCHIVE - it's not LZ4 frame signature
+  SZ_ERROR_UNSUPPORTED - unsupported version, reserved bits are set, or dictionary is required
+  SZ_ERROR_CRC - header checksum error
+*/
+
+SRes Lz4FrameHeader_Parse(CLz4FrameHeader *p, const Byte *buf);
+
+/* Lz4FrameHeader_Write() writes frame header to buf and returns its size */
+
+unsigned Lz4FrameHeader_Write(Byte *buf, const CLz4FrameHeader *p);
+
+/* ---------- Block decoder ---------- */
+
+/*
+Lz4_DecodeBlock()
+  decodes compressed block to dest[destPos ... destLim).
+  The matches can refer to the data in dest[0 ... destPos), so the caller
+  keeps the history of linked blocks there.
+  src must be followed by LZ4_PADDING_SIZE readable bytes,
+  dest must have LZ4_PADDING_SIZE writable bytes after destLim.
+Returns:
+  SZ_OK - *outSize contains the size of decoded data
+  SZ_ERROR_DATA - data error
+*/
+
+SRes Lz4_DecodeBlock(const Byte *src, size_t srcSize, Byte *dest, size_t destPos, size_t destLim, size_t *outSize);
+
+EXTERN_C_END
+
+#endif
@@ -0,0 +1,117 @@
+/* Lz4Dec.c -- LZ4 Block Decoder
+2026-10-18 : Public domain */
+
+#include "Precomp.h"
+
+#include <string.h>
+
+#include "CpuArch.h"
+#include "Lz4.h"
+
+#define COPY_16(dest, src) memcpy(dest, src, 16)
+#define COPY_8(dest, src) memcpy(dest, src, 8)
+
+/* The sequence is: token, [literal length bytes], literals, offset (2 bytes), [match length bytes].
+   The last sequence of block contains only literals.
+   The sizes are checked before each copy, and the copies by chunks can write
+   up to 15 bytes after the end of literals or match. */
+
+SRes Lz4_DecodeBlock(const Byte *src, size_t srcSize, Byte *dest, size_t destPos, size_t destLim, size_t *outSize)
+{
+  const Byte *ip = src;
+  const Byte *ipLim = src + srcSize;
+  Byte *op = dest + destPos;
+  Byte *opLim = dest + destLim;
+
+  *outSize = 0;
+
+  for (;;)
+  {
+    unsigned token;
+    size_t litLen, matchLen, offset;
+
+    if (ip == ipLim)
+      return SZ_ERROR_DATA;
+    token = *ip++;
+    litLen = token >> 4;
+    if (litLen == 15)
+    {
+      unsigned b;
+      do
+      {
+        if (ip == ipLim)
+          return SZ_ERROR_DATA;
+        b = *ip++;
+        litLen += b;
+      }
+      while (b == 255);
+    }
+
+    if (litLen > (size_t)(ipLim - ip) || litLen > (size_t)(opLim - op))
+      return SZ_ERROR_DATA;
+    if (litLen <= 16)
+      COPY_16(op, ip);
+    else
+      memcpy(op, ip, litLen);
+    op += litLen;
+    ip += litLen;
+
+    if (ip == ipLim)
+      break;
+
+    if ((size_t)(ipLim - ip) < 2)
+      return SZ_ERROR_DATA;
+    offset = GetUi16(ip);
+    ip += 2;
+    matchLen = token & 15;
+    if (matchLen == 15)
+    {
+      unsigned b;
+      do
+      {
+        if (ip == ipLim)
+          return SZ_ERROR_DATA;
+        b = *ip++;
+        matchLen += b;
+      }
+      while (b == 255);
+    }
+    matchLen += LZ4_MATCH_LEN_MIN;
+
+    if (offset == 0 || offset > (size_t)(op - dest) || matchLen > (size_t)(opLim - op))
+      return SZ_ERROR_DATA;
+    {
+      const Byte *m = op - offset;
+      Byte *end = op + matchLen;
+      if (offset >= 16)
+      {
+        do
+        {
+          COPY_16(op, m);
+          op += 16;
+          m += 16;
+        }
+        while (op < end);
+      }
+      else if (offset >= 8)
+      {
+        do
+        {
+          COPY_8(op, m);
+          op += 8;
+          m += 8;
+        }
+        while (op < end);
+      }
+      else if (offset == 1)
+        memset(op, *m, matchLen);
+      else
+        for (; op != end; op++, m++)
+          *op = *m;
+      op = end;
+    }
+  }
+
+  *outSize = (size_t)(op - (dest + destPos));
+  return SZ_OK;
+}
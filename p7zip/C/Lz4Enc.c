@@ -0,0 +1,697 @@
+/* Lz4Enc.c -- LZ4 Encoder
+2026-10-18 : Public domain */
+
+#include "Precomp.h"
+
+#include <string.h>
+
+#include "CpuArch.h"
+#include "Lz4Enc.h"
+#include "MtCoder.h"
+
+#ifdef _MSC_VER
+#define MY_FORCE_INLINE __forceinline
+#elif defined(__GNUC__)
+#define MY_FORCE_INLINE __inline__ __attribute__((always_inline))
+#else
+#define MY_FORCE_INLINE
+#endif
+
+/* The last match must start at least 12 bytes before the end of block,
+   and the last 5 bytes of block are always literals. */
+
+#define kMfLimit 12
+#define kLastLiterals 5
+#define kMaxDistance (LZ4_WINDOW_SIZE - 1)
+
+#define kSkipTrigger 6
+#define kHcHashLog 15
+#define kChainSize ((UInt32)1 << 16)
+
+/* the group of blocks that is compressed by one thread in multithreading mode */
+#define kMtBlockSizeMin ((UInt32)1 << 22)
+
+#define HASH4(p, hashLog) ((GetUi32(p) * 2654435761U) >> (32 - (hashLog)))
+
+static const UInt32 g_HcAttempts[LZ4_ENC_LEVEL_MAX + 1] =
+  { 0, 0, 0, 4, 8, 16, 32, 64, 128, 256, 512, 1024, 4096 };
+
+void Lz4EncProps_Init(CLz4EncProps *p)
+{
+  p->level = LZ4_ENC_LEVEL_DEFAULT;
+  p->blockSize = 0;
+  p->checksum = 1;
+  p->blockChecksum = 0;
+  p->reduceSize = (UInt64)(Int64)-1;
+  p->numThreads = 1;
+}
+
+static UInt32 GetMtBlockSize(UInt32 blockSize)
+{
+  return (blockSize < kMtBlockSizeMin) ? kMtBlockSizeMin : blockSize;
+}
+
+void Lz4EncProps_Normalize(CLz4EncProps *p)
+{
+  unsigned id;
+  if (p->level <= 0)
+    p->level = LZ4_ENC_LEVEL_DEFAULT;
+  if (p->level > LZ4_ENC_LEVEL_MAX)
+    p->level = LZ4_ENC_LEVEL_MAX;
+
+  if (p->blockSize == 0)
+  {
+    for (id = LZ4_BLOCK_SIZE_ID_MAX; id > LZ4_BLOCK_SIZE_ID_MIN && Lz4_GetBlockSizeMax(id - 1) >= p->reduceSize; id--);
+  }
+  else
+  {
+    for (id = LZ4_BLOCK_SIZE_ID_MIN; id < LZ4_BLOCK_SIZE_ID_MAX && Lz4_GetBlockSizeMax(id) < p->blockSize; id++);
+  }
+  p->blockSize = Lz4_GetBlockSizeMax(id);
+
+  if (p->numThreads <= 0)
+    p->numThreads = 1;
+  if (p->numThreads > NUM_MT_CODER_THREADS_MAX)
+    p->numThreads = NUM_MT_CODER_THREADS_MAX;
+  if (p->numThreads > 1)
+  {
+    UInt64 numBlocks = p->reduceSize / GetMtBlockSize(p->blockSize) + 1;
+    if (numBlocks < (UInt64)p->numThreads)
+      p->numThreads = (int)numBlocks;
+  }
+}
+
+/* ---------- Block encoder ---------- */
+
+typedef struct
+{
+  UInt32 *hash;
+  UInt16 *chain;
+  unsigned hashLog;
+  UInt32 nextToUpdate;
+
+  /* The hash tables contain (base + position in block).
+     The base is increased by (blockSize + LZ4_WINDOW_SIZE) after each block,
+     so the items of previous blocks are out of window, and blocks are independent. */
+  UInt32 base;
+
+  Byte *buf;
+  size_t bufSize;
+} CLz4EncCore;
+
+static void Core_Construct(CLz4EncCore *p)
+{
+  p->hash = NULL;
+  p->chain = NULL;
+  p->hashLog = 0;
+  p->buf = NULL;
+  p->bufSize = 0;
+}
+
+static void Core_Free(CLz4EncCore *p, ISzAlloc *alloc, ISzAlloc *allocBig)
+{
+  IAlloc_Free(allocBig, p->hash);
+  IAlloc_Free(allocBig, p->chain);
+  IAlloc_Free(allocBig, p->buf);
+  (void)alloc;
+  Core_Construct(p);
+}
+
+static SRes Core_Alloc(CLz4EncCore *p, int level, ISzAlloc *allocBig)
+{
+  unsigned hashLog = (level >= LZ4_ENC_LEVEL_HC_MIN) ? kHcHashLog : (level == 1) ? 12 : 16;
+  if (p->hashLog != hashLog)
+  {
+    IAlloc_Free(allocBig, p->hash);
+    p->hashLog = 0;
+    p->hash = (UInt32 *)IAlloc_Alloc(allocBig, ((size_t)1 << hashLog) * sizeof(UInt32));
+    if (!p->hash)
+      return SZ_ERROR_MEM;
+    p->hashLog = hashLog;
+  }
+  if (level >= LZ4_ENC_LEVEL_HC_MIN && !p->chain)
+  {
+    p->chain = (UInt16 *)IAlloc_Alloc(allocBig, kChainSize * sizeof(UInt16));
+    if (!p->chain)
+      return SZ_ERROR_MEM;
+  }
+  memset(p->hash, 0, ((size_t)1 << hashLog) * sizeof(UInt32));
+  p->base = LZ4_WINDOW_SIZE;
+  return SZ_OK;
+}
+
+/* GetMatchLen() returns the number of equal bytes in (a) and (b), up to (lim) in (a) */
+
+static MY_FORCE_INLINE UInt32 GetMatchLen(const Byte *a, const Byte *b, const Byte *lim)
+{
+  const Byte *start = a;
+  #if defined(MY_CPU_LE_UNALIGN) && defined(MY_CPU_64BIT) && defined(__GNUC__)
+  for (; lim - a >= 8; a += 8, b += 8)
+  {
+    UInt64 x = GetUi64(a) ^ GetUi64(b);
+    if (x != 0)
+      return (UInt32)(a - start) + ((UInt32)__builtin_ctzll(x) >> 3);
+  }
+  #endif
+  for (; a != lim && *a == *b; a++, b++);
+  return (UInt32)(a - start);
+}
+
+static MY_FORCE_INLINE Byte *WriteLen(Byte *op, size_t len)
+{
+  for (; len >= 255; len -= 255)
+    *op++ = 255;
+  *op++ = (Byte)len;
+  return op;
+}
+
+/* WriteSeq() writes the sequence: (litLen) literals and the match.
+   It returns NULL, if there is no space in output buffer. */
+
+static MY_FORCE_INLINE Byte *WriteSeq(Byte *op, const Byte *opLim, const Byte *lits, size_t litLen, UInt32 offset, size_t matchLen)
+{
+  Byte *token;
+  matchLen -= LZ4_MATCH_LEN_MIN;
+  if ((size_t)(opLim - op) < litLen + litLen / 255 + matchLen / 255 + 8)
+    return NULL;
+  token = op++;
+  if (litLen >= 15)
+  {
+    *token = 15 << 4;
+    op = WriteLen(op, litLen - 15);
+  }
+  else
+    *token = (Byte)(litLen << 4);
+  memcpy(op, lits, litLen);
+  op += litLen;
+  SetUi16(op, (UInt16)offset);
+  op += 2;
+  if (matchLen >= 15)
+  {
+    *token |= 15;
+    op = WriteLen(op, matchLen - 15);
+  }
+  else
+    *token |= (Byte)matchLen;
+  return op;
+}
+
+/* WriteLastLiterals() returns the size of compressed block or 0, if there is no space in output buffer. */
+
+static size_t WriteLastLiterals(Byte *dest, Byte *op, const Byte *opLim, const Byte *lits, size_t litLen)
+{
+  if (!op || (size_t)(opLim - op) < litLen + litLen / 255 + 2)
+    return 0;
+  if (litLen >= 15)
+  {
+    *op++ = 15 << 4;
+    op = WriteLen(op, litLen - 15);
+  }
+  else
+    *op++ = (Byte)(litLen << 4);
+  memcpy(op, lits, litLen);
+  op += litLen;
+  return (size_t)(op - dest);
+}
+
+/* Core_CompressFast() is a single hash table parser.
+   The search step increases in the data without matches. */
+
+static size_t Core_CompressFast(CLz4EncCore *p, const Byte *src, size_t srcSize, Byte *dest, size_t destLim)
+{
+  UInt32 *hash = p->hash;
+  const unsigned hashLog = p->hashLog;
+  const UInt32 base = p->base;
+  const Byte *ip = src;
+  const Byte *anchor = src;
+  const Byte *iend = src + srcSize;
+  const Byte *mfLimit = iend - kMfLimit;
+  const Byte *matchLimit = iend - kLastLiterals;
+  Byte *op = dest;
+  const Byte *opLim = dest + destLim;
+
+  if (srcSize <= kMfLimit)
+    return WriteLastLiterals(dest, op, opLim, anchor, srcSize);
+
+  hash[HASH4(ip, hashLog)] = base;
+  ip++;
+
+  while (ip <= mfLimit)
+  {
+    const Byte *match = NULL;
+    UInt32 step = 1;
+    UInt32 searchMatchNb = (UInt32)1 << kSkipTrigger;
+
+    for (;;)
+    {
+      UInt32 h = HASH4(ip, hashLog);
+      UInt32 cur = base + (UInt32)(ip - src);
+      UInt32 cand = hash[h];
+      hash[h] = cur;
+      if (cur - cand <= kMaxDistance)
+      {
+        match = ip - (cur - cand);
+        if (GetUi32(match) == GetUi32(ip))
+          break;
+      }
+      ip += step;
+      step = searchMatchNb++ >> kSkipTrigger;
+      if (ip > mfLimit)
+        break;
+    }
+    if (ip > mfLimit)
+      break;
+
+    while (ip > anchor && match > src && ip[-1] == match[-1])
+    {
+      ip--;
+      match--;
+    }
+
+    for (;;)
+    {
+      UInt32 len = LZ4_MATCH_LEN_MIN + GetMatchLen(ip + LZ4_MATCH_LEN_MIN, match + LZ4_MATCH_LEN_MIN, matchLimit);
+      UInt32 h, cur, cand;
+      op = WriteSeq(op, opLim, anchor, (size_t)(ip - anchor), (UInt32)(ip - match), len);
+      if (!op)
+        return 0;
+      ip += len;
+      anchor = ip;
+      if (ip > mfLimit)
+        break;
+      hash[HASH4(ip - 2, hashLog)] = base + (UInt32)(ip - 2 - src);
+
+      // we test the position after match, and write the match without literals
+      h = HASH4(ip, hashLog);
+      cur = base + (UInt32)(ip - src);
+      cand = hash[h];
+      hash[h] = cur;
+      if (cur - cand > kMaxDistance)
+        break;
+      match = ip - (cur - cand);
+      if (GetUi32(match) != GetUi32(ip))
+        break;
+    }
+    ip++;
+  }
+
+  return WriteLastLiterals(dest, op, opLim, anchor, (size_t)(iend - anchor));
+}
+
+static MY_FORCE_INLINE void Hc_Insert(CLz4EncCore *p, const Byte *src, UInt32 target)
+{
+  UInt32 *hash = p->hash;
+  UInt16 *chain = p->chain;
+  UInt32 pos;
+  for (pos = p->nextToUpdate; pos < target; pos++)
+  {
+    UInt32 h = HASH4(src + (pos - p->base), kHcHashLog);
+    UInt32 delta = pos - hash[h];
+    chain[pos & (kChainSize - 1)] = (UInt16)(delta > kMaxDistance ? 0 : delta);
+    hash[h] = pos;
+  }
+  p->nextToUpdate = target;
+}
+
+/* Hc_Find() returns the length of longest match that is longer than (bestLen), or (bestLen). */
+
+static UInt32 Hc_Find(CLz4EncCore *p, const Byte *src, const Byte *ip, const Byte *lim,
+    UInt32 numAttempts, UInt32 bestLen, UInt32 *offsetRes)
+{
+  const UInt32 cur = p->base + (UInt32)(ip - src);
+  const UInt32 maxDist = ((size_t)(ip - src) < kMaxDistance) ? (UInt32)(ip - src) : kMaxDistance;
+  UInt32 cand;
+
+  Hc_Insert(p, src, cur);
+  cand = p->hash[HASH4(ip, kHcHashLog)];
+
+  for (; numAttempts != 0; numAttempts--)
+  {
+    const UInt32 dist = cur - cand;
+    UInt32 delta;
+    if (dist - 1 >= maxDist)
+      break;
+    {
+      const Byte *m = ip - dist;
+      if (m[bestLen] == ip[bestLen] && GetUi32(m) == GetUi32(ip))
+      {
+        UInt32 len = LZ4_MATCH_LEN_MIN + GetMatchLen(ip + LZ4_MATCH_LEN_MIN, m + LZ4_MATCH_LEN_MIN, lim);
+        if (len > bestLen)
+        {
+          bestLen = len;
+          *offsetRes = dist;
+          if (ip + len == lim)
+            break;
+        }
+      }
+    }
+    delta = p->chain[cand & (kChainSize - 1)];
+    if (delta == 0)
+      break;
+    cand -= delta;
+  }
+  return bestLen;
+}
+
+/* Core_CompressHc() is hash chain parser with lazy matching:
+   it checks the match at next position before writing the match. */
+
+static size_t Core_CompressHc(CLz4EncCore *p, const Byte *src, size_t srcSize, Byte *dest, size_t destLim,
+    UInt32 numAttempts, Bool lazy)
+{
+  const Byte *ip = src;
+  const Byte *anchor = src;
+  const Byte *iend = src + srcSize;
+  const Byte *mfLimit = iend - kMfLimit;
+  const Byte *matchLimit = iend - kLastLiterals;
+  Byte *op = dest;
+  const Byte *opLim = dest + destLim;
+
+  if (srcSize <= kMfLimit)
+    return WriteLastLiterals(dest, op, opLim, anchor, srcSize);
+
+  p->nextToUpdate = p->base;
+
+  while (ip <= mfLimit)
+  {
+    UInt32 offset = 0;
+    UInt32 len = Hc_Find(p, src, ip, matchLimit, numAttempts, LZ4_MATCH_LEN_MIN - 1, &offset);
+    if (len < LZ4_MATCH_LEN_MIN)
+    {
+      ip++;
+      continue;
+    }
+    if (lazy)
+      while (ip < mfLimit)
+      {
+        UInt32 offset2 = 0;
+        UInt32 len2 = Hc_Find(p, src, ip + 1, matchLimit, numAttempts, len, &offset2);
+        if (len2 <= len)
+          break;
+        ip++;
+        len = len2;
+        offset = offset2;
+      }
+    while (ip > anchor && ip - offset > src && ip[-1] == ip[-1 - (size_t)offset])
+    {
+      ip--;
+      len++;
+    }
+    op = WriteSeq(op, opLim, anchor, (size_t)(ip - anchor), offset, len);
+    if (!op)
+      return 0;
+    ip += len;
+    anchor = ip;
+  }
+
+  return WriteLastLiterals(dest, op, opLim, anchor, (size_t)(iend - anchor));
+}
+
+/* Core_EncodeBlock() writes block size, block data and block checksum to dest.
+   It stores the block without compression, if compression doesn't reduce the size.
+   dest must have (srcSize + LZ4_BLOCK_HEADER_SIZE + LZ4_CHECKSUM_SIZE) bytes. */
+
+static size_t Core_EncodeBlock(CLz4EncCore *p, int level, Bool blockChecksum,
+    const Byte *src, size_t srcSize, Byte *dest)
+{
+  size_t size;
+  if (p->base > ((UInt32)1 << 30))
+  {
+    memset(p->hash, 0, ((size_t)1 << p->hashLog) * sizeof(UInt32));
+    p->base = LZ4_WINDOW_SIZE;
+  }
+  if (level >= LZ4_ENC_LEVEL_HC_MIN)
+    size = Core_CompressHc(p, src, srcSize, dest + LZ4_BLOCK_HEADER_SIZE, srcSize - 1,
+        g_HcAttempts[level], (Bool)(level >= LZ4_ENC_LEVEL_HC_MIN + 1));
+  else
+    size = Core_CompressFast(p, src, srcSize, dest + LZ4_BLOCK_HEADER_SIZE, srcSize - 1);
+  p->base += (UInt32)srcSize + LZ4_WINDOW_SIZE;
+
+  if (size == 0)
+  {
+    memcpy(dest + LZ4_BLOCK_HEADER_SIZE, src, srcSize);
+    size = srcSize;
+    SetUi32(dest, (UInt32)size | LZ4_BLOCK_UNCOMPRESSED_FLAG)
+  }
+  else
+  {
+    SetUi32(dest, (UInt32)size)
+  }
+  size += LZ4_BLOCK_HEADER_SIZE;
+  if (blockChecksum)
+  {
+    SetUi32(dest + size, Xxh32_Calc(dest + LZ4_BLOCK_HEADER_SIZE, size - LZ4_BLOCK_HEADER_SIZE))
+    size += LZ4_CHECKSUM_SIZE;
+  }
+  return size;
+}
+
+/* ---------- CLz4Enc ---------- */
+
+/* CHashInStream calculates content checksum of data that is read from input stream.
+   MtCoder reads the blocks in order, so it works in multithreading mode too. */
+
+typedef struct
+{
+  ISeqInStream p;
+  ISeqInStream *inStream;
+  CXxh32 xxh;
+} CHashInStream;
+
+static SRes HashInStream_Read(void *pp, void *data, size_t *size)
+{
+  CHashInStream *p = (CHashInStream *)pp;
+  SRes res = p->inStream->Read(p->inStream, data, size);
+  Xxh32_Update(&p->xxh, data, *size);
+  return res;
+}
+
+typedef struct
+{
+  CLz4EncProps props;
+
+  ISzAlloc *alloc;
+  ISzAlloc *allocBig;
+
+  CLz4EncCore coders[NUM_MT_CODER_THREADS_MAX];
+
+  #ifndef _7ZIP_ST
+  CMtCoder mtCoder;
+  #endif
+} CLz4Enc;
+
+static SRes Progress(ICompressProgress *p, UInt64 inSize, UInt64 outSize)
+{
+  return (p && p->Progress(p, inSize, outSize) != SZ_OK) ? SZ_ERROR_PROGRESS : SZ_OK;
+}
+
+static SRes ReadFull(ISeqInStream *stream, Byte *data, size_t *size)
+{
+  size_t rem = *size;
+  *size = 0;
+  while (rem != 0)
+  {
+    size_t cur = rem;
+    SRes res = stream->Read(stream, data, &cur);
+    *size += cur;
+    data += cur;
+    rem -= cur;
+    RINOK(res);
+    if (cur == 0)
+      return SZ_OK;
+  }
+  return SZ_OK;
+}
+
+static SRes WriteData(ISeqOutStream *stream, const Byte *data, size_t size)
+{
+  return (stream->Write(stream, data, size) == size) ? SZ_OK : SZ_ERROR_WRITE;
+}
+
+static SRes Lz4Enc_EncodeMt1(CLz4Enc *mainEncoder, CLz4EncCore *p,
+    ISeqOutStream *outStream, ISeqInStream *inStream, ICompressProgress *progress)
+{
+  const size_t blockSize = mainEncoder->props.blockSize;
+  const size_t bufSize = blockSize * 2 + LZ4_BLOCK_HEADER_SIZE + LZ4_CHECKSUM_SIZE;
+  UInt64 inTotal = 0, outTotal = 0;
+
+  if (!p->buf || p->bufSize != bufSize)
+  {
+    IAlloc_Free(mainEncoder->allocBig, p->buf);
+    p->bufSize = 0;
+    p->buf = (Byte *)IAlloc_Alloc(mainEncoder->allocBig, bufSize);
+    if (!p->buf)
+      return SZ_ERROR_MEM;
+    p->bufSize = bufSize;
+  }
+
+  for (;;)
+  {
+    size_t size = blockSize;
+    Byte *out = p->buf + blockSize;
+    size_t outSize;
+    RINOK(ReadFull(inStream, p->buf, &size));
+    if (size == 0)
+      break;
+    outSize = Core_EncodeBlock(p, mainEncoder->props.level, (Bool)(mainEncoder->props.blockChecksum != 0),
+        p->buf, size, out);
+    RINOK(WriteData(outStream, out, outSize));
+    inTotal += size;
+    outTotal += outSize;
+    RINOK(Progress(progress, inTotal, outTotal));
+    if (size != blockSize)
+      break;
+  }
+  return SZ_OK;
+}
+
+#ifndef _7ZIP_ST
+
+typedef struct
+{
+  IMtCoderCallback funcTable;
+  CLz4Enc *lz4Enc;
+} CMtCallbackImp;
+
+static SRes MtCallbackImp_Code(void *pp, unsigned index, Byte *dest, size_t *destSize,
+      const Byte *src, size_t srcSize, int finished)
+{
+  CMtCallbackImp *imp = (CMtCallbackImp *)pp;
+  CLz4Enc *mainEncoder = imp->lz4Enc;
+  CLz4EncCore *p = &mainEncoder->coders[index];
+  const size_t blockSize = mainEncoder->props.blockSize;
+  const size_t destLim = *destSize;
+  size_t destPos = 0;
+  size_t pos = 0;
+
+  (void)finished;
+  *destSize = 0;
+
+  while (pos != srcSize)
+  {
+    size_t cur = srcSize - pos;
+    if (cur > blockSize)
+      cur = blockSize;
+    if (destLim - destPos < cur + LZ4_BLOCK_HEADER_SIZE + LZ4_CHECKSUM_SIZE)
+      return SZ_ERROR_OUTPUT_EOF;
+    destPos += Core_EncodeBlock(p, mainEncoder->props.level, (Bool)(mainEncoder->props.blockChecksum != 0),
+        src + pos, cur, dest + destPos);
+    pos += cur;
+    if (MtProgress_Set(&mainEncoder->mtCoder.mtProgress, index, pos, destPos) != SZ_OK)
+      return SZ_ERROR_PROGRESS;
+  }
+  *destSize = destPos;
+  return SZ_OK;
+}
+
+#endif
+
+CLz4EncHandle Lz4Enc_Create(ISzAlloc *alloc, ISzAlloc *allocBig)
+{
+  CLz4Enc *p = (CLz4Enc *)alloc->Alloc(alloc, sizeof(CLz4Enc));
+  unsigned i;
+  if (!p)
+    return NULL;
+  Lz4EncProps_Init(&p->props);
+  Lz4EncProps_Normalize(&p->props);
+  p->alloc = alloc;
+  p->allocBig = allocBig;
+  for (i = 0; i < NUM_MT_CODER_THREADS_MAX; i++)
+    Core_Construct(&p->coders[i]);
+  #ifndef _7ZIP_ST
+  MtCoder_Construct(&p->mtCoder);
+  #endif
+  return p;
+}
+
+void Lz4Enc_Destroy(CLz4EncHandle pp)
+{
+  CLz4Enc *p = (CLz4Enc *)pp;
+  unsigned i;
+  for (i = 0; i < NUM_MT_CODER_THREADS_MAX; i++)
+    Core_Free(&p->coders[i], p->alloc, p->allocBig);
+  #ifndef _7ZIP_ST
+  MtCoder_Destruct(&p->mtCoder);
+  #endif
+  IAlloc_Free(p->alloc, pp);
+}
+
+SRes Lz4Enc_SetProps(CLz4EncHandle pp, const CLz4EncProps *props)
+{
+  CLz4Enc *p = (CLz4Enc *)pp;
+  if (props->level > LZ4_ENC_LEVEL_MAX || props->blockSize > Lz4_GetBlockSizeMax(LZ4_BLOCK_SIZE_ID_MAX))
+    return SZ_ERROR_PARAM;
+  p->props = *props;
+  Lz4EncProps_Normalize(&p->props);
+  return SZ_OK;
+}
+
+SRes Lz4Enc_Encode(CLz4EncHandle pp,
+    ISeqOutStream *outStream, ISeqInStream *inStream, ICompressProgress *progress)
+{
+  CLz4Enc *p = (CLz4Enc *)pp;
+  CHashInStream hashStream;
+  Byte header[LZ4_FRAME_HEADER_SIZE_MAX];
+  unsigned size;
+  int i;
+
+  for (i = 0; i < p->props.numThreads; i++)
+  {
+    RINOK(Core_Alloc(&p->coders[i], p->props.level, p->allocBig));
+  }
+
+  {
+    CLz4FrameHeader fh;
+    fh.flags = LZ4_FLG_BLOCK_INDEP;
+    if (p->props.blockChecksum)
+      fh.flags |= LZ4_FLG_BLOCK_CHECKSUM;
+    if (p->props.checksum)
+      fh.flags |= LZ4_FLG_CONTENT_CHECKSUM;
+    fh.blockSizeMax = p->props.blockSize;
+    fh.contentSize = LZ4_CONTENT_SIZE_UNKNOWN;
+    fh.dictId = 0;
+    size = Lz4FrameHeader_Write(header, &fh);
+    RINOK(WriteData(outStream, header, size));
+  }
+
+  hashStream.p.Read = HashInStream_Read;
+  hashStream.inStream = inStream;
+  Xxh32_Init(&hashStream.xxh);
+
+  #ifndef _7ZIP_ST
+  if (p->props.numThreads > 1)
+  {
+    CMtCallbackImp mtCallback;
+    const size_t blockSize = GetMtBlockSize(p->props.blockSize);
+
+    mtCallback.funcTable.Code = MtCallbackImp_Code;
+    mtCallback.lz4Enc = p;
+
+    p->mtCoder.progress = progress;
+    p->mtCoder.inStream = &hashStream.p;
+    p->mtCoder.outStream = outStream;
+    p->mtCoder.alloc = p->alloc;
+    p->mtCoder.mtCallback = &mtCallback.funcTable;
+
+    p->mtCoder.blockSize = blockSize;
+    p->mtCoder.destBlockSize = blockSize
+        + (blockSize / p->props.blockSize) * (LZ4_BLOCK_HEADER_SIZE + LZ4_CHECKSUM_SIZE);
+    p->mtCoder.numThreads = p->props.numThreads;
+
+    RINOK(MtCoder_Code(&p->mtCoder));
+  }
+  else
+  #endif
+  {
+    RINOK(Lz4Enc_EncodeMt1(p, &p->coders[0], outStream, &hashStream.p, progress));
+  }
+
+  SetUi32(header, 0)
+  size = LZ4_BLOCK_HEADER_SIZE;
+  if (p->props.checksum)
+  {
+    SetUi32(header + size, Xxh32_Digest(&hashStream.xxh))
+    size += LZ4_CHECKSUM_SIZE;
+  }
+  return WriteData(outStream, header, size);
+}
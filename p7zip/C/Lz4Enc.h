@@ -0,0 +1,59 @@
+/* Lz4Enc.h -- LZ4 Encoder
+2026-10-18 : Public domain */
+
+#ifndef __LZ4_ENC_H
+#define __LZ4_ENC_H
+
+#include "Lz4.h"
+
+EXTERN_C_BEGIN
+
+/* levels 1 and 2 use fast hash table parser,
+   levels 3 - 12 use hash chain parser with increasing search depth */
+
+#define LZ4_ENC_LEVEL_MIN 1
+#define LZ4_ENC_LEVEL_MAX 12
+#define LZ4_ENC_LEVEL_DEFAULT 1
+#define LZ4_ENC_LEVEL_HC_MIN 3
+
+typedef struct
+{
+  int level;          /* 1 <= level <= 12, default = 1 */
+  UInt32 blockSize;   /* (64 KiB, 256 KiB, 1 MiB, 4 MiB), default = 0 (4 MiB, or less for small (reduceSize)) */
+  int checksum;       /* content checksum: 0 or 1, default = 1 */
+  int blockChecksum;  /* 0 or 1, default = 0 */
+  UInt64 reduceSize;  /* estimated size of data that will be compressed. default = (UInt64)(Int64)-1.
+                         Encoder uses this value to reduce block size. */
+  int numThreads;     /* 1 or 2 ... , default = 1 */
+} CLz4EncProps;
+
+void Lz4EncProps_Init(CLz4EncProps *p);
+void Lz4EncProps_Normalize(CLz4EncProps *p);
+
+/* ---------- CLz4EncHandle Interface ---------- */
+
+/* The encoder writes one frame with independent blocks, so the decoder can decode blocks in parallel.
+   In multithreading mode the threads compress groups of blocks.
+
+Lz4Enc_* functions can return the following exit codes:
+Returns:
+  SZ_OK           - OK
+  SZ_ERROR_MEM    - Memory allocation error
+  SZ_ERROR_PARAM  - Incorrect paramater in props
+  SZ_ERROR_READ   - Read callback error
+  SZ_ERROR_WRITE  - Write callback error
+  SZ_ERROR_PROGRESS - some break from progress callback
+  SZ_ERROR_THREAD - errors in multithreading functions (only for Mt version)
+*/
+
+typedef void * CLz4EncHandle;
+
+CLz4EncHandle Lz4Enc_Create(ISzAlloc *alloc, ISzAlloc *allocBig);
+void Lz4Enc_Destroy(CLz4EncHandle p);
+SRes Lz4Enc_SetProps(CLz4EncHandle p, const CLz4EncProps *props);
+SRes Lz4Enc_Encode(CLz4EncHandle p,
+    ISeqOutStream *outStream, ISeqInStream *inStream, ICompressProgress *progress);
+
+EXTERN_C_END
+
+#endif
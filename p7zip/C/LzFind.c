@@ -5,9 +5,24 @@
 
 #include <string.h>
 
+#include "CpuArch.h"
 #include "LzFind.h"
 #include "LzHash.h"
 
+#if defined(MY_CPU_AMD64) || (defined(MY_CPU_X86) && defined(__SSE2__)) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LZ_MATCH_LEN_SSE2
+#include <emmintrin.h>
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#define MY_FORCE_INLINE __forceinline
+#elif defined(__GNUC__)
+#define MY_FORCE_INLINE __inline__ __attribute__((always_inline))
+#else
+#define MY_FORCE_INLINE
+#endif
+
 #define kEmptyHashValue 0
 #define kMaxValForNormalize ((UInt32)0xFFFFFFFF)
 #define kNormalizeStepMin (1 << 10) /* it must be power of 2 */
@@ -321,6 +336,44 @@ static void MatchFinder_CheckLimits(CMatchFinder *p)
   MatchFinder_SetLimits(p);
 }
 
+/* GetMatchLen() returns the position of first different byte in (pb) and (cur),
+   starting from (len), or (lenLimit), if all bytes before (lenLimit) are equal.
+   It compares 16 bytes per step with SSE2, or 8 bytes per step on other
+   64-bit little-endian CPUs with unaligned access. Bytes after (lenLimit) are not read. */
+
+static MY_FORCE_INLINE UInt32 GetMatchLen(const Byte *pb, const Byte *cur, UInt32 len, UInt32 lenLimit)
+{
+  #if defined(LZ_MATCH_LEN_SSE2)
+  for (; len + 16 <= lenLimit; len += 16)
+  {
+    unsigned mask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(
+        _mm_loadu_si128((const __m128i *)(const void *)(pb + len)),
+        _mm_loadu_si128((const __m128i *)(const void *)(cur + len))));
+    if (mask != 0xFFFF)
+    {
+      #ifdef _MSC_VER
+      unsigned long index;
+      _BitScanForward(&index, ~mask);
+      return len + (UInt32)index;
+      #else
+      return len + (UInt32)__builtin_ctz(~mask);
+      #endif
+    }
+  }
+  #elif defined(MY_CPU_LE_UNALIGN) && defined(MY_CPU_64BIT) && defined(__GNUC__)
+  for (; len + 8 <= lenLimit; len += 8)
+  {
+    UInt64 x = GetUi64(pb + len) ^ GetUi64(cur + len);
+    if (x != 0)
+      return len + ((UInt32)__builtin_ctzll(x) >> 3);
+  }
+  #endif
+  for (; len != lenLimit; len++)
+    if (pb[len] != cur[len])
+      break;
+  return len;
+}
+
 static UInt32 * Hc_GetMatchesSpec(UInt32 lenLimit, UInt32 curMatch, UInt32 pos, const Byte *cur, CLzRef *son,
     UInt32 _cyclicBufferPos, UInt32 _cyclicBufferSize, UInt32 cutValue,
     UInt32 *distances, UInt32 maxLen)
@@ -336,10 +389,7 @@ static UInt32 * Hc_GetMatchesSpec(UInt32 lenLimit, UInt32 curMatch, UInt32 pos,
       curMatch = son[_cyclicBufferPos - delta + ((delta > _cyclicBufferPos) ? _cyclicBufferSize : 0)];
       if (pb[maxLen] == cur[maxLen] && *pb == *cur)
       {
-        UInt32 len = 0;
-        while (++len != lenLimit)
-          if (pb[len] != cur[len])
-            break;
+        UInt32 len = GetMatchLen(pb, cur, 1, lenLimit);
         if (maxLen < len)
         {
           *distances++ = maxLen = len;
@@ -374,9 +424,7 @@ UInt32 * GetMatchesSpec1(UInt32 lenLimit, UInt32 curMatch, UInt32 pos, const Byt
       if (pb[len] == cur[len])
       {
         if (++len != lenLimit && pb[len] == cur[len])
-          while (++len != lenLimit)
-            if (pb[len] != cur[len])
-              break;
+          len = GetMatchLen(pb, cur, len + 1, lenLimit);
         if (maxLen < len)
         {
           *distances++ = maxLen = len;
@@ -427,9 +475,7 @@ static void SkipMatchesSpec(UInt32 lenLimit, UInt32 curMatch, UInt32 pos, const
       UInt32 len = (len0 < len1 ? len0 : len1);
       if (pb[len] == cur[len])
       {
-        while (++len != lenLimit)
-          if (pb[len] != cur[len])
-            break;
+        len = GetMatchLen(pb, cur, len + 1, lenLimit);
         {
           if (len == lenLimit)
           {
@@ -523,9 +569,7 @@ static UInt32 Bt3_MatchFinder_GetMatches(CMatchFinder *p, UInt32 *distances)
   offset = 0;
   if (delta2 < p->cyclicBufferSize && *(cur - delta2) == *cur)
   {
-    for (; maxLen != lenLimit; maxLen++)
-      if (cur[(ptrdiff_t)maxLen - delta2] != cur[maxLen])
-        break;
+    maxLen = GetMatchLen(cur - delta2, cur, maxLen, lenLimit);
     distances[0] = maxLen;
     distances[1] = delta2 - 1;
     offset = 2;
@@ -570,9 +614,7 @@ static UInt32 Bt4_MatchFinder_GetMatches(CMatchFinder *p, UInt32 *distances)
   }
   if (offset != 0)
   {
-    for (; maxLen != lenLimit; maxLen++)
-      if (cur[(ptrdiff_t)maxLen - delta2] != cur[maxLen])
-        break;
+    maxLen = GetMatchLen(cur - delta2, cur, maxLen, lenLimit);
     distances[offset - 2] = maxLen;
     if (maxLen == lenLimit)
     {
@@ -617,9 +659,7 @@ static UInt32 Hc4_MatchFinder_GetMatches(CMatchFinder *p, UInt32 *distances)
   }
   if (offset != 0)
   {
-    for (; maxLen != lenLimit; maxLen++)
-      if (cur[(ptrdiff_t)maxLen - delta2] != cur[maxLen])
-        break;
+    maxLen = GetMatchLen(cur - delta2, cur, maxLen, lenLimit);
     distances[offset - 2] = maxLen;
     if (maxLen == lenLimit)
     {
@@ -3,6 +3,7 @@
 
 #include "Precomp.h"
 
+#include "Alloc.h"
 #include "LzHash.h"
 
 #include "LzFindMt.h"
@@ -115,6 +116,7 @@ static SRes MtSync_Create2(CMtSync *p, THREAD_FUNC_TYPE startAddress, void *obj,
   RINOK_THREAD(Semaphore_Create(&p->filledSemaphore, 0, numBlocks));
 
   p->needStart = True;
+  p->numaNode = GetNumaLocalNode();
 
   RINOK_THREAD(Thread_Create(&p->thread, startAddress, obj));
   p->wasCreated = True;
@@ -133,11 +135,22 @@ void MtSync_Init(CMtSync *p) { p->needStart = True; }
 
 #define kMtMaxValForNormalize 0xFFFFFFFF
 
+/* GetHeads functions calculate the hash values for a batch of positions first,
+   and they prefetch the hash table items for these values. So the cache misses
+   of random accesses to big hash table are overlapped. Then the hash table
+   is updated in order of positions, as before. */
+
+#define kGetHeadsBatchSize 64
+
 #define DEF_GetHeads2(name, v, action) \
 static void GetHeads ## name(const Byte *p, UInt32 pos, \
 UInt32 *hash, UInt32 hashMask, UInt32 *heads, UInt32 numHeads, const UInt32 *crc) \
-{ action; for (; numHeads != 0; numHeads--) { \
-const UInt32 value = (v); p++; *heads++ = pos - hash[value]; hash[value] = pos++;  } }
+{ UInt32 values[kGetHeadsBatchSize]; action; \
+while (numHeads != 0) { \
+UInt32 i, num = (numHeads < kGetHeadsBatchSize) ? numHeads : kGetHeadsBatchSize; \
+for (i = 0; i < num; i++, p++) { const UInt32 value = (v); values[i] = value; LZ_PREFETCH(hash + value); } \
+for (i = 0; i < num; i++) { const UInt32 value = values[i]; heads[i] = pos - hash[value]; hash[value] = pos++; } \
+heads += num; numHeads -= num; } }
 
 #define DEF_GetHeads(name, v) DEF_GetHeads2(name, v, ;)
 
@@ -150,6 +163,7 @@ DEF_GetHeads(4b, (crc[p[0]] ^ p[1] ^ ((UInt32)p[2] << 8) ^ ((UInt32)p[3] << 16))
 void HashThreadFunc(CMatchFinderMt *mt)
 {
   CMtSync *p = &mt->hashSync;
+  PinThreadToNumaNode(p->numaNode);
   for (;;)
   {
     UInt32 numProcessedBlocks = 0;
@@ -407,6 +421,7 @@ void BtFillBlock(CMatchFinderMt *p, UInt32 globalBlockIndex)
 void BtThreadFunc(CMatchFinderMt *mt)
 {
   CMtSync *p = &mt->btSync;
+  PinThreadToNumaNode(p->numaNode);
   for (;;)
   {
     UInt32 blockIndex = 0;
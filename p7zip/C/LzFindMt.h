@@ -34,6 +34,7 @@ typedef struct _CMtSync
   Bool csWasEntered;
   CCriticalSection cs;
   UInt32 numProcessedBlocks;
+  int numaNode;
 } CMtSync;
 
 typedef UInt32 * (*Mf_Mix_Matches)(void *p, UInt32 matchMinPos, UInt32 *distances);
@@ -4,6 +4,15 @@
 #ifndef __LZ_HASH_H
 #define __LZ_HASH_H
 
+#if defined(__GNUC__)
+#define LZ_PREFETCH(ptr) __builtin_prefetch(ptr)
+#elif defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64) || defined(_M_AMD64))
+#include <xmmintrin.h>
+#define LZ_PREFETCH(ptr) _mm_prefetch((const char *)(ptr), _MM_HINT_T0)
+#else
+#define LZ_PREFETCH(ptr)
+#endif
+
 #define kHash2Size (1 << 10)
 #define kHash3Size (1 << 16)
 #define kHash4Size (1 << 20)
@@ -64,9 +64,21 @@ typedef struct
   UInt32 numProbs;
   unsigned tempBufSize;
   Byte tempBuf[LZMA_REQUIRED_INPUT_MAX];
+  int core;
 } CLzmaDec;
 
-#define LzmaDec_Construct(p) { (p)->dic = 0; (p)->probs = 0; }
+/* (core) selects the code that decodes LZMA symbols in that decoder:
+     LZMA_DEC_CORE_REF  - (default) original code.
+     LZMA_DEC_CORE_FAST - branch-reduced literal decoding and
+                          chunked copying of matches.
+   Both cores use same state and produce same output,
+   so the core can be changed between calls of decoding functions. */
+
+#define LZMA_DEC_CORE_REF  0
+#define LZMA_DEC_CORE_FAST 1
+
+#define LzmaDec_Construct(p) { (p)->dic = 0; (p)->probs = 0; (p)->core = LZMA_DEC_CORE_REF; }
+#define LzmaDec_SetCore(p, c) (p)->core = (c)
 
 void LzmaDec_Init(CLzmaDec *p);
 
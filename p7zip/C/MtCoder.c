@@ -5,6 +5,7 @@
 
 #include <stdio.h>
 
+#include "Alloc.h"
 #include "MtCoder.h"
 
 void LoopThread_Construct(CLoopThread *p)
@@ -24,6 +25,7 @@ void LoopThread_Close(CLoopThread *p)
 static THREAD_FUNC_RET_TYPE THREAD_FUNC_CALL_TYPE LoopThreadFunc(void *pp)
 {
   CLoopThread *p = (CLoopThread *)pp;
+  PinThreadToNumaNode(p->numaNode);
   for (;;)
   {
     if (Event_Wait(&p->startEvent) != 0)
@@ -39,6 +41,7 @@ static THREAD_FUNC_RET_TYPE THREAD_FUNC_CALL_TYPE LoopThreadFunc(void *pp)
 WRes LoopThread_Create(CLoopThread *p)
 {
   p->stop = 0;
+  p->numaNode = GetNumaLocalNode();
   RINOK(AutoResetEvent_CreateNotSignaled(&p->startEvent));
   RINOK(AutoResetEvent_CreateNotSignaled(&p->finishedEvent));
   return Thread_Create(&p->thread, LoopThreadFunc, p);
@@ -18,6 +18,7 @@ typedef struct
   THREAD_FUNC_TYPE func;
   LPVOID param;
   THREAD_FUNC_RET_TYPE res;
+  int numaNode;
 } CLoopThread;
 
 void LoopThread_Construct(CLoopThread *p);
@@ -16,6 +16,7 @@ EXTERN_C_BEGIN
 #define XZ_ID_ARM 7
 #define XZ_ID_ARMT 8
 #define XZ_ID_SPARC 9
+#define XZ_ID_ARM64 0xA
 #define XZ_ID_LZMA2 0x21
 
 unsigned Xz_ReadVarInt(const Byte *p, size_t maxSize, UInt64 *value);
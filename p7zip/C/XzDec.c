@@ -92,6 +92,7 @@ SRes BraState_SetProps(void *pp, const Byte *props, size_t propSize, ISzAlloc *a
         case XZ_ID_PPC:
         case XZ_ID_ARM:
         case XZ_ID_SPARC:
+        case XZ_ID_ARM64:
           if ((v & 3) != 0)
             return SZ_ERROR_UNSUPPORTED;
           break;
@@ -180,6 +181,7 @@ static SRes BraState_Code(void *pp, Byte *dest, SizeT *destLen, const Byte *src,
       CASE_BRA_CONV(ARM)
       CASE_BRA_CONV(ARMT)
       CASE_BRA_CONV(SPARC)
+      CASE_BRA_CONV(ARM64)
       default:
         return SZ_ERROR_UNSUPPORTED;
     }
@@ -206,7 +208,8 @@ SRes BraState_SetFromMethod(IStateCoder *p, UInt64 id, int encodeMode, ISzAlloc
       id != XZ_ID_IA64 &&
       id != XZ_ID_ARM &&
       id != XZ_ID_ARMT &&
-      id != XZ_ID_SPARC)
+      id != XZ_ID_SPARC &&
+      id != XZ_ID_ARM64)
     return SZ_ERROR_UNSUPPORTED;
   p->p = 0;
   decoder = (CBraState *)alloc->Alloc(alloc, sizeof(CBraState));
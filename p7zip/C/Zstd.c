@@ -0,0 +1,231 @@
+/* Zstd.c -- Zstandard format
+2026-10-18 : Public domain */
+
+#include "Precomp.h"
+
+#include <string.h>
+
+#include "CpuArch.h"
+#include "Zstd.h"
+
+/* ---------- XXH64 ---------- */
+
+#define XXH_P1 UINT64_CONST(0x9E3779B185EBCA87)
+#define XXH_P2 UINT64_CONST(0xC2B2AE3D27D4EB4F)
+#define XXH_P3 UINT64_CONST(0x165667B19E3779F9)
+#define XXH_P4 UINT64_CONST(0x85EBCA77C2B2AE63)
+#define XXH_P5 UINT64_CONST(0x27D4EB2F165667C5)
+
+#define XXH_ROTL(x, n) (((x) << (n)) | ((x) >> (64 - (n))))
+
+static UInt64 Xxh64_Round(UInt64 acc, UInt64 v)
+{
+  acc += v * XXH_P2;
+  acc = XXH_ROTL(acc, 31);
+  return acc * XXH_P1;
+}
+
+static UInt64 Xxh64_MergeRound(UInt64 acc, UInt64 v)
+{
+  acc ^= Xxh64_Round(0, v);
+  return acc * XXH_P1 + XXH_P4;
+}
+
+void Xxh64_Init(CXxh64 *p)
+{
+  p->v[0] = XXH_P1 + XXH_P2;
+  p->v[1] = XXH_P2;
+  p->v[2] = 0;
+  p->v[3] = (UInt64)0 - XXH_P1;
+  p->totalSize = 0;
+  p->bufSize = 0;
+}
+
+static const Byte *Xxh64_Process(UInt64 *v, const Byte *data, const Byte *lim)
+{
+  UInt64 v0 = v[0], v1 = v[1], v2 = v[2], v3 = v[3];
+  for (; (size_t)(lim - data) >= 32; data += 32)
+  {
+    v0 = Xxh64_Round(v0, GetUi64(data));
+    v1 = Xxh64_Round(v1, GetUi64(data + 8));
+    v2 = Xxh64_Round(v2, GetUi64(data + 16));
+    v3 = Xxh64_Round(v3, GetUi64(data + 24));
+  }
+  v[0] = v0; v[1] = v1; v[2] = v2; v[3] = v3;
+  return data;
+}
+
+void Xxh64_Update(CXxh64 *p, const void *data, size_t size)
+{
+  const Byte *d = (const Byte *)data;
+  p->totalSize += size;
+  if (p->bufSize != 0)
+  {
+    unsigned rem = 32 - p->bufSize;
+    if (size < rem)
+    {
+      memcpy(p->buf + p->bufSize, d, size);
+      p->bufSize += (unsigned)size;
+      return;
+    }
+    memcpy(p->buf + p->bufSize, d, rem);
+    Xxh64_Process(p->v, p->buf, p->buf + 32);
+    d += rem;
+    size -= rem;
+    p->bufSize = 0;
+  }
+  {
+    const Byte *lim = d + size;
+    d = Xxh64_Process(p->v, d, lim);
+    p->bufSize = (unsigned)(lim - d);
+    memcpy(p->buf, d, p->bufSize);
+  }
+}
+
+UInt64 Xxh64_Digest(const CXxh64 *p)
+{
+  UInt64 h;
+  const Byte *d = p->buf;
+  unsigned rem = p->bufSize;
+  if (p->totalSize >= 32)
+  {
+    h = XXH_ROTL(p->v[0], 1) + XXH_ROTL(p->v[1], 7) + XXH_ROTL(p->v[2], 12) + XXH_ROTL(p->v[3], 18);
+    h = Xxh64_MergeRound(h, p->v[0]);
+    h = Xxh64_MergeRound(h, p->v[1]);
+    h = Xxh64_MergeRound(h, p->v[2]);
+    h = Xxh64_MergeRound(h, p->v[3]);
+  }
+  else
+    h = XXH_P5;
+  h += p->totalSize;
+  for (; rem >= 8; rem -= 8, d += 8)
+  {
+    h ^= Xxh64_Round(0, GetUi64(d));
+    h = XXH_ROTL(h, 27) * XXH_P1 + XXH_P4;
+  }
+  if (rem >= 4)
+  {
+    h ^= (UInt64)GetUi32(d) * XXH_P1;
+    h = XXH_ROTL(h, 23) * XXH_P2 + XXH_P3;
+    rem -= 4;
+    d += 4;
+  }
+  for (; rem != 0; rem--, d++)
+  {
+    h ^= *d * XXH_P5;
+    h = XXH_ROTL(h, 11) * XXH_P1;
+  }
+  h ^= h >> 33;
+  h *= XXH_P2;
+  h ^= h >> 29;
+  h *= XXH_P3;
+  h ^= h >> 32;
+  return h;
+}
+
+/* ---------- Sequence codes ---------- */
+
+const UInt32 g_ZstdLlBase[ZSTD_NUM_LL_CODES] =
+{
+  0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+  16, 18, 20, 22, 24, 28, 32, 40, 48, 64, 128, 256, 512, 1024, 2048, 4096,
+  8192, 16384, 32768, 65536
+};
+
+const Byte g_ZstdLlBits[ZSTD_NUM_LL_CODES] =
+{
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  1, 1, 1, 1, 2, 2, 3, 3, 4, 6, 7, 8, 9, 10, 11, 12,
+  13, 14, 15, 16
+};
+
+const UInt32 g_ZstdMlBase[ZSTD_NUM_ML_CODES] =
+{
+  3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18,
+  19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32, 33, 34,
+  35, 37, 39, 41, 43, 47, 51, 59, 67, 83, 99, 131, 259, 515, 1027, 2051,
+  4099, 8195, 16387, 32771, 65539
+};
+
+const Byte g_ZstdMlBits[ZSTD_NUM_ML_CODES] =
+{
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  1, 1, 1, 1, 2, 2, 3, 3, 4, 4, 5, 7, 8, 9, 10, 11,
+  12, 13, 14, 15, 16
+};
+
+const Int16 g_ZstdLlDefaultNorm[ZSTD_NUM_LL_CODES] =
+{
+  4, 3, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 1, 1, 1,
+  2, 2, 2, 2, 2, 2, 2, 2, 2, 3, 2, 1, 1, 1, 1, 1,
+  -1, -1, -1, -1
+};
+
+const Int16 g_ZstdMlDefaultNorm[ZSTD_NUM_ML_CODES] =
+{
+  1, 4, 3, 2, 2, 2, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1,
+  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, -1, -1,
+  -1, -1, -1, -1, -1
+};
+
+const Int16 g_ZstdOfDefaultNorm[ZSTD_NUM_OF_CODES_DEFAULT] =
+{
+  1, 1, 1, 1, 1, 1, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1,
+  1, 1, 1, 1, 1, 1, 1, 1, -1, -1, -1, -1, -1
+};
+
+/* ---------- Frame header ---------- */
+
+static const Byte k_DictIdSizes[4] = { 0, 1, 2, 4 };
+static const Byte k_ContentSizeSizes[4] = { 0, 2, 4, 8 };
+
+unsigned ZstdFrameHeader_GetSize(Byte d)
+{
+  unsigned size = ZSTD_SIG_SIZE + 1 + k_DictIdSizes[d & 3] + k_ContentSizeSizes[d >> 6];
+  if ((d & ZSTD_FD_SINGLE_SEGMENT) == 0)
+    size++;
+  else if ((d >> 6) == 0)
+    size++;
+  return size;
+}
+
+SRes ZstdFrameHeader_Parse(CZstdFrameHeader *p, const Byte *buf)
+{
+  Byte d;
+  const Byte *cur;
+  unsigned i, size;
+  if (GetUi32(buf) != ZSTD_MAGIC)
+    return SZ_ERROR_NO_ARCHIVE;
+  d = buf[4];
+  p->descriptor = d;
+  if ((d & 8) != 0)
+    return SZ_ERROR_UNSUPPORTED;
+  cur = buf + 5;
+  p->windowSize = 0;
+  if ((d & ZSTD_FD_SINGLE_SEGMENT) == 0)
+  {
+    unsigned wd = *cur++;
+    unsigned wlog = ZSTD_WINDOW_LOG_MIN + (wd >> 3);
+    if (wlog > ZSTD_WINDOW_LOG_MAX)
+      return SZ_ERROR_UNSUPPORTED;
+    p->windowSize = ((UInt64)1 << wlog) + ((UInt64)1 << (wlog - 3)) * (wd & 7);
+  }
+  p->dictId = 0;
+  size = k_DictIdSizes[d & 3];
+  for (i = 0; i < size; i++)
+    p->dictId |= (UInt32)cur[i] << (8 * i);
+  cur += size;
+  p->contentSize = ZSTD_CONTENT_SIZE_UNKNOWN;
+  switch (d >> 6)
+  {
+    case 0: if ((d & ZSTD_FD_SINGLE_SEGMENT) != 0) p->contentSize = cur[0]; break;
+    case 1: p->contentSize = (UInt32)cur[0] + ((UInt32)cur[1] << 8) + 256; break;
+    case 2: p->contentSize = GetUi32(cur); break;
+    default: p->contentSize = GetUi64(cur); break;
+  }
+  if ((d & ZSTD_FD_SINGLE_SEGMENT) != 0)
+    p->windowSize = p->contentSize;
+  return SZ_OK;
+}
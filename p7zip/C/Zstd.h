@@ -0,0 +1,175 @@
+/* Zstd.h -- Zstandard format
+2026-10-18 : Public domain */
+
+#ifndef __ZSTD_H
+#define __ZSTD_H
+
+#include "7zTypes.h"
+
+EXTERN_C_BEGIN
+
+#define ZSTD_MAGIC 0xFD2FB528
+#define ZSTD_SKIP_MAGIC 0x184D2A50
+#define ZSTD_SKIP_MAGIC_MASK 0xFFFFFFF0
+
+#define ZSTD_SIG_SIZE 4
+#define ZSTD_SKIP_HEADER_SIZE 8
+#define ZSTD_FRAME_HEADER_SIZE_MIN 6
+#define ZSTD_FRAME_HEADER_SIZE_MAX 18
+#define ZSTD_BLOCK_HEADER_SIZE 3
+#define ZSTD_CHECKSUM_SIZE 4
+
+#define ZSTD_BLOCK_SIZE_MAX (1 << 17)
+
+#define ZSTD_WINDOW_LOG_MIN 10
+#define ZSTD_WINDOW_LOG_MAX 31
+
+#define ZSTD_BLOCK_TYPE_RAW 0
+#define ZSTD_BLOCK_TYPE_RLE 1
+#define ZSTD_BLOCK_TYPE_COMPRESSED 2
+
+#define ZSTD_FD_SINGLE_SEGMENT (1 << 5)
+#define ZSTD_FD_CHECKSUM (1 << 2)
+
+#define ZSTD_CONTENT_SIZE_UNKNOWN ((UInt64)(Int64)-1)
+
+/* the decoder and the encoder copy literals and matches by 16-byte chunks,
+   so they can read and write up to ZSTD_PADDING_SIZE bytes after the end of data */
+
+#define ZSTD_PADDING_SIZE 32
+
+/* ---------- XXH64 (frame checksum) ---------- */
+
+typedef struct
+{
+  UInt64 v[4];
+  UInt64 totalSize;
+  Byte buf[32];
+  unsigned bufSize;
+} CXxh64;
+
+void Xxh64_Init(CXxh64 *p);
+void Xxh64_Update(CXxh64 *p, const void *data, size_t size);
+UInt64 Xxh64_Digest(const CXxh64 *p);
+
+/* ---------- Sequence codes ---------- */
+
+#define ZSTD_NUM_LL_CODES 36
+#define ZSTD_NUM_ML_CODES 53
+#define ZSTD_NUM_OF_CODES 32
+
+#define ZSTD_LL_LOG_MAX 9
+#define ZSTD_ML_LOG_MAX 9
+#define ZSTD_OF_LOG_MAX 8
+
+#define ZSTD_LL_LOG_DEFAULT 6
+#define ZSTD_ML_LOG_DEFAULT 6
+#define ZSTD_OF_LOG_DEFAULT 5
+#define ZSTD_NUM_OF_CODES_DEFAULT 29
+
+#define ZSTD_MATCH_LEN_MIN 3
+
+#define ZSTD_HUF_LOG_MAX 11
+#define ZSTD_HUF_WEIGHTS_LOG_MAX 6
+
+extern const UInt32 g_ZstdLlBase[ZSTD_NUM_LL_CODES];
+extern const Byte g_ZstdLlBits[ZSTD_NUM_LL_CODES];
+extern const UInt32 g_ZstdMlBase[ZSTD_NUM_ML_CODES];
+extern const Byte g_ZstdMlBits[ZSTD_NUM_ML_CODES];
+
+extern const Int16 g_ZstdLlDefaultNorm[ZSTD_NUM_LL_CODES];
+extern const Int16 g_ZstdMlDefaultNorm[ZSTD_NUM_ML_CODES];
+extern const Int16 g_ZstdOfDefaultNorm[ZSTD_NUM_OF_CODES_DEFAULT];
+
+/* ---------- Frame header ---------- */
+
+typedef struct
+{
+  UInt64 contentSize;
+  UInt64 windowSize;
+  UInt32 dictId;
+  Byte descriptor;
+} CZstdFrameHeader;
+
+#define ZstdFrameHeader_HasChecksum(p) (((p)->descriptor & ZSTD_FD_CHECKSUM) != 0)
+
+/* ZstdFrameHeader_GetSize() returns the size of frame header (including signature)
+   from descriptor byte (buf[4]). */
+
+unsigned ZstdFrameHeader_GetSize(Byte descriptor);
+
+/*
+ZstdFrameHeader_Parse()
+  buf must contain full frame header (ZstdFrameHeader_GetSize(buf[4]) bytes).
+Returns:
+  SZ_OK
+  SZ_ERROR_NO_ARCHIVE - it's not zstd frame signature
+  SZ_ERROR_UNSUPPORTED - reserved bit is set, or window is too big
+*/
+
+SRes ZstdFrameHeader_Parse(CZstdFrameHeader *p, const Byte *buf);
+
+/* ---------- Block decoder ---------- */
+
+typedef struct
+{
+  UInt16 nextState;
+  Byte numAddBits;
+  Byte numBits;
+  UInt32 base;
+} CZstdSeqCell;
+
+typedef struct
+{
+  Byte symbol;
+  Byte numBits;
+} CZstdHufCell;
+
+typedef struct
+{
+  CZstdSeqCell *llTable;
+  CZstdSeqCell *mlTable;
+  CZstdSeqCell *ofTable;
+  CZstdHufCell *hufTable;
+  Byte *litBuf;
+
+  unsigned llLog;
+  unsigned mlLog;
+  unsigned ofLog;
+  unsigned hufLog;
+  Bool hufDefined;
+  Bool llDefined;
+  Bool mlDefined;
+  Bool ofDefined;
+
+  UInt32 reps[3];
+} CZstdDec;
+
+void ZstdDec_Construct(CZstdDec *p);
+SRes ZstdDec_Allocate(CZstdDec *p, ISzAlloc *alloc);
+void ZstdDec_Free(CZstdDec *p, ISzAlloc *alloc);
+
+/* ZstdDec_InitFrame() must be called at the start of each frame */
+
+void ZstdDec_InitFrame(CZstdDec *p);
+
+/*
+ZstdDec_DecodeBlock() decodes the content of one compressed block.
+  src     - block content, (ZSTD_PADDING_SIZE) bytes after (src + srcSize) must be readable.
+  dic     - output buffer. Decoded data is written to (dic + dicPos).
+            (ZSTD_PADDING_SIZE) bytes after (dic + dicPos + blockSizeMax) must be writable.
+  histSize - the number of bytes before (dic + dicPos) that belong to current frame
+            and that can be referenced by matches (up to window size).
+  blockSizeMax - the maximum size of decoded block.
+  *outSize - the size of decoded data.
+Returns:
+  SZ_OK
+  SZ_ERROR_DATA - data error
+*/
+
+SRes ZstdDec_DecodeBlock(CZstdDec *p, const Byte *src, size_t srcSize,
+    Byte *dic, size_t dicPos, size_t histSize, size_t blockSizeMax, size_t *outSize);
+
+EXTERN_C_END
+
+#endif
@@ -0,0 +1,824 @@
+/* ZstdDec.c -- Zstandard Decoder
+2026-10-18 : Public domain */
+
+#include "Precomp.h"
+
+#include <string.h>
+
+#include "CpuArch.h"
+#include "Zstd.h"
+
+#ifdef _MSC_VER
+#define MY_FORCE_INLINE __forceinline
+#elif defined(__GNUC__)
+#define MY_FORCE_INLINE __inline__ __attribute__((always_inline))
+#else
+#define MY_FORCE_INLINE
+#endif
+
+#define kLitBufSize (ZSTD_BLOCK_SIZE_MAX + ZSTD_PADDING_SIZE)
+
+#define kLlTableSize (1 << ZSTD_LL_LOG_MAX)
+#define kMlTableSize (1 << ZSTD_ML_LOG_MAX)
+#define kOfTableSize (1 << ZSTD_OF_LOG_MAX)
+#define kHufTableSize (1 << ZSTD_HUF_LOG_MAX)
+
+#define kNumSymbolsMax 64
+
+#define COPY_16(dest, src) memcpy(dest, src, 16)
+#define COPY_8(dest, src) memcpy(dest, src, 8)
+
+static unsigned GetHighBit(UInt32 v)
+{
+  unsigned i = 0;
+  for (; (v >>= 1) != 0; i++);
+  return i;
+}
+
+/* ---------- Backward bit stream ---------- */
+
+/* The encoder writes the bits from low to high and it sets the highest bit
+   of last byte as end marker. The decoder reads bits from the end of stream.
+   v contains 8 bytes at cur, numBits is the number of bits consumed from the top of v.
+   If (numBits > 64), the decoder has read more bits than there are in stream. */
+
+typedef struct
+{
+  UInt64 v;
+  unsigned numBits;
+  const Byte *cur;
+  const Byte *lim;
+} CBitDec;
+
+static SRes BitDec_Init(CBitDec *p, const Byte *src, size_t size)
+{
+  unsigned i;
+  if (size == 0 || src[size - 1] == 0)
+    return SZ_ERROR_DATA;
+  p->lim = src;
+  if (size >= 8)
+  {
+    p->cur = src + size - 8;
+    p->v = GetUi64(p->cur);
+    p->numBits = 0;
+  }
+  else
+  {
+    p->cur = src;
+    p->v = 0;
+    for (i = 0; i < size; i++)
+      p->v |= (UInt64)src[i] << (8 * i);
+    p->numBits = (8 - (unsigned)size) * 8;
+  }
+  p->numBits += 8 - GetHighBit(src[size - 1]);
+  return SZ_OK;
+}
+
+#define BitDec_Peek(p, n) ((UInt32)((((p)->v << ((p)->numBits & 63)) >> 1) >> (63 - (n))))
+#define BitDec_Skip(p, n) (p)->numBits += (n)
+#define BitDec_IsFinished(p) ((p)->cur == (p)->lim && (p)->numBits == 64)
+#define BitDec_IsOverflow(p) ((p)->numBits > 64)
+
+static MY_FORCE_INLINE UInt32 BitDec_Read(CBitDec *p, unsigned n)
+{
+  UInt32 v = BitDec_Peek(p, n);
+  p->numBits += n;
+  return v;
+}
+
+static MY_FORCE_INLINE void BitDec_Reload(CBitDec *p)
+{
+  if (p->cur != p->lim)
+  {
+    size_t n = p->numBits >> 3;
+    size_t rem = (size_t)(p->cur - p->lim);
+    if (n > rem)
+      n = rem;
+    p->cur -= n;
+    p->numBits -= (unsigned)n * 8;
+    p->v = GetUi64(p->cur);
+  }
+}
+
+/* ---------- FSE tables ---------- */
+
+/* ReadNormCounts() reads FSE table description.
+   It returns the size of description, or 0 for data error. */
+
+static size_t ReadNormCounts(Int16 *norm, unsigned *maxSymbol, unsigned *tableLog,
+    unsigned maxLog, const Byte *src, size_t size)
+{
+  size_t bitPos;
+  unsigned sym = 0;
+  unsigned maxSym = *maxSymbol;
+  Int32 remaining, threshold;
+  unsigned numBits;
+  Bool prev0 = False;
+
+  #define GET_BYTE(pos) ((pos) < size ? (UInt32)src[pos] : 0)
+  #define PEEK_BITS(n) ((UInt32)((GET_BYTE(bitPos >> 3) | (GET_BYTE((bitPos >> 3) + 1) << 8) \
+      | (GET_BYTE((bitPos >> 3) + 2) << 16) | (GET_BYTE((bitPos >> 3) + 3) << 24)) >> (bitPos & 7)) & (((UInt32)1 << (n)) - 1))
+
+  if (size == 0)
+    return 0;
+  *tableLog = (src[0] & 0xF) + 5;
+  if (*tableLog > maxLog)
+    return 0;
+  bitPos = 4;
+  remaining = ((Int32)1 << *tableLog) + 1;
+  threshold = (Int32)1 << *tableLog;
+  numBits = *tableLog + 1;
+
+  while (remaining > 1)
+  {
+    Int32 max, count;
+    UInt32 v;
+    if (prev0)
+    {
+      unsigned n0 = sym;
+      for (;;)
+      {
+        UInt32 r = PEEK_BITS(2);
+        bitPos += 2;
+        n0 += r;
+        if (r != 3)
+          break;
+        if (n0 > maxSym)
+          return 0;
+      }
+      if (n0 > maxSym)
+        return 0;
+      while (sym < n0)
+        norm[sym++] = 0;
+    }
+    if (sym > maxSym)
+      return 0;
+    max = (2 * threshold - 1) - remaining;
+    v = PEEK_BITS(numBits);
+    if ((Int32)(v & (threshold - 1)) < max)
+    {
+      count = (Int32)(v & (threshold - 1));
+      bitPos += numBits - 1;
+    }
+    else
+    {
+      count = (Int32)(v & (2 * threshold - 1));
+      if (count >= threshold)
+        count -= max;
+      bitPos += numBits;
+    }
+    count--;
+    remaining -= (count < 0) ? -count : count;
+    norm[sym++] = (Int16)count;
+    prev0 = (count == 0);
+    while (remaining < threshold)
+    {
+      numBits--;
+      threshold >>= 1;
+    }
+  }
+  if (remaining != 1)
+    return 0;
+  *maxSymbol = sym - 1;
+  bitPos = (bitPos + 7) >> 3;
+  if (bitPos > size)
+    return 0;
+  return bitPos;
+}
+
+/* BuildSeqTable() builds decoding table from normalized counts.
+   (base) and (addBits) are the values of symbols for sequence codes,
+   or NULL for Huffman weights (base = symbol). */
+
+static void BuildSeqTable(CZstdSeqCell *table, const Int16 *norm, unsigned maxSym, unsigned tableLog,
+    const UInt32 *base, const Byte *addBits)
+{
+  UInt16 symbolNext[kNumSymbolsMax];
+  Byte symbols[1 << ZSTD_LL_LOG_MAX];
+  const UInt32 tableSize = (UInt32)1 << tableLog;
+  const UInt32 mask = tableSize - 1;
+  const UInt32 step = (tableSize >> 1) + (tableSize >> 3) + 3;
+  UInt32 highThreshold = tableSize - 1;
+  UInt32 pos = 0, u;
+  unsigned s;
+
+  for (s = 0; s <= maxSym; s++)
+  {
+    if (norm[s] == -1)
+    {
+      symbols[highThreshold--] = (Byte)s;
+      symbolNext[s] = 1;
+    }
+    else
+      symbolNext[s] = (UInt16)norm[s];
+  }
+  for (s = 0; s <= maxSym; s++)
+  {
+    int i;
+    for (i = 0; i < norm[s]; i++)
+    {
+      symbols[pos] = (Byte)s;
+      do
+        pos = (pos + step) & mask;
+      while (pos > highThreshold);
+    }
+  }
+  for (u = 0; u < tableSize; u++)
+  {
+    CZstdSeqCell *cell = &table[u];
+    UInt32 next;
+    unsigned numBits;
+    s = symbols[u];
+    next = symbolNext[s]++;
+    numBits = tableLog - GetHighBit(next);
+    cell->numBits = (Byte)numBits;
+    cell->nextState = (UInt16)((next << numBits) - tableSize);
+    if (base)
+    {
+      cell->base = base[s];
+      cell->numAddBits = addBits[s];
+    }
+    else
+    {
+      cell->base = s;
+      cell->numAddBits = 0;
+    }
+  }
+}
+
+static const UInt32 k_OfBase[ZSTD_NUM_OF_CODES] =
+{
+  1, 2, 4, 8, 0x10, 0x20, 0x40, 0x80,
+  0x100, 0x200, 0x400, 0x800, 0x1000, 0x2000, 0x4000, 0x8000,
+  0x10000, 0x20000, 0x40000, 0x80000, 0x100000, 0x200000, 0x400000, 0x800000,
+  0x1000000, 0x2000000, 0x4000000, 0x8000000, 0x10000000, 0x20000000, 0x40000000, 0x80000000
+};
+
+static const Byte k_OfBits[ZSTD_NUM_OF_CODES] =
+{
+  0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+  16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31
+};
+
+/* ---------- Huffman ---------- */
+
+static size_t ReadHuffWeights(Byte *weights, unsigned *numWeights, const Byte *src, size_t size)
+{
+  unsigned header, i, n;
+  if (size == 0)
+    return 0;
+  header = src[0];
+  if (header >= 128)
+  {
+    n = header - 127;
+    if (1 + ((n + 1) >> 1) > size)
+      return 0;
+    for (i = 0; i < n; i++)
+    {
+      Byte b = src[1 + (i >> 1)];
+      weights[i] = (Byte)((i & 1) ? (b & 0xF) : (b >> 4));
+    }
+    *numWeights = n;
+    return 1 + ((n + 1) >> 1);
+  }
+  {
+    CZstdSeqCell table[1 << ZSTD_HUF_WEIGHTS_LOG_MAX];
+    Int16 norm[16];
+    unsigned maxSym = 15, tableLog;
+    size_t hs;
+    CBitDec bd;
+    UInt32 s1, s2;
+    if (header == 0 || header + 1 > size)
+      return 0;
+    hs = ReadNormCounts(norm, &maxSym, &tableLog, ZSTD_HUF_WEIGHTS_LOG_MAX, src + 1, header);
+    if (hs == 0 || hs >= header)
+      return 0;
+    BuildSeqTable(table, norm, maxSym, tableLog, NULL, NULL);
+    if (BitDec_Init(&bd, src + 1 + hs, header - hs) != SZ_OK)
+      return 0;
+    s1 = BitDec_Read(&bd, tableLog);
+    s2 = BitDec_Read(&bd, tableLog);
+    n = 0;
+    for (;;)
+    {
+      if (n >= 254)
+        return 0;
+      weights[n++] = (Byte)table[s1].base;
+      s1 = table[s1].nextState + BitDec_Read(&bd, table[s1].numBits);
+      BitDec_Reload(&bd);
+      if (BitDec_IsOverflow(&bd))
+      {
+        weights[n++] = (Byte)table[s2].base;
+        break;
+      }
+      weights[n++] = (Byte)table[s2].base;
+      s2 = table[s2].nextState + BitDec_Read(&bd, table[s2].numBits);
+      BitDec_Reload(&bd);
+      if (BitDec_IsOverflow(&bd))
+      {
+        weights[n++] = (Byte)table[s1].base;
+        break;
+      }
+    }
+    *numWeights = n;
+    return 1 + header;
+  }
+}
+
+static size_t ReadHuffTable(CZstdDec *p, const Byte *src, size_t size)
+{
+  Byte weights[256];
+  UInt32 rankStart[ZSTD_HUF_LOG_MAX + 2];
+  unsigned numWeights, i, maxBits;
+  UInt32 total = 0, rest;
+  size_t hs = ReadHuffWeights(weights, &numWeights, src, size);
+  if (hs == 0)
+    return 0;
+  for (i = 0; i <= ZSTD_HUF_LOG_MAX + 1; i++)
+    rankStart[i] = 0;
+  for (i = 0; i < numWeights; i++)
+  {
+    unsigned w = weights[i];
+    if (w > ZSTD_HUF_LOG_MAX)
+      return 0;
+    rankStart[w]++;
+    if (w != 0)
+      total += (UInt32)1 << (w - 1);
+  }
+  if (total == 0)
+    return 0;
+  maxBits = GetHighBit(total) + 1;
+  if (maxBits > ZSTD_HUF_LOG_MAX)
+    return 0;
+  rest = ((UInt32)1 << maxBits) - total;
+  {
+    unsigned w = GetHighBit(rest) + 1;
+    if (rest != ((UInt32)1 << (w - 1)))
+      return 0;
+    weights[numWeights++] = (Byte)w;
+    rankStart[w]++;
+  }
+  {
+    UInt32 start = 0;
+    for (i = 1; i <= maxBits; i++)
+    {
+      UInt32 num = rankStart[i];
+      rankStart[i] = start;
+      start += num << (i - 1);
+    }
+  }
+  for (i = 0; i < numWeights; i++)
+  {
+    unsigned w = weights[i];
+    if (w != 0)
+    {
+      CZstdHufCell cell;
+      CZstdHufCell *t = p->hufTable + rankStart[w];
+      UInt32 len = (UInt32)1 << (w - 1), k;
+      rankStart[w] += len;
+      cell.symbol = (Byte)i;
+      cell.numBits = (Byte)(maxBits + 1 - w);
+      for (k = 0; k < len; k++)
+        t[k] = cell;
+    }
+  }
+  p->hufLog = maxBits;
+  p->hufDefined = True;
+  return hs;
+}
+
+#define HUF_DECODE(bd, dest) { UInt32 idx = BitDec_Peek(&bd, log); \
+    *dest++ = table[idx].symbol; BitDec_Skip(&bd, table[idx].numBits); }
+
+static SRes HufDecodeTail(CBitDec *bd, const CZstdHufCell *table, unsigned log, Byte *dest, Byte *lim)
+{
+  CBitDec b = *bd;
+  while (lim - dest >= 4)
+  {
+    BitDec_Reload(&b);
+    HUF_DECODE(b, dest)
+    HUF_DECODE(b, dest)
+    HUF_DECODE(b, dest)
+    HUF_DECODE(b, dest)
+  }
+  BitDec_Reload(&b);
+  while (dest != lim)
+    HUF_DECODE(b, dest)
+  return BitDec_IsFinished(&b) ? SZ_OK : SZ_ERROR_DATA;
+}
+
+static SRes HufDecode4(const CZstdDec *p, const Byte *src, size_t size, Byte *dest, size_t destSize)
+{
+  CBitDec b1, b2, b3, b4;
+  const CZstdHufCell *table = p->hufTable;
+  unsigned log = p->hufLog;
+  size_t s1, s2, s3, seg = (destSize + 3) >> 2;
+  Byte *d1 = dest, *d2 = dest + seg, *d3 = dest + seg * 2, *d4 = dest + seg * 3;
+  Byte *lim4 = dest + destSize;
+  if (size < 10 || seg * 3 > destSize)
+    return SZ_ERROR_DATA;
+  s1 = GetUi16(src);
+  s2 = GetUi16(src + 2);
+  s3 = GetUi16(src + 4);
+  src += 6;
+  size -= 6;
+  if (s1 + s2 + s3 >= size)
+    return SZ_ERROR_DATA;
+  RINOK(BitDec_Init(&b1, src, s1));
+  RINOK(BitDec_Init(&b2, src + s1, s2));
+  RINOK(BitDec_Init(&b3, src + s1 + s2, s3));
+  RINOK(BitDec_Init(&b4, src + s1 + s2 + s3, size - s1 - s2 - s3));
+  while (lim4 - d4 >= 4)
+  {
+    BitDec_Reload(&b1);
+    BitDec_Reload(&b2);
+    BitDec_Reload(&b3);
+    BitDec_Reload(&b4);
+    HUF_DECODE(b1, d1) HUF_DECODE(b2, d2) HUF_DECODE(b3, d3) HUF_DECODE(b4, d4)
+    HUF_DECODE(b1, d1) HUF_DECODE(b2, d2) HUF_DECODE(b3, d3) HUF_DECODE(b4, d4)
+    HUF_DECODE(b1, d1) HUF_DECODE(b2, d2) HUF_DECODE(b3, d3) HUF_DECODE(b4, d4)
+    HUF_DECODE(b1, d1) HUF_DECODE(b2, d2) HUF_DECODE(b3, d3) HUF_DECODE(b4, d4)
+  }
+  RINOK(HufDecodeTail(&b1, table, log, d1, dest + seg));
+  RINOK(HufDecodeTail(&b2, table, log, d2, dest + seg * 2));
+  RINOK(HufDecodeTail(&b3, table, log, d3, dest + seg * 3));
+  return HufDecodeTail(&b4, table, log, d4, lim4);
+}
+
+/* ---------- Literals ---------- */
+
+static SRes DecodeLiterals(CZstdDec *p, const Byte *src, size_t srcSize,
+    const Byte **lit, size_t *litSize, size_t *processed)
+{
+  unsigned type, sf;
+  size_t regen, packSize, hs;
+  if (srcSize == 0)
+    return SZ_ERROR_DATA;
+  type = src[0] & 3;
+  sf = (src[0] >> 2) & 3;
+
+  if (type < 2)
+  {
+    switch (sf)
+    {
+      case 0: case 2: hs = 1; regen = src[0] >> 3; break;
+      case 1: hs = 2; if (srcSize < hs) return SZ_ERROR_DATA;
+        regen = (src[0] >> 4) + ((size_t)src[1] << 4); break;
+      default: hs = 3; if (srcSize < hs) return SZ_ERROR_DATA;
+        regen = (src[0] >> 4) + ((size_t)src[1] << 4) + ((size_t)src[2] << 12); break;
+    }
+    if (regen > ZSTD_BLOCK_SIZE_MAX)
+      return SZ_ERROR_DATA;
+    *litSize = regen;
+    if (type == 0)
+    {
+      if (srcSize - hs < regen)
+        return SZ_ERROR_DATA;
+      *lit = src + hs;
+      *processed = hs + regen;
+    }
+    else
+    {
+      if (srcSize - hs < 1)
+        return SZ_ERROR_DATA;
+      memset(p->litBuf, src[hs], regen + ZSTD_PADDING_SIZE);
+      *lit = p->litBuf;
+      *processed = hs + 1;
+    }
+    return SZ_OK;
+  }
+
+  if (srcSize < 5)
+    return SZ_ERROR_DATA;
+  {
+    UInt32 v = GetUi32(src);
+    switch (sf)
+    {
+      case 0: case 1: hs = 3; regen = (v >> 4) & 0x3FF; packSize = (v >> 14) & 0x3FF; break;
+      case 2: hs = 4; regen = (v >> 4) & 0x3FFF; packSize = v >> 18; break;
+      default: hs = 5; regen = (v >> 4) & 0x3FFFF; packSize = (v >> 22) + ((size_t)src[4] << 10); break;
+    }
+  }
+  if (regen > ZSTD_BLOCK_SIZE_MAX || packSize > srcSize - hs)
+    return SZ_ERROR_DATA;
+  src += hs;
+  *processed = hs + packSize;
+  if (type == 2)
+  {
+    size_t size = ReadHuffTable(p, src, packSize);
+    if (size == 0)
+      return SZ_ERROR_DATA;
+    src += size;
+    packSize -= size;
+  }
+  else if (!p->hufDefined)
+    return SZ_ERROR_DATA;
+
+  *lit = p->litBuf;
+  *litSize = regen;
+  if (sf == 0)
+  {
+    CBitDec bd;
+    RINOK(BitDec_Init(&bd, src, packSize));
+    return HufDecodeTail(&bd, p->hufTable, p->hufLog, p->litBuf, p->litBuf + regen);
+  }
+  return HufDecode4(p, src, packSize, p->litBuf, regen);
+}
+
+/* ---------- Sequences ---------- */
+
+#define SEQ_MODE_PREDEFINED 0
+#define SEQ_MODE_RLE 1
+#define SEQ_MODE_FSE 2
+#define SEQ_MODE_REPEAT 3
+
+static size_t ReadSeqTable(CZstdSeqCell *table, unsigned *tableLog, Bool *defined, unsigned mode,
+    unsigned maxSym, unsigned maxLog, const Int16 *defaultNorm, unsigned defaultMaxSym, unsigned defaultLog,
+    const UInt32 *base, const Byte *addBits, const Byte *src, size_t size)
+{
+  switch (mode)
+  {
+    case SEQ_MODE_PREDEFINED:
+      BuildSeqTable(table, defaultNorm, defaultMaxSym, defaultLog, base, addBits);
+      *tableLog = defaultLog;
+      *defined = True;
+      return 0;
+    case SEQ_MODE_RLE:
+    {
+      unsigned s;
+      if (size == 0)
+        return (size_t)(Int32)-1;
+      s = src[0];
+      if (s > maxSym)
+        return (size_t)(Int32)-1;
+      table[0].nextState = 0;
+      table[0].numBits = 0;
+      table[0].base = base[s];
+      table[0].numAddBits = addBits[s];
+      *tableLog = 0;
+      *defined = True;
+      return 1;
+    }
+    case SEQ_MODE_FSE:
+    {
+      Int16 norm[kNumSymbolsMax];
+      size_t hs = ReadNormCounts(norm, &maxSym, tableLog, maxLog, src, size);
+      if (hs == 0)
+        return (size_t)(Int32)-1;
+      BuildSeqTable(table, norm, maxSym, *tableLog, base, addBits);
+      *defined = True;
+      return hs;
+    }
+    default:
+      if (!*defined)
+        return (size_t)(Int32)-1;
+      return 0;
+  }
+}
+
+SRes ZstdDec_DecodeBlock(CZstdDec *p, const Byte *src, size_t srcSize,
+    Byte *dic, size_t dicPos, size_t histSize, size_t blockSizeMax, size_t *outSize)
+{
+  const Byte *lit, *litLim;
+  size_t litSize, processed;
+  UInt32 numSeqs;
+  Byte *op = dic + dicPos;
+  Byte * const oLim = op + blockSizeMax;
+  const Byte * const histStart = op - histSize;
+
+  *outSize = 0;
+  RINOK(DecodeLiterals(p, src, srcSize, &lit, &litSize, &processed));
+  src += processed;
+  srcSize -= processed;
+  litLim = lit + litSize;
+
+  if (srcSize == 0)
+    return SZ_ERROR_DATA;
+  numSeqs = src[0];
+  if (numSeqs < 128)
+  {
+    src++;
+    srcSize--;
+  }
+  else if (numSeqs < 255)
+  {
+    if (srcSize < 2)
+      return SZ_ERROR_DATA;
+    numSeqs = ((numSeqs - 128) << 8) + src[1];
+    src += 2;
+    srcSize -= 2;
+  }
+  else
+  {
+    if (srcSize < 3)
+      return SZ_ERROR_DATA;
+    numSeqs = (UInt32)src[1] + ((UInt32)src[2] << 8) + 0x7F00;
+    src += 3;
+    srcSize -= 3;
+  }
+
+  if (numSeqs != 0)
+  {
+    CBitDec bd;
+    UInt32 llState, mlState, ofState;
+    UInt32 rep0 = p->reps[0], rep1 = p->reps[1], rep2 = p->reps[2];
+    const CZstdSeqCell *llTable = p->llTable;
+    const CZstdSeqCell *mlTable = p->mlTable;
+    const CZstdSeqCell *ofTable = p->ofTable;
+    {
+      unsigned modes;
+      size_t size;
+      if (srcSize == 0)
+        return SZ_ERROR_DATA;
+      modes = src[0];
+      if ((modes & 3) != 0)
+        return SZ_ERROR_DATA;
+      src++;
+      srcSize--;
+      size = ReadSeqTable(p->llTable, &p->llLog, &p->llDefined, modes >> 6,
+          ZSTD_NUM_LL_CODES - 1, ZSTD_LL_LOG_MAX,
+          g_ZstdLlDefaultNorm, ZSTD_NUM_LL_CODES - 1, ZSTD_LL_LOG_DEFAULT,
+          g_ZstdLlBase, g_ZstdLlBits, src, srcSize);
+      if (size > srcSize)
+        return SZ_ERROR_DATA;
+      src += size;
+      srcSize -= size;
+      size = ReadSeqTable(p->ofTable, &p->ofLog, &p->ofDefined, (modes >> 4) & 3,
+          ZSTD_NUM_OF_CODES - 1, ZSTD_OF_LOG_MAX,
+          g_ZstdOfDefaultNorm, ZSTD_NUM_OF_CODES_DEFAULT - 1, ZSTD_OF_LOG_DEFAULT,
+          k_OfBase, k_OfBits, src, srcSize);
+      if (size > srcSize)
+        return SZ_ERROR_DATA;
+      src += size;
+      srcSize -= size;
+      size = ReadSeqTable(p->mlTable, &p->mlLog, &p->mlDefined, (modes >> 2) & 3,
+          ZSTD_NUM_ML_CODES - 1, ZSTD_ML_LOG_MAX,
+          g_ZstdMlDefaultNorm, ZSTD_NUM_ML_CODES - 1, ZSTD_ML_LOG_DEFAULT,
+          g_ZstdMlBase, g_ZstdMlBits, src, srcSize);
+      if (size > srcSize)
+        return SZ_ERROR_DATA;
+      src += size;
+      srcSize -= size;
+    }
+
+    RINOK(BitDec_Init(&bd, src, srcSize));
+    llState = BitDec_Read(&bd, p->llLog);
+    ofState = BitDec_Read(&bd, p->ofLog);
+    mlState = BitDec_Read(&bd, p->mlLog);
+
+    for (;;)
+    {
+      UInt32 offset, matchLen, litLen;
+      const CZstdSeqCell *llCell = &llTable[llState];
+      const CZstdSeqCell *mlCell = &mlTable[mlState];
+      const CZstdSeqCell *ofCell = &ofTable[ofState];
+
+      BitDec_Reload(&bd);
+      offset = ofCell->base + BitDec_Read(&bd, ofCell->numAddBits);
+      matchLen = mlCell->base + BitDec_Read(&bd, mlCell->numAddBits);
+      if (ofCell->numAddBits + mlCell->numAddBits + llCell->numAddBits > 31)
+        BitDec_Reload(&bd);
+      litLen = llCell->base + BitDec_Read(&bd, llCell->numAddBits);
+
+      if (offset > 3)
+      {
+        offset -= 3;
+        rep2 = rep1;
+        rep1 = rep0;
+        rep0 = offset;
+      }
+      else
+      {
+        unsigned index = (unsigned)offset - 1 + (litLen == 0);
+        if (index == 0)
+          offset = rep0;
+        else
+        {
+          offset = (index == 1) ? rep1 : (index == 2) ? rep2 : rep0 - 1;
+          if (index != 1)
+            rep2 = rep1;
+          rep1 = rep0;
+          rep0 = offset;
+        }
+      }
+
+      if (litLen > (size_t)(litLim - lit))
+        return SZ_ERROR_DATA;
+      if ((size_t)litLen + matchLen > (size_t)(oLim - op))
+        return SZ_ERROR_DATA;
+
+      if (litLen <= 16)
+        COPY_16(op, lit);
+      else
+        memcpy(op, lit, litLen);
+      op += litLen;
+      lit += litLen;
+
+      if (offset == 0 || offset > (size_t)(op - histStart))
+        return SZ_ERROR_DATA;
+      {
+        const Byte *m = op - offset;
+        Byte *end = op + matchLen;
+        if (offset >= 16)
+        {
+          do
+          {
+            COPY_16(op, m);
+            op += 16;
+            m += 16;
+          }
+          while (op < end);
+        }
+        else if (offset >= 8)
+        {
+          do
+          {
+            COPY_8(op, m);
+            op += 8;
+            m += 8;
+          }
+          while (op < end);
+        }
+        else if (offset == 1)
+          memset(op, *m, matchLen);
+        else
+          for (; op != end; op++, m++)
+            *op = *m;
+        op = end;
+      }
+
+      if (--numSeqs == 0)
+        break;
+      llState = llCell->nextState + BitDec_Read(&bd, llCell->numBits);
+      mlState = mlCell->nextState + BitDec_Read(&bd, mlCell->numBits);
+      ofState = ofCell->nextState + BitDec_Read(&bd, ofCell->numBits);
+    }
+
+    BitDec_Reload(&bd);
+    if (!BitDec_IsFinished(&bd))
+      return SZ_ERROR_DATA;
+    p->reps[0] = rep0;
+    p->reps[1] = rep1;
+    p->reps[2] = rep2;
+  }
+  else if (srcSize != 0)
+    return SZ_ERROR_DATA;
+
+  litSize = (size_t)(litLim - lit);
+  if (litSize > (size_t)(oLim - op))
+    return SZ_ERROR_DATA;
+  memcpy(op, lit, litSize);
+  op += litSize;
+  *outSize = (size_t)(op - (dic + dicPos));
+  return SZ_OK;
+}
+
+/* ---------- CZstdDec ---------- */
+
+void ZstdDec_Construct(CZstdDec *p)
+{
+  p->llTable = NULL;
+  p->litBuf = NULL;
+  ZstdDec_InitFrame(p);
+}
+
+SRes ZstdDec_Allocate(CZstdDec *p, ISzAlloc *alloc)
+{
+  if (!p->llTable)
+  {
+    p->llTable = (CZstdSeqCell *)alloc->Alloc(alloc,
+        (kLlTableSize + kMlTableSize + kOfTableSize) * sizeof(CZstdSeqCell)
+        + kHufTableSize * sizeof(CZstdHufCell));
+    if (!p->llTable)
+      return SZ_ERROR_MEM;
+    p->mlTable = p->llTable + kLlTableSize;
+    p->ofTable = p->mlTable + kMlTableSize;
+    p->hufTable = (CZstdHufCell *)(p->ofTable + kOfTableSize);
+  }
+  if (!p->litBuf)
+  {
+    p->litBuf = (Byte *)alloc->Alloc(alloc, kLitBufSize);
+    if (!p->litBuf)
+      return SZ_ERROR_MEM;
+  }
+  return SZ_OK;
+}
+
+void ZstdDec_Free(CZstdDec *p, ISzAlloc *alloc)
+{
+  alloc->Free(alloc, p->llTable);
+  alloc->Free(alloc, p->litBuf);
+  p->llTable = NULL;
+  p->litBuf = NULL;
+}
+
+void ZstdDec_InitFrame(CZstdDec *p)
+{
+  p->hufDefined = False;
+  p->llDefined = False;
+  p->mlDefined = False;
+  p->ofDefined = False;
+  p->reps[0] = 1;
+  p->reps[1] = 4;
+  p->reps[2] = 8;
+}
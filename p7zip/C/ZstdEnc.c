@@ -0,0 +1,1884 @@
+/* ZstdEnc.c -- Zstandard Encoder
+2026-10-18 : Public domain */
+
+#include "Precomp.h"
+
+#include <string.h>
+
+#include "CpuArch.h"
+#include "HuffEnc.h"
+#include "MtCoder.h"
+#include "ZstdEnc.h"
+
+#ifdef _MSC_VER
+#define MY_FORCE_INLINE __forceinline
+#elif defined(__GNUC__)
+#define MY_FORCE_INLINE __inline__ __attribute__((always_inline))
+#else
+#define MY_FORCE_INLINE
+#endif
+
+#define kNumSymbolsMax 64
+#define kSeqsMax (ZSTD_BLOCK_SIZE_MAX / ZSTD_MATCH_LEN_MIN + 1)
+
+/* the encoder compresses block to temp buffer. It can write up to kBlockBufExtra bytes after
+   the limit of compressed block, before it detects that block is not compressible. */
+#define kBlockBufExtra 1024
+
+/* the encoder skips more positions in the data that has no matches */
+#define kSearchStrength 8
+
+#define kMinLiteralsToCompress 64
+
+static unsigned GetHighBit(UInt32 v)
+{
+  #if defined(_MSC_VER)
+  unsigned long index;
+  _BitScanReverse(&index, v | 1);
+  return (unsigned)index;
+  #elif defined(__GNUC__)
+  return 31 - (unsigned)__builtin_clz(v | 1);
+  #else
+  unsigned i = 0;
+  for (; (v >>= 1) != 0; i++);
+  return i;
+  #endif
+}
+
+/* Log2x8() returns log2(v) with 3 bits of fraction */
+
+static unsigned Log2x8(UInt32 v)
+{
+  unsigned hb = GetHighBit(v);
+  return (hb << 3) + (unsigned)(((v << 3) >> hb) & 7);
+}
+
+/* ---------- Forward bit stream ---------- */
+
+/* Bits are written from low to high. BitEnc_Flush() writes 8 bytes at cur.
+   If the stream reaches (lim), the encoder stops to advance (cur),
+   and BitEnc_Close() reports the overflow. */
+
+typedef struct
+{
+  UInt64 v;
+  unsigned numBits;
+  Byte *cur;
+  Byte *lim;
+  Byte *start;
+} CBitEnc;
+
+static void BitEnc_Init(CBitEnc *p, Byte *buf, size_t size)
+{
+  p->v = 0;
+  p->numBits = 0;
+  p->start = buf;
+  p->cur = buf;
+  p->lim = buf + (size < 8 ? 0 : size - 8);
+}
+
+#define BitEnc_Add(p, val, n) { (p)->v |= (UInt64)(val) << (p)->numBits; (p)->numBits += (n); }
+#define BitEnc_AddMasked(p, val, n) BitEnc_Add(p, (val) & (((UInt32)1 << (n)) - 1), n)
+
+static MY_FORCE_INLINE void BitEnc_Flush(CBitEnc *p)
+{
+  unsigned num = p->numBits >> 3;
+  SetUi64(p->cur, p->v);
+  p->cur += num;
+  if (p->cur > p->lim)
+    p->cur = p->lim;
+  p->v >>= num * 8;
+  p->numBits &= 7;
+}
+
+/* returns the size of stream, or 0, if the stream doesn't fit to buffer */
+
+static size_t BitEnc_Close(CBitEnc *p)
+{
+  BitEnc_Add(p, 1, 1);
+  BitEnc_Flush(p);
+  if (p->cur >= p->lim)
+    return 0;
+  return (size_t)(p->cur - p->start) + (p->numBits != 0);
+}
+
+/* ---------- FSE ---------- */
+
+typedef struct
+{
+  Int32 deltaFindState;
+  UInt32 deltaNbBits;
+} CFseSymbolTransform;
+
+typedef struct
+{
+  unsigned tableLog;
+  UInt16 stateTable[1 << ZSTD_LL_LOG_MAX];
+  CFseSymbolTransform symbolTT[kNumSymbolsMax];
+} CFseCTable;
+
+static unsigned Fse_OptimalTableLog(unsigned maxLog, UInt32 srcSize, unsigned maxSym)
+{
+  unsigned maxBitsSrc = GetHighBit(srcSize - 1);
+  unsigned minBitsSrc = GetHighBit(srcSize) + 1;
+  unsigned minBitsSym = GetHighBit(maxSym) + 2;
+  unsigned minBits = minBitsSrc < minBitsSym ? minBitsSrc : minBitsSym;
+  unsigned tableLog = maxLog;
+  if (maxBitsSrc >= 2 && maxBitsSrc - 2 < tableLog)
+    tableLog = maxBitsSrc - 2;
+  if (minBits > tableLog)
+    tableLog = minBits;
+  if (tableLog < 5)
+    tableLog = 5;
+  if (tableLog > maxLog)
+    tableLog = maxLog;
+  return tableLog;
+}
+
+/* Fse_Normalize() scales the counts to the sum (1 << tableLog).
+   The symbols with small probability get (-1) that means the probability lower than one cell.
+   tableLog must be large enough to contain one cell for each used symbol. */
+
+static void Fse_Normalize(Int16 *norm, unsigned tableLog, const UInt32 *counts, UInt32 total, unsigned maxSym)
+{
+  static const UInt32 kRestToBeat[8] = { 0, 473195, 504333, 520860, 550000, 700000, 750000, 830000 };
+  const unsigned scale = 62 - tableLog;
+  const UInt64 step = ((UInt64)1 << 62) / total;
+  const UInt64 vStep = (UInt64)1 << (scale - 20);
+  const UInt32 lowThreshold = total >> tableLog;
+  Int32 rest = (Int32)1 << tableLog;
+  unsigned s, largest = 0;
+  Int16 largestP = 0;
+
+  for (s = 0; s <= maxSym; s++)
+  {
+    UInt32 c = counts[s];
+    if (c == 0)
+      norm[s] = 0;
+    else if (c <= lowThreshold)
+    {
+      norm[s] = -1;
+      rest--;
+    }
+    else
+    {
+      UInt64 v = (UInt64)c * step;
+      Int16 proba = (Int16)(v >> scale);
+      if (proba < 8)
+        proba = (Int16)(proba + (v - ((UInt64)proba << scale) > vStep * kRestToBeat[proba]));
+      if (proba > largestP)
+      {
+        largestP = proba;
+        largest = s;
+      }
+      norm[s] = proba;
+      rest -= proba;
+    }
+  }
+
+  if (-rest < (norm[largest] >> 1))
+  {
+    norm[largest] = (Int16)(norm[largest] + rest);
+    return;
+  }
+
+  /* the rounding has given too many cells to small symbols. We take them back from largest symbols. */
+  while (rest < 0)
+  {
+    Int16 maxP = 1;
+    unsigned maxS = 0;
+    for (s = 0; s <= maxSym; s++)
+      if (norm[s] > maxP)
+      {
+        maxP = norm[s];
+        maxS = s;
+      }
+    norm[maxS]--;
+    rest++;
+  }
+}
+
+static size_t Fse_WriteNCount(Byte *dest, const Int16 *norm, unsigned maxSym, unsigned tableLog)
+{
+  Byte *d = dest;
+  UInt32 bits = tableLog - 5;
+  unsigned numBits = 4;
+  Int32 remaining = ((Int32)1 << tableLog) + 1;
+  Int32 threshold = (Int32)1 << tableLog;
+  unsigned countBits = tableLog + 1;
+  unsigned sym = 0;
+  Bool prev0 = False;
+
+  #define NCOUNT_FLUSH16 { d[0] = (Byte)bits; d[1] = (Byte)(bits >> 8); d += 2; bits >>= 16; numBits -= 16; }
+
+  while (sym <= maxSym && remaining > 1)
+  {
+    Int32 count, max;
+    if (prev0)
+    {
+      unsigned start = sym;
+      while (norm[sym] == 0)
+        sym++;
+      while (sym >= start + 24)
+      {
+        start += 24;
+        bits += (UInt32)0xFFFF << numBits;
+        numBits += 16;
+        NCOUNT_FLUSH16
+      }
+      while (sym >= start + 3)
+      {
+        start += 3;
+        bits += (UInt32)3 << numBits;
+        numBits += 2;
+      }
+      bits += (UInt32)(sym - start) << numBits;
+      numBits += 2;
+      if (numBits > 16)
+        NCOUNT_FLUSH16
+    }
+    count = norm[sym++];
+    max = (2 * threshold - 1) - remaining;
+    remaining -= count < 0 ? -count : count;
+    count++;
+    if (count >= threshold)
+      count += max;
+    bits += (UInt32)count << numBits;
+    numBits += countBits;
+    if (count < max)
+      numBits--;
+    prev0 = (count == 1);
+    while (remaining < threshold)
+    {
+      countBits--;
+      threshold >>= 1;
+    }
+    if (numBits > 16)
+      NCOUNT_FLUSH16
+  }
+  d[0] = (Byte)bits;
+  d[1] = (Byte)(bits >> 8);
+  d += (numBits + 7) >> 3;
+  return (size_t)(d - dest);
+}
+
+/* Fse_BuildCTable() spreads the symbols in same order as decoder does */
+
+static void Fse_BuildCTable(CFseCTable *ct, const Int16 *norm, unsigned maxSym, unsigned tableLog)
+{
+  const UInt32 tableSize = (UInt32)1 << tableLog;
+  const UInt32 mask = tableSize - 1;
+  const UInt32 step = (tableSize >> 1) + (tableSize >> 3) + 3;
+  UInt32 cumul[kNumSymbolsMax + 1];
+  Byte symbols[1 << ZSTD_LL_LOG_MAX];
+  UInt32 highThreshold = tableSize - 1;
+  UInt32 pos = 0, u;
+  Int32 total = 0;
+  unsigned s;
+
+  ct->tableLog = tableLog;
+  cumul[0] = 0;
+  for (s = 0; s <= maxSym; s++)
+  {
+    if (norm[s] == -1)
+    {
+      cumul[s + 1] = cumul[s] + 1;
+      symbols[highThreshold--] = (Byte)s;
+    }
+    else
+      cumul[s + 1] = cumul[s] + (UInt32)norm[s];
+  }
+  for (s = 0; s <= maxSym; s++)
+  {
+    int i;
+    for (i = 0; i < norm[s]; i++)
+    {
+      symbols[pos] = (Byte)s;
+      do
+        pos = (pos + step) & mask;
+      while (pos > highThreshold);
+    }
+  }
+  for (u = 0; u < tableSize; u++)
+    ct->stateTable[cumul[symbols[u]]++] = (UInt16)(tableSize + u);
+
+  for (s = 0; s <= maxSym; s++)
+  {
+    CFseSymbolTransform *t = &ct->symbolTT[s];
+    Int32 n = norm[s];
+    if (n == 0)
+    {
+      t->deltaNbBits = ((tableLog + 1) << 16) - tableSize;
+      t->deltaFindState = 0;
+    }
+    else if (n == -1 || n == 1)
+    {
+      t->deltaNbBits = (tableLog << 16) - tableSize;
+      t->deltaFindState = total - 1;
+      total++;
+    }
+    else
+    {
+      UInt32 maxBitsOut = tableLog - GetHighBit((UInt32)n - 1);
+      UInt32 minStatePlus = (UInt32)n << maxBitsOut;
+      t->deltaNbBits = (maxBitsOut << 16) - minStatePlus;
+      t->deltaFindState = total - n;
+      total += n;
+    }
+  }
+}
+
+/* the table for RLE mode: the encoder writes no bits for symbols and states */
+
+static void Fse_BuildCTableRle(CFseCTable *ct, unsigned sym)
+{
+  ct->tableLog = 0;
+  ct->stateTable[0] = 0;
+  ct->stateTable[1] = 0;
+  ct->symbolTT[sym].deltaNbBits = 0;
+  ct->symbolTT[sym].deltaFindState = 0;
+}
+
+static UInt32 Fse_InitState(const CFseCTable *ct, unsigned sym)
+{
+  const CFseSymbolTransform *t = &ct->symbolTT[sym];
+  UInt32 numBits = (t->deltaNbBits + (1 << 15)) >> 16;
+  UInt32 v = (numBits << 16) - t->deltaNbBits;
+  return ct->stateTable[(Int32)(v >> numBits) + t->deltaFindState];
+}
+
+#define FSE_ENCODE(bc, state, ct, sym) { const CFseSymbolTransform *t = &(ct)->symbolTT[sym]; \
+    UInt32 nb = ((state) + t->deltaNbBits) >> 16; BitEnc_AddMasked(bc, state, nb); \
+    state = (ct)->stateTable[(Int32)((state) >> nb) + t->deltaFindState]; }
+
+#define FSE_FLUSH_STATE(bc, state, ct) BitEnc_AddMasked(bc, state, (ct)->tableLog)
+
+/* ---------- Huffman ---------- */
+
+typedef struct
+{
+  UInt32 codes[256];
+  Byte lens[256];
+  unsigned maxSym;
+  unsigned maxBits;
+} CHufCTable;
+
+/* Huf_Build() builds the code, where the codes are assigned in same order as decoder
+   fills its table: from the longest codes to shortest, in symbol order.
+   It returns False, if Huffman code is not complete. */
+
+static Bool Huf_Build(CHufCTable *p, const UInt32 *counts, unsigned maxSym)
+{
+  UInt32 temp[256];
+  UInt32 rankStart[ZSTD_HUF_LOG_MAX + 2];
+  UInt32 start = 0;
+  unsigned i, maxBits = 0;
+
+  Huffman_Generate(counts, temp, p->lens, maxSym + 1, ZSTD_HUF_LOG_MAX);
+  for (i = 0; i <= maxSym; i++)
+    if (maxBits < p->lens[i])
+      maxBits = p->lens[i];
+  for (i = 0; i <= ZSTD_HUF_LOG_MAX + 1; i++)
+    rankStart[i] = 0;
+  for (i = 0; i <= maxSym; i++)
+    if (p->lens[i] != 0)
+      rankStart[maxBits + 1 - p->lens[i]]++;
+  for (i = 1; i <= maxBits; i++)
+  {
+    UInt32 num = rankStart[i];
+    rankStart[i] = start;
+    start += num << (i - 1);
+  }
+  if (start != ((UInt32)1 << maxBits))
+    return False;
+  for (i = 0; i <= maxSym; i++)
+  {
+    unsigned len = p->lens[i];
+    if (len != 0)
+    {
+      unsigned w = maxBits + 1 - len;
+      p->codes[i] = rankStart[w] >> (w - 1);
+      rankStart[w] += (UInt32)1 << (w - 1);
+    }
+  }
+  p->maxSym = maxSym;
+  p->maxBits = maxBits;
+  return True;
+}
+
+/* Huf_CompressWeights() writes the weights with FSE of two interleaved states.
+   It returns 0, if FSE is not useful */
+
+static size_t Huf_CompressWeights(Byte *dest, size_t destSize, const Byte *weights, unsigned num)
+{
+  UInt32 counts[ZSTD_HUF_LOG_MAX + 1];
+  Int16 norm[ZSTD_HUF_LOG_MAX + 1];
+  CFseCTable ct;
+  CBitEnc bc;
+  unsigned maxW = 0, i, tableLog;
+  UInt32 maxCount = 0, s1, s2;
+  size_t hs, size;
+
+  if (num < 2)
+    return 0;
+  for (i = 0; i <= ZSTD_HUF_LOG_MAX; i++)
+    counts[i] = 0;
+  for (i = 0; i < num; i++)
+    counts[weights[i]]++;
+  for (i = 0; i <= ZSTD_HUF_LOG_MAX; i++)
+    if (counts[i] != 0)
+    {
+      maxW = i;
+      if (maxCount < counts[i])
+        maxCount = counts[i];
+    }
+  if (maxCount == num || maxCount == 1)
+    return 0;
+
+  tableLog = Fse_OptimalTableLog(ZSTD_HUF_WEIGHTS_LOG_MAX, num, maxW);
+  Fse_Normalize(norm, tableLog, counts, num, maxW);
+  hs = Fse_WriteNCount(dest, norm, maxW, tableLog);
+  Fse_BuildCTable(&ct, norm, maxW, tableLog);
+
+  BitEnc_Init(&bc, dest + hs, destSize - hs);
+  i = num;
+  if (num & 1)
+  {
+    s1 = Fse_InitState(&ct, weights[--i]);
+    s2 = Fse_InitState(&ct, weights[--i]);
+    FSE_ENCODE(&bc, s1, &ct, weights[--i])
+    BitEnc_Flush(&bc);
+  }
+  else
+  {
+    s2 = Fse_InitState(&ct, weights[--i]);
+    s1 = Fse_InitState(&ct, weights[--i]);
+  }
+  while (i != 0)
+  {
+    FSE_ENCODE(&bc, s2, &ct, weights[--i])
+    FSE_ENCODE(&bc, s1, &ct, weights[--i])
+    BitEnc_Flush(&bc);
+  }
+  FSE_FLUSH_STATE(&bc, s2, &ct)
+  FSE_FLUSH_STATE(&bc, s1, &ct)
+  size = BitEnc_Close(&bc);
+  if (size == 0)
+    return 0;
+  return hs + size;
+}
+
+/* Huf_WriteTable() returns the size of tree description, or 0, if the tree can't be written */
+
+static size_t Huf_WriteTable(Byte *dest, const CHufCTable *p)
+{
+  Byte weights[256];
+  Byte temp[256];
+  unsigned num = p->maxSym, i;
+  size_t size;
+  for (i = 0; i < num; i++)
+    weights[i] = (Byte)(p->lens[i] != 0 ? p->maxBits + 1 - p->lens[i] : 0);
+  size = Huf_CompressWeights(temp, sizeof(temp) - 8, weights, num);
+  if (size > 1 && size < 128 && size < num / 2)
+  {
+    dest[0] = (Byte)size;
+    memcpy(dest + 1, temp, size);
+    return size + 1;
+  }
+  if (num > 128)
+    return 0;
+  dest[0] = (Byte)(127 + num);
+  for (i = 0; i < num; i += 2)
+    dest[1 + (i >> 1)] = (Byte)((weights[i] << 4) | (i + 1 < num ? weights[i + 1] : 0));
+  return 1 + ((num + 1) >> 1);
+}
+
+/* Huf_Encode1() writes one Huffman stream. The decoder reads the stream backward,
+   so the last symbol is written first. It returns 0, if the stream doesn't fit to buffer */
+
+static size_t Huf_Encode1(Byte *dest, size_t destSize, const Byte *src, size_t size, const CHufCTable *p)
+{
+  CBitEnc bc;
+  const UInt32 *codes = p->codes;
+  const Byte *lens = p->lens;
+  BitEnc_Init(&bc, dest, destSize);
+  while ((size & 3) != 0)
+  {
+    unsigned b = src[--size];
+    BitEnc_Add(&bc, codes[b], lens[b])
+  }
+  BitEnc_Flush(&bc);
+  while (size != 0)
+  {
+    unsigned b;
+    b = src[--size]; BitEnc_Add(&bc, codes[b], lens[b])
+    b = src[--size]; BitEnc_Add(&bc, codes[b], lens[b])
+    b = src[--size]; BitEnc_Add(&bc, codes[b], lens[b])
+    b = src[--size]; BitEnc_Add(&bc, codes[b], lens[b])
+    BitEnc_Flush(&bc);
+  }
+  return BitEnc_Close(&bc);
+}
+
+/* ---------- Sequence codes ---------- */
+
+static const Byte k_LlCode[64] =
+{
+   0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15,
+  16, 16, 17, 17, 18, 18, 19, 19, 20, 20, 20, 20, 21, 21, 21, 21,
+  22, 22, 22, 22, 22, 22, 22, 22, 23, 23, 23, 23, 23, 23, 23, 23,
+  24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24
+};
+
+static const Byte k_MlCode[128] =
+{
+   0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15,
+  16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31,
+  32, 32, 33, 33, 34, 34, 35, 35, 36, 36, 36, 36, 37, 37, 37, 37,
+  38, 38, 38, 38, 38, 38, 38, 38, 39, 39, 39, 39, 39, 39, 39, 39,
+  40, 40, 40, 40, 40, 40, 40, 40, 40, 40, 40, 40, 40, 40, 40, 40,
+  41, 41, 41, 41, 41, 41, 41, 41, 41, 41, 41, 41, 41, 41, 41, 41,
+  42, 42, 42, 42, 42, 42, 42, 42, 42, 42, 42, 42, 42, 42, 42, 42,
+  42, 42, 42, 42, 42, 42, 42, 42, 42, 42, 42, 42, 42, 42, 42, 42
+};
+
+#define GET_LL_CODE(v) ((v) < 64 ? k_LlCode[v] : GetHighBit(v) + 19)
+#define GET_ML_CODE(v) ((v) < 128 ? k_MlCode[v] : GetHighBit(v) + 36)
+
+typedef struct
+{
+  UInt32 litLen;
+  UInt32 mlBase;  /* matchLen - ZSTD_MATCH_LEN_MIN */
+  UInt32 offBase; /* 1...3 : repeat offset codes, (offset + 3) : new offset */
+} CZstdSeq;
+
+/* ---------- Levels ---------- */
+
+#define STRATEGY_FAST 0
+#define STRATEGY_DFAST 1
+#define STRATEGY_GREEDY 2
+#define STRATEGY_LAZY 3
+#define STRATEGY_LAZY2 4
+
+/* STRATEGY_DFAST uses two hash tables: (hash) for 8-byte matches and (chain) as hash table for short matches */
+
+typedef struct
+{
+  Byte windowLog;
+  Byte hashLog;
+  Byte chainLog;
+  Byte searchLog;
+  Byte minMatch;
+  Byte strategy;
+} CZstdLevelParams;
+
+static const CZstdLevelParams g_Levels[ZSTD_ENC_LEVEL_MAX + 1] =
+{
+  /* window hash chain search minMatch strategy */
+  { 19, 16,  0,  0, 6, STRATEGY_FAST },
+  { 19, 16,  0,  0, 6, STRATEGY_FAST },
+  { 20, 17,  0,  0, 5, STRATEGY_FAST },
+  { 21, 17, 16,  0, 5, STRATEGY_DFAST },
+  { 21, 18, 17,  0, 5, STRATEGY_DFAST },
+  { 21, 18, 17,  2, 5, STRATEGY_GREEDY },
+  { 21, 18, 18,  2, 5, STRATEGY_LAZY },
+  { 21, 18, 18,  3, 5, STRATEGY_LAZY },
+  { 21, 19, 19,  3, 5, STRATEGY_LAZY2 },
+  { 22, 19, 19,  4, 5, STRATEGY_LAZY2 },
+  { 22, 20, 20,  4, 5, STRATEGY_LAZY2 },
+  { 22, 20, 20,  5, 5, STRATEGY_LAZY2 },
+  { 22, 21, 21,  5, 5, STRATEGY_LAZY2 },
+  { 23, 21, 22,  5, 4, STRATEGY_LAZY2 },
+  { 23, 22, 22,  6, 4, STRATEGY_LAZY2 },
+  { 23, 22, 23,  6, 4, STRATEGY_LAZY2 },
+  { 23, 22, 23,  7, 4, STRATEGY_LAZY2 },
+  { 24, 22, 23,  7, 4, STRATEGY_LAZY2 },
+  { 24, 22, 24,  7, 4, STRATEGY_LAZY2 },
+  { 25, 22, 24,  8, 4, STRATEGY_LAZY2 },
+  { 26, 22, 25,  8, 4, STRATEGY_LAZY2 },
+  { 27, 22, 25,  8, 4, STRATEGY_LAZY2 },
+  { 27, 22, 25,  9, 4, STRATEGY_LAZY2 }
+};
+
+/* ---------- Block encoder ---------- */
+
+typedef struct
+{
+  CZstdLevelParams params;
+  UInt32 windowSize;
+
+  UInt32 *hash;
+  UInt32 *chain;
+  UInt32 hashSize;
+  UInt32 chainSize;
+  UInt32 nextToUpdate;
+
+  UInt32 reps[3];
+
+  CZstdSeq *seqs;
+  size_t numSeqs;
+  Byte *lits;
+  size_t numLits;
+  Byte *codes; /* ll, of, ml codes for each sequence */
+  Byte *blockBuf;
+
+  CHufCTable huf;
+  CFseCTable llTable;
+  CFseCTable ofTable;
+  CFseCTable mlTable;
+
+  Byte *win; /* the window buffer for single-thread stream mode */
+  size_t winSize;
+} CZstdEncCore;
+
+static void Core_Construct(CZstdEncCore *p)
+{
+  p->hash = NULL;
+  p->chain = NULL;
+  p->hashSize = 0;
+  p->chainSize = 0;
+  p->seqs = NULL;
+  p->lits = NULL;
+  p->codes = NULL;
+  p->blockBuf = NULL;
+  p->win = NULL;
+  p->winSize = 0;
+}
+
+static void Core_Free(CZstdEncCore *p, ISzAlloc *alloc, ISzAlloc *allocBig)
+{
+  IAlloc_Free(allocBig, p->hash);
+  IAlloc_Free(allocBig, p->chain);
+  IAlloc_Free(alloc, p->seqs);
+  IAlloc_Free(alloc, p->lits);
+  IAlloc_Free(alloc, p->codes);
+  IAlloc_Free(alloc, p->blockBuf);
+  IAlloc_Free(allocBig, p->win);
+  Core_Construct(p);
+}
+
+static SRes Core_Alloc(CZstdEncCore *p, const CZstdLevelParams *params, ISzAlloc *alloc, ISzAlloc *allocBig)
+{
+  UInt32 hashSize = (UInt32)1 << params->hashLog;
+  UInt32 chainSize = (params->strategy == STRATEGY_FAST) ? 0 : (UInt32)1 << params->chainLog;
+  p->params = *params;
+  p->windowSize = (UInt32)1 << params->windowLog;
+  if (p->hashSize != hashSize)
+  {
+    IAlloc_Free(allocBig, p->hash);
+    p->hashSize = 0;
+    p->hash = (UInt32 *)IAlloc_Alloc(allocBig, (size_t)hashSize * sizeof(UInt32));
+    if (!p->hash)
+      return SZ_ERROR_MEM;
+    p->hashSize = hashSize;
+  }
+  if (p->chainSize != chainSize)
+  {
+    IAlloc_Free(allocBig, p->chain);
+    p->chain = NULL;
+    p->chainSize = 0;
+    if (chainSize != 0)
+    {
+      p->chain = (UInt32 *)IAlloc_Alloc(allocBig, (size_t)chainSize * sizeof(UInt32));
+      if (!p->chain)
+        return SZ_ERROR_MEM;
+    }
+    p->chainSize = chainSize;
+  }
+  if (!p->seqs)
+  {
+    p->seqs = (CZstdSeq *)IAlloc_Alloc(alloc, kSeqsMax * sizeof(CZstdSeq));
+    p->lits = (Byte *)IAlloc_Alloc(alloc, ZSTD_BLOCK_SIZE_MAX + ZSTD_PADDING_SIZE);
+    p->codes = (Byte *)IAlloc_Alloc(alloc, kSeqsMax * 3);
+    p->blockBuf = (Byte *)IAlloc_Alloc(alloc, ZSTD_BLOCK_SIZE_MAX + kBlockBufExtra);
+    if (!p->seqs || !p->lits || !p->codes || !p->blockBuf)
+      return SZ_ERROR_MEM;
+  }
+  return SZ_OK;
+}
+
+static void Core_InitFrame(CZstdEncCore *p)
+{
+  memset(p->hash, 0, (size_t)p->hashSize * sizeof(UInt32));
+  if (p->chain)
+    memset(p->chain, 0, (size_t)p->chainSize * sizeof(UInt32));
+  p->nextToUpdate = 0;
+  p->reps[0] = 1;
+  p->reps[1] = 4;
+  p->reps[2] = 8;
+}
+
+/* Core_ReduceOffsets() is called after the window buffer was moved by (delta) bytes */
+
+static void Core_ReduceOffsets(CZstdEncCore *p, UInt32 delta)
+{
+  UInt32 *t = p->hash;
+  size_t i, num = p->hashSize;
+  for (i = 0; i < num; i++)
+    t[i] = (t[i] > delta) ? t[i] - delta : 0;
+  t = p->chain;
+  num = p->chainSize;
+  for (i = 0; i < num; i++)
+    t[i] = (t[i] > delta) ? t[i] - delta : 0;
+  p->nextToUpdate = (p->nextToUpdate > delta) ? p->nextToUpdate - delta : 0;
+}
+
+/* ---------- Match finder ---------- */
+
+#define kHashPrime5 UINT64_CONST(889523592379)
+#define kHashPrime6 UINT64_CONST(227718039650203)
+#define kHashPrime8 UINT64_CONST(0xCF1BBCDCB7A56463)
+
+static MY_FORCE_INLINE UInt32 GetHash(const Byte *p, unsigned hashLog, unsigned minMatch)
+{
+  if (minMatch == 4)
+    return (GetUi32(p) * (UInt32)2654435761U) >> (32 - hashLog);
+  if (minMatch == 5)
+    return (UInt32)(((GetUi64(p) << 24) * kHashPrime5) >> (64 - hashLog));
+  if (minMatch == 6)
+    return (UInt32)(((GetUi64(p) << 16) * kHashPrime6) >> (64 - hashLog));
+  return (UInt32)((GetUi64(p) * kHashPrime8) >> (64 - hashLog));
+}
+
+/* GetMatchLen() returns the number of equal bytes in (a) and (b), up to (lim) in (a) */
+
+static MY_FORCE_INLINE UInt32 GetMatchLen(const Byte *a, const Byte *b, const Byte *lim)
+{
+  const Byte *start = a;
+  #if defined(MY_CPU_LE_UNALIGN) && defined(MY_CPU_64BIT) && defined(__GNUC__)
+  for (; lim - a >= 8; a += 8, b += 8)
+  {
+    UInt64 x = GetUi64(a) ^ GetUi64(b);
+    if (x != 0)
+      return (UInt32)(a - start) + ((UInt32)__builtin_ctzll(x) >> 3);
+  }
+  #endif
+  for (; a != lim && *a == *b; a++, b++);
+  return (UInt32)(a - start);
+}
+
+/* Core_AddSeq() converts match offset to offset code, updates repeat offsets,
+   and adds the sequence with literals before match. */
+
+static MY_FORCE_INLINE void Core_AddSeq(CZstdEncCore *p, const Byte *lits, UInt32 litLen, UInt32 offset, UInt32 matchLen)
+{
+  CZstdSeq *seq = &p->seqs[p->numSeqs++];
+  UInt32 *reps = p->reps;
+  UInt32 offBase;
+  memcpy(p->lits + p->numLits, lits, litLen);
+  p->numLits += litLen;
+  seq->litLen = litLen;
+  seq->mlBase = matchLen - ZSTD_MATCH_LEN_MIN;
+  if (litLen != 0 && offset == reps[0])
+    offBase = 1;
+  else if (offset == reps[1])
+  {
+    reps[1] = reps[0];
+    reps[0] = offset;
+    offBase = (litLen == 0) ? 1 : 2;
+  }
+  else if (litLen != 0 && offset == reps[2])
+  {
+    reps[2] = reps[1];
+    reps[1] = reps[0];
+    reps[0] = offset;
+    offBase = 3;
+  }
+  else if (litLen == 0 && offset == reps[2])
+  {
+    reps[2] = reps[1];
+    reps[1] = reps[0];
+    reps[0] = offset;
+    offBase = 2;
+  }
+  else if (litLen == 0 && offset == reps[0] - 1)
+  {
+    reps[2] = reps[1];
+    reps[1] = reps[0];
+    reps[0] = offset;
+    offBase = 3;
+  }
+  else
+  {
+    reps[2] = reps[1];
+    reps[1] = reps[0];
+    reps[0] = offset;
+    offBase = offset + 3;
+  }
+  seq->offBase = offBase;
+}
+
+static void Parse_Fast(CZstdEncCore *p, const Byte *data, UInt32 pos, UInt32 end)
+{
+  UInt32 *hash = p->hash;
+  const unsigned hashLog = p->params.hashLog;
+  const unsigned minMatch = p->params.minMatch;
+  const UInt32 windowSize = p->windowSize;
+  const UInt32 ilimit = end - 8;
+  const Byte *lim = data + end;
+  UInt32 anchor = pos;
+
+  if (end - pos < 8 + 1)
+    return;
+
+  while (pos < ilimit)
+  {
+    const UInt32 h = GetHash(data + pos, hashLog, minMatch);
+    const UInt32 rep = p->reps[0];
+    UInt32 cand = hash[h];
+    UInt32 offset, len;
+    hash[h] = pos;
+
+    if (pos > anchor && rep <= pos && rep <= windowSize && GetUi32(data + pos - rep) == GetUi32(data + pos))
+    {
+      offset = rep;
+      len = 4 + GetMatchLen(data + pos + 4, data + pos + 4 - rep, lim);
+    }
+    else if (cand < pos && pos - cand <= windowSize && GetUi32(data + cand) == GetUi32(data + pos))
+    {
+      offset = pos - cand;
+      len = 4 + GetMatchLen(data + pos + 4, data + cand + 4, lim);
+      while (pos > anchor && cand > 0 && data[pos - 1] == data[cand - 1])
+      {
+        pos--;
+        cand--;
+        len++;
+      }
+    }
+    else
+    {
+      pos += 1 + ((pos - anchor) >> kSearchStrength);
+      continue;
+    }
+
+    Core_AddSeq(p, data + anchor, pos - anchor, offset, len);
+    pos += len;
+    anchor = pos;
+
+    if (pos < ilimit)
+    {
+      hash[GetHash(data + pos - 2, hashLog, minMatch)] = pos - 2;
+      /* the match with second repeat offset just after current match */
+      for (;;)
+      {
+        UInt32 rep1 = p->reps[1];
+        if (pos >= ilimit || rep1 > pos || rep1 > windowSize || GetUi32(data + pos - rep1) != GetUi32(data + pos))
+          break;
+        len = 4 + GetMatchLen(data + pos + 4, data + pos + 4 - rep1, lim);
+        hash[GetHash(data + pos, hashLog, minMatch)] = pos;
+        Core_AddSeq(p, data + anchor, 0, rep1, len);
+        pos += len;
+        anchor = pos;
+      }
+    }
+  }
+
+  memcpy(p->lits + p->numLits, data + anchor, end - anchor);
+  p->numLits += end - anchor;
+}
+
+static void Parse_DFast(CZstdEncCore *p, const Byte *data, UInt32 pos, UInt32 end)
+{
+  UInt32 *hashLong = p->hash;
+  UInt32 *hashShort = p->chain;
+  const unsigned hashLog = p->params.hashLog;
+  const unsigned shortLog = p->params.chainLog;
+  const unsigned minMatch = p->params.minMatch;
+  const UInt32 windowSize = p->windowSize;
+  const UInt32 ilimit = end - 8;
+  const Byte *lim = data + end;
+  UInt32 anchor = pos;
+
+  if (end - pos < 8 + 1)
+    return;
+
+  while (pos < ilimit)
+  {
+    const UInt32 hl = GetHash(data + pos, hashLog, 8);
+    const UInt32 hs = GetHash(data + pos, shortLog, minMatch);
+    const UInt32 rep = p->reps[0];
+    UInt32 candLong = hashLong[hl];
+    UInt32 candShort = hashShort[hs];
+    UInt32 offset, len;
+    hashLong[hl] = pos;
+    hashShort[hs] = pos;
+
+    if (pos > anchor && rep <= pos && rep <= windowSize && GetUi32(data + pos - rep) == GetUi32(data + pos))
+    {
+      offset = rep;
+      len = 4 + GetMatchLen(data + pos + 4, data + pos + 4 - rep, lim);
+    }
+    else
+    {
+      UInt32 cand;
+      if (candLong < pos && pos - candLong <= windowSize && GetUi64(data + candLong) == GetUi64(data + pos))
+      {
+        cand = candLong;
+        len = 8 + GetMatchLen(data + pos + 8, data + cand + 8, lim);
+      }
+      else if (candShort < pos && pos - candShort <= windowSize && GetUi32(data + candShort) == GetUi32(data + pos))
+      {
+        /* the long match at next position is better than short match at current position */
+        const UInt32 hl1 = GetHash(data + pos + 1, hashLog, 8);
+        const UInt32 cand1 = hashLong[hl1];
+        hashLong[hl1] = pos + 1;
+        if (cand1 < pos + 1 && pos + 1 - cand1 <= windowSize && GetUi64(data + cand1) == GetUi64(data + pos + 1))
+        {
+          pos++;
+          cand = cand1;
+          len = 8 + GetMatchLen(data + pos + 8, data + cand + 8, lim);
+        }
+        else
+        {
+          cand = candShort;
+          len = 4 + GetMatchLen(data + pos + 4, data + cand + 4, lim);
+        }
+      }
+      else
+      {
+        pos += 1 + ((pos - anchor) >> kSearchStrength);
+        continue;
+      }
+      offset = pos - cand;
+      while (pos > anchor && cand > 0 && data[pos - 1] == data[cand - 1])
+      {
+        pos--;
+        cand--;
+        len++;
+      }
+    }
+
+    Core_AddSeq(p, data + anchor, pos - anchor, offset, len);
+    {
+      const UInt32 start = pos;
+      pos += len;
+      anchor = pos;
+      if (pos >= ilimit)
+        break;
+      hashLong[GetHash(data + start + 2, hashLog, 8)] = start + 2;
+      hashShort[GetHash(data + start + 2, shortLog, minMatch)] = start + 2;
+      hashLong[GetHash(data + pos - 2, hashLog, 8)] = pos - 2;
+      hashShort[GetHash(data + pos - 1, shortLog, minMatch)] = pos - 1;
+    }
+
+    for (;;)
+    {
+      UInt32 rep1 = p->reps[1];
+      if (pos >= ilimit || rep1 > pos || rep1 > windowSize || GetUi32(data + pos - rep1) != GetUi32(data + pos))
+        break;
+      len = 4 + GetMatchLen(data + pos + 4, data + pos + 4 - rep1, lim);
+      hashLong[GetHash(data + pos, hashLog, 8)] = pos;
+      hashShort[GetHash(data + pos, shortLog, minMatch)] = pos;
+      Core_AddSeq(p, data + anchor, 0, rep1, len);
+      pos += len;
+      anchor = pos;
+    }
+  }
+
+  memcpy(p->lits + p->numLits, data + anchor, end - anchor);
+  p->numLits += end - anchor;
+}
+
+static MY_FORCE_INLINE void Hc_Update(CZstdEncCore *p, const Byte *data, UInt32 target)
+{
+  UInt32 *hash = p->hash;
+  UInt32 *chain = p->chain;
+  const UInt32 mask = p->chainSize - 1;
+  const unsigned hashLog = p->params.hashLog;
+  const unsigned minMatch = p->params.minMatch;
+  UInt32 i;
+  for (i = p->nextToUpdate; i < target; i++)
+  {
+    UInt32 h = GetHash(data + i, hashLog, minMatch);
+    chain[i & mask] = hash[h];
+    hash[h] = i;
+  }
+  p->nextToUpdate = target;
+}
+
+/* Hc_Find() returns the length of longest match at (pos), or 0. The match with repeat offset
+   is preferred, if it's not much shorter than the match with new offset. */
+
+static MY_FORCE_INLINE UInt32 Hc_Find(CZstdEncCore *p, const Byte *data, UInt32 pos, UInt32 end, Bool checkRep, UInt32 *offsetRes)
+{
+  const UInt32 *chain = p->chain;
+  const UInt32 mask = p->chainSize - 1;
+  const Byte *cur = data + pos;
+  const Byte *lim = data + end;
+  UInt32 minPos, cand, bestLen, bestOffset = 0;
+  unsigned numAttempts = (unsigned)1 << p->params.searchLog;
+
+  Hc_Update(p, data, pos + 1);
+
+  minPos = (pos > p->windowSize) ? pos - p->windowSize : 0;
+  if (pos + 1 > p->chainSize && minPos < pos + 1 - p->chainSize)
+    minPos = pos + 1 - p->chainSize;
+
+  bestLen = (UInt32)p->params.minMatch - 1;
+  cand = chain[pos & mask];
+  for (; numAttempts != 0 && cand >= minPos && cand < pos; numAttempts--)
+  {
+    const Byte *pb = data + cand;
+    if (pb[bestLen] == cur[bestLen] && GetUi32(pb) == GetUi32(cur))
+    {
+      UInt32 len = 4 + GetMatchLen(cur + 4, pb + 4, lim);
+      if (len > bestLen)
+      {
+        bestLen = len;
+        bestOffset = pos - cand;
+        if (cur + len == lim)
+          break;
+      }
+    }
+    cand = chain[cand & mask];
+  }
+
+  if (checkRep)
+  {
+    const UInt32 rep = p->reps[0];
+    if (rep <= pos && rep <= p->windowSize && GetUi32(cur - rep) == GetUi32(cur))
+    {
+      UInt32 len = 4 + GetMatchLen(cur + 4, cur + 4 - rep, lim);
+      if (len >= p->params.minMatch && (bestOffset == 0
+          || (Int32)(len << 2) + 1 >= (Int32)(bestLen << 2) - (Int32)GetHighBit(bestOffset + 3)))
+      {
+        *offsetRes = rep;
+        return len;
+      }
+    }
+  }
+
+  if (bestOffset == 0)
+    return 0;
+  *offsetRes = bestOffset;
+  return bestLen;
+}
+
+#define GET_GAIN(len, offset) (((Int32)(len) << 2) - (Int32)GetHighBit((offset) == p->reps[0] ? 1 : (offset) + 3))
+
+static void Parse_Lazy(CZstdEncCore *p, const Byte *data, UInt32 pos, UInt32 end, unsigned depth)
+{
+  const UInt32 ilimit = end - 8;
+  const UInt32 windowSize = p->windowSize;
+  const Byte *lim = data + end;
+  UInt32 anchor = pos;
+
+  if (end - pos < 8 + 1)
+    return;
+
+  while (pos < ilimit)
+  {
+    UInt32 offset = 0;
+    UInt32 start = pos;
+    UInt32 len = Hc_Find(p, data, pos, end, pos > anchor, &offset);
+
+    if (len == 0)
+    {
+      pos += 1 + ((pos - anchor) >> kSearchStrength);
+      continue;
+    }
+
+    if (depth != 0)
+    {
+      while (pos < ilimit)
+      {
+        UInt32 offset2 = 0, len2;
+        pos++;
+        len2 = Hc_Find(p, data, pos, end, True, &offset2);
+        if (len2 != 0 && GET_GAIN(len2, offset2) > GET_GAIN(len, offset) + 4)
+        {
+          len = len2;
+          offset = offset2;
+          start = pos;
+          continue;
+        }
+        if (depth == 2 && pos < ilimit)
+        {
+          pos++;
+          len2 = Hc_Find(p, data, pos, end, True, &offset2);
+          if (len2 != 0 && GET_GAIN(len2, offset2) > GET_GAIN(len, offset) + 7)
+          {
+            len = len2;
+            offset = offset2;
+            start = pos;
+            continue;
+          }
+        }
+        break;
+      }
+    }
+
+    while (start > anchor && start > offset && data[start - 1] == data[start - 1 - offset])
+    {
+      start--;
+      len++;
+    }
+
+    Core_AddSeq(p, data + anchor, start - anchor, offset, len);
+    pos = start + len;
+    anchor = pos;
+
+    for (;;)
+    {
+      UInt32 rep1 = p->reps[1];
+      if (pos >= ilimit || rep1 > pos || rep1 > windowSize || GetUi32(data + pos - rep1) != GetUi32(data + pos))
+        break;
+      len = 4 + GetMatchLen(data + pos + 4, data + pos + 4 - rep1, lim);
+      Core_AddSeq(p, data + anchor, 0, rep1, len);
+      pos += len;
+      anchor = pos;
+    }
+  }
+
+  memcpy(p->lits + p->numLits, data + anchor, end - anchor);
+  p->numLits += end - anchor;
+}
+
+/* ---------- Block writing ---------- */
+
+/* WriteLiterals() returns the size of literals section, or 0, if it doesn't fit to (destSize) */
+
+static size_t Core_WriteLiterals(CZstdEncCore *p, Byte *dest, size_t destSize)
+{
+  const Byte *lits = p->lits;
+  const size_t size = p->numLits;
+  UInt32 counts[256];
+  unsigned maxSym = 0, numSyms = 0, i;
+
+  if (size >= kMinLiteralsToCompress)
+  {
+    for (i = 0; i < 256; i++)
+      counts[i] = 0;
+    {
+      size_t k;
+      for (k = 0; k < size; k++)
+        counts[lits[k]]++;
+    }
+    for (i = 0; i < 256; i++)
+      if (counts[i] != 0)
+      {
+        maxSym = i;
+        numSyms++;
+      }
+  }
+
+  if (numSyms == 1)
+  {
+    /* RLE literals */
+    const unsigned hs = 1 + (size > 31) + (size > 4095);
+    if (destSize < hs + 1)
+      return 0;
+    if (hs == 1)
+      dest[0] = (Byte)(1 + (size << 3));
+    else if (hs == 2)
+      SetUi16(dest, (UInt16)(1 + (1 << 2) + (size << 4)))
+    else
+      SetUi32(dest, (UInt32)(1 + (3 << 2) + (size << 4)))
+    dest[hs] = lits[0];
+    return hs + 1;
+  }
+
+  if (numSyms > 1 && Huf_Build(&p->huf, counts, maxSym))
+  {
+    const Bool single = (size < 256);
+    const unsigned hs = single ? 3 : 3 + (size >= 1024) + (size >= 16384);
+    UInt64 bits = 0;
+    size_t ts, cs, est;
+    for (i = 0; i <= maxSym; i++)
+      bits += (UInt64)counts[i] * p->huf.lens[i];
+    est = hs + (single ? 0 : 6) + (size_t)(bits >> 3) + 4 + (maxSym >> 1);
+    if (est + (size >> 6) < size && est < destSize)
+    {
+      Byte *d = dest + hs;
+      const Byte *lim = dest + destSize;
+      ts = Huf_WriteTable(d, &p->huf);
+      if (ts != 0)
+      {
+        d += ts;
+        if (single)
+        {
+          cs = Huf_Encode1(d, (size_t)(lim - d), lits, size, &p->huf);
+          d = (cs == 0) ? NULL : d + cs;
+        }
+        else
+        {
+          const size_t segSize = (size + 3) >> 2;
+          Byte *jump = d;
+          unsigned k;
+          d += 6;
+          for (k = 0; k < 4 && d; k++)
+          {
+            const size_t cur = (k == 3) ? size - segSize * 3 : segSize;
+            cs = (d < lim) ? Huf_Encode1(d, (size_t)(lim - d), lits + segSize * k, cur, &p->huf) : 0;
+            if (cs == 0 || (k != 3 && cs > 0xFFFF))
+              d = NULL;
+            else
+            {
+              if (k != 3)
+                SetUi16(jump + k * 2, (UInt16)cs)
+              d += cs;
+            }
+          }
+        }
+        if (d && (size_t)(d - dest) < size)
+        {
+          const UInt32 cSize = (UInt32)(d - dest) - hs;
+          if (hs == 3)
+          {
+            UInt32 v = 2 + ((UInt32)!single << 2) + ((UInt32)size << 4) + (cSize << 14);
+            dest[0] = (Byte)v;
+            dest[1] = (Byte)(v >> 8);
+            dest[2] = (Byte)(v >> 16);
+          }
+          else if (hs == 4)
+            SetUi32(dest, 2 + (2 << 2) + ((UInt32)size << 4) + (cSize << 18))
+          else
+          {
+            SetUi32(dest, 2 + (3 << 2) + ((UInt32)size << 4) + (cSize << 22))
+            dest[4] = (Byte)(cSize >> 10);
+          }
+          return (size_t)(d - dest);
+        }
+      }
+    }
+  }
+
+  /* raw literals */
+  {
+    const unsigned hs = 1 + (size > 31) + (size > 4095);
+    if (destSize < hs + size)
+      return 0;
+    if (hs == 1)
+      dest[0] = (Byte)(size << 3);
+    else if (hs == 2)
+      SetUi16(dest, (UInt16)((1 << 2) + (size << 4)))
+    else
+    {
+      UInt32 v = (3 << 2) + ((UInt32)size << 4);
+      dest[0] = (Byte)v;
+      dest[1] = (Byte)(v >> 8);
+      dest[2] = (Byte)(v >> 16);
+    }
+    memcpy(dest + hs, lits, size);
+    return hs + size;
+  }
+}
+
+#define SEQ_MODE_PREDEFINED 0
+#define SEQ_MODE_RLE 1
+#define SEQ_MODE_FSE 2
+
+/* SelectSeqMode() builds encoding table for one of the sequence codes (LL, OF, ML)
+   and writes the table description to (*dest), if it's required */
+
+static unsigned SelectSeqMode(CFseCTable *ct, Byte **dest, const UInt32 *counts, unsigned maxCode, UInt32 numSeqs,
+    const Int16 *defNorm, unsigned defMax, unsigned defLog, unsigned maxLog)
+{
+  Int16 norm[kNumSymbolsMax];
+  Byte temp[kNumSymbolsMax * 2 + 8];
+  UInt64 costDef = (UInt64)(Int64)-1, costFse = 0;
+  unsigned s, tableLog;
+  size_t hs;
+
+  if (counts[maxCode] == numSeqs && numSeqs > 2)
+  {
+    *(*dest)++ = (Byte)maxCode;
+    Fse_BuildCTableRle(ct, maxCode);
+    return SEQ_MODE_RLE;
+  }
+
+  if (maxCode <= defMax)
+  {
+    costDef = 0;
+    for (s = 0; s <= maxCode; s++)
+      costDef += (UInt64)counts[s] * ((defLog << 3) - Log2x8(defNorm[s] < 0 ? 1 : (UInt32)defNorm[s]));
+  }
+
+  tableLog = Fse_OptimalTableLog(maxLog, numSeqs, maxCode);
+  Fse_Normalize(norm, tableLog, counts, numSeqs, maxCode);
+  hs = Fse_WriteNCount(temp, norm, maxCode, tableLog);
+  costFse = (UInt64)hs << 6;
+  for (s = 0; s <= maxCode; s++)
+    if (counts[s] != 0)
+      costFse += (UInt64)counts[s] * ((tableLog << 3) - Log2x8(norm[s] < 0 ? 1 : (UInt32)norm[s]));
+
+  if (costDef <= costFse)
+  {
+    Fse_BuildCTable(ct, defNorm, defMax, defLog);
+    return SEQ_MODE_PREDEFINED;
+  }
+  memcpy(*dest, temp, hs);
+  *dest += hs;
+  Fse_BuildCTable(ct, norm, maxCode, tableLog);
+  return SEQ_MODE_FSE;
+}
+
+/* Core_WriteSequences() returns the size of sequences section, or 0, if it doesn't fit to (destSize) */
+
+static size_t Core_WriteSequences(CZstdEncCore *p, Byte *dest, size_t destSize)
+{
+  const CZstdSeq *seqs = p->seqs;
+  const size_t numSeqs = p->numSeqs;
+  Byte *llCodes = p->codes;
+  Byte *ofCodes = llCodes + numSeqs;
+  Byte *mlCodes = ofCodes + numSeqs;
+  UInt32 llCounts[ZSTD_NUM_LL_CODES];
+  UInt32 ofCounts[ZSTD_NUM_OF_CODES];
+  UInt32 mlCounts[ZSTD_NUM_ML_CODES];
+  unsigned llMax = 0, ofMax = 0, mlMax = 0, modes;
+  Byte *d = dest;
+  size_t i;
+
+  if (destSize < 4 + 1 + kNumSymbolsMax * 2 * 3 + 16)
+    return 0;
+
+  if (numSeqs < 128)
+    *d++ = (Byte)numSeqs;
+  else if (numSeqs < 0x7F00)
+  {
+    d[0] = (Byte)((numSeqs >> 8) + 0x80);
+    d[1] = (Byte)numSeqs;
+    d += 2;
+  }
+  else
+  {
+    d[0] = 0xFF;
+    SetUi16(d + 1, (UInt16)(numSeqs - 0x7F00))
+    d += 3;
+  }
+  if (numSeqs == 0)
+    return (size_t)(d - dest);
+
+  memset(llCounts, 0, sizeof(llCounts));
+  memset(ofCounts, 0, sizeof(ofCounts));
+  memset(mlCounts, 0, sizeof(mlCounts));
+  for (i = 0; i < numSeqs; i++)
+  {
+    const CZstdSeq *seq = &seqs[i];
+    unsigned ll = GET_LL_CODE(seq->litLen);
+    unsigned of = GetHighBit(seq->offBase);
+    unsigned ml = GET_ML_CODE(seq->mlBase);
+    llCodes[i] = (Byte)ll;
+    ofCodes[i] = (Byte)of;
+    mlCodes[i] = (Byte)ml;
+    llCounts[ll]++;
+    ofCounts[of]++;
+    mlCounts[ml]++;
+    if (llMax < ll) llMax = ll;
+    if (ofMax < of) ofMax = of;
+    if (mlMax < ml) mlMax = ml;
+  }
+
+  {
+    Byte *modesPtr = d++;
+    modes = SelectSeqMode(&p->llTable, &d, llCounts, llMax, (UInt32)numSeqs,
+        g_ZstdLlDefaultNorm, ZSTD_NUM_LL_CODES - 1, ZSTD_LL_LOG_DEFAULT, ZSTD_LL_LOG_MAX) << 6;
+    modes |= SelectSeqMode(&p->ofTable, &d, ofCounts, ofMax, (UInt32)numSeqs,
+        g_ZstdOfDefaultNorm, ZSTD_NUM_OF_CODES_DEFAULT - 1, ZSTD_OF_LOG_DEFAULT, ZSTD_OF_LOG_MAX) << 4;
+    modes |= SelectSeqMode(&p->mlTable, &d, mlCounts, mlMax, (UInt32)numSeqs,
+        g_ZstdMlDefaultNorm, ZSTD_NUM_ML_CODES - 1, ZSTD_ML_LOG_DEFAULT, ZSTD_ML_LOG_MAX) << 2;
+    *modesPtr = (Byte)modes;
+  }
+
+  {
+    const CFseCTable *llTable = &p->llTable;
+    const CFseCTable *ofTable = &p->ofTable;
+    const CFseCTable *mlTable = &p->mlTable;
+    CBitEnc bc;
+    UInt32 llState, ofState, mlState;
+    size_t n = numSeqs - 1;
+    size_t size;
+
+    BitEnc_Init(&bc, d, destSize - (size_t)(d - dest));
+
+    mlState = Fse_InitState(mlTable, mlCodes[n]);
+    ofState = Fse_InitState(ofTable, ofCodes[n]);
+    llState = Fse_InitState(llTable, llCodes[n]);
+    BitEnc_Add(&bc, seqs[n].litLen - g_ZstdLlBase[llCodes[n]], g_ZstdLlBits[llCodes[n]])
+    BitEnc_Flush(&bc);
+    BitEnc_Add(&bc, seqs[n].mlBase + ZSTD_MATCH_LEN_MIN - g_ZstdMlBase[mlCodes[n]], g_ZstdMlBits[mlCodes[n]])
+    BitEnc_Flush(&bc);
+    BitEnc_AddMasked(&bc, seqs[n].offBase, ofCodes[n])
+    BitEnc_Flush(&bc);
+
+    while (n != 0)
+    {
+      const CZstdSeq *seq = &seqs[--n];
+      const unsigned ll = llCodes[n];
+      const unsigned of = ofCodes[n];
+      const unsigned ml = mlCodes[n];
+      FSE_ENCODE(&bc, ofState, ofTable, of)
+      FSE_ENCODE(&bc, mlState, mlTable, ml)
+      FSE_ENCODE(&bc, llState, llTable, ll)
+      BitEnc_Flush(&bc);
+      BitEnc_Add(&bc, seq->litLen - g_ZstdLlBase[ll], g_ZstdLlBits[ll])
+      BitEnc_Add(&bc, seq->mlBase + ZSTD_MATCH_LEN_MIN - g_ZstdMlBase[ml], g_ZstdMlBits[ml])
+      BitEnc_Flush(&bc);
+      BitEnc_AddMasked(&bc, seq->offBase, of)
+      BitEnc_Flush(&bc);
+    }
+
+    FSE_FLUSH_STATE(&bc, mlState, mlTable)
+    FSE_FLUSH_STATE(&bc, ofState, ofTable)
+    FSE_FLUSH_STATE(&bc, llState, llTable)
+    size = BitEnc_Close(&bc);
+    if (size == 0)
+      return 0;
+    return (size_t)(d - dest) + size;
+  }
+}
+
+/* Core_EncodeBlock() encodes block (data + pos, size) and writes the block with header to (dest).
+   The data before (pos) in current frame is used as history.
+   (dest) must have (ZSTD_BLOCK_HEADER_SIZE + size) bytes. Returns the size of written data. */
+
+static size_t Core_EncodeBlock(CZstdEncCore *p, const Byte *data, UInt32 pos, UInt32 size, Bool last, Byte *dest)
+{
+  UInt32 reps[3];
+  size_t cSize = 0;
+  UInt32 header;
+
+  reps[0] = p->reps[0];
+  reps[1] = p->reps[1];
+  reps[2] = p->reps[2];
+  p->numSeqs = 0;
+  p->numLits = 0;
+
+  if (size >= 16)
+  {
+    if (p->params.strategy == STRATEGY_FAST)
+      Parse_Fast(p, data, pos, pos + size);
+    else if (p->params.strategy == STRATEGY_DFAST)
+      Parse_DFast(p, data, pos, pos + size);
+    else
+      Parse_Lazy(p, data, pos, pos + size, p->params.strategy - STRATEGY_GREEDY);
+  }
+
+  if (p->numSeqs != 0)
+  {
+    Byte *buf = p->blockBuf;
+    size_t litSize = Core_WriteLiterals(p, buf, size);
+    if (litSize != 0)
+    {
+      size_t seqSize = Core_WriteSequences(p, buf + litSize, size + kBlockBufExtra / 2 - litSize);
+      if (seqSize != 0 && litSize + seqSize < size)
+        cSize = litSize + seqSize;
+    }
+  }
+
+  if (cSize == 0)
+  {
+    /* the decoder doesn't change repeat offsets for raw blocks */
+    p->reps[0] = reps[0];
+    p->reps[1] = reps[1];
+    p->reps[2] = reps[2];
+    header = ((UInt32)size << 3) | (ZSTD_BLOCK_TYPE_RAW << 1);
+    memcpy(dest + ZSTD_BLOCK_HEADER_SIZE, data + pos, size);
+    cSize = size;
+  }
+  else
+  {
+    header = ((UInt32)cSize << 3) | (ZSTD_BLOCK_TYPE_COMPRESSED << 1);
+    memcpy(dest + ZSTD_BLOCK_HEADER_SIZE, p->blockBuf, cSize);
+  }
+  if (last)
+    header |= 1;
+  dest[0] = (Byte)header;
+  dest[1] = (Byte)(header >> 8);
+  dest[2] = (Byte)(header >> 16);
+  return ZSTD_BLOCK_HEADER_SIZE + cSize;
+}
+
+/* WriteFrameHeader() writes frame header. If (contentSize) is known,
+   and it's not larger than window, the frame is single segment */
+
+static unsigned WriteFrameHeader(Byte *dest, unsigned windowLog, UInt64 contentSize, Bool checksum)
+{
+  unsigned pos = ZSTD_SIG_SIZE + 1;
+  Byte d = (Byte)(checksum ? ZSTD_FD_CHECKSUM : 0);
+  SetUi32(dest, ZSTD_MAGIC)
+  if (contentSize != ZSTD_CONTENT_SIZE_UNKNOWN && contentSize <= ((UInt64)1 << windowLog))
+    d |= ZSTD_FD_SINGLE_SEGMENT;
+  else
+    dest[pos++] = (Byte)((windowLog - ZSTD_WINDOW_LOG_MIN) << 3);
+  if (contentSize != ZSTD_CONTENT_SIZE_UNKNOWN)
+  {
+    if (contentSize < 256 && (d & ZSTD_FD_SINGLE_SEGMENT))
+      dest[pos++] = (Byte)contentSize;
+    else if (contentSize < 0x10000 + 256)
+    {
+      d |= 1 << 6;
+      SetUi16(dest + pos, (UInt16)(contentSize - 256))
+      pos += 2;
+    }
+    else if (contentSize <= 0xFFFFFFFF)
+    {
+      d |= 2 << 6;
+      SetUi32(dest + pos, (UInt32)contentSize)
+      pos += 4;
+    }
+    else
+    {
+      d |= 3 << 6;
+      SetUi64(dest + pos, contentSize)
+      pos += 8;
+    }
+  }
+  dest[ZSTD_SIG_SIZE] = d;
+  return pos;
+}
+
+/* ---------- ZstdEnc ---------- */
+
+void ZstdEncProps_Init(CZstdEncProps *p)
+{
+  p->level = ZSTD_ENC_LEVEL_DEFAULT;
+  p->windowLog = 0;
+  p->checksum = 1;
+  p->reduceSize = (UInt64)(Int64)-1;
+  p->blockSize = 0;
+  p->numThreads = 1;
+}
+
+static void ZstdEncProps_GetLevelParams(const CZstdEncProps *p, CZstdLevelParams *lp)
+{
+  unsigned windowLog;
+  *lp = g_Levels[p->level];
+  windowLog = lp->windowLog;
+  if (p->windowLog != 0)
+    windowLog = p->windowLog;
+  {
+    UInt64 reduceSize = p->reduceSize;
+    if (p->numThreads > 1 && reduceSize > p->blockSize)
+      reduceSize = p->blockSize;
+    while (windowLog > ZSTD_WINDOW_LOG_MIN && ((UInt64)1 << (windowLog - 1)) >= reduceSize)
+      windowLog--;
+  }
+  lp->windowLog = (Byte)windowLog;
+  if (lp->chainLog > windowLog)
+    lp->chainLog = (Byte)windowLog;
+  if (lp->hashLog > windowLog + 1)
+    lp->hashLog = (Byte)(windowLog + 1);
+}
+
+void ZstdEncProps_Normalize(CZstdEncProps *p)
+{
+  if (p->level < 0)
+    p->level = ZSTD_ENC_LEVEL_DEFAULT;
+  if (p->level < ZSTD_ENC_LEVEL_MIN)
+    p->level = ZSTD_ENC_LEVEL_MIN;
+  if (p->level > ZSTD_ENC_LEVEL_MAX)
+    p->level = ZSTD_ENC_LEVEL_MAX;
+  if (p->windowLog != 0)
+  {
+    if (p->windowLog < ZSTD_WINDOW_LOG_MIN)
+      p->windowLog = ZSTD_WINDOW_LOG_MIN;
+    if (p->windowLog > ZSTD_ENC_WINDOW_LOG_MAX)
+      p->windowLog = ZSTD_ENC_WINDOW_LOG_MAX;
+  }
+  if (p->numThreads <= 0)
+    p->numThreads = 1;
+  if (p->numThreads > NUM_MT_CODER_THREADS_MAX)
+    p->numThreads = NUM_MT_CODER_THREADS_MAX;
+
+  if (p->blockSize == 0)
+  {
+    unsigned windowLog = (p->windowLog != 0) ? p->windowLog : g_Levels[p->level].windowLog;
+    UInt64 blockSize = (UInt64)1 << (windowLog + 2);
+    const UInt32 kMinSize = (UInt32)1 << 20;
+    const UInt32 kMaxSize = (UInt32)1 << 28;
+    if (blockSize < kMinSize) blockSize = kMinSize;
+    if (blockSize > kMaxSize) blockSize = kMaxSize;
+    p->blockSize = (size_t)blockSize;
+  }
+  if (p->numThreads > 1)
+  {
+    UInt64 numBlocks = p->reduceSize / p->blockSize + 1;
+    if (numBlocks < (UInt64)p->numThreads)
+      p->numThreads = (int)numBlocks;
+  }
+}
+
+typedef struct
+{
+  CZstdEncProps props;
+  CZstdLevelParams params;
+
+  ISzAlloc *alloc;
+  ISzAlloc *allocBig;
+
+  CZstdEncCore coders[NUM_MT_CODER_THREADS_MAX];
+
+  #ifndef _7ZIP_ST
+  CMtCoder mtCoder;
+  #endif
+} CZstdEnc;
+
+static SRes Progress(ICompressProgress *p, UInt64 inSize, UInt64 outSize)
+{
+  return (p && p->Progress(p, inSize, outSize) != SZ_OK) ? SZ_ERROR_PROGRESS : SZ_OK;
+}
+
+/* ---------- ZstdEncThread ---------- */
+
+/* single-thread mode writes one frame with unknown content size.
+   The input stream is read to window buffer that keeps (windowSize) bytes of history. */
+
+static SRes ZstdEnc_EncodeMt1(CZstdEnc *mainEncoder, CZstdEncCore *p,
+    ISeqOutStream *outStream, ISeqInStream *inStream, ICompressProgress *progress)
+{
+  const UInt32 windowSize = (UInt32)1 << mainEncoder->params.windowLog;
+  const UInt32 blockSizeMax = (windowSize < ZSTD_BLOCK_SIZE_MAX) ? windowSize : ZSTD_BLOCK_SIZE_MAX;
+  const size_t readSize = (windowSize > ((UInt32)1 << 20) ? windowSize : ((UInt32)1 << 20)) + ZSTD_BLOCK_SIZE_MAX;
+  const size_t winSize = (size_t)windowSize + readSize;
+  const Bool checksum = (mainEncoder->props.checksum != 0);
+  Byte *out;
+  UInt32 pos = 0, lim = 0;
+  UInt64 inTotal = 0, outTotal = 0;
+  Bool eof = False, lastWritten = False;
+  CXxh64 xxh;
+  Byte header[ZSTD_FRAME_HEADER_SIZE_MAX];
+  size_t size;
+
+  if (!p->win || p->winSize != winSize)
+  {
+    IAlloc_Free(mainEncoder->allocBig, p->win);
+    p->winSize = 0;
+    p->win = (Byte *)IAlloc_Alloc(mainEncoder->allocBig, winSize);
+    if (!p->win)
+      return SZ_ERROR_MEM;
+    p->winSize = winSize;
+  }
+  out = (Byte *)IAlloc_Alloc(mainEncoder->alloc, ZSTD_BLOCK_HEADER_SIZE + ZSTD_BLOCK_SIZE_MAX);
+  if (!out)
+    return SZ_ERROR_MEM;
+
+  Core_InitFrame(p);
+  Xxh64_Init(&xxh);
+
+  size = WriteFrameHeader(header, mainEncoder->params.windowLog, ZSTD_CONTENT_SIZE_UNKNOWN, checksum);
+  if (outStream->Write(outStream, header, size) != size)
+  {
+    IAlloc_Free(mainEncoder->alloc, out);
+    return SZ_ERROR_WRITE;
+  }
+  outTotal = size;
+
+  for (;;)
+  {
+    SRes res = SZ_OK;
+    while (!eof && lim != winSize)
+    {
+      size_t cur = winSize - lim;
+      if (inStream->Read(inStream, p->win + lim, &cur) != SZ_OK)
+      {
+        res = SZ_ERROR_READ;
+        break;
+      }
+      if (cur == 0)
+        eof = True;
+      if (checksum)
+        Xxh64_Update(&xxh, p->win + lim, cur);
+      lim += (UInt32)cur;
+      inTotal += cur;
+    }
+
+    while (res == SZ_OK && pos != lim && (lim - pos >= blockSizeMax || eof))
+    {
+      UInt32 blockSize = lim - pos;
+      Bool last;
+      if (blockSize > blockSizeMax)
+        blockSize = blockSizeMax;
+      last = (eof && pos + blockSize == lim);
+      size = Core_EncodeBlock(p, p->win, pos, blockSize, last, out);
+      pos += blockSize;
+      lastWritten = last;
+      if (outStream->Write(outStream, out, size) != size)
+        res = SZ_ERROR_WRITE;
+      else
+      {
+        outTotal += size;
+        res = Progress(progress, inTotal - (lim - pos), outTotal);
+      }
+    }
+
+    if (res != SZ_OK)
+    {
+      IAlloc_Free(mainEncoder->alloc, out);
+      return res;
+    }
+    if (eof)
+      break;
+
+    {
+      UInt32 delta = pos - windowSize;
+      if (p->chainSize != 0)
+        delta &= ~(p->chainSize - 1);
+      memmove(p->win, p->win + delta, lim - delta);
+      pos -= delta;
+      lim -= delta;
+      Core_ReduceOffsets(p, delta);
+    }
+  }
+
+  IAlloc_Free(mainEncoder->alloc, out);
+
+  size = 0;
+  if (!lastWritten)
+  {
+    header[0] = 1;
+    header[1] = 0;
+    header[2] = 0;
+    size = ZSTD_BLOCK_HEADER_SIZE;
+  }
+  if (checksum)
+  {
+    SetUi32(header + size, (UInt32)Xxh64_Digest(&xxh))
+    size += ZSTD_CHECKSUM_SIZE;
+  }
+  if (size != 0 && outStream->Write(outStream, header, size) != size)
+    return SZ_ERROR_WRITE;
+  return SZ_OK;
+}
+
+#ifndef _7ZIP_ST
+
+typedef struct
+{
+  IMtCoderCallback funcTable;
+  CZstdEnc *zstdEnc;
+} CMtCallbackImp;
+
+/* each block of multithreading mode is written as separate frame.
+   The frame is written also for empty last block, so the empty stream is encoded to one empty frame. */
+
+static SRes MtCallbackImp_Code(void *pp, unsigned index, Byte *dest, size_t *destSize,
+      const Byte *src, size_t srcSize, int finished)
+{
+  CMtCallbackImp *imp = (CMtCallbackImp *)pp;
+  CZstdEnc *mainEncoder = imp->zstdEnc;
+  CZstdEncCore *p = &mainEncoder->coders[index];
+  const Bool checksum = (mainEncoder->props.checksum != 0);
+  const size_t destLim = *destSize;
+  const UInt32 windowSize = (UInt32)1 << mainEncoder->params.windowLog;
+  const UInt32 blockSizeMax = (windowSize < ZSTD_BLOCK_SIZE_MAX && windowSize < srcSize) ? windowSize : ZSTD_BLOCK_SIZE_MAX;
+  size_t destPos;
+  UInt32 pos = 0;
+
+  (void)finished;
+  *destSize = 0;
+
+  Core_InitFrame(p);
+  destPos = WriteFrameHeader(dest, mainEncoder->params.windowLog, srcSize, checksum);
+
+  do
+  {
+    UInt32 blockSize = (UInt32)srcSize - pos;
+    if (blockSize > blockSizeMax)
+      blockSize = blockSizeMax;
+    if (destLim - destPos < ZSTD_BLOCK_HEADER_SIZE + blockSize + ZSTD_CHECKSUM_SIZE)
+      return SZ_ERROR_OUTPUT_EOF;
+    destPos += Core_EncodeBlock(p, src, pos, blockSize, pos + blockSize == srcSize, dest + destPos);
+    pos += blockSize;
+    if (MtProgress_Set(&mainEncoder->mtCoder.mtProgress, index, pos, destPos) != SZ_OK)
+      return SZ_ERROR_PROGRESS;
+  }
+  while (pos != srcSize);
+
+  if (checksum)
+  {
+    CXxh64 xxh;
+    Xxh64_Init(&xxh);
+    Xxh64_Update(&xxh, src, srcSize);
+    SetUi32(dest + destPos, (UInt32)Xxh64_Digest(&xxh))
+    destPos += ZSTD_CHECKSUM_SIZE;
+  }
+  *destSize = destPos;
+  return SZ_OK;
+}
+
+#endif
+
+CZstdEncHandle ZstdEnc_Create(ISzAlloc *alloc, ISzAlloc *allocBig)
+{
+  CZstdEnc *p = (CZstdEnc *)alloc->Alloc(alloc, sizeof(CZstdEnc));
+  unsigned i;
+  if (!p)
+    return NULL;
+  ZstdEncProps_Init(&p->props);
+  ZstdEncProps_Normalize(&p->props);
+  p->alloc = alloc;
+  p->allocBig = allocBig;
+  for (i = 0; i < NUM_MT_CODER_THREADS_MAX; i++)
+    Core_Construct(&p->coders[i]);
+  #ifndef _7ZIP_ST
+  MtCoder_Construct(&p->mtCoder);
+  #endif
+  return p;
+}
+
+void ZstdEnc_Destroy(CZstdEncHandle pp)
+{
+  CZstdEnc *p = (CZstdEnc *)pp;
+  unsigned i;
+  for (i = 0; i < NUM_MT_CODER_THREADS_MAX; i++)
+    Core_Free(&p->coders[i], p->alloc, p->allocBig);
+  #ifndef _7ZIP_ST
+  MtCoder_Destruct(&p->mtCoder);
+  #endif
+  IAlloc_Free(p->alloc, pp);
+}
+
+SRes ZstdEnc_SetProps(CZstdEncHandle pp, const CZstdEncProps *props)
+{
+  CZstdEnc *p = (CZstdEnc *)pp;
+  if (props->level > ZSTD_ENC_LEVEL_MAX
+      || (props->windowLog != 0 && (props->windowLog < ZSTD_WINDOW_LOG_MIN || props->windowLog > ZSTD_ENC_WINDOW_LOG_MAX)))
+    return SZ_ERROR_PARAM;
+  p->props = *props;
+  ZstdEncProps_Normalize(&p->props);
+  return SZ_OK;
+}
+
+SRes ZstdEnc_Encode(CZstdEncHandle pp,
+    ISeqOutStream *outStream, ISeqInStream *inStream, ICompressProgress *progress)
+{
+  CZstdEnc *p = (CZstdEnc *)pp;
+  int i;
+
+  ZstdEncProps_GetLevelParams(&p->props, &p->params);
+
+  for (i = 0; i < p->props.numThreads; i++)
+  {
+    RINOK(Core_Alloc(&p->coders[i], &p->params, p->alloc, p->allocBig));
+  }
+
+  #ifndef _7ZIP_ST
+  if (p->props.numThreads <= 1)
+  #endif
+    return ZstdEnc_EncodeMt1(p, &p->coders[0], outStream, inStream, progress);
+
+  #ifndef _7ZIP_ST
+
+  {
+    CMtCallbackImp mtCallback;
+    const size_t blockSize = p->props.blockSize;
+
+    mtCallback.funcTable.Code = MtCallbackImp_Code;
+    mtCallback.zstdEnc = p;
+
+    p->mtCoder.progress = progress;
+    p->mtCoder.inStream = inStream;
+    p->mtCoder.outStream = outStream;
+    p->mtCoder.alloc = p->alloc;
+    p->mtCoder.mtCallback = &mtCallback.funcTable;
+
+    p->mtCoder.blockSize = blockSize;
+    p->mtCoder.destBlockSize = blockSize + (blockSize >> 15) * ZSTD_BLOCK_HEADER_SIZE
+        + ZSTD_FRAME_HEADER_SIZE_MAX + ZSTD_BLOCK_HEADER_SIZE + ZSTD_CHECKSUM_SIZE + 16;
+    p->mtCoder.numThreads = p->props.numThreads;
+
+    return MtCoder_Code(&p->mtCoder);
+  }
+  #endif
+}
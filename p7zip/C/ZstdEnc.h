@@ -0,0 +1,58 @@
+/* ZstdEnc.h -- Zstandard Encoder
+2026-10-18 : Public domain */
+
+#ifndef __ZSTD_ENC_H
+#define __ZSTD_ENC_H
+
+#include "Zstd.h"
+
+EXTERN_C_BEGIN
+
+#define ZSTD_ENC_LEVEL_MIN 1
+#define ZSTD_ENC_LEVEL_MAX 22
+#define ZSTD_ENC_LEVEL_DEFAULT 3
+
+#define ZSTD_ENC_WINDOW_LOG_MAX 27
+
+typedef struct
+{
+  int level;          /* 1 <= level <= 22, default = 3 */
+  unsigned windowLog; /* 10 <= windowLog <= 27, default = 0 (it depends from level) */
+  int checksum;       /* 0 or 1, default = 1 */
+  UInt64 reduceSize;  /* estimated size of data that will be compressed. default = (UInt64)(Int64)-1.
+                         Encoder uses this value to reduce window size. */
+  size_t blockSize;   /* the size of independent frame in multithreading mode. default = 0 (auto) */
+  int numThreads;     /* 1 or 2 ... , default = 1 */
+} CZstdEncProps;
+
+void ZstdEncProps_Init(CZstdEncProps *p);
+void ZstdEncProps_Normalize(CZstdEncProps *p);
+
+/* ---------- CZstdEncHandle Interface ---------- */
+
+/* In multithreading mode the encoder splits the input stream to blocks of (blockSize)
+   and writes each block as separate zstd frame. Zstd decoders decode concatenated frames
+   as one stream.
+
+ZstdEnc_* functions can return the following exit codes:
+Returns:
+  SZ_OK           - OK
+  SZ_ERROR_MEM    - Memory allocation error
+  SZ_ERROR_PARAM  - Incorrect paramater in props
+  SZ_ERROR_READ   - Read callback error
+  SZ_ERROR_WRITE  - Write callback error
+  SZ_ERROR_PROGRESS - some break from progress callback
+  SZ_ERROR_THREAD - errors in multithreading functions (only for Mt version)
+*/
+
+typedef void * CZstdEncHandle;
+
+CZstdEncHandle ZstdEnc_Create(ISzAlloc *alloc, ISzAlloc *allocBig);
+void ZstdEnc_Destroy(CZstdEncHandle p);
+SRes ZstdEnc_SetProps(CZstdEncHandle p, const CZstdEncProps *props);
+SRes ZstdEnc_Encode(CZstdEncHandle p,
+    ISeqOutStream *outStream, ISeqInStream *inStream, ICompressProgress *progress);
+
+EXTERN_C_END
+
+#endif
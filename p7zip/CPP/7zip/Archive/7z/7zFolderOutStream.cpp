@@ -46,10 +46,9 @@ HRESULT CFolderOutStream::OpenFile()
   _crcStreamSpec->SetStream(realOutStream);
   _crcStreamSpec->Init(_checkCrc);
   _fileIsOpen = true;
-  const CFileItem &fi = _db->Files[index];
-  _rem = fi.Size;
+  _rem = _db->Files.GetSize(index);
   if (askMode == NExtract::NAskMode::kExtract && !realOutStream &&
-      !_db->IsItemAnti(index) && !fi.IsDir)
+      !_db->IsItemAnti(index) && !_db->Files.IsDir(index))
     askMode = NExtract::NAskMode::kSkip;
   return _extractCallback->PrepareOperation(askMode);
 }
@@ -64,16 +63,17 @@ HRESULT CFolderOutStream::CloseFileAndSetResult(Int32 res)
 
 HRESULT CFolderOutStream::CloseFileAndSetResult()
 {
-  const CFileItem &fi = _db->Files[_startIndex + _currentIndex];
+  unsigned index = _startIndex + _currentIndex;
+  UInt32 crc;
   return CloseFileAndSetResult(
-      (fi.IsDir || !fi.CrcDefined || !_checkCrc || fi.Crc == _crcStreamSpec->GetCRC()) ?
+      (_db->Files.IsDir(index) || !_db->Files.GetCrc(index, crc) || !_checkCrc || crc == _crcStreamSpec->GetCRC()) ?
       NExtract::NOperationResult::kOK :
       NExtract::NOperationResult::kCRCError);
 }
 
 HRESULT CFolderOutStream::ProcessEmptyFiles()
 {
-  while (_currentIndex < _extractStatuses->Size() && _db->Files[_startIndex + _currentIndex].Size == 0)
+  while (_currentIndex < _extractStatuses->Size() && _db->Files.GetSize(_startIndex + _currentIndex) == 0)
   {
     RINOK(OpenFile());
     RINOK(CloseFileAndSetResult());
@@ -126,7 +126,7 @@ STDMETHODIMP CFolderOutStream::GetSubStreamSize(UInt64 subStream, UInt64 *value)
   *value = 0;
   if ((int)subStream >= _extractStatuses->Size())
     return S_FALSE;
-  *value = _db->Files[_startIndex + (int)subStream].Size;
+  *value = _db->Files.GetSize(_startIndex + (int)subStream);
   return S_OK;
 }
 
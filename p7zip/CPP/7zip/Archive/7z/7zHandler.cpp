@@ -252,7 +252,7 @@ STDMETHODIMP CHandler::GetArchiveProperty(PROPID propID, PROPVARIANT *value)
   #endif
 }
 
-static void SetFileTimeProp_From_UInt64Def(PROPVARIANT *prop, const CUInt64DefVector &v, int index)
+static void SetFileTimeProp_From_UInt64Def(PROPVARIANT *prop, const CTimeVector &v, int index)
 {
   UInt64 value;
   if (v.GetItem(index, value))
@@ -552,15 +552,15 @@ STDMETHODIMP CHandler::GetProperty(UInt32 index, PROPID propID, PROPVARIANT *val
   const CRef &ref = ref2.Refs.Front();
   */
 
-  const CFileItem &item = _db.Files[index];
+  const CFileItems &files = _db.Files;
   UInt32 index2 = index;
 
   switch(propID)
   {
-    case kpidIsDir: PropVarEm_Set_Bool(value, item.IsDir); break;
+    case kpidIsDir: PropVarEm_Set_Bool(value, files.IsDir(index)); break;
     case kpidSize:
     {
-      PropVarEm_Set_UInt64(value, item.Size);
+      PropVarEm_Set_UInt64(value, files.GetSize(index));
       // prop = ref2.Size;
       break;
     }
@@ -588,8 +588,8 @@ STDMETHODIMP CHandler::GetProperty(UInt32 index, PROPID propID, PROPVARIANT *val
     case kpidCTime:  SetFileTimeProp_From_UInt64Def(value, _db.CTime, index2); break;
     case kpidATime:  SetFileTimeProp_From_UInt64Def(value, _db.ATime, index2); break;
     case kpidMTime:  SetFileTimeProp_From_UInt64Def(value, _db.MTime, index2); break;
-    case kpidAttrib:  if (item.AttribDefined) PropVarEm_Set_UInt32(value, item.Attrib); break;
-    case kpidCRC:  if (item.CrcDefined) PropVarEm_Set_UInt32(value, item.Crc); break;
+    case kpidAttrib:  { UInt32 v; if (files.GetAttrib(index, v)) PropVarEm_Set_UInt32(value, v); break; }
+    case kpidCRC:  { UInt32 v; if (files.GetCrc(index, v)) PropVarEm_Set_UInt32(value, v); break; }
     case kpidEncrypted:  PropVarEm_Set_Bool(value, IsFolderEncrypted(_db.FileIndexToFolderIndexMap[index2])); break;
     case kpidIsAnti:  PropVarEm_Set_Bool(value, _db.IsItemAnti(index2)); break;
     /*
@@ -65,6 +65,12 @@ public:
   CBoolPair Write_MTime;
 
   bool _volumeMode;
+  bool _dedup;
+
+  #ifndef _7ZIP_ST
+  UInt32 _numBlockThreads;
+  UInt64 _blockMemUsageLimit;
+  #endif
 
   void InitSolidFiles() { _numSolidFiles = (UInt64)(Int64)(-1); }
   void InitSolidSize()  { _numSolidBytes = (UInt64)(Int64)(-1); }
@@ -157,6 +163,9 @@ private:
       , UInt32 numThreads
       #endif
       );
+  #ifndef _7ZIP_ST
+  HRESULT GetBlockMemUsage(UInt32 numCoderThreads, UInt64 &memUsage);
+  #endif
 
 
   #endif
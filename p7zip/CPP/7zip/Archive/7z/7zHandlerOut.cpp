@@ -6,6 +6,10 @@
 #include "../../../Common/StringToInt.h"
 #include "../../../Common/Wildcard.h"
 
+#ifndef _7ZIP_ST
+#include "../../../Windows/System.h"
+#endif
+
 #include "../Common/ItemNameUtils.h"
 #include "../Common/ParseProperties.h"
 
@@ -140,6 +144,60 @@ HRESULT CHandler::SetMainMethod(
   return S_OK;
 }
 
+#ifndef _7ZIP_ST
+
+// it's approximate memory usage of one encoder of solid block
+
+static UInt64 GetMethodMemUsage(CMethodId id, const COneMethodInfo &m)
+{
+  const UInt64 kMemUsage_Default = (UInt64)1 << 22;
+  switch (id)
+  {
+    case k_LZMA:
+    case k_LZMA2:
+    {
+      UInt64 dicSize = m.Get_Lzma_DicSize();
+      UInt64 size = dicSize * 23 / 2 + ((UInt64)6 << 20);
+      int numThreads = m.Get_NumThreads();
+      if (id == k_LZMA2 && numThreads > 2)
+      {
+        // each LZMA2 block coder uses 2 threads
+        UInt32 numCoders = ((UInt32)numThreads + 1) / 2;
+        size = (size + dicSize * 4) * numCoders;
+      }
+      return size;
+    }
+    case k_PPMD: return (UInt64)m.Get_Ppmd_MemSize() + ((UInt64)1 << 22);
+    case k_BZip2:
+    {
+      bool fixedNumber;
+      return ((UInt64)m.Get_BZip2_BlockSize() * 10 + ((UInt64)1 << 20)) * m.Get_BZip2_NumThreads(fixedNumber);
+    }
+  }
+  return kMemUsage_Default;
+}
+
+// it's approximate memory usage of all encoders of one solid block,
+// including the temp buffer for packed stream
+
+HRESULT CHandler::GetBlockMemUsage(UInt32 numCoderThreads, UInt64 &memUsage)
+{
+  memUsage = (UInt64)1 << 20;
+  FOR_VECTOR (i, _methods)
+  {
+    // SetMainMethod() doesn't change the number of threads, if it's set already,
+    // so we estimate with the copy of method props
+    COneMethodInfo m = _methods[i];
+    SetGlobalLevelAndThreads(m, numCoderThreads);
+    CMethodFull methodFull;
+    RINOK(PropsMethod_To_FullMethod(methodFull, m));
+    memUsage += GetMethodMemUsage(methodFull.Id, m);
+  }
+  return S_OK;
+}
+
+#endif
+
 static HRESULT GetTime(IArchiveUpdateCallback *updateCallback, int index, PROPID propID, UInt64 &ft, bool &ftDefined)
 {
   // ft = 0;
@@ -298,13 +356,13 @@ STDMETHODIMP CHandler::UpdateItems(ISequentialOutStream *outStream, UInt32 numIt
     {
       if (db == 0 || (unsigned)ui.IndexInArchive >= db->Files.Size())
         return E_INVALIDARG;
-      const CFileItem &fi = db->Files[ui.IndexInArchive];
+      const CFileItems &files = db->Files;
       if (!ui.NewProps)
       {
         _db.GetPath(ui.IndexInArchive, name);
       }
-      ui.IsDir = fi.IsDir;
-      ui.Size = fi.Size;
+      ui.IsDir = files.IsDir(ui.IndexInArchive);
+      ui.Size = files.GetSize(ui.IndexInArchive);
       // isAltStream = fi.IsAltStream;
       ui.IsAnti = db->IsItemAnti(ui.IndexInArchive);
 
@@ -517,9 +575,45 @@ STDMETHODIMP CHandler::UpdateItems(ISequentialOutStream *outStream, UInt32 numIt
 
   CCompressionMethodMode methodMode, headerMethod;
 
+  #ifndef _7ZIP_ST
+  // the threads are shared by the solid blocks that are compressed concurrently.
+  // We reduce the number of blocks by the number of new files and by memory limit
+  // before we split the threads, so each block gets all threads that it can use.
+  UInt32 numBlockThreads = (_numBlockThreads == 0 ? 1 : _numBlockThreads);
+  UInt64 blockMemUsage = 0;
+  UInt64 memUsageLimit = _blockMemUsageLimit;
+  if (numBlockThreads > 1)
+  {
+    UInt32 numNewFiles = 0;
+    FOR_VECTOR (k, updateItems)
+    {
+      const CUpdateItem &ui = updateItems[k];
+      if (ui.NewData && ui.HasStream())
+        numNewFiles++;
+    }
+    if (numBlockThreads > numNewFiles)
+      numBlockThreads = numNewFiles;
+    if (memUsageLimit == 0)
+      memUsageLimit = NSystem::GetRamSize() / 2;
+    AddDefaultMethod();
+    for (; numBlockThreads > 1; numBlockThreads--)
+    {
+      UInt32 numCoderThreads = _numThreads / numBlockThreads;
+      RINOK(GetBlockMemUsage(numCoderThreads == 0 ? 1 : numCoderThreads, blockMemUsage));
+      if (blockMemUsage * numBlockThreads <= memUsageLimit)
+        break;
+    }
+    if (numBlockThreads == 0)
+      numBlockThreads = 1;
+  }
+  UInt32 numCoderThreads = _numThreads / numBlockThreads;
+  if (numCoderThreads == 0)
+    numCoderThreads = 1;
+  #endif
+
   HRESULT res = SetMainMethod(methodMode, _methods
     #ifndef _7ZIP_ST
-    , _numThreads
+    , numCoderThreads
     #endif
     );
   RINOK(res);
@@ -527,7 +621,7 @@ STDMETHODIMP CHandler::UpdateItems(ISequentialOutStream *outStream, UInt32 numIt
 
   RINOK(SetHeaderMethod(headerMethod));
   #ifndef _7ZIP_ST
-  methodMode.NumThreads = _numThreads;
+  methodMode.NumThreads = numCoderThreads;
   headerMethod.NumThreads = 1;
   #endif
 
@@ -588,6 +682,13 @@ STDMETHODIMP CHandler::UpdateItems(ISequentialOutStream *outStream, UInt32 numIt
   options.SolidExtension = _solidExtension;
   options.RemoveSfxBlock = _removeSfxBlock;
   options.VolumeMode = _volumeMode;
+  options.Dedup = _dedup;
+
+  #ifndef _7ZIP_ST
+  options.NumBlockThreads = numBlockThreads;
+  options.BlockMemUsage = (numBlockThreads > 1 ? blockMemUsage : 0);
+  options.MemUsageLimit = memUsageLimit;
+  #endif
 
   COutArchive archive;
   CArchiveDatabaseOut newDatabase;
@@ -668,6 +769,13 @@ void COutHandler::InitProps()
   Write_MTime.Init();
 
   _volumeMode = false;
+  _dedup = false;
+
+  #ifndef _7ZIP_ST
+  _numBlockThreads = 1;
+  _blockMemUsageLimit = 0;
+  #endif
+
   InitSolid();
 }
 
@@ -788,6 +896,27 @@ HRESULT COutHandler::SetProperty(const wchar_t *nameSpec, const PROPVARIANT &val
     if (name.IsEqualTo("tm")) return PROPVARIANT_to_BoolPair(value, Write_MTime);
 
     if (name.IsEqualTo("v"))  return PROPVARIANT_to_bool(value, _volumeMode);
+    if (name.IsEqualTo("dedup")) return PROPVARIANT_to_bool(value, _dedup);
+
+    if (name.IsPrefixedBy(L"mtbm"))
+    {
+      UInt32 memLimitMB = 0;
+      RINOK(ParsePropToUInt32(name.Ptr(4), value, memLimitMB));
+      #ifndef _7ZIP_ST
+      _blockMemUsageLimit = (UInt64)memLimitMB << 20;
+      #endif
+      return S_OK;
+    }
+
+    if (name.IsPrefixedBy(L"mtb"))
+    {
+      UInt32 numBlockThreads = 1;
+      RINOK(ParsePropToUInt32(name.Ptr(3), value, numBlockThreads));
+      #ifndef _7ZIP_ST
+      _numBlockThreads = numBlockThreads;
+      #endif
+      return S_OK;
+    }
   }
   return CMultiMethodProps::SetProperty(name, value);
 }
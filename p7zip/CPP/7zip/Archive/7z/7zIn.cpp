@@ -1067,6 +1067,109 @@ void CInArchive::ReadBoolVector2(unsigned numItems, CBoolVector &v)
     p[i] = true;
 }
 
+void CInArchive::ReadBitVector(unsigned numItems, CBitVector &v)
+{
+  v.ClearAndSetSize(numItems);
+  ReadBytes(v.GetBuf(), ((size_t)numItems + 7) >> 3);
+}
+
+void CInArchive::ReadBitVector2(unsigned numItems, CBitVector &v)
+{
+  Byte allAreDefined = ReadByte();
+  if (allAreDefined == 0)
+  {
+    ReadBitVector(numItems, v);
+    return;
+  }
+  v.ClearAndSetSize(numItems);
+  for (unsigned i = 0; i < numItems; i++)
+    v.Set(i);
+}
+
+static unsigned GetNumTimeBlocks(unsigned numItems)
+{
+  return (unsigned)(((size_t)numItems + ((1 << kTimeBlockBits) - 1)) >> kTimeBlockBits);
+}
+
+void CTimeVector::StartAdding()
+{
+  unsigned numBlocks = GetNumTimeBlocks(Defs.Size());
+  _bases.ClearAndReserve(numBlocks);
+  _offsets.ClearAndReserve(numBlocks);
+  _numBytes.ClearAndReserve(numBlocks);
+  _deltas.Clear();
+  _curBlock = 0;
+}
+
+void CTimeVector::FlushBlock()
+{
+  unsigned start = (unsigned)_curBlock << kTimeBlockBits;
+  unsigned num = MyMin((unsigned)1 << kTimeBlockBits, Defs.Size() - start);
+  UInt64 minVal = 0;
+  UInt64 maxVal = 0;
+  bool wasDefined = false;
+  unsigned i;
+  for (i = 0; i < num; i++)
+    if (Defs[start + i])
+    {
+      UInt64 v = _blockVals[i];
+      if (!wasDefined || minVal > v) minVal = v;
+      if (!wasDefined || maxVal < v) maxVal = v;
+      wasDefined = true;
+    }
+  unsigned numBytes = 0;
+  for (UInt64 range = maxVal - minVal; range != 0; range >>= 8)
+    numBytes++;
+  _bases.Add(minVal);
+  _offsets.Add(_deltas.Size());
+  _numBytes.Add((Byte)numBytes);
+  if (numBytes != 0)
+  {
+    for (i = 0; i < num; i++)
+    {
+      UInt64 delta = Defs[start + i] ? _blockVals[i] - minVal : 0;
+      for (unsigned k = 0; k < numBytes; k++, delta >>= 8)
+        _deltas.Add((Byte)delta);
+    }
+    if (_deltas.Size() > ((UInt32)1 << 31))
+      ThrowUnsupported();
+  }
+  _curBlock++;
+}
+
+void CTimeVector::AddItem(unsigned index, UInt64 value)
+{
+  while ((unsigned)_curBlock != (index >> kTimeBlockBits))
+    FlushBlock();
+  _blockVals[index & ((1 << kTimeBlockBits) - 1)] = value;
+}
+
+void CTimeVector::FinishAdding()
+{
+  unsigned numBlocks = GetNumTimeBlocks(Defs.Size());
+  while ((unsigned)_curBlock < numBlocks)
+    FlushBlock();
+  // GetItem() reads 8 bytes for each delta
+  for (unsigned i = 0; i < 8; i++)
+    _deltas.Add(0);
+  _deltas.ReserveDown();
+}
+
+void CInArchive::ReadTimeVector(const CObjectVector<CByteBuffer> &dataVector,
+    CTimeVector &v, unsigned numItems)
+{
+  ReadBitVector2(numItems, v.Defs);
+
+  CStreamSwitch streamSwitch;
+  streamSwitch.Set(this, &dataVector);
+
+  v.StartAdding();
+  for (unsigned i = 0; i < numItems; i++)
+    if (v.Defs[i])
+      v.AddItem(i, ReadUInt64());
+  v.FinishAdding();
+}
+
 void CInArchive::ReadUInt64DefVector(const CObjectVector<CByteBuffer> &dataVector,
     CUInt64DefVector &v, unsigned numItems)
 {
@@ -1211,10 +1314,10 @@ HRESULT CInArchive::ReadHeader(
   if (numFiles > 0  && !digests.Defs.IsEmpty())
     db.ArcInfo.FileInfoPopIDs.Add(NID::kCRC);
 
-  CBoolVector emptyStreamVector;
-  BoolVector_Fill_False(emptyStreamVector, (unsigned)numFiles);
-  CBoolVector emptyFileVector;
-  CBoolVector antiFileVector;
+  CBitVector emptyStreamVector;
+  emptyStreamVector.ClearAndSetSize((unsigned)numFiles);
+  CBitVector emptyFileVector;
+  CBitVector antiFileVector;
   CNum numEmptyStreams = 0;
 
   for (;;)
@@ -1238,6 +1341,9 @@ HRESULT CInArchive::ReadHeader(
         CStreamSwitch streamSwitch;
         streamSwitch.Set(this, &dataVector);
         size_t rem = _inByteBack->GetRem();
+        // NameOffsets are 32-bit
+        if (rem / 2 > (UInt32)0xFFFFFFFF)
+          ThrowUnsupported();
         db.NamesBuf.Alloc(rem);
         ReadBytes(db.NamesBuf, rem);
         db.NameOffsets.Alloc(db.Files.Size() + 1);
@@ -1251,27 +1357,24 @@ HRESULT CInArchive::ReadHeader(
           for (j = 0; j < curRem && buf[j] != 0; j++);
           if (j == curRem)
             ThrowEndOfData();
-          db.NameOffsets[i] = pos / 2;
+          db.NameOffsets[i] = (UInt32)(pos / 2);
           pos += j * 2 + 2;
         }
-        db.NameOffsets[i] = pos / 2;
+        db.NameOffsets[i] = (UInt32)(pos / 2);
         if (pos != rem)
           ThereIsHeaderError = true;
         break;
       }
       case NID::kWinAttrib:
       {
-        CBoolVector boolVector;
-        ReadBoolVector2(db.Files.Size(), boolVector);
+        CFileItems &files = db.Files;
+        ReadBitVector2(files.Size(), files.AttribDefs);
         CStreamSwitch streamSwitch;
         streamSwitch.Set(this, &dataVector);
+        files.Attribs.Alloc(numFiles);
         for (i = 0; i < numFiles; i++)
-        {
-          CFileItem &file = db.Files[i];
-          file.AttribDefined = boolVector[i];
-          if (file.AttribDefined)
-            file.Attrib = ReadUInt32();
-        }
+          if (files.AttribDefs[i])
+            files.Attribs[i] = ReadUInt32();
         break;
       }
       /*
@@ -1306,23 +1409,23 @@ HRESULT CInArchive::ReadHeader(
       */
       case NID::kEmptyStream:
       {
-        ReadBoolVector(numFiles, emptyStreamVector);
+        ReadBitVector(numFiles, emptyStreamVector);
         numEmptyStreams = 0;
         for (i = 0; i < (CNum)emptyStreamVector.Size(); i++)
           if (emptyStreamVector[i])
             numEmptyStreams++;
 
-        BoolVector_Fill_False(emptyFileVector, numEmptyStreams);
-        BoolVector_Fill_False(antiFileVector, numEmptyStreams);
+        emptyFileVector.ClearAndSetSize(numEmptyStreams);
+        antiFileVector.ClearAndSetSize(numEmptyStreams);
 
         break;
       }
-      case NID::kEmptyFile:  ReadBoolVector(numEmptyStreams, emptyFileVector); break;
-      case NID::kAnti:  ReadBoolVector(numEmptyStreams, antiFileVector); break;
+      case NID::kEmptyFile:  ReadBitVector(numEmptyStreams, emptyFileVector); break;
+      case NID::kAnti:  ReadBitVector(numEmptyStreams, antiFileVector); break;
       case NID::kStartPos:  ReadUInt64DefVector(dataVector, db.StartPos, (unsigned)numFiles); break;
-      case NID::kCTime:  ReadUInt64DefVector(dataVector, db.CTime, (unsigned)numFiles); break;
-      case NID::kATime:  ReadUInt64DefVector(dataVector, db.ATime, (unsigned)numFiles); break;
-      case NID::kMTime:  ReadUInt64DefVector(dataVector, db.MTime, (unsigned)numFiles); break;
+      case NID::kCTime:  ReadTimeVector(dataVector, db.CTime, (unsigned)numFiles); break;
+      case NID::kATime:  ReadTimeVector(dataVector, db.ATime, (unsigned)numFiles); break;
+      case NID::kMTime:  ReadTimeVector(dataVector, db.MTime, (unsigned)numFiles); break;
       case NID::kDummy:
       {
         for (UInt64 j = 0; j < size; j++)
@@ -1404,32 +1507,44 @@ HRESULT CInArchive::ReadHeader(
     if (antiFileVector[i])
       numAntiItems++;
 
+  CFileItems &files = db.Files;
+  {
+    UInt64 maxSize = 0;
+    FOR_VECTOR (k, unpackSizes)
+      if (maxSize < unpackSizes[k])
+        maxSize = unpackSizes[k];
+    files.Sizes.Alloc(numFiles, maxSize);
+  }
+  if (!digests.Defs.IsEmpty())
+  {
+    files.CrcDefs.ClearAndSetSize(numFiles);
+    files.Crcs.Alloc(numFiles);
+  }
+  if (numAntiItems != 0)
+    db.IsAnti.ClearAndSetSize(numFiles);
+
   for (i = 0; i < numFiles; i++)
   {
-    CFileItem &file = db.Files[i];
-    bool isAnti;
-    file.HasStream = !emptyStreamVector[i];
-    file.Crc = 0;
-    if (file.HasStream)
+    if (!emptyStreamVector[i])
     {
-      file.IsDir = false;
-      isAnti = false;
-      file.Size = unpackSizes[sizeIndex];
-      file.CrcDefined = digests.ValidAndDefined(sizeIndex);
-      if (file.CrcDefined)
-        file.Crc = digests.Vals[sizeIndex];
+      files.HasStreams.Set(i);
+      files.Sizes.Set(i, unpackSizes[sizeIndex]);
+      if (digests.ValidAndDefined(sizeIndex))
+      {
+        files.CrcDefs.Set(i);
+        files.Crcs[i] = digests.Vals[sizeIndex];
+      }
       sizeIndex++;
     }
     else
     {
-      file.IsDir = !emptyFileVector[emptyFileIndex];
-      isAnti = antiFileVector[emptyFileIndex];
+      if (!emptyFileVector[emptyFileIndex])
+        files.IsDirs.Set(i);
+      if (antiFileVector[emptyFileIndex])
+        db.IsAnti.Set(i);
       emptyFileIndex++;
-      file.Size = 0;
-      file.CrcDefined = false;
+      files.Sizes.Set(i, 0);
     }
-    if (numAntiItems != 0)
-      db.IsAnti.Add(isAnti);
   }
   }
   db.FillLinks();
@@ -1453,7 +1568,7 @@ void CDbEx::FillLinks()
   unsigned i;
   for (i = 0; i < Files.Size(); i++)
   {
-    bool emptyStream = !Files[i].HasStream;
+    bool emptyStream = !Files.HasStream(i);
     if (indexInFolder == 0)
     {
       if (emptyStream)
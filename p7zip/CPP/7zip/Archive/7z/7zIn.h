@@ -95,15 +95,139 @@ struct CFolders
   }
 };
 
+/* CTimeVector stores FILETIME values of items (CTime, ATime or MTime).
+   Items are grouped to blocks of (1 << kTimeBlockBits) items. Each block stores
+   the minimal defined value in block, and the deltas from that value for all
+   items of block. All deltas in block use same number of bytes, so any item
+   can be read without decoding of other items. */
+
+const unsigned kTimeBlockBits = 4;
+
+class CTimeVector
+{
+  CRecordVector<UInt64> _bases;
+  CRecordVector<UInt32> _offsets;
+  CRecordVector<Byte> _numBytes;
+  CRecordVector<Byte> _deltas;
+  UInt64 _blockVals[1 << kTimeBlockBits];
+  int _curBlock;
+
+  void FlushBlock();
+public:
+  CBitVector Defs;
+
+  void Clear()
+  {
+    Defs.Clear();
+    _bases.Clear();
+    _offsets.Clear();
+    _numBytes.Clear();
+    _deltas.Clear();
+  }
+
+  // Defs must be set before these calls. AddItem() is called in increasing order of indexes.
+  void StartAdding();
+  void AddItem(unsigned index, UInt64 value);
+  void FinishAdding();
+
+  bool GetItem(unsigned index, UInt64 &value) const
+  {
+    value = 0;
+    if (!Defs.ValidAndDefined(index))
+      return false;
+    unsigned block = index >> kTimeBlockBits;
+    unsigned numBytes = _numBytes[block];
+    value = _bases[block];
+    if (numBytes != 0)
+    {
+      const Byte *p = &_deltas[_offsets[block]] + (index & ((1 << kTimeBlockBits) - 1)) * numBytes;
+      UInt64 mask = (numBytes == 8) ? (UInt64)(Int64)-1 : (((UInt64)1 << (numBytes * 8)) - 1);
+      value += GetUi64(p) & mask;
+    }
+    return true;
+  }
+};
+
+/* Items of CDatabase are stored by columns.
+   Attribs and Crcs are allocated only if archive contains them. */
+
+class CFileItems
+{
+  unsigned _size;
+public:
+  CPackedNumVector Sizes;
+  CBitVector HasStreams;
+  CBitVector IsDirs;
+  CBitVector AttribDefs;
+  CObjArray<UInt32> Attribs;
+  CBitVector CrcDefs;
+  CObjArray<UInt32> Crcs;
+
+  CFileItems(): _size(0) {}
+
+  unsigned Size() const { return _size; }
+
+  void Clear()
+  {
+    _size = 0;
+    Sizes.Clear();
+    HasStreams.Clear();
+    IsDirs.Clear();
+    AttribDefs.Clear();
+    Attribs.Free();
+    CrcDefs.Clear();
+    Crcs.Free();
+  }
+
+  void ClearAndSetSize(unsigned size)
+  {
+    Clear();
+    _size = size;
+    HasStreams.ClearAndSetSize(size);
+    IsDirs.ClearAndSetSize(size);
+  }
+
+  UInt64 GetSize(unsigned index) const { return Sizes[index]; }
+  bool HasStream(unsigned index) const { return HasStreams[index]; }
+  bool IsDir(unsigned index) const { return IsDirs[index]; }
+
+  bool GetAttrib(unsigned index, UInt32 &attrib) const
+  {
+    attrib = 0;
+    if (!AttribDefs.ValidAndDefined(index))
+      return false;
+    attrib = Attribs[index];
+    return true;
+  }
+
+  bool GetCrc(unsigned index, UInt32 &crc) const
+  {
+    crc = 0;
+    if (!CrcDefs.ValidAndDefined(index))
+      return false;
+    crc = Crcs[index];
+    return true;
+  }
+
+  void GetItem(unsigned index, CFileItem &file) const
+  {
+    file.Size = Sizes[index];
+    file.HasStream = HasStreams[index];
+    file.IsDir = IsDirs[index];
+    file.AttribDefined = GetAttrib(index, file.Attrib);
+    file.CrcDefined = GetCrc(index, file.Crc);
+  }
+};
+
 struct CDatabase: public CFolders
 {
-  CRecordVector<CFileItem> Files;
+  CFileItems Files;
 
-  CUInt64DefVector CTime;
-  CUInt64DefVector ATime;
-  CUInt64DefVector MTime;
+  CTimeVector CTime;
+  CTimeVector ATime;
+  CTimeVector MTime;
   CUInt64DefVector StartPos;
-  CRecordVector<bool> IsAnti;
+  CBitVector IsAnti;
   /*
   CRecordVector<bool> IsAux;
   CByteBuffer SecureBuf;
@@ -111,7 +235,7 @@ struct CDatabase: public CFolders
   */
 
   CByteBuffer NamesBuf;
-  CObjArray<size_t> NameOffsets; // numFiles + 1, offsets of utf-16 symbols
+  CObjArray<UInt32> NameOffsets; // numFiles + 1, offsets of utf-16 symbols
 
   /*
   void ClearSecure()
@@ -145,7 +269,7 @@ struct CDatabase: public CFolders
         return true;
     return false;
   }
-  bool IsItemAnti(unsigned index) const { return (index < IsAnti.Size() && IsAnti[index]); }
+  bool IsItemAnti(unsigned index) const { return IsAnti.ValidAndDefined(index); }
   // bool IsItemAux(unsigned index) const { return (index < IsAux.Size() && IsAux[index]); }
 
   const void * GetName(unsigned index) const
@@ -377,8 +501,12 @@ private:
 
   void ReadBoolVector(unsigned numItems, CBoolVector &v);
   void ReadBoolVector2(unsigned numItems, CBoolVector &v);
+  void ReadBitVector(unsigned numItems, CBitVector &v);
+  void ReadBitVector2(unsigned numItems, CBitVector &v);
   void ReadUInt64DefVector(const CObjectVector<CByteBuffer> &dataVector,
       CUInt64DefVector &v, unsigned numItems);
+  void ReadTimeVector(const CObjectVector<CByteBuffer> &dataVector,
+      CTimeVector &v, unsigned numItems);
   HRESULT ReadAndDecodePackedStreams(
       DECL_EXTERNAL_CODECS_LOC_VARS
       UInt64 baseOffset, UInt64 &dataOffset,
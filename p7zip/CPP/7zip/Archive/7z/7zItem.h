@@ -3,6 +3,8 @@
 #ifndef __7Z_ITEM_H
 #define __7Z_ITEM_H
 
+#include "../../../../C/CpuArch.h"
+
 #include "../../../Common/MyBuffer.h"
 #include "../../../Common/MyString.h"
 
@@ -149,6 +151,81 @@ struct CUInt64DefVector
   bool CheckSize(unsigned size) const { return Defs.Size() == size || Defs.Size() == 0; }
 };
 
+/* CBitVector stores one bit per item, in same bit order as 7z headers:
+   the high bit of first byte is item 0. */
+
+class CBitVector
+{
+  CByteBuffer _bits;
+  unsigned _size;
+public:
+  CBitVector(): _size(0) {}
+
+  unsigned Size() const { return _size; }
+  bool IsEmpty() const { return _size == 0; }
+  Byte *GetBuf() { return _bits; }
+
+  void Clear()
+  {
+    _bits.Free();
+    _size = 0;
+  }
+
+  // all bits are cleared
+  void ClearAndSetSize(unsigned size)
+  {
+    size_t numBytes = ((size_t)size + 7) >> 3;
+    _bits.Alloc(numBytes);
+    if (numBytes != 0)
+      memset(_bits, 0, numBytes);
+    _size = size;
+  }
+
+  bool operator[](unsigned index) const { return (_bits[index >> 3] & (0x80 >> (index & 7))) != 0; }
+  void Set(unsigned index) { _bits[index >> 3] |= (Byte)(0x80 >> (index & 7)); }
+  bool ValidAndDefined(unsigned index) const { return index < _size && (*this)[index]; }
+};
+
+/* CPackedNumVector stores each number with the same number of bytes,
+   that is enough for the biggest number in vector. */
+
+class CPackedNumVector
+{
+  CByteBuffer _buf;
+  unsigned _numBytes;
+  UInt64 _mask;
+public:
+  CPackedNumVector(): _numBytes(0), _mask(0) {}
+
+  void Clear()
+  {
+    _buf.Free();
+    _numBytes = 0;
+    _mask = 0;
+  }
+
+  void Alloc(unsigned size, UInt64 maxValue)
+  {
+    _numBytes = 0;
+    for (; maxValue != 0; maxValue >>= 8)
+      _numBytes++;
+    _mask = (_numBytes == 8) ? (UInt64)(Int64)-1 : (((UInt64)1 << (_numBytes * 8)) - 1);
+    // we read 8 bytes for each item, so we need 8 bytes of padding after last item
+    size_t bufSize = (size_t)size * _numBytes + 8;
+    _buf.Alloc(bufSize);
+    memset(_buf + bufSize - 8, 0, 8);
+  }
+
+  void Set(unsigned index, UInt64 value)
+  {
+    Byte *p = _buf + (size_t)index * _numBytes;
+    for (unsigned i = 0; i < _numBytes; i++, value >>= 8)
+      p[i] = (Byte)value;
+  }
+
+  UInt64 operator[](unsigned index) const { return GetUi64(_buf + (size_t)index * _numBytes) & _mask; }
+};
+
 struct CFileItem
 {
   UInt64 Size;
@@ -10,6 +10,11 @@
 #include "../../Common/LimitedStreams.h"
 #include "../../Common/ProgressUtils.h"
 
+#ifndef _7ZIP_ST
+#include "../../Common/InOutTempBuffer.h"
+#include "../../Common/ProgressMt.h"
+#endif
+
 #include "../../Compress/CopyCoder.h"
 
 #include "../Common/ItemNameUtils.h"
@@ -597,7 +602,7 @@ void CFolderOutStream2::OpenFile()
   _crcStreamSpec->SetStream((*_extractStatuses)[_currentIndex] ? (ISequentialOutStream *)_outStream : NULL); // FIXED for gcc 2.95
   _crcStreamSpec->Init(true);
   _fileIsOpen = true;
-  _rem = _db->Files[_startIndex + _currentIndex].Size;
+  _rem = _db->Files.GetSize(_startIndex + _currentIndex);
 }
 
 void CFolderOutStream2::CloseFile()
@@ -609,14 +614,17 @@ void CFolderOutStream2::CloseFile()
 
 HRESULT CFolderOutStream2::CloseFileAndSetResult()
 {
-  const CFileItem &file = _db->Files[_startIndex + _currentIndex];
+  unsigned index = _startIndex + _currentIndex;
+  UInt32 crc;
+  bool crcDefined = _db->Files.GetCrc(index, crc);
+  bool isDir = _db->Files.IsDir(index);
   CloseFile();
-  return (file.IsDir || !file.CrcDefined || file.Crc == _crcStreamSpec->GetCRC()) ? S_OK: S_FALSE;
+  return (isDir || !crcDefined || crc == _crcStreamSpec->GetCRC()) ? S_OK: S_FALSE;
 }
 
 HRESULT CFolderOutStream2::ProcessEmptyFiles()
 {
-  while (_currentIndex < _extractStatuses->Size() && _db->Files[_startIndex + _currentIndex].Size == 0)
+  while (_currentIndex < _extractStatuses->Size() && _db->Files.GetSize(_startIndex + _currentIndex) == 0)
   {
     OpenFile();
     RINOK(CloseFileAndSetResult());
@@ -772,7 +780,7 @@ static int GetGroupIndex(bool encrypted, int bcjFiltered)
 
 static void GetFile(const CDatabase &inDb, int index, CFileItem &file, CFileItem2 &file2)
 {
-  file = inDb.Files[index];
+  inDb.Files.GetItem(index, file);
   file2.CTimeDefined = inDb.CTime.GetItem(index, file2.CTime);
   file2.ATimeDefined = inDb.ATime.GetItem(index, file2.ATime);
   file2.MTimeDefined = inDb.MTime.GetItem(index, file2.MTime);
@@ -781,6 +789,333 @@ static void GetFile(const CDatabase &inDb, int index, CFileItem &file, CFileItem
   // file2.IsAux = inDb.IsItemAux(index);
 }
 
+/* Dedup mode:
+   7z format can't share the packed data of one file with another file.
+   So we place the files of same size next to each other: such files usually are
+   copies of one file, and LZ coder finds each copy as one long match.
+   The files are not read before compression, so IArchiveUpdateCallback is called
+   once for each file. The copies with same name and time are already neighbours
+   after sorting by type, so dedup mode helps for the renamed copies.
+   The false match can't damage the archive: it changes only the order of files. */
+
+static const UInt64 kDedupSizeMin = (1 << 12);
+
+static int CompareItemSizes(const UInt32 *p1, const UInt32 *p2, void *param)
+{
+  const CObjectVector<CUpdateItem> &updateItems = *(const CObjectVector<CUpdateItem> *)param;
+  RINOZ_COMP(updateItems[*p1].Size, updateItems[*p2].Size);
+  return MyCompare(*p1, *p2);
+}
+
+// it returns same content ID for the files of same size
+
+static void GetContentIds(const CObjectVector<CUpdateItem> &updateItems,
+    CIntArr &contentIds, unsigned &numIds)
+{
+  unsigned numItems = updateItems.Size();
+  contentIds.Alloc(numItems);
+  CUIntVector sizeSorted;
+  unsigned i;
+  for (i = 0; i < numItems; i++)
+  {
+    contentIds[i] = -1;
+    const CUpdateItem &ui = updateItems[i];
+    if (ui.NewData && ui.HasStream() && ui.Size >= kDedupSizeMin)
+      sizeSorted.Add(i);
+  }
+  sizeSorted.Sort(CompareItemSizes, (void *)&updateItems);
+  numIds = 0;
+  for (i = 0; i < sizeSorted.Size(); i++)
+  {
+    UInt32 index = sizeSorted[i];
+    if (i == 0 || updateItems[sizeSorted[i - 1]].Size != updateItems[index].Size)
+      numIds++;
+    contentIds[index] = numIds - 1;
+  }
+}
+
+// it moves the duplicates of each file to the positions after that file
+
+static void MoveDuplicates(const int *contentIds, unsigned numIds,
+    UInt32 *indices, unsigned numFiles)
+{
+  CIntArr next(numFiles);
+  CIntArr lastPos(numIds);
+  CBoolArr moved(numFiles);
+  unsigned i;
+  for (i = 0; i < numIds; i++)
+    lastPos[i] = -1;
+  for (i = 0; i < numFiles; i++)
+  {
+    next[i] = -1;
+    moved[i] = false;
+    int id = contentIds[indices[i]];
+    if (id < 0)
+      continue;
+    if (lastPos[id] >= 0)
+      next[lastPos[id]] = i;
+    lastPos[id] = i;
+  }
+
+  CObjArray<UInt32> dest(numFiles);
+  unsigned destPos = 0;
+  for (i = 0; i < numFiles; i++)
+  {
+    if (moved[i])
+      continue;
+    dest[destPos++] = indices[i];
+    for (int k = next[i]; k >= 0; k = next[k])
+    {
+      moved[k] = true;
+      dest[destPos++] = indices[k];
+    }
+  }
+  for (i = 0; i < numFiles; i++)
+    indices[i] = dest[i];
+}
+
+// it adds the files of new solid block that was compressed from (inStream)
+
+static HRESULT AddFolderFiles(const CDbEx *db, const CObjectVector<CUpdateItem> &updateItems,
+    const UInt32 *indices, unsigned numSubFiles, const CFolderInStream &inStream,
+    CArchiveDatabaseOut &newDatabase)
+{
+  CNum numUnpackStreams = 0;
+  for (unsigned subIndex = 0; subIndex < numSubFiles; subIndex++)
+  {
+    const CUpdateItem &ui = updateItems[indices[subIndex]];
+    CFileItem file;
+    CFileItem2 file2;
+    UString name;
+    if (ui.NewProps)
+    {
+      FromUpdateItemToFileItem(ui, file, file2);
+      name = ui.Name;
+    }
+    else
+    {
+      GetFile(*db, ui.IndexInArchive, file, file2);
+      db->GetPath(ui.IndexInArchive, name);
+    }
+    if (file2.IsAnti || file.IsDir)
+      return E_FAIL;
+
+    /*
+    CFileItem &file = newDatabase.Files[
+          startFileIndexInDatabase + i + subIndex];
+    */
+    if (!inStream.Processed[subIndex])
+    {
+      continue;
+      // file.Name += L".locked";
+    }
+
+    file.Crc = inStream.CRCs[subIndex];
+    file.Size = inStream.Sizes[subIndex];
+    if (file.Size != 0)
+    {
+      file.CrcDefined = true;
+      file.HasStream = true;
+      numUnpackStreams++;
+    }
+    else
+    {
+      file.CrcDefined = false;
+      file.HasStream = false;
+    }
+    /*
+    file.Parent = ui.ParentFolderIndex;
+    if (ui.TreeFolderIndex >= 0)
+      treeFolderToArcIndex[ui.TreeFolderIndex] = newDatabase.Files.Size();
+    if (totalSecureDataSize != 0)
+      newDatabase.SecureIDs.Add(ui.SecureIndex);
+    */
+    newDatabase.AddFile(file, file2, name);
+  }
+  // numUnpackStreams = 0 is very bad case for locked files
+  // v3.13 doesn't understand it.
+  newDatabase.NumUnpackStreamsVector.Add(numUnpackStreams);
+  return S_OK;
+}
+
+#ifndef _7ZIP_ST
+
+/* The solid blocks of new files can be compressed concurrently.
+   Each CThreadEncoder compresses one block to its temp buffer, and
+   the blocks are written to archive in same order as in single-thread mode.
+   CMtUpdateCallback serializes the calls of (updateCallback) from threads. */
+
+class CMtUpdateCallback:
+  public IArchiveUpdateCallback,
+  public CMyUnknownImp
+{
+  CMyComPtr<IArchiveUpdateCallback> _callback;
+  NWindows::NSynchronization::CCriticalSection *_cs;
+public:
+  void Init(IArchiveUpdateCallback *callback, NWindows::NSynchronization::CCriticalSection *cs)
+  {
+    _callback = callback;
+    _cs = cs;
+  }
+
+  MY_UNKNOWN_IMP
+  INTERFACE_IArchiveUpdateCallback(;)
+};
+
+#define MT_CALLBACK_LOCK NWindows::NSynchronization::CCriticalSectionLock lock(*_cs);
+
+STDMETHODIMP CMtUpdateCallback::SetTotal(UInt64 total)
+  { MT_CALLBACK_LOCK return _callback->SetTotal(total); }
+STDMETHODIMP CMtUpdateCallback::SetCompleted(const UInt64 *completeValue)
+  { MT_CALLBACK_LOCK return _callback->SetCompleted(completeValue); }
+STDMETHODIMP CMtUpdateCallback::GetUpdateItemInfo(UInt32 index, Int32 *newData, Int32 *newProps, UInt32 *indexInArchive)
+  { MT_CALLBACK_LOCK return _callback->GetUpdateItemInfo(index, newData, newProps, indexInArchive); }
+STDMETHODIMP CMtUpdateCallback::GetProperty(UInt32 index, PROPID propID, PROPVARIANT *value)
+  { MT_CALLBACK_LOCK return _callback->GetProperty(index, propID, value); }
+STDMETHODIMP CMtUpdateCallback::GetStream(UInt32 index, ISequentialInStream **inStream)
+  { MT_CALLBACK_LOCK return _callback->GetStream(index, inStream); }
+STDMETHODIMP CMtUpdateCallback::SetOperationResult(Int32 operationResult)
+  { MT_CALLBACK_LOCK return _callback->SetOperationResult(operationResult); }
+
+class CThreadEncoder: public CVirtThread
+{
+public:
+  HRESULT Result;
+
+  DECL_EXTERNAL_CODECS_LOC_VARS2;
+  CEncoder *Encoder;
+  int EncoderGroup;
+  const UInt64 *InSizeForReduce;
+
+  CRecordVector<UInt32> Indices;
+  CFolderInStream *InStreamSpec;
+  CMyComPtr<ISequentialInStream> InStream;
+
+  CInOutTempBuffer OutBuf;
+  CSequentialOutTempBufferImp *OutStreamSpec;
+  CMyComPtr<ISequentialOutStream> OutStream;
+
+  CMtCompressProgress *ProgressSpec;
+  CMyComPtr<ICompressProgressInfo> Progress;
+
+  CFolder *Folder;
+  CRecordVector<UInt64> CoderUnpackSizes;
+  CRecordVector<UInt64> PackSizes;
+  UInt64 UnpackSize;
+
+  CThreadEncoder():
+    Result(E_FAIL),
+    Encoder(NULL),
+    EncoderGroup(-1),
+    InSizeForReduce(NULL),
+    Folder(NULL)
+  {
+    OutBuf.Create();
+    OutStreamSpec = new CSequentialOutTempBufferImp;
+    OutStream = OutStreamSpec;
+    OutStreamSpec->Init(&OutBuf);
+    ProgressSpec = new CMtCompressProgress;
+    Progress = ProgressSpec;
+  }
+  ~CThreadEncoder()
+  {
+    CVirtThread::WaitThreadFinish();
+    delete Encoder;
+  }
+  virtual void Execute();
+};
+
+void CThreadEncoder::Execute()
+{
+  try
+  {
+    CoderUnpackSizes.Clear();
+    PackSizes.Clear();
+    OutBuf.InitWriting();
+    Result = Encoder->Encode(
+        EXTERNAL_CODECS_LOC_VARS
+        InStream, NULL, InSizeForReduce,
+        *Folder, CoderUnpackSizes, UnpackSize,
+        OutStream, PackSizes, Progress);
+  }
+  catch(...)
+  {
+    Result = E_FAIL;
+  }
+  if (Result == S_OK)
+  {
+    UInt64 packSize = 0;
+    FOR_VECTOR (i, PackSizes)
+      packSize += PackSizes[i];
+    Result = Progress->SetRatioInfo(&UnpackSize, &packSize);
+  }
+}
+
+class CMtBlockEncoder
+{
+public:
+  CMtCompressProgressMixer ProgressMixer;
+  CMyComPtr<IArchiveUpdateCallback> UpdateCallback;
+  CObjectVector<CThreadEncoder> Threads;
+  unsigned NumQueued;
+  unsigned Head;
+  UInt64 InSize;
+  UInt64 OutSize;
+
+  CMtBlockEncoder(): NumQueued(0), Head(0), InSize(0), OutSize(0) {}
+  bool IsFull() const { return NumQueued == Threads.Size(); }
+  CThreadEncoder &GetFreeThread() { return Threads[(Head + NumQueued) % Threads.Size()]; }
+
+  HRESULT WriteBlock(ISequentialOutStream *outStream, const CDbEx *db,
+      const CObjectVector<CUpdateItem> &updateItems, CArchiveDatabaseOut &newDatabase);
+  HRESULT Flush(ISequentialOutStream *outStream, const CDbEx *db,
+      const CObjectVector<CUpdateItem> &updateItems, CArchiveDatabaseOut &newDatabase,
+      CLocalProgress *lps);
+};
+
+// it waits the oldest block and writes it
+
+HRESULT CMtBlockEncoder::WriteBlock(ISequentialOutStream *outStream, const CDbEx *db,
+    const CObjectVector<CUpdateItem> &updateItems, CArchiveDatabaseOut &newDatabase)
+{
+  CThreadEncoder &t = Threads[Head];
+  t.WaitExecuteFinish();
+  Head = (Head + 1) % Threads.Size();
+  NumQueued--;
+  RINOK(t.Result);
+  RINOK(t.OutBuf.WriteToStream(outStream));
+  FOR_VECTOR (i, t.PackSizes)
+  {
+    newDatabase.PackSizes.Add(t.PackSizes[i]);
+    OutSize += t.PackSizes[i];
+  }
+  newDatabase.CoderUnpackSizes += t.CoderUnpackSizes;
+  InSize += t.UnpackSize;
+  RINOK(AddFolderFiles(db, updateItems, &t.Indices[0], t.Indices.Size(), *t.InStreamSpec, newDatabase));
+  t.InStream.Release();
+  return S_OK;
+}
+
+// it writes all blocks and moves the sizes of written blocks to (lps)
+
+HRESULT CMtBlockEncoder::Flush(ISequentialOutStream *outStream, const CDbEx *db,
+    const CObjectVector<CUpdateItem> &updateItems, CArchiveDatabaseOut &newDatabase,
+    CLocalProgress *lps)
+{
+  while (NumQueued != 0)
+  {
+    RINOK(WriteBlock(outStream, db, updateItems, newDatabase));
+  }
+  lps->InSize += InSize;
+  lps->OutSize += OutSize;
+  InSize = 0;
+  OutSize = 0;
+  ProgressMixer.Init(Threads.Size(), lps);
+  return S_OK;
+}
+
+#endif
+
 HRESULT Update(
     DECL_EXTERNAL_CODECS_LOC_VARS
     IInStream *inStream,
@@ -844,15 +1179,14 @@ HRESULT Update(
       UInt64 repackSize = 0;
       for (CNum fi = db->FolderStartFileIndex[i]; indexInFolder < numUnpackStreams; fi++)
       {
-        const CFileItem &file = db->Files[fi];
-        if (file.HasStream)
+        if (db->Files.HasStream(fi))
         {
           indexInFolder++;
           int updateIndex = fileIndexToUpdateIndexMap[fi];
           if (updateIndex >= 0 && !updateItems[updateIndex].NewData)
           {
             numCopyItems++;
-            repackSize += file.Size;
+            repackSize += db->Files.GetSize(fi);
           }
         }
       }
@@ -949,6 +1283,50 @@ HRESULT Update(
     }
   }
 
+  CIntArr contentIds;
+  unsigned numContentIds = 0;
+  if (options.Dedup)
+    GetContentIds(updateItems, contentIds, numContentIds);
+
+  #ifndef _7ZIP_ST
+
+  UInt64 numBlockThreads = options.NumBlockThreads;
+  if (numBlockThreads > 1 && options.BlockMemUsage != 0)
+  {
+    UInt64 numBlockThreadsMax = options.MemUsageLimit / options.BlockMemUsage;
+    if (numBlockThreads > numBlockThreadsMax)
+      numBlockThreads = numBlockThreadsMax;
+  }
+  {
+    UInt64 numNewFiles = 0;
+    for (i = 0; i < kNumGroupsMax; i++)
+      numNewFiles += groups[i].Indices.Size();
+    if (numBlockThreads > numNewFiles)
+      numBlockThreads = numNewFiles;
+  }
+
+  bool mtMode = (numBlockThreads > 1);
+  CMtBlockEncoder mt;
+  if (mtMode)
+  {
+    mt.ProgressMixer.Init((int)numBlockThreads, progress);
+    CMtUpdateCallback *mtCallbackSpec = new CMtUpdateCallback;
+    mt.UpdateCallback = mtCallbackSpec;
+    mtCallbackSpec->Init(updateCallback, &mt.ProgressMixer.CriticalSection);
+    for (i = 0; i < numBlockThreads; i++)
+    {
+      CThreadEncoder &t = mt.Threads.AddNew();
+      #ifdef EXTERNAL_CODECS
+      t.__externalCodecs = __externalCodecs;
+      #endif
+      t.InSizeForReduce = &inSizeForReduce;
+      t.ProgressSpec->Init(&mt.ProgressMixer, i);
+      RINOK(t.Create());
+    }
+  }
+
+  #endif
+
   #ifndef _NO_CRYPTO
 
   CCryptoGetTextPassword *getPasswordSpec = NULL;
@@ -1034,7 +1412,7 @@ HRESULT Update(
         if (ui.HasStream())
           continue;
       }
-      else if (ui.IndexInArchive != -1 && db->Files[ui.IndexInArchive].HasStream)
+      else if (ui.IndexInArchive != -1 && db->Files.HasStream(ui.IndexInArchive))
         continue;
       /*
       if (ui.TreeFolderIndex >= 0)
@@ -1098,6 +1476,13 @@ HRESULT Update(
 
     CEncoder encoder(method);
 
+    #ifndef _7ZIP_ST
+    if (mtMode && folderRefIndex < folderRefs.Size() && folderRefs[folderRefIndex].Group == groupIndex)
+    {
+      RINOK(mt.Flush(archive.SeqStream, db, updateItems, newDatabase, lps));
+    }
+    #endif
+
     for (; folderRefIndex < folderRefs.Size(); folderRefIndex++)
     {
       const CFolderRepack &rep = folderRefs[folderRefIndex];
@@ -1137,7 +1522,7 @@ HRESULT Update(
         for (CNum fi = db->FolderStartFileIndex[folderIndex]; indexInFolder < numUnpackStreams; fi++)
         {
           bool needExtract = false;
-          if (db->Files[fi].HasStream)
+          if (db->Files.HasStream(fi))
           {
             indexInFolder++;
             int updateIndex = fileIndexToUpdateIndexMap[fi];
@@ -1258,16 +1643,20 @@ HRESULT Update(
       */
     }
 
+    if (options.Dedup)
+      MoveDuplicates(contentIds, numContentIds, indices, numFiles);
+
     for (i = 0; i < numFiles;)
     {
       UInt64 totalSize = 0;
       int numSubFiles;
       UString prevExtension;
-      for (numSubFiles = 0; i + numSubFiles < numFiles &&
-          numSubFiles < numSolidFiles; numSubFiles++)
+      for (numSubFiles = 0; i + numSubFiles < numFiles; numSubFiles++)
       {
         const CUpdateItem &ui = updateItems[indices[i + numSubFiles]];
         totalSize += ui.Size;
+        if (numSubFiles >= numSolidFiles)
+          break;
         if (totalSize > options.NumSolidBytes)
           break;
         if (options.SolidExtension)
@@ -1283,6 +1672,36 @@ HRESULT Update(
       if (numSubFiles < 1)
         numSubFiles = 1;
 
+      #ifndef _7ZIP_ST
+      if (mtMode)
+      {
+        if (mt.IsFull())
+        {
+          RINOK(mt.WriteBlock(archive.SeqStream, db, updateItems, newDatabase));
+        }
+        CThreadEncoder &t = mt.GetFreeThread();
+        if (t.EncoderGroup != groupIndex)
+        {
+          delete t.Encoder;
+          t.Encoder = NULL;
+          t.Encoder = new CEncoder(method);
+          t.EncoderGroup = groupIndex;
+        }
+        t.Indices.Clear();
+        for (int subIndex = 0; subIndex < numSubFiles; subIndex++)
+          t.Indices.Add(indices[i + subIndex]);
+        t.InStreamSpec = new CFolderInStream;
+        t.InStream = t.InStreamSpec;
+        t.InStreamSpec->Init(mt.UpdateCallback, &t.Indices[0], numSubFiles);
+        t.Folder = &newDatabase.Folders.AddNew();
+        t.ProgressSpec->Reinit();
+        mt.NumQueued++;
+        t.Start();
+        i += numSubFiles;
+        continue;
+      }
+      #endif
+
       CFolderInStream *inStreamSpec = new CFolderInStream;
       CMyComPtr<ISequentialInStream> solidInStream(inStreamSpec);
       inStreamSpec->Init(updateCallback, &indices[i], numSubFiles);
@@ -1303,65 +1722,18 @@ HRESULT Update(
       // newDatabase.PackCRCsDefined.Add(false);
       // newDatabase.PackCRCs.Add(0);
 
-      CNum numUnpackStreams = 0;
-      for (int subIndex = 0; subIndex < numSubFiles; subIndex++)
-      {
-        const CUpdateItem &ui = updateItems[indices[i + subIndex]];
-        CFileItem file;
-        CFileItem2 file2;
-        UString name;
-        if (ui.NewProps)
-        {
-          FromUpdateItemToFileItem(ui, file, file2);
-          name = ui.Name;
-        }
-        else
-        {
-          GetFile(*db, ui.IndexInArchive, file, file2);
-          db->GetPath(ui.IndexInArchive, name);
-        }
-        if (file2.IsAnti || file.IsDir)
-          return E_FAIL;
-
-        /*
-        CFileItem &file = newDatabase.Files[
-              startFileIndexInDatabase + i + subIndex];
-        */
-        if (!inStreamSpec->Processed[subIndex])
-        {
-          continue;
-          // file.Name += L".locked";
-        }
-
-        file.Crc = inStreamSpec->CRCs[subIndex];
-        file.Size = inStreamSpec->Sizes[subIndex];
-        if (file.Size != 0)
-        {
-          file.CrcDefined = true;
-          file.HasStream = true;
-          numUnpackStreams++;
-        }
-        else
-        {
-          file.CrcDefined = false;
-          file.HasStream = false;
-        }
-        /*
-        file.Parent = ui.ParentFolderIndex;
-        if (ui.TreeFolderIndex >= 0)
-          treeFolderToArcIndex[ui.TreeFolderIndex] = newDatabase.Files.Size();
-        if (totalSecureDataSize != 0)
-          newDatabase.SecureIDs.Add(ui.SecureIndex);
-        */
-        newDatabase.AddFile(file, file2, name);
-      }
-      // numUnpackStreams = 0 is very bad case for locked files
-      // v3.13 doesn't understand it.
-      newDatabase.NumUnpackStreamsVector.Add(numUnpackStreams);
+      RINOK(AddFolderFiles(db, updateItems, &indices[i], numSubFiles, *inStreamSpec, newDatabase));
       i += numSubFiles;
     }
   }
 
+  #ifndef _7ZIP_ST
+  if (mtMode)
+  {
+    RINOK(mt.Flush(archive.SeqStream, db, updateItems, newDatabase, lps));
+  }
+  #endif
+
   if (folderRefIndex != folderRefs.Size())
     return E_FAIL;
 
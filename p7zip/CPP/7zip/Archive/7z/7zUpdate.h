@@ -97,6 +97,13 @@ struct CUpdateOptions
   bool SolidExtension;
   bool RemoveSfxBlock;
   bool VolumeMode;
+  bool Dedup;              // the files of same size are placed next to each other
+
+  #ifndef _7ZIP_ST
+  UInt32 NumBlockThreads; // number of solid blocks that are compressed concurrently
+  UInt64 BlockMemUsage;   // estimated memory usage for one solid block
+  UInt64 MemUsageLimit;
+  #endif
 };
 
 HRESULT Update(
@@ -5,6 +5,7 @@
 // #include <stdio.h>
 
 #include "../../../../C/Alloc.h"
+#include "../../../../C/CpuArch.h"
 
 #include "../../../Common/ComTry.h"
 #include "../../../Common/IntToString.h"
@@ -14,8 +15,13 @@
 #include "../../../Windows/PropVariant.h"
 #include "../../../Windows/TimeUtils.h"
 
+#include "../../Common/MethodProps.h"
 #include "../../Common/ProgressUtils.h"
+#include "../../Common/StreamObjects.h"
 #include "../../Common/StreamUtils.h"
+#ifndef _7ZIP_ST
+#include "../../Common/VirtThread.h"
+#endif
 
 #include "../../Compress/CopyCoder.h"
 #include "../../Compress/DeflateDecoder.h"
@@ -829,6 +835,252 @@ HRESULT CFolderOutStream::Unsupported()
 }
 
 
+class CBlockDecoder
+{
+  NCompress::CCopyCoder *copyCoderSpec;
+  CMyComPtr<ICompressCoder> copyCoder;
+
+  NCompress::NDeflate::NDecoder::CCOMCoder *deflateDecoderSpec;
+  CMyComPtr<ICompressCoder> deflateDecoder;
+
+  NCompress::NLzx::CDecoder *lzxDecoderSpec;
+  CMyComPtr<ICompressCoder> lzxDecoder;
+
+  NCompress::NQuantum::CDecoder *quantumDecoderSpec;
+  CMyComPtr<ICompressCoder> quantumDecoder;
+public:
+  CCabBlockInStream *InStreamSpec;
+  CMyComPtr<ISequentialInStream> InStream;
+
+  CBlockDecoder():
+      deflateDecoderSpec(NULL),
+      lzxDecoderSpec(NULL),
+      quantumDecoderSpec(NULL)
+  {
+    copyCoderSpec = new NCompress::CCopyCoder;
+    copyCoder = copyCoderSpec;
+    InStreamSpec = new CCabBlockInStream;
+    InStream = InStreamSpec;
+  }
+
+  bool Create() { return InStreamSpec->Create(); }
+  HRESULT SetMethod(const CFolder &folder);
+  HRESULT Code(const CFolder &folder, ISequentialOutStream *outStream, UInt64 unpackRemain, bool keepHistory);
+};
+
+// it returns E_INVALIDARG for unsupported method
+
+HRESULT CBlockDecoder::SetMethod(const CFolder &folder)
+{
+  InStreamSpec->MsZip = false;
+  switch (folder.GetMethod())
+  {
+    case NHeader::NMethod::kNone:
+      return S_OK;
+    case NHeader::NMethod::kMSZip:
+      if (!deflateDecoder)
+      {
+        deflateDecoderSpec = new NCompress::NDeflate::NDecoder::CCOMCoder;
+        deflateDecoder = deflateDecoderSpec;
+      }
+      InStreamSpec->MsZip = true;
+      return S_OK;
+    case NHeader::NMethod::kLZX:
+      if (!lzxDecoder)
+      {
+        lzxDecoderSpec = new NCompress::NLzx::CDecoder;
+        lzxDecoder = lzxDecoderSpec;
+      }
+      return lzxDecoderSpec->SetParams(folder.MethodMinor);
+    case NHeader::NMethod::kQuantum:
+      if (!quantumDecoder)
+      {
+        quantumDecoderSpec = new NCompress::NQuantum::CDecoder;
+        quantumDecoder = quantumDecoderSpec;
+      }
+      return quantumDecoderSpec->SetParams(folder.MethodMinor);
+  }
+  return E_INVALIDARG;
+}
+
+HRESULT CBlockDecoder::Code(const CFolder &folder, ISequentialOutStream *outStream, UInt64 unpackRemain, bool keepHistory)
+{
+  HRESULT res = S_OK;
+  switch (folder.GetMethod())
+  {
+    case NHeader::NMethod::kNone:
+      res = copyCoder->Code(InStream, outStream, NULL, &unpackRemain, NULL);
+      break;
+    case NHeader::NMethod::kMSZip:
+      deflateDecoderSpec->Set_KeepHistory(keepHistory);
+      /* v9.31: now we follow MSZIP specification that requires to finish deflate stream at the end of each block.
+         But PyCabArc can create CAB archives that doesn't have finish marker at the end of block.
+         Cabarc probably ignores such errors in cab archives.
+         Maybe we also should ignore that error?
+         Or we should extract full file and show the warning? */
+      deflateDecoderSpec->Set_NeedFinishInput(true);
+      res = deflateDecoder->Code(InStream, outStream, NULL, &unpackRemain, NULL);
+      if (res == S_OK)
+      {
+        if (!deflateDecoderSpec->IsFinished())
+          res = S_FALSE;
+        if (!deflateDecoderSpec->IsFinalBlock())
+          res = S_FALSE;
+      }
+      break;
+    case NHeader::NMethod::kLZX:
+      lzxDecoderSpec->SetKeepHistory(keepHistory);
+      res = lzxDecoder->Code(InStream, outStream, NULL, &unpackRemain, NULL);
+      break;
+    case NHeader::NMethod::kQuantum:
+      quantumDecoderSpec->SetKeepHistory(keepHistory);
+      res = quantumDecoder->Code(InStream, outStream, NULL, &unpackRemain, NULL);
+      break;
+  }
+  return res;
+}
+
+static const UInt32 kBlockSizeMax = (1 << 15);
+
+/* The folders are independent compression units. In multithreaded mode the
+   main thread reads CFDATA blocks of next folders to memory, and the threads
+   decode these folders to memory buffers. The main thread writes the decoded
+   folders to extract callback in order of items. The folders that continue
+   in another volume and big folders are decoded by the main thread.
+   MSZIP blocks of one folder are not decoded in parallel: deflate history is
+   kept between CFDATA blocks. */
+
+struct CFolderGroup
+{
+  unsigned VolIndex;
+  int LocFolderIndex;
+  UInt64 UnpackSize;
+};
+
+#ifndef _7ZIP_ST
+
+static const UInt32 kNumThreadsMax = 64;
+static const UInt64 kFolderBufSizeMax = (UInt64)1 << 25;
+
+struct CFolderJob
+{
+  bool IsParallel;
+  const CFolder *Folder;
+  UInt32 ReservedSize;
+  UInt32 NumBlocks;
+  CByteBuffer PackBuf;
+  size_t PackSize;
+  UInt64 PackSizeTotal; // sum of packSize of blocks for progress
+  CByteBuffer Buf;
+  size_t Size;
+  size_t OutSize;
+  HRESULT Result;
+
+  HRESULT Read(const CMvDatabaseEx &database, const CFolderGroup &group);
+  HRESULT Decode2(CBlockDecoder &decoder, ISequentialInStream *packStream, CBufPtrSeqOutStream *outStreamSpec);
+  void Decode(CBlockDecoder &decoder);
+};
+
+// it sets IsParallel = false, if the folder must be decoded by main thread
+
+HRESULT CFolderJob::Read(const CMvDatabaseEx &database, const CFolderGroup &group)
+{
+  IsParallel = false;
+  if (group.UnpackSize > kFolderBufSizeMax)
+    return S_OK;
+  const CDatabaseEx &db = database.Volumes[group.VolIndex];
+  Folder = &db.Folders[group.LocFolderIndex];
+  ReservedSize = db.ArcInfo.GetDataBlockReserveSize();
+  RINOK(db.Stream->Seek(db.StartPosition + Folder->DataStart, STREAM_SEEK_SET, NULL));
+
+  const size_t headerSize = 8 + ReservedSize;
+  PackSize = 0;
+  PackSizeTotal = 0;
+  UInt64 unpackTotal = 0;
+  for (NumBlocks = 0; NumBlocks < Folder->NumDataBlocks && unpackTotal < group.UnpackSize; NumBlocks++)
+  {
+    Byte header[8 + 256];
+    size_t processed = headerSize;
+    RINOK(ReadStream(db.Stream, header, &processed));
+    if (processed != headerSize)
+      return S_OK;
+    UInt32 packSize = GetUi16(header + 4);
+    UInt32 unpackSize = GetUi16(header + 6);
+    // the block that continues in next volume has (unpackSize == 0)
+    if (unpackSize == 0)
+      return S_OK;
+    size_t newSize = PackSize + headerSize + packSize;
+    if (PackBuf.Size() < newSize)
+      PackBuf.ChangeSize_KeepData(newSize + (newSize >> 1), PackSize);
+    memcpy(PackBuf + PackSize, header, headerSize);
+    processed = packSize;
+    RINOK(ReadStream(db.Stream, PackBuf + PackSize + headerSize, &processed));
+    if (processed != packSize)
+      return S_OK;
+    PackSize = newSize;
+    PackSizeTotal += packSize;
+    unpackTotal += unpackSize;
+  }
+  if (unpackTotal < group.UnpackSize)
+    return S_OK;
+  Size = (size_t)group.UnpackSize;
+  Buf.AllocAtLeast(Size);
+  IsParallel = true;
+  return S_OK;
+}
+
+HRESULT CFolderJob::Decode2(CBlockDecoder &decoder, ISequentialInStream *packStream, CBufPtrSeqOutStream *outStreamSpec)
+{
+  if (!decoder.Create())
+    return E_OUTOFMEMORY;
+  RINOK(decoder.SetMethod(*Folder));
+  decoder.InStreamSpec->ReservedSize = ReservedSize;
+  bool keepHistory = false;
+  for (UInt32 f = 0; f < NumBlocks && outStreamSpec->GetPos() != Size; f++)
+  {
+    decoder.InStreamSpec->InitForNewBlock();
+    UInt32 packSize, unpackSize;
+    RINOK(decoder.InStreamSpec->PreRead(packStream, packSize, unpackSize));
+    UInt64 unpackRemain = Size - outStreamSpec->GetPos();
+    if (unpackRemain > kBlockSizeMax)
+      unpackRemain = kBlockSizeMax;
+    if (unpackRemain > unpackSize)
+      unpackRemain = unpackSize;
+    RINOK(decoder.Code(*Folder, outStreamSpec, unpackRemain, keepHistory));
+    keepHistory = true;
+  }
+  return S_OK;
+}
+
+void CFolderJob::Decode(CBlockDecoder &decoder)
+{
+  OutSize = 0;
+  try
+  {
+    CBufInStream *packStreamSpec = new CBufInStream;
+    CMyComPtr<ISequentialInStream> packStream = packStreamSpec;
+    packStreamSpec->Init(PackBuf, PackSize);
+    CBufPtrSeqOutStream *outStreamSpec = new CBufPtrSeqOutStream;
+    CMyComPtr<ISequentialOutStream> outStream = outStreamSpec;
+    outStreamSpec->Init(Buf, Size);
+    Result = Decode2(decoder, packStream, outStreamSpec);
+    OutSize = outStreamSpec->GetPos();
+  }
+  catch(...) { Result = E_OUTOFMEMORY; }
+}
+
+class CDecoderThread: public CVirtThread
+{
+public:
+  CBlockDecoder Decoder;
+  CFolderJob *Job;
+
+  ~CDecoderThread() { CVirtThread::WaitThreadFinish(); }
+  virtual void Execute() { Job->Decode(Decoder); }
+};
+
+#endif
+
 STDMETHODIMP CHandler::Extract(const UInt32 *indices, UInt32 numItems,
     Int32 testModeSpec, IArchiveExtractCallback *extractCallback)
 {
@@ -869,22 +1121,66 @@ STDMETHODIMP CHandler::Extract(const UInt32 *indices, UInt32 numItems,
   CMyComPtr<ICompressProgressInfo> progress = lps;
   lps->Init(extractCallback, false);
 
-  NCompress::CCopyCoder *copyCoderSpec = new NCompress::CCopyCoder;
-  CMyComPtr<ICompressCoder> copyCoder = copyCoderSpec;
+  CBlockDecoder decoder;
+  if (!decoder.Create())
+    return E_OUTOFMEMORY;
 
-  NCompress::NDeflate::NDecoder::CCOMCoder *deflateDecoderSpec = NULL;
-  CMyComPtr<ICompressCoder> deflateDecoder;
+  #ifndef _7ZIP_ST
 
-  NCompress::NLzx::CDecoder *lzxDecoderSpec = NULL;
-  CMyComPtr<ICompressCoder> lzxDecoder;
+  // the groups of items in same folder in order of extraction
 
-  NCompress::NQuantum::CDecoder *quantumDecoderSpec = NULL;
-  CMyComPtr<ICompressCoder> quantumDecoder;
+  CRecordVector<CFolderGroup> groups;
+  UInt32 numThreads = (_numThreads < kNumThreadsMax) ? _numThreads : kNumThreadsMax;
+  if (numThreads > 1)
+  {
+    for (i = 0; i < numItems;)
+    {
+      int index = allFilesMode ? i : indices[i];
+      const CMvItem &mvItem = m_Database.Items[index];
+      const CDatabaseEx &db = m_Database.Volumes[mvItem.VolumeIndex];
+      const CItem &item = db.Items[mvItem.ItemIndex];
+      i++;
+      if (item.IsDir())
+        continue;
+      int folderIndex = m_Database.GetFolderIndex(&mvItem);
+      if (folderIndex < 0)
+        continue;
+      CFolderGroup group;
+      group.VolIndex = mvItem.VolumeIndex;
+      group.LocFolderIndex = item.GetFolderIndex(db.Folders.Size());
+      group.UnpackSize = item.GetEndOffset();
+      for (; i < numItems; i++)
+      {
+        int indexNext = allFilesMode ? i : indices[i];
+        const CMvItem &mvItem = m_Database.Items[indexNext];
+        const CItem &item = m_Database.Volumes[mvItem.VolumeIndex].Items[mvItem.ItemIndex];
+        if (item.IsDir())
+          continue;
+        if (m_Database.GetFolderIndex(&mvItem) != folderIndex)
+          break;
+        group.UnpackSize = item.GetEndOffset();
+      }
+      groups.Add(group);
+    }
+    if (groups.Size() < 2)
+      numThreads = 1;
+  }
 
-  CCabBlockInStream *cabBlockInStreamSpec = new CCabBlockInStream();
-  CMyComPtr<ISequentialInStream> cabBlockInStream = cabBlockInStreamSpec;
-  if (!cabBlockInStreamSpec->Create())
-    return E_OUTOFMEMORY;
+  // jobs must be destroyed after threads
+  CObjectVector<CFolderJob> jobs;
+  CObjectVector<CDecoderThread> threads;
+  if (numThreads > 1)
+  {
+    for (i = 0; i < numThreads; i++)
+    {
+      jobs.AddNew();
+      RINOK(threads.AddNew().Create());
+    }
+  }
+  unsigned groupIndex = 0;
+  unsigned nextJob = 0;
+
+  #endif
 
   CRecordVector<bool> extractStatuses;
   for(i = 0; i < numItems;)
@@ -961,40 +1257,62 @@ STDMETHODIMP CHandler::Extract(const UInt32 *indices, UInt32 numItems,
     cabFolderOutStream->Init(&m_Database, &extractStatuses, startIndex2,
         curUnpack, extractCallback, testMode);
 
-    cabBlockInStreamSpec->MsZip = false;
-    HRESULT res = S_OK;
-    switch (folder.GetMethod())
+    #ifndef _7ZIP_ST
+    if (numThreads > 1)
     {
-      case NHeader::NMethod::kNone:
-        break;
-      case NHeader::NMethod::kMSZip:
-        if (!deflateDecoder)
+      for (; nextJob < groups.Size() && nextJob < groupIndex + numThreads; nextJob++)
+      {
+        CFolderJob &job = jobs[nextJob % numThreads];
+        RINOK(job.Read(m_Database, groups[nextJob]));
+        if (job.IsParallel)
         {
-          deflateDecoderSpec = new NCompress::NDeflate::NDecoder::CCOMCoder;
-          deflateDecoder = deflateDecoderSpec;
+          CDecoderThread &thread = threads[nextJob % numThreads];
+          thread.Job = &job;
+          thread.Start();
         }
-        cabBlockInStreamSpec->MsZip = true;
-        break;
-      case NHeader::NMethod::kLZX:
-        if (!lzxDecoder)
+      }
+      unsigned slot = groupIndex % numThreads;
+      groupIndex++;
+      CFolderJob &job = jobs[slot];
+      if (job.IsParallel)
+      {
+        threads[slot].WaitExecuteFinish();
+        HRESULT res = job.Result;
+        if (res == E_INVALIDARG)
         {
-          lzxDecoderSpec = new NCompress::NLzx::CDecoder;
-          lzxDecoder = lzxDecoderSpec;
+          RINOK(cabFolderOutStream->Unsupported());
+          totalUnPacked += curUnpack;
+          continue;
         }
-        res = lzxDecoderSpec->SetParams(folder.MethodMinor);
-        break;
-      case NHeader::NMethod::kQuantum:
-        if (!quantumDecoder)
+        if (res != S_OK && res != S_FALSE)
+          return res;
+        totalPacked += job.PackSizeTotal;
+        for (size_t pos = 0; pos < job.OutSize;)
         {
-          quantumDecoderSpec = new NCompress::NQuantum::CDecoder;
-          quantumDecoder = quantumDecoderSpec;
+          lps->OutSize = totalUnPacked + pos;
+          lps->InSize = totalPacked;
+          RINOK(lps->SetCur());
+          size_t cur = job.OutSize - pos;
+          if (cur > kBlockSizeMax)
+            cur = kBlockSizeMax;
+          RINOK(WriteStream(outStream, job.Buf + pos, cur));
+          pos += cur;
         }
-        res = quantumDecoderSpec->SetParams(folder.MethodMinor);
-        break;
-      default:
-        res = E_INVALIDARG;
-        break;
+        if (res == S_OK)
+        {
+          RINOK(cabFolderOutStream->WriteEmptyFiles());
+        }
+        if (res != S_OK || cabFolderOutStream->GetRemain() != 0)
+        {
+          RINOK(cabFolderOutStream->FlushCorrupted());
+        }
+        totalUnPacked += curUnpack;
+        continue;
+      }
     }
+    #endif
+
+    HRESULT res = decoder.SetMethod(folder);
 
     if (res == E_INVALIDARG)
     {
@@ -1021,7 +1339,7 @@ STDMETHODIMP CHandler::Extract(const UInt32 *indices, UInt32 numItems,
         const CFolder &folder = db.Folders[locFolderIndex];
         if (f == 0)
         {
-          cabBlockInStreamSpec->ReservedSize = db.ArcInfo.GetDataBlockReserveSize();
+          decoder.InStreamSpec->ReservedSize = db.ArcInfo.GetDataBlockReserveSize();
           RINOK(db.Stream->Seek(db.StartPosition + folder.DataStart, STREAM_SEEK_SET, NULL));
         }
         if (f == folder.NumDataBlocks)
@@ -1034,10 +1352,10 @@ STDMETHODIMP CHandler::Extract(const UInt32 *indices, UInt32 numItems,
         f++;
 
         if (!keepInputBuffer)
-          cabBlockInStreamSpec->InitForNewBlock();
+          decoder.InStreamSpec->InitForNewBlock();
 
         UInt32 packSize, unpackSize;
-        res = cabBlockInStreamSpec->PreRead(db.Stream, packSize, unpackSize);
+        res = decoder.InStreamSpec->PreRead(db.Stream, packSize, unpackSize);
         if (res == S_FALSE)
           break;
         RINOK(res);
@@ -1054,44 +1372,12 @@ STDMETHODIMP CHandler::Extract(const UInt32 *indices, UInt32 numItems,
 
         UInt64 unpackRemain = cabFolderOutStream->GetRemain();
 
-        const UInt32 kBlockSizeMax = (1 << 15);
         if (unpackRemain > kBlockSizeMax)
           unpackRemain = kBlockSizeMax;
         if (unpackRemain > unpackSize)
           unpackRemain = unpackSize;
 
-        switch (folder.GetMethod())
-        {
-          case NHeader::NMethod::kNone:
-            res = copyCoder->Code(cabBlockInStream, outStream, NULL, &unpackRemain, NULL);
-            break;
-          case NHeader::NMethod::kMSZip:
-            deflateDecoderSpec->Set_KeepHistory(keepHistory);
-            /* v9.31: now we follow MSZIP specification that requires to finish deflate stream at the end of each block.
-               But PyCabArc can create CAB archives that doesn't have finish marker at the end of block.
-               Cabarc probably ignores such errors in cab archives.
-               Maybe we also should ignore that error?
-               Or we should extract full file and show the warning? */
-            deflateDecoderSpec->Set_NeedFinishInput(true);
-            res = deflateDecoder->Code(cabBlockInStream, outStream, NULL, &unpackRemain, NULL);
-            if (res == S_OK)
-            {
-              if (!deflateDecoderSpec->IsFinished())
-                res = S_FALSE;
-              if (!deflateDecoderSpec->IsFinalBlock())
-                res = S_FALSE;
-            }
-
-            break;
-          case NHeader::NMethod::kLZX:
-            lzxDecoderSpec->SetKeepHistory(keepHistory);
-            res = lzxDecoder->Code(cabBlockInStream, outStream, NULL, &unpackRemain, NULL);
-            break;
-          case NHeader::NMethod::kQuantum:
-            quantumDecoderSpec->SetKeepHistory(keepHistory);
-            res = quantumDecoder->Code(cabBlockInStream, outStream, NULL, &unpackRemain, NULL);
-          break;
-        }
+        res = decoder.Code(folder, outStream, unpackRemain, keepHistory);
         if (res != S_OK)
         {
           if (res != S_FALSE)
@@ -1115,6 +1401,28 @@ STDMETHODIMP CHandler::Extract(const UInt32 *indices, UInt32 numItems,
   COM_TRY_END
 }
 
+STDMETHODIMP CHandler::SetProperties(const wchar_t **names, const PROPVARIANT *values, UInt32 numProps)
+{
+  InitDefaults();
+  for (UInt32 i = 0; i < numProps; i++)
+  {
+    UString name = names[i];
+    name.MakeLower_Ascii();
+    if (name.IsEmpty())
+      return E_INVALIDARG;
+    const PROPVARIANT &prop = values[i];
+    if (name.IsPrefixedBy(L"mt"))
+    {
+      #ifndef _7ZIP_ST
+      RINOK(ParseMtProp(name.Ptr(2), prop, NWindows::NSystem::GetNumberOfProcessors(), _numThreads));
+      #endif
+    }
+    else
+      return E_INVALIDARG;
+  }
+  return S_OK;
+}
+
 STDMETHODIMP CHandler::GetNumberOfItems(UInt32 *numItems)
 {
   *numItems = m_Database.Items.Size();
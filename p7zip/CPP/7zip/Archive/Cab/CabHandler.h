@@ -5,6 +5,10 @@
 
 #include "../../../Common/MyCom.h"
 
+#ifndef _7ZIP_ST
+#include "../../../Windows/System.h"
+#endif
+
 #include "../IArchive.h"
 
 #include "CabIn.h"
@@ -14,12 +18,16 @@ namespace NCab {
 
 class CHandler:
   public IInArchive,
+  public ISetProperties,
   public CMyUnknownImp
 {
 public:
-  MY_UNKNOWN_IMP1(IInArchive)
+  MY_UNKNOWN_IMP2(IInArchive, ISetProperties)
 
   INTERFACE_IInArchive(;)
+  STDMETHOD(SetProperties)(const wchar_t **names, const PROPVARIANT *values, UInt32 numProps);
+
+  CHandler() { InitDefaults(); }
 
 private:
   CMvDatabaseEx m_Database;
@@ -30,6 +38,17 @@ private:
   // int _mainVolIndex;
   UInt32 _phySize;
   UInt64 _offset;
+
+  #ifndef _7ZIP_ST
+  UInt32 _numThreads;
+  #endif
+
+  void InitDefaults()
+  {
+    #ifndef _7ZIP_ST
+    _numThreads = NWindows::NSystem::GetNumberOfProcessors();
+    #endif
+  }
 };
 
 }}
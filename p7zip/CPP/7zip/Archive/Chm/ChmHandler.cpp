@@ -2,7 +2,10 @@
 
 #include "StdAfx.h"
 
+#include <new>
+
 #include "../../../Common/ComTry.h"
+#include "../../../Common/MyException.h"
 #include "../../../Common/StringConvert.h"
 #include "../../../Common/UTFConvert.h"
 
@@ -10,9 +13,14 @@
 #include "../../../Windows/TimeUtils.h"
 
 #include "../../Common/LimitedStreams.h"
+#include "../../Common/MethodProps.h"
 #include "../../Common/ProgressUtils.h"
+#include "../../Common/StreamObjects.h"
 #include "../../Common/StreamUtils.h"
 #include "../../Common/RegisterArc.h"
+#ifndef _7ZIP_ST
+#include "../../Common/VirtThread.h"
+#endif
 
 #include "../../Compress/CopyCoder.h"
 #include "../../Compress/LzxDecoder.h"
@@ -264,6 +272,7 @@ public:
     const CFilesDatabase *database,
     IArchiveExtractCallback *extractCallback,
     bool testMode);
+  HRESULT WriteData(const Byte *data, size_t size, bool isOK);
   HRESULT FlushCorrupted(UInt64 maxSize);
 };
 
@@ -392,6 +401,21 @@ STDMETHODIMP CChmFolderOutStream::Write(const void *data, UInt32 size, UInt32 *p
   return Write2(data, size, processedSize, true);
 }
 
+HRESULT CChmFolderOutStream::WriteData(const Byte *data, size_t size, bool isOK)
+{
+  while (size != 0)
+  {
+    UInt32 cur = (UInt32)MyMin(size, (size_t)1 << 30);
+    UInt32 processedSizeLocal = 0;
+    RINOK(Write2(data, cur, &processedSizeLocal, isOK));
+    if (processedSizeLocal == 0)
+      return S_OK;
+    data += processedSizeLocal;
+    size -= processedSizeLocal;
+  }
+  return S_OK;
+}
+
 HRESULT CChmFolderOutStream::FlushCorrupted(UInt64 maxSize)
 {
   const UInt32 kBufferSize = (1 << 10);
@@ -411,6 +435,327 @@ HRESULT CChmFolderOutStream::FlushCorrupted(UInt64 maxSize)
   return S_OK;
 }
 
+/* LZX decoder state is reset at the start of each folder (ResetInterval blocks),
+   so the folders can be decoded independently. CFolderCache decodes whole
+   folders to memory: the requested folder and the next folders from the
+   extraction plan are decoded in parallel, and the recently used folders are
+   kept, so each folder is decoded once, even if it contains parts of
+   several requested files. */
+
+struct CFolderKey
+{
+  UInt64 Section;
+  UInt64 Folder;
+
+  bool IsEqualTo(UInt64 section, UInt64 folder) const { return Section == section && Folder == folder; }
+};
+
+struct CCachedFolder
+{
+  UInt64 Section;
+  UInt64 Folder;
+  UInt32 LastUse;
+  bool IsDefined;
+
+  unsigned NumDictBits;
+  UInt64 BlockSize;
+  CRecordVector<size_t> BlockPos; // offsets of the blocks in PackBuf. (NumBlocks + 1) items
+  CByteBuffer PackBuf;
+  CByteBuffer Buf;
+  size_t Size;        // requested unpack size
+  size_t DecodedSize;
+  size_t ErrorPos;    // start of the block, where decoding failed
+  HRESULT Result;
+
+  CCachedFolder(): LastUse(0), IsDefined(false) {}
+};
+
+class CFolderDecoder
+{
+  NCompress::NLzx::CDecoder *lzxDecoderSpec;
+  CMyComPtr<ICompressCoder> lzxDecoder;
+  CBufInStream *inStreamSpec;
+  CMyComPtr<ISequentialInStream> inStream;
+  CBufPtrSeqOutStream *outStreamSpec;
+  CMyComPtr<ISequentialOutStream> outStream;
+
+  HRESULT Decode2(CCachedFolder &f);
+public:
+  CFolderDecoder(): lzxDecoderSpec(NULL), inStreamSpec(NULL), outStreamSpec(NULL) {}
+  void Decode(CCachedFolder &f);
+};
+
+HRESULT CFolderDecoder::Decode2(CCachedFolder &f)
+{
+  if (!lzxDecoder)
+  {
+    lzxDecoderSpec = new NCompress::NLzx::CDecoder;
+    lzxDecoder = lzxDecoderSpec;
+    inStreamSpec = new CBufInStream;
+    inStream = inStreamSpec;
+    outStreamSpec = new CBufPtrSeqOutStream;
+    outStream = outStreamSpec;
+  }
+  outStreamSpec->Init(f.Buf, f.Size);
+  RINOK(lzxDecoderSpec->SetParams(f.NumDictBits));
+  unsigned numBlocks = f.BlockPos.Size() - 1;
+  for (unsigned b = 0; b < numBlocks; b++)
+  {
+    size_t pos = f.BlockPos[b];
+    inStreamSpec->Init((const Byte *)f.PackBuf + pos, f.BlockPos[b + 1] - pos);
+    UInt64 rem = f.Size - outStreamSpec->GetPos();
+    if (rem > f.BlockSize)
+      rem = f.BlockSize;
+    lzxDecoderSpec->SetKeepHistory(b > 0);
+    f.ErrorPos = (size_t)outStreamSpec->GetPos();
+    RINOK(lzxDecoder->Code(inStream, outStream, NULL, &rem, NULL));
+  }
+  return S_OK;
+}
+
+void CFolderDecoder::Decode(CCachedFolder &f)
+{
+  // ReadFolder() has found an error in headers
+  if (f.Result != S_OK)
+    return;
+  f.ErrorPos = 0;
+  try
+  {
+    f.Result = Decode2(f);
+  }
+  catch(const CSystemException &e) { f.Result = e.ErrorCode; }
+  catch(const std::bad_alloc &) { f.Result = E_OUTOFMEMORY; }
+  catch(...) { f.Result = S_FALSE; }
+  f.DecodedSize = outStreamSpec ? outStreamSpec->GetPos() : 0;
+}
+
+#ifndef _7ZIP_ST
+
+class CFolderThread: public CVirtThread
+{
+public:
+  CFolderDecoder Decoder;
+  CCachedFolder *Folder;
+
+  ~CFolderThread() { CVirtThread::WaitThreadFinish(); }
+  virtual void Execute() { Decoder.Decode(*Folder); }
+};
+
+#endif
+
+static const unsigned kNumThreadsMax = 64;
+
+class CFolderCache
+{
+  CObjectVector<CCachedFolder> _folders;
+  CFolderDecoder _decoder;
+  #ifndef _7ZIP_ST
+  CObjectVector<CFolderThread> _threads;
+  #endif
+  UInt32 _useCounter;
+  unsigned _planPos;
+
+  int FindFolder(UInt64 section, UInt64 folder) const;
+  CCachedFolder &GetFreeFolder(UInt32 minUse);
+  HRESULT ReadFolder(IInStream *stream, const CFilesDatabase &db, CCachedFolder &f);
+  HRESULT DecodeFolders(CCachedFolder **folders, unsigned num);
+public:
+  UInt32 NumThreads;
+  CRecordVector<CFolderKey> Plan; // folders in order of extraction
+
+  CFolderCache(): _useCounter(0), _planPos(0), NumThreads(1) {}
+  HRESULT GetFolder(IInStream *stream, const CFilesDatabase &db, UInt64 section, UInt64 folder,
+      const CCachedFolder *&result);
+};
+
+int CFolderCache::FindFolder(UInt64 section, UInt64 folder) const
+{
+  FOR_VECTOR (i, _folders)
+  {
+    const CCachedFolder &f = _folders[i];
+    if (f.IsDefined && f.Section == section && f.Folder == folder)
+      return i;
+  }
+  return -1;
+}
+
+// it returns least recently used folder, that was not used after (minUse)
+
+CCachedFolder &CFolderCache::GetFreeFolder(UInt32 minUse)
+{
+  unsigned numThreads = (NumThreads < kNumThreadsMax) ? NumThreads : kNumThreadsMax;
+  if (_folders.Size() < numThreads * 2 + 2)
+    return _folders.AddNew();
+  int best = -1;
+  FOR_VECTOR (i, _folders)
+  {
+    const CCachedFolder &f = _folders[i];
+    if (f.LastUse < minUse && (best < 0 || f.LastUse < _folders[best].LastUse))
+      best = i;
+  }
+  if (best < 0)
+    return _folders.AddNew();
+  return _folders[best];
+}
+
+HRESULT CFolderCache::ReadFolder(IInStream *stream, const CFilesDatabase &db, CCachedFolder &f)
+{
+  const CSectionInfo &section = db.Sections[(unsigned)f.Section];
+  const CLzxInfo &lzxInfo = section.Methods[0].LzxInfo;
+  const CResetTable &rt = lzxInfo.ResetTable;
+
+  f.Result = S_OK;
+  f.DecodedSize = 0;
+  f.ErrorPos = 0;
+  f.NumDictBits = lzxInfo.GetNumDictBits();
+  f.BlockSize = rt.BlockSize;
+
+  f.Size = 0;
+  f.BlockPos.ClearAndSetSize(1);
+  f.BlockPos[0] = 0;
+
+  // the sizes in headers can be wrong: the buffers are limited by the unpack sizes
+  // of reset table and section, and by the number of blocks in reset table
+  UInt64 unpackSize = rt.UncompressedSize;
+  if (unpackSize > section.UncompressedSize)
+    unpackSize = section.UncompressedSize;
+  UInt64 startPos = lzxInfo.GetFolderPos(f.Folder);
+  if (startPos >= unpackSize)
+    return S_OK;
+  UInt64 size = lzxInfo.GetFolderSize();
+  if (size > unpackSize - startPos)
+    size = unpackSize - startPos;
+
+  UInt64 startBlock = lzxInfo.GetBlockIndexFromFolderIndex(f.Folder);
+  if (rt.BlockSize == 0 || startBlock >= rt.ResetOffsets.Size())
+    return S_OK;
+  UInt64 numBlocks = rt.GetNumBlocks(size);
+  if (numBlocks > rt.ResetOffsets.Size() - startBlock)
+    numBlocks = rt.ResetOffsets.Size() - startBlock;
+  // (numBlocks < 2^32) and (BlockSize == 0x8000), so it doesn't overflow
+  if (size > numBlocks * rt.BlockSize)
+    size = numBlocks * rt.BlockSize;
+
+  UInt64 packSize;
+  // the compressed size of LZX block can't be much larger than the size of block
+  if (!rt.GetCompressedSizeOfBlocks(startBlock, (UInt32)numBlocks, packSize)
+      || packSize > (numBlocks + 1) * rt.BlockSize * 2
+      || packSize > section.CompressedSize)
+  {
+    f.Result = S_FALSE;
+    return S_OK;
+  }
+  if (size != (size_t)size || packSize != (size_t)packSize)
+    return E_OUTOFMEMORY;
+  f.Size = (size_t)size;
+  f.Buf.AllocAtLeast(f.Size);
+  f.BlockPos.ClearAndSetSize((unsigned)numBlocks + 1);
+  f.BlockPos[0] = 0;
+  f.PackBuf.AllocAtLeast((size_t)packSize);
+  UInt64 startOffset = rt.ResetOffsets[(unsigned)startBlock];
+  RINOK(stream->Seek(db.ContentOffset + section.Offset + startOffset, STREAM_SEEK_SET, NULL));
+  size_t processed = (size_t)packSize;
+  RINOK(ReadStream(stream, f.PackBuf, &processed));
+
+  for (unsigned b = 1; b <= (unsigned)numBlocks; b++)
+  {
+    UInt64 pos = packSize;
+    if (startBlock + b < rt.ResetOffsets.Size())
+      pos = rt.ResetOffsets[(unsigned)(startBlock + b)] - startOffset;
+    if (pos > processed)
+      pos = processed;
+    if (pos < f.BlockPos[b - 1])
+      pos = f.BlockPos[b - 1];
+    f.BlockPos[b] = (size_t)pos;
+  }
+  return S_OK;
+}
+
+HRESULT CFolderCache::DecodeFolders(CCachedFolder **folders, unsigned num)
+{
+  #ifndef _7ZIP_ST
+  while (_threads.Size() + 1 < num)
+  {
+    WRes wres = _threads.AddNew().Create();
+    if (wres != 0)
+    {
+      _threads.DeleteBack();
+      return wres;
+    }
+  }
+  unsigned i;
+  for (i = 1; i < num; i++)
+  {
+    CFolderThread &thread = _threads[i - 1];
+    thread.Folder = folders[i];
+    thread.Start();
+  }
+  #endif
+  _decoder.Decode(*folders[0]);
+  #ifndef _7ZIP_ST
+  for (i = 1; i < num; i++)
+    _threads[i - 1].WaitExecuteFinish();
+  #endif
+  return S_OK;
+}
+
+HRESULT CFolderCache::GetFolder(IInStream *stream, const CFilesDatabase &db, UInt64 section, UInt64 folder,
+    const CCachedFolder *&result)
+{
+  int index = FindFolder(section, folder);
+  if (index >= 0)
+  {
+    CCachedFolder &f = _folders[index];
+    f.LastUse = ++_useCounter;
+    result = &f;
+    return S_OK;
+  }
+
+  CFolderKey keys[kNumThreadsMax];
+  unsigned num = 0;
+  keys[num].Section = section;
+  keys[num].Folder = folder;
+  num++;
+
+  // we decode next folders from plan in the same pass
+
+  unsigned numThreads = 1;
+  #ifndef _7ZIP_ST
+  numThreads = (NumThreads < kNumThreadsMax) ? NumThreads : kNumThreadsMax;
+  #endif
+  unsigned i;
+  for (i = _planPos; i < Plan.Size(); i++)
+    if (Plan[i].IsEqualTo(section, folder))
+      break;
+  if (i < Plan.Size())
+  {
+    _planPos = i;
+    for (i++; i < Plan.Size() && num < numThreads; i++)
+    {
+      const CFolderKey &key = Plan[i];
+      if (FindFolder(key.Section, key.Folder) < 0)
+        keys[num++] = key;
+    }
+  }
+
+  UInt32 minUse = _useCounter + 1;
+  CCachedFolder *folders[kNumThreadsMax];
+  for (i = 0; i < num; i++)
+  {
+    CCachedFolder &f = GetFreeFolder(minUse);
+    f.IsDefined = false;
+    f.Section = keys[i].Section;
+    f.Folder = keys[i].Folder;
+    f.LastUse = ++_useCounter;
+    RINOK(ReadFolder(stream, db, f));
+    folders[i] = &f;
+  }
+  RINOK(DecodeFolders(folders, num));
+  for (i = 0; i < num; i++)
+    folders[i]->IsDefined = true;
+  result = folders[0];
+  return S_OK;
+}
 
 STDMETHODIMP CHandler::Extract(const UInt32 *indices, UInt32 numItems,
     Int32 testModeSpec, IArchiveExtractCallback *extractCallback)
@@ -511,6 +856,11 @@ STDMETHODIMP CHandler::Extract(const UInt32 *indices, UInt32 numItems,
     return S_OK;
   }
 
+  CFolderCache folderCache;
+  #ifndef _7ZIP_ST
+  folderCache.NumThreads = _numThreads;
+  #endif
+
   UInt64 lastFolderIndex = ((UInt64)0 - 1);
   for (i = 0; i < numItems; i++)
   {
@@ -534,14 +884,18 @@ STDMETHODIMP CHandler::Extract(const UInt32 *indices, UInt32 numItems,
         folderIndex++;
       lastFolderIndex = m_Database.GetLastFolder(index);
       for (; folderIndex <= lastFolderIndex; folderIndex++)
+      {
         currentTotalSize += lzxInfo.GetFolderSize();
+        CFolderKey key;
+        key.Section = sectionIndex;
+        key.Folder = folderIndex;
+        folderCache.Plan.Add(key);
+      }
     }
   }
 
   RINOK(extractCallback->SetTotal(currentTotalSize));
 
-  NCompress::NLzx::CDecoder *lzxDecoderSpec = 0;
-  CMyComPtr<ICompressCoder> lzxDecoder;
   CChmFolderOutStream *chmFolderOutStream = 0;
   CMyComPtr<ISequentialOutStream> outStream;
 
@@ -617,18 +971,8 @@ STDMETHODIMP CHandler::Extract(const UInt32 *indices, UInt32 numItems,
 
     chmFolderOutStream->Init(&m_Database, extractCallback, testMode);
 
-    if (lzxDecoderSpec == NULL)
-    {
-      lzxDecoderSpec = new NCompress::NLzx::CDecoder;
-      lzxDecoder = lzxDecoderSpec;
-    }
-
     UInt64 folderIndex = m_Database.GetFolder(index);
 
-    UInt64 compressedPos = m_Database.ContentOffset + section.Offset;
-    UInt32 numDictBits = lzxInfo.GetNumDictBits();
-    RINOK(lzxDecoderSpec->SetParams(numDictBits));
-
     const CItem *lastItem = &item;
     extractStatuses.Clear();
     extractStatuses.Add(true);
@@ -678,40 +1022,40 @@ STDMETHODIMP CHandler::Extract(const UInt32 *indices, UInt32 numItems,
       chmFolderOutStream->m_ExtractStatuses = &extractStatuses;
       chmFolderOutStream->m_NumFiles = extractStatuses.Size();
       chmFolderOutStream->m_CurrentIndex = 0;
-      try
       {
         UInt64 startBlock = lzxInfo.GetBlockIndexFromFolderIndex(folderIndex);
         const CResetTable &rt = lzxInfo.ResetTable;
-        UInt32 numBlocks = (UInt32)rt.GetNumBlocks(unPackSize);
-        for (UInt32 b = 0; b < numBlocks; b++)
+        UInt64 numBlocks = rt.GetNumBlocks(unPackSize);
+        if (startBlock + numBlocks > rt.ResetOffsets.Size())
+          return E_FAIL;
+        const CCachedFolder *folder;
+        RINOK(folderCache.GetFolder(m_Stream, m_Database, sectionIndex, folderIndex, folder));
+        HRESULT res = folder->Result;
+        if (res != S_OK && res != S_FALSE)
+          return res;
+        size_t size = folder->DecodedSize;
+        if (size > unPackSize)
+          size = (size_t)unPackSize;
+        // the data after the start of failed block is reported as data error
+        size_t okSize = size;
+        if (res != S_OK && okSize > folder->ErrorPos)
+          okSize = folder->ErrorPos;
+        for (size_t pos = 0; pos < size;)
         {
           UInt64 completedSize = currentTotalSize + chmFolderOutStream->m_PosInSection - startPos;
           RINOK(extractCallback->SetCompleted(&completedSize));
-          UInt64 bCur = startBlock + b;
-          if (bCur >= rt.ResetOffsets.Size())
-            return E_FAIL;
-          UInt64 offset = rt.ResetOffsets[(int)bCur];
-          UInt64 compressedSize;
-          rt.GetCompressedSizeOfBlock(bCur, compressedSize);
-          UInt64 rem = finishPos - chmFolderOutStream->m_PosInSection;
-          if (rem > rt.BlockSize)
-            rem = rt.BlockSize;
-          RINOK(m_Stream->Seek(compressedPos + offset, STREAM_SEEK_SET, NULL));
-          streamSpec->SetStream(m_Stream);
-          streamSpec->Init(compressedSize);
-          lzxDecoderSpec->SetKeepHistory(b > 0);
-          HRESULT res = lzxDecoder->Code(inStream, outStream, NULL, &rem, NULL);
-          if (res != S_OK)
-          {
-            if (res != S_FALSE)
-              return res;
-            throw 1;
-          }
+          size_t cur = size - pos;
+          if (cur > rt.BlockSize)
+            cur = (size_t)rt.BlockSize;
+          if (pos < okSize && cur > okSize - pos)
+            cur = okSize - pos;
+          RINOK(chmFolderOutStream->WriteData((const Byte *)folder->Buf + pos, cur, pos < okSize));
+          pos += cur;
+        }
+        if (size < unPackSize)
+        {
+          RINOK(chmFolderOutStream->FlushCorrupted(unPackSize));
         }
-      }
-      catch(...)
-      {
-        RINOK(chmFolderOutStream->FlushCorrupted(unPackSize));
       }
       currentTotalSize += folderSize;
       if (folderIndex == lastFolderIndex)
@@ -723,6 +1067,28 @@ STDMETHODIMP CHandler::Extract(const UInt32 *indices, UInt32 numItems,
   COM_TRY_END
 }
 
+STDMETHODIMP CHandler::SetProperties(const wchar_t **names, const PROPVARIANT *values, UInt32 numProps)
+{
+  InitDefaults();
+  for (UInt32 i = 0; i < numProps; i++)
+  {
+    UString name = names[i];
+    name.MakeLower_Ascii();
+    if (name.IsEmpty())
+      return E_INVALIDARG;
+    const PROPVARIANT &prop = values[i];
+    if (name.IsPrefixedBy(L"mt"))
+    {
+      #ifndef _7ZIP_ST
+      RINOK(ParseMtProp(name.Ptr(2), prop, NWindows::NSystem::GetNumberOfProcessors(), _numThreads));
+      #endif
+    }
+    else
+      return E_INVALIDARG;
+  }
+  return S_OK;
+}
+
 STDMETHODIMP CHandler::GetNumberOfItems(UInt32 *numItems)
 {
     *numItems = m_Database.NewFormat ? 1:
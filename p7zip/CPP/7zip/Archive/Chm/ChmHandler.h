@@ -5,6 +5,10 @@
 
 #include "../../../Common/MyCom.h"
 
+#ifndef _7ZIP_ST
+#include "../../../Windows/System.h"
+#endif
+
 #include "../IArchive.h"
 
 #include "ChmIn.h"
@@ -14,20 +18,33 @@ namespace NChm {
 
 class CHandler:
   public IInArchive,
+  public ISetProperties,
   public CMyUnknownImp
 {
 public:
-  MY_UNKNOWN_IMP1(IInArchive)
+  MY_UNKNOWN_IMP2(IInArchive, ISetProperties)
 
   INTERFACE_IInArchive(;)
+  STDMETHOD(SetProperties)(const wchar_t **names, const PROPVARIANT *values, UInt32 numProps);
 
   bool _help2;
-  CHandler(bool help2): _help2(help2) {}
+  CHandler(bool help2): _help2(help2) { InitDefaults(); }
 
 private:
   CFilesDatabase m_Database;
   CMyComPtr<IInStream> m_Stream;
   UInt32 m_ErrorFlags;
+
+  #ifndef _7ZIP_ST
+  UInt32 _numThreads;
+  #endif
+
+  void InitDefaults()
+  {
+    #ifndef _7ZIP_ST
+    _numThreads = NWindows::NSystem::GetNumberOfProcessors();
+    #endif
+  }
 };
 
 }}
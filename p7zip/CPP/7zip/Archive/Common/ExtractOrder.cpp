@@ -0,0 +1,161 @@
+// ExtractOrder.cpp
+
+#include "StdAfx.h"
+
+#include <string.h>
+
+#include "../../Common/StreamUtils.h"
+
+#include "ExtractOrder.h"
+
+#define RINOZ(x) { int __tt = (x); if (__tt != 0) return __tt; }
+
+namespace NArchive {
+
+static int ComparePhyOrderItems(const CPhyOrderItem *p1, const CPhyOrderItem *p2, void * /* param */)
+{
+  RINOZ(MyCompare(p1->Pos, p2->Pos));
+  return MyCompare(p1->Index, p2->Index);
+}
+
+void CPhyOrder::Sort()
+{
+  _items.Sort(ComparePhyOrderItems, NULL);
+
+  // (nextPos) and (spanEnd) describe the next item with data
+  UInt64 nextPos = 0;
+  UInt64 spanEnd = 0;
+  for (unsigned i = _items.Size(); i != 0;)
+  {
+    CPhyOrderItem &item = _items[--i];
+    if (item.Size == 0)
+      continue;
+    UInt64 end = item.Pos + item.Size;
+    if (end < item.Pos)
+      end = (UInt64)(Int64)-1;
+    if (spanEnd > end && (nextPos <= end || nextPos - end <= kPhyOrderMaxGap))
+      end = spanEnd;
+    item.SpanEnd = end;
+    nextPos = item.Pos;
+    spanEnd = end;
+  }
+}
+
+void CReadAheadInStream::SetStream(IInStream *stream)
+{
+  _stream = stream;
+  _streamGetFd.Release();
+  if (stream)
+    stream->QueryInterface(IID_IStreamGetFd, (void **)&_streamGetFd);
+}
+
+HRESULT CReadAheadInStream::Init(size_t blockSize)
+{
+  _bufPos = 0;
+  _bufSize = 0;
+  _aheadEnd = (UInt64)(Int64)-1;
+  if (_buf.Size() != blockSize)
+    _buf.Alloc(blockSize);
+  RINOK(_stream->Seek(0, STREAM_SEEK_CUR, &_physPos));
+  _virtPos = _physPos;
+  return S_OK;
+}
+
+HRESULT CReadAheadInStream::SeekToVirt()
+{
+  if (_physPos == _virtPos)
+    return S_OK;
+  return _stream->Seek(_virtPos, STREAM_SEEK_SET, &_physPos);
+}
+
+STDMETHODIMP CReadAheadInStream::Read(void *data, UInt32 size, UInt32 *processedSize)
+{
+  if (processedSize)
+    *processedSize = 0;
+  if (size == 0)
+    return S_OK;
+
+  if (!IsInBuf())
+  {
+    RINOK(SeekToVirt());
+    size_t aheadSize = _buf.Size();
+    if (_aheadEnd <= _virtPos)
+      aheadSize = 0;
+    else if (aheadSize > _aheadEnd - _virtPos)
+      aheadSize = (size_t)(_aheadEnd - _virtPos);
+    if (size >= aheadSize)
+    {
+      UInt32 cur = 0;
+      HRESULT res = _stream->Read(data, size, &cur);
+      _physPos += cur;
+      _virtPos = _physPos;
+      if (processedSize)
+        *processedSize = cur;
+      return res;
+    }
+    _bufPos = _physPos;
+    _bufSize = aheadSize;
+    HRESULT res = ReadStream(_stream, _buf, &_bufSize);
+    _physPos += _bufSize;
+    RINOK(res);
+    if (_bufSize == 0)
+      return S_OK;
+  }
+
+  size_t offset = (size_t)(_virtPos - _bufPos);
+  size_t rem = _bufSize - offset;
+  if (size > rem)
+    size = (UInt32)rem;
+  memcpy(data, _buf + offset, size);
+  _virtPos += size;
+  if (processedSize)
+    *processedSize = size;
+  return S_OK;
+}
+
+STDMETHODIMP CReadAheadInStream::Seek(Int64 offset, UInt32 seekOrigin, UInt64 *newPosition)
+{
+  switch (seekOrigin)
+  {
+    case STREAM_SEEK_SET: break;
+    case STREAM_SEEK_CUR: offset += _virtPos; break;
+    case STREAM_SEEK_END:
+    {
+      UInt64 size;
+      RINOK(_stream->Seek(0, STREAM_SEEK_END, &size));
+      _physPos = size;
+      offset += size;
+      break;
+    }
+    default: return STG_E_INVALIDFUNCTION;
+  }
+  if (offset < 0)
+    return HRESULT_WIN32_ERROR_NEGATIVE_SEEK;
+  _virtPos = offset;
+  if (newPosition)
+    *newPosition = _virtPos;
+  return S_OK;
+}
+
+// the data that is in buffer already is copied via Read()
+
+STDMETHODIMP CReadAheadInStream::GetFd(int *fd, UInt64 *rem)
+{
+  *fd = -1;
+  *rem = 0;
+  if (!_streamGetFd || IsInBuf())
+    return S_FALSE;
+  RINOK(SeekToVirt());
+  return _streamGetFd->GetFd(fd, rem);
+}
+
+STDMETHODIMP CReadAheadInStream::FdTransferred(UInt64 size)
+{
+  if (!_streamGetFd)
+    return E_FAIL;
+  _virtPos += size;
+  _physPos = _virtPos;
+  return _streamGetFd->FdTransferred(size);
+}
+
+}
@@ -0,0 +1,97 @@
+// ExtractOrder.h
+
+#ifndef __EXTRACT_ORDER_H
+#define __EXTRACT_ORDER_H
+
+#include "../../../Common/MyBuffer.h"
+#include "../../../Common/MyCom.h"
+#include "../../../Common/MyVector.h"
+
+#include "../../IStream.h"
+
+namespace NArchive {
+
+/* Disk image handlers (ISO, UDF, FAT, NTFS, HFS) store the data of items at
+   places of the image that are not related to the order of items.
+   Extract() gets the physical position of each requested item from handler,
+   and it processes the items in order of these positions, so the image is read
+   mostly forward. The items are still reported to callback with their own indexes.
+   Items without data in image (dirs, empty, resident and inline items) use
+   position 0, so they go first.
+   Sort() joins the data of items that follow one another in image with small
+   gaps (up to kPhyOrderMaxGap) to spans. Extract() passes the end of span of
+   item to CReadAheadInStream::SetReadAheadEnd(), so the data after the current
+   and next items is not read ahead. */
+
+const UInt32 kPhyOrderMaxGap = (UInt32)1 << 16;
+
+struct CPhyOrderItem
+{
+  UInt64 Pos;
+  UInt64 Size;
+  UInt64 SpanEnd; // 0, if item has no data in image
+  UInt32 Index;
+};
+
+class CPhyOrder
+{
+  CRecordVector<CPhyOrderItem> _items;
+public:
+  void Reserve(unsigned num) { _items.ClearAndReserve(num); }
+  void Add(UInt32 index, UInt64 pos, UInt64 size)
+  {
+    CPhyOrderItem item;
+    item.Pos = pos;
+    item.Size = (pos == 0 ? 0 : size);
+    item.SpanEnd = 0;
+    item.Index = index;
+    _items.Add(item);
+  }
+  void Sort();
+  unsigned Size() const { return _items.Size(); }
+  UInt32 GetIndex(unsigned i) const { return _items[i].Index; }
+  UInt64 GetSpanEnd(unsigned i) const { return _items[i].SpanEnd; }
+};
+
+/* CReadAheadInStream is a seekable stream over the image stream for Extract().
+   It reads the image by big blocks, so small reads of neighbouring items
+   (that go one after another in physical order) are joined to one read.
+   The block is not read after the end that was set by SetReadAheadEnd().
+   Reads that are not smaller than block are passed to image stream directly. */
+
+const size_t kReadAheadBlockSize = (size_t)1 << 20;
+
+class CReadAheadInStream:
+  public IInStream,
+  public IStreamGetFd,
+  public CMyUnknownImp
+{
+  CMyComPtr<IInStream> _stream;
+  CMyComPtr<IStreamGetFd> _streamGetFd;
+  UInt64 _virtPos;
+  UInt64 _physPos;
+  UInt64 _bufPos;
+  size_t _bufSize;
+  UInt64 _aheadEnd;
+  CByteBuffer _buf;
+
+  bool IsInBuf() const { return _virtPos >= _bufPos && _virtPos - _bufPos < _bufSize; }
+  HRESULT SeekToVirt();
+public:
+  void SetStream(IInStream *stream);
+  void ReleaseStream() { _stream.Release(); _streamGetFd.Release(); }
+  HRESULT Init(size_t blockSize = kReadAheadBlockSize);
+  // Init() sets no limit. (end == 0) disables read-ahead.
+  void SetReadAheadEnd(UInt64 end) { _aheadEnd = end; }
+
+  MY_UNKNOWN_IMP3(ISequentialInStream, IInStream, IStreamGetFd)
+
+  STDMETHOD(Read)(void *data, UInt32 size, UInt32 *processedSize);
+  STDMETHOD(Seek)(Int64 offset, UInt32 seekOrigin, UInt64 *newPosition);
+  STDMETHOD(GetFd)(int *fd, UInt64 *rem);
+  STDMETHOD(FdTransferred)(UInt64 size);
+};
+
+}
+
+#endif
@@ -0,0 +1,260 @@
+// MultiVolumeInStream.cpp
+
+#include "StdAfx.h"
+
+#include "../../../Common/Wildcard.h"
+
+#include "../../../Windows/PropVariant.h"
+
+#include "MultiVolumeInStream.h"
+
+using namespace NWindows;
+
+bool CVolumeInStream::Open(CFSTR path)
+{
+  _pos = 0;
+  _size = 0;
+  if (!File.Open(path))
+    return false;
+  return File.GetLength(_size);
+}
+
+STDMETHODIMP CVolumeInStream::Read(void *data, UInt32 size, UInt32 *processedSize)
+{
+  if (processedSize)
+    *processedSize = 0;
+  if (size == 0 || _pos >= _size)
+    return S_OK;
+  UInt64 rem = _size - _pos;
+  if (size > rem)
+    size = (UInt32)rem;
+  UInt32 realProcessedSize;
+  bool result = File.ReadAt(_pos, data, size, realProcessedSize);
+  _pos += realProcessedSize;
+  if (processedSize)
+    *processedSize = realProcessedSize;
+  return result ? S_OK : E_FAIL;
+}
+
+STDMETHODIMP CVolumeInStream::Seek(Int64 offset, UInt32 seekOrigin, UInt64 *newPosition)
+{
+  switch (seekOrigin)
+  {
+    case STREAM_SEEK_SET: break;
+    case STREAM_SEEK_CUR: offset += _pos; break;
+    case STREAM_SEEK_END: offset += _size; break;
+    default: return STG_E_INVALIDFUNCTION;
+  }
+  if (offset < 0)
+    return HRESULT_WIN32_ERROR_NEGATIVE_SEEK;
+  _pos = offset;
+  if (newPosition)
+    *newPosition = offset;
+  return S_OK;
+}
+
+STDMETHODIMP CVolumeInStream::GetSize(UInt64 *size)
+{
+  *size = _size;
+  return S_OK;
+}
+
+static bool IsDigit(wchar_t c)
+{
+  return c >= L'0' && c <= L'9';
+}
+
+static bool IsDigitsOnly(const UString &s)
+{
+  if (s.IsEmpty())
+    return false;
+  for (unsigned i = 0; i < s.Len(); i++)
+    if (!IsDigit(s[i]))
+      return false;
+  return true;
+}
+
+// increments decimal number in s[start, end); it keeps the width, if possible
+
+static void IncreaseNumber(UString &s, unsigned start, unsigned end)
+{
+  for (unsigned i = end; i > start;)
+  {
+    i--;
+    wchar_t c = s[i];
+    if (c != L'9')
+    {
+      s.ReplaceOneCharAtPos(i, (wchar_t)(c + 1));
+      return;
+    }
+    s.ReplaceOneCharAtPos(i, L'0');
+  }
+  s.Insert(start, L"1");
+}
+
+/* Determines the type of volume set and the name of the first volume.
+   (numStart, numEnd) is the position of the volume number in the name. */
+
+static NVolumeSet::EType GetVolumeSetType(UString &name, unsigned &numStart, unsigned &numEnd)
+{
+  int dotPos = name.ReverseFind(L'.');
+  if (dotPos < 0)
+    return NVolumeSet::kSingle;
+  UString ext = name.Ptr(dotPos + 1);
+  UString base = name.Left(dotPos);
+
+  if (IsDigitsOnly(ext))
+  {
+    numStart = dotPos + 1;
+    numEnd = name.Len();
+    return NVolumeSet::kNumbered;
+  }
+
+  if (ext.IsEqualToNoCase(L"zip")
+      || (ext.Len() == 3 && (ext[0] == L'z' || ext[0] == L'Z') && IsDigit(ext[1]) && IsDigit(ext[2])))
+  {
+    name = base;
+    name += (ext[0] == L'Z' ? L".Z01" : L".z01");
+    numStart = dotPos + 2;
+    numEnd = name.Len();
+    return NVolumeSet::kZipSplit;
+  }
+
+  if (ext.IsEqualToNoCase(L"rar"))
+  {
+    int partDotPos = base.ReverseFind(L'.');
+    if (partDotPos >= 0)
+    {
+      UString part = base.Ptr(partDotPos + 1);
+      if (part.Len() > 4 && part.IsPrefixedBy_Ascii_NoCase("part") && IsDigitsOnly(part.Ptr(4)))
+      {
+        numStart = partDotPos + 5;
+        numEnd = dotPos;
+        return NVolumeSet::kRarParts;
+      }
+    }
+    numStart = dotPos + 2;
+    numEnd = dotPos + 4;
+    return NVolumeSet::kRarOld;
+  }
+
+  return NVolumeSet::kSingle;
+}
+
+HRESULT CMultiVolumeInStream::Open(const UString &firstVolumePath)
+{
+  Streams.Clear();
+  Names.Clear();
+
+  UString name;
+  SplitPathToParts_2(firstVolumePath, _dirPrefix, name);
+
+  unsigned numStart = 0, numEnd = 0;
+  Type = GetVolumeSetType(name, numStart, numEnd);
+
+  UString zipLastName;
+  if (Type == NVolumeSet::kZipSplit)
+  {
+    zipLastName = name.Left(numStart - 1);
+    zipLastName += (name[numStart - 1] == L'Z' ? L"ZIP" : L"zip");
+  }
+  else if (Type == NVolumeSet::kRarOld)
+  {
+    // name.rar is the first volume. The next one is name.r00
+    CMyComPtr<IInStream> streamRef;
+    CVolumeInStream *streamSpec = new CVolumeInStream;
+    streamRef = streamSpec;
+    if (!streamSpec->Open(us2fs(_dirPrefix + name)))
+      return S_FALSE;
+    CSubStreamInfo &subStream = Streams.AddNew();
+    subStream.Stream = streamRef;
+    subStream.Size = streamSpec->Size();
+    Names.Add(name);
+    name.DeleteFrom(numStart - 1);
+    name += L"r00";
+  }
+
+  for (;;)
+  {
+    CMyComPtr<IInStream> streamRef;
+    CVolumeInStream *streamSpec = new CVolumeInStream;
+    streamRef = streamSpec;
+    if (!streamSpec->Open(us2fs(_dirPrefix + name)))
+      break;
+    CSubStreamInfo &subStream = Streams.AddNew();
+    subStream.Stream = streamRef;
+    subStream.Size = streamSpec->Size();
+    Names.Add(name);
+    if (Type == NVolumeSet::kSingle)
+      break;
+    unsigned len = name.Len();
+    IncreaseNumber(name, numStart, numEnd);
+    if (name.Len() != len)
+    {
+      // the number got a new digit, so the position of the end moves too
+      if (Type == NVolumeSet::kRarOld)
+        break;
+      numEnd += name.Len() - len;
+    }
+  }
+
+  if (Type == NVolumeSet::kZipSplit)
+  {
+    // name.zip is always the last volume of zip split set
+    CMyComPtr<IInStream> streamRef;
+    CVolumeInStream *streamSpec = new CVolumeInStream;
+    streamRef = streamSpec;
+    if (!streamSpec->Open(us2fs(_dirPrefix + zipLastName)))
+      return S_FALSE;
+    CSubStreamInfo &subStream = Streams.AddNew();
+    subStream.Stream = streamRef;
+    subStream.Size = streamSpec->Size();
+    Names.Add(zipLastName);
+  }
+
+  if (Streams.IsEmpty())
+    return S_FALSE;
+  if (Streams.Size() == 1)
+    Type = NVolumeSet::kSingle;
+  return Init();
+}
+
+int CMultiVolumeInStream::FindVolume(const UString &name) const
+{
+  FOR_VECTOR (i, Names)
+    if (CompareFileNames(Names[i], name) == 0)
+      return i;
+  return -1;
+}
+
+STDMETHODIMP CMultiVolumeOpenCallback::GetProperty(PROPID propID, PROPVARIANT *value)
+{
+  NCOM::CPropVariant prop;
+  switch (propID)
+  {
+    case kpidName: prop = _volumes->Names[0]; break;
+    case kpidSize: prop = _volumes->Streams[0].Size; break;
+  }
+  prop.Detach(value);
+  return S_OK;
+}
+
+STDMETHODIMP CMultiVolumeOpenCallback::GetStream(const wchar_t *name, IInStream **inStream)
+{
+  *inStream = NULL;
+  int index = _volumes->FindVolume(name);
+  if (index >= 0)
+  {
+    CMyComPtr<IInStream> stream = _volumes->Streams[index].Stream;
+    RINOK(stream->Seek(0, STREAM_SEEK_SET, NULL));
+    *inStream = stream.Detach();
+    return S_OK;
+  }
+  // the handler can ask for a volume that doesn't follow the naming pattern of the set
+  CVolumeInStream *streamSpec = new CVolumeInStream;
+  CMyComPtr<IInStream> streamTemp = streamSpec;
+  if (!streamSpec->Open(us2fs(_volumes->GetDirPrefix() + name)))
+    return S_FALSE;
+  *inStream = streamTemp.Detach();
+  return S_OK;
+}
@@ -0,0 +1,89 @@
+// MultiVolumeInStream.h
+
+#ifndef __MULTI_VOLUME_IN_STREAM_H
+#define __MULTI_VOLUME_IN_STREAM_H
+
+#include "../../../Common/MyString.h"
+
+#include "../../../Windows/FileIO.h"
+
+#include "../IArchive.h"
+
+#include "MultiStream.h"
+
+/* CVolumeInStream reads one volume file with positional reads.
+   It keeps its own position, so any number of volumes can stay open
+   and Seek() never touches the file descriptor. */
+
+class CVolumeInStream:
+  public IInStream,
+  public IStreamGetSize,
+  public CMyUnknownImp
+{
+  UInt64 _pos;
+  UInt64 _size;
+public:
+  NWindows::NFile::NIO::CInFile File;
+
+  CVolumeInStream(): _pos(0), _size(0) {}
+  bool Open(CFSTR path);
+  UInt64 Size() const { return _size; }
+
+  MY_UNKNOWN_IMP2(IInStream, IStreamGetSize)
+
+  STDMETHOD(Read)(void *data, UInt32 size, UInt32 *processedSize);
+  STDMETHOD(Seek)(Int64 offset, UInt32 seekOrigin, UInt64 *newPosition);
+  STDMETHOD(GetSize)(UInt64 *size);
+};
+
+namespace NVolumeSet {
+
+enum EType
+{
+  kSingle,    // name.ext
+  kNumbered,  // name.ext.001, name.ext.002, ...
+  kZipSplit,  // name.z01, name.z02, ..., name.zip
+  kRarParts,  // name.part1.rar, name.part2.rar, ...
+  kRarOld     // name.rar, name.r00, name.r01, ...
+};
+
+}
+
+/* CMultiVolumeInStream opens all volumes of a set from the path of the
+   first volume. Numbered and zip split sets are byte-level splits, so
+   the volumes are concatenated via CMultiStream. RAR volumes can't be
+   concatenated: the handler asks for them by name via
+   IArchiveOpenVolumeCallback (see CMultiVolumeOpenCallback). */
+
+class CMultiVolumeInStream: public CMultiStream
+{
+  UString _dirPrefix;
+public:
+  NVolumeSet::EType Type;
+  UStringVector Names; // names of the volumes without _dirPrefix
+
+  CMultiVolumeInStream(): Type(NVolumeSet::kSingle) {}
+
+  HRESULT Open(const UString &firstVolumePath);
+
+  bool IsConcatenated() const
+    { return Type == NVolumeSet::kNumbered || Type == NVolumeSet::kZipSplit; }
+  int FindVolume(const UString &name) const;
+  const UString &GetDirPrefix() const { return _dirPrefix; }
+};
+
+class CMultiVolumeOpenCallback:
+  public IArchiveOpenVolumeCallback,
+  public CMyUnknownImp
+{
+  CMyComPtr<IInStream> _volumesRef;
+  CMultiVolumeInStream *_volumes;
+public:
+  CMultiVolumeOpenCallback(CMultiVolumeInStream *volumes): _volumesRef(volumes), _volumes(volumes) {}
+
+  MY_UNKNOWN_IMP1(IArchiveOpenVolumeCallback)
+
+  INTERFACE_IArchiveOpenVolumeCallback(;)
+};
+
+#endif
@@ -10,12 +10,19 @@
 #include "../../Common/UTFConvert.h"
 
 #include "../../Windows/PropVariant.h"
+#ifndef _7ZIP_ST
+#include "../../Windows/System.h"
+#endif
 
 #include "../Common/LimitedStreams.h"
+#include "../Common/MethodProps.h"
 #include "../Common/ProgressUtils.h"
 #include "../Common/RegisterArc.h"
 #include "../Common/StreamObjects.h"
 #include "../Common/StreamUtils.h"
+#ifndef _7ZIP_ST
+#include "../Common/VirtThread.h"
+#endif
 
 #include "../Compress/BZip2Decoder.h"
 #include "../Compress/CopyCoder.h"
@@ -174,6 +181,7 @@ struct CExtraFile
 class CHandler:
   public IInArchive,
   public IInArchiveGetStream,
+  public ISetProperties,
   public CMyUnknownImp
 {
   CMyComPtr<IInStream> _inStream;
@@ -187,12 +195,27 @@ class CHandler:
   CObjectVector<CExtraFile> _extras;
   #endif
 
+  #ifndef _7ZIP_ST
+  UInt32 _numThreads;
+  #endif
+
+  void InitDefaults()
+  {
+    #ifndef _7ZIP_ST
+    _numThreads = NWindows::NSystem::GetNumberOfProcessors();
+    #endif
+  }
+
+  UInt32 GetNumDecoders() const;
   HRESULT Open2(IInStream *stream);
   HRESULT Extract(IInStream *stream);
 public:
-  MY_UNKNOWN_IMP2(IInArchive, IInArchiveGetStream)
+  MY_UNKNOWN_IMP3(IInArchive, IInArchiveGetStream, ISetProperties)
   INTERFACE_IInArchive(;)
   STDMETHOD(GetStream)(UInt32 index, ISequentialInStream **stream);
+  STDMETHOD(SetProperties)(const wchar_t **names, const PROPVARIANT *values, UInt32 numProps);
+
+  CHandler() { InitDefaults(); }
 };
 
 const UInt32 kXmlSizeMax = ((UInt32)1 << 31) - (1 << 14);
@@ -1049,6 +1072,214 @@ STDMETHODIMP CAdcDecoder::Code(ISequentialInStream *inStream,
 }
 
 
+/* ADC, zlib and bzip2 blocks are decoded from memory to memory.
+   The blocks are independent, so several blocks can be decoded in parallel.
+   Extract() uses that path for blocks that are not larger than kMemBlockSizeMax. */
+
+static const UInt64 kMemBlockSizeMax = (UInt64)1 << 26;
+static const UInt64 kBatchSizeMax = (UInt64)1 << 27; // max unpack size of blocks decoded in one pass of Extract()
+static const UInt32 kNumThreadsMax = 64;
+
+static bool IsMemMethod(UInt32 type)
+{
+  return type == METHOD_ADC || type == METHOD_ZLIB || type == METHOD_BZIP2;
+}
+
+static bool IsMemBlock(const CBlock &block)
+{
+  return IsMemMethod(block.Type)
+      && block.UnpSize <= kMemBlockSizeMax
+      && block.PackSize <= kMemBlockSizeMax;
+}
+
+struct CBlockJob
+{
+  const CBlock *Block;
+  unsigned BlockIndex;
+  int ChunkIndex;       // used by CInStream
+  CByteBuffer PackBuf;
+  size_t PackSize;      // size of data in PackBuf. It can be smaller than Block->PackSize for truncated archive
+  CByteBuffer UnpackBuf;
+  Byte *Dest;
+  size_t OutSize;       // size of decoded data in Dest
+  HRESULT Result;       // S_OK, S_FALSE for data error, or another error code
+  bool InputSizeError;  // the decoder has finished before the end of packed data
+
+  HRESULT ReadPackData(IInStream *stream, UInt64 pos);
+};
+
+HRESULT CBlockJob::ReadPackData(IInStream *stream, UInt64 pos)
+{
+  PackSize = (size_t)Block->PackSize;
+  PackBuf.AllocAtLeast(PackSize);
+  RINOK(stream->Seek(pos, STREAM_SEEK_SET, NULL));
+  return ReadStream(stream, PackBuf, &PackSize);
+}
+
+class CBlockDecoder
+{
+  NCompress::NBZip2::CDecoder *bzip2CoderSpec;
+  CMyComPtr<ICompressCoder> bzip2Coder;
+
+  NCompress::NZlib::CDecoder *zlibCoderSpec;
+  CMyComPtr<ICompressCoder> zlibCoder;
+
+  CAdcDecoder *adcCoderSpec;
+  CMyComPtr<ICompressCoder> adcCoder;
+
+  CBufInStream *inStreamSpec;
+  CMyComPtr<ISequentialInStream> inStream;
+
+  CBufPtrSeqOutStream *outStreamSpec;
+  CMyComPtr<ISequentialOutStream> outStream;
+
+  HRESULT Decode2(CBlockJob &job);
+public:
+  void Decode(CBlockJob &job);
+};
+
+HRESULT CBlockDecoder::Decode2(CBlockJob &job)
+{
+  const CBlock &block = *job.Block;
+  if (!inStream)
+  {
+    inStreamSpec = new CBufInStream;
+    inStream = inStreamSpec;
+    outStreamSpec = new CBufPtrSeqOutStream;
+    outStream = outStreamSpec;
+  }
+  inStreamSpec->Init(job.PackBuf, job.PackSize);
+  outStreamSpec->Init(job.Dest, (size_t)block.UnpSize);
+
+  HRESULT res;
+  switch (block.Type)
+  {
+    case METHOD_ADC:
+      if (!adcCoder)
+      {
+        adcCoderSpec = new CAdcDecoder();
+        adcCoder = adcCoderSpec;
+      }
+      res = adcCoder->Code(inStream, outStream, &block.PackSize, &block.UnpSize, NULL);
+      break;
+
+    case METHOD_ZLIB:
+      if (!zlibCoder)
+      {
+        zlibCoderSpec = new NCompress::NZlib::CDecoder();
+        zlibCoder = zlibCoderSpec;
+      }
+      res = zlibCoder->Code(inStream, outStream, NULL, NULL, NULL);
+      if (res == S_OK && zlibCoderSpec->GetInputProcessedSize() != block.PackSize)
+        job.InputSizeError = true;
+      break;
+
+    case METHOD_BZIP2:
+      if (!bzip2Coder)
+      {
+        bzip2CoderSpec = new NCompress::NBZip2::CDecoder();
+        bzip2Coder = bzip2CoderSpec;
+      }
+      res = bzip2Coder->Code(inStream, outStream, NULL, NULL, NULL);
+      if (res == S_OK && bzip2CoderSpec->GetInputProcessedSize() != block.PackSize)
+        job.InputSizeError = true;
+      break;
+
+    default:
+      return E_NOTIMPL;
+  }
+  job.OutSize = outStreamSpec->GetPos();
+  return res;
+}
+
+void CBlockDecoder::Decode(CBlockJob &job)
+{
+  job.OutSize = 0;
+  job.InputSizeError = false;
+  try { job.Result = Decode2(job); }
+  catch(...) { job.Result = E_OUTOFMEMORY; }
+}
+
+#ifndef _7ZIP_ST
+
+class CDecoderThread: public CVirtThread
+{
+public:
+  CBlockDecoder Decoder;
+  CBlockJob *Job;
+
+  ~CDecoderThread() { CVirtThread::WaitThreadFinish(); }
+  virtual void Execute() { Decoder.Decode(*Job); }
+};
+
+#endif
+
+// CBlockDecoders::Decode() decodes jobs[0] in the calling thread and other jobs in the threads
+
+class CBlockDecoders
+{
+  CBlockDecoder _decoder;
+  #ifndef _7ZIP_ST
+  CObjectVector<CDecoderThread> _threads;
+  #endif
+public:
+  HRESULT Decode(CObjectVector<CBlockJob> &jobs, unsigned num);
+};
+
+HRESULT CBlockDecoders::Decode(CObjectVector<CBlockJob> &jobs, unsigned num)
+{
+  if (num == 0)
+    return S_OK;
+  unsigned i;
+  #ifndef _7ZIP_ST
+  while (_threads.Size() + 1 < num)
+  {
+    WRes wres = _threads.AddNew().Create();
+    if (wres != 0)
+    {
+      _threads.DeleteBack();
+      return wres;
+    }
+  }
+  for (i = 1; i < num; i++)
+  {
+    CDecoderThread &thread = _threads[i - 1];
+    thread.Job = &jobs[i];
+    thread.Start();
+  }
+  #endif
+  _decoder.Decode(jobs[0]);
+  #ifndef _7ZIP_ST
+  for (i = 1; i < num; i++)
+    _threads[i - 1].WaitExecuteFinish();
+  #else
+  for (i = 1; i < num; i++)
+    _decoder.Decode(jobs[i]);
+  #endif
+  return S_OK;
+}
+
+UInt32 CHandler::GetNumDecoders() const
+{
+  #ifndef _7ZIP_ST
+  if (_numThreads > 1)
+    return MyMin(_numThreads, kNumThreadsMax);
+  #endif
+  return 1;
+}
+
+static HRESULT WriteZeros(CLimitedSequentialOutStream *outStreamSpec, ISequentialOutStream *outStream,
+    const Byte *zeroBuf, UInt32 zeroBufSize)
+{
+  while (outStreamSpec->GetRem() != 0)
+  {
+    UInt64 rem = outStreamSpec->GetRem();
+    UInt32 size = (UInt32)MyMin(rem, (UInt64)zeroBufSize);
+    RINOK(WriteStream(outStream, zeroBuf, size));
+  }
+  return S_OK;
+}
+
 STDMETHODIMP CHandler::Extract(const UInt32 *indices, UInt32 numItems,
     Int32 testMode, IArchiveExtractCallback *extractCallback)
 {
@@ -1101,6 +1332,14 @@ STDMETHODIMP CHandler::Extract(const UInt32 *indices, UInt32 numItems,
   CMyComPtr<ISequentialInStream> inStream(streamSpec);
   streamSpec->SetStream(_inStream);
 
+  CBlockDecoders decoders;
+  CObjectVector<CBlockJob> jobs;
+  {
+    UInt32 numDecoders = GetNumDecoders();
+    for (UInt32 t = 0; t < numDecoders; t++)
+      jobs.AddNew();
+  }
+
   for (i = 0; i < numItems; i++, currentPackTotal += currentPackSize, currentUnpTotal += currentUnpSize)
   {
     lps->InSize = currentPackTotal;
@@ -1153,13 +1392,80 @@ STDMETHODIMP CHandler::Extract(const UInt32 *indices, UInt32 numItems,
       UInt64 unpPos = 0;
       UInt64 packPos = 0;
       {
-        FOR_VECTOR (j, item.Blocks)
+        for (unsigned j = 0; j < item.Blocks.Size();)
         {
           lps->InSize = currentPackTotal + packPos;
           lps->OutSize = currentUnpTotal + unpPos;
           RINOK(lps->SetCur());
 
           const CBlock &block = item.Blocks[j];
+
+          if (IsMemBlock(block))
+          {
+            /* we read the packed data of the sequence of such blocks,
+               decode these blocks in parallel and write the data in order of blocks. */
+            unsigned numJobs = 0;
+            UInt64 batchSize = 0;
+            for (; j < item.Blocks.Size() && numJobs < jobs.Size(); j++)
+            {
+              const CBlock &b = item.Blocks[j];
+              if (!b.ThereAreDataInBlock())
+                continue;
+              if (!IsMemBlock(b) || (numJobs != 0 && batchSize + b.UnpSize > kBatchSizeMax))
+                break;
+              batchSize += b.UnpSize;
+              CBlockJob &job = jobs[numJobs++];
+              job.Block = &b;
+              job.BlockIndex = j;
+              RINOK(job.ReadPackData(_inStream, _startPos + item.StartPos + b.PackPos));
+              job.UnpackBuf.AllocAtLeast((size_t)b.UnpSize);
+              job.Dest = job.UnpackBuf;
+            }
+            RINOK(decoders.Decode(jobs, numJobs));
+
+            bool posError = false;
+            for (unsigned k = 0; k < numJobs; k++)
+            {
+              const CBlockJob &job = jobs[k];
+              const CBlock &b = *job.Block;
+              if (k != 0)
+              {
+                lps->InSize = currentPackTotal + packPos;
+                lps->OutSize = currentUnpTotal + unpPos;
+                RINOK(lps->SetCur());
+              }
+              packPos += b.PackSize;
+              if (b.UnpPos != unpPos)
+              {
+                posError = true;
+                break;
+              }
+              outStreamSpec->Init(b.UnpSize);
+              outCrcStreamSpec->EnableCalc(needCrc);
+              if (job.Result != S_OK && job.Result != S_FALSE)
+                return job.Result;
+              RINOK(WriteStream(outStream, job.Dest, job.OutSize));
+              if (job.InputSizeError)
+                opRes = NExtract::NOperationResult::kDataError;
+              if (job.Result != S_OK && opRes == NExtract::NOperationResult::kOK)
+                opRes = NExtract::NOperationResult::kDataError;
+              unpPos += b.UnpSize;
+              if (!outStreamSpec->IsFinishedOK())
+              {
+                if (opRes == NExtract::NOperationResult::kOK)
+                  opRes = NExtract::NOperationResult::kDataError;
+                RINOK(WriteZeros(outStreamSpec, outStream, zeroBuf, kZeroBufSize));
+              }
+            }
+            if (posError)
+            {
+              opRes = NExtract::NOperationResult::kDataError;
+              break;
+            }
+            continue;
+          }
+
+          j++;
           if (!block.ThereAreDataInBlock())
             continue;
 
@@ -1237,13 +1543,7 @@ STDMETHODIMP CHandler::Extract(const UInt32 *indices, UInt32 numItems,
           {
             if (realMethod && opRes == NExtract::NOperationResult::kOK)
               opRes = NExtract::NOperationResult::kDataError;
-
-            while (outStreamSpec->GetRem() != 0)
-            {
-              UInt64 rem = outStreamSpec->GetRem();
-              UInt32 size = (UInt32)MyMin(rem, (UInt64)kZeroBufSize);
-              RINOK(WriteStream(outStream, zeroBuf, size));
-            }
+            RINOK(WriteZeros(outStreamSpec, outStream, zeroBuf, kZeroBufSize));
           }
         }
       }
@@ -1262,11 +1562,21 @@ STDMETHODIMP CHandler::Extract(const UInt32 *indices, UInt32 numItems,
 
 struct CChunk
 {
-  int BlockIndex;
-  UInt64 AccessMark;
+  int BlockIndex; // -1, if there is no block in chunk
+  int Prev;       // in LRU list: (Prev) is more recently used chunk
+  int Next;
   CByteBuffer Buf;
 };
 
+/* CInStream keeps decoded blocks in chunks.
+   (_blockToChunk) is index of chunk for each block, and the cached chunks are
+   linked to LRU list. The total size of chunk buffers is limited by kCacheSizeMax:
+   the least recently used chunks are reused or freed, if a new block doesn't fit.
+   If the blocks are read sequentially, the next blocks are decoded in advance
+   together with current block. */
+
+static const UInt64 kCacheSizeMax = (UInt64)1 << 27;
+
 class CInStream:
   public IInStream,
   public CMyUnknownImp
@@ -1274,29 +1584,29 @@ class CInStream:
   UInt64 _virtPos;
   int _latestChunk;
   int _latestBlock;
-  UInt64 _accessMark;
-  CObjectVector<CChunk> _chunks;
-
-  NCompress::NBZip2::CDecoder *bzip2CoderSpec;
-  CMyComPtr<ICompressCoder> bzip2Coder;
-
-  NCompress::NZlib::CDecoder *zlibCoderSpec;
-  CMyComPtr<ICompressCoder> zlibCoder;
-
-  CAdcDecoder *adcCoderSpec;
-  CMyComPtr<ICompressCoder> adcCoder;
-
-  CBufPtrSeqOutStream *outStreamSpec;
-  CMyComPtr<ISequentialOutStream> outStream;
-
-  CLimitedSequentialInStream *limitedStreamSpec;
-  CMyComPtr<ISequentialInStream> inStream;
+  unsigned _nextBlock; // the block that follows the latest block in sequential reading
 
+  CObjectVector<CChunk> _chunks;
+  CRecordVector<int> _blockToChunk;
+  CRecordVector<int> _freeChunks; // the chunks without buffer
+  int _head;                      // most recently used chunk
+  int _tail;                      // least recently used chunk
+  UInt64 _cacheSize;
+
+  CObjectVector<CBlockJob> _jobs;
+  CBlockDecoders _decoders;
+
+  void Unlink(int index);
+  void LinkFirst(int index);
+  void LinkLast(int index);
+  int AllocChunk(size_t size);
+  HRESULT LoadBlocks(unsigned blockIndex);
 public:
   CMyComPtr<IInStream> Stream;
   UInt64 Size;
   const CFile *File;
   UInt64 _startPos;
+  UInt32 NumDecoders;
 
   HRESULT InitAndSeek(UInt64 startPos)
   {
@@ -1304,14 +1614,16 @@ public:
     _virtPos = 0;
     _latestChunk = -1;
     _latestBlock = -1;
-    _accessMark = 0;
-
-    limitedStreamSpec = new CLimitedSequentialInStream;
-    inStream = limitedStreamSpec;
-    limitedStreamSpec->SetStream(Stream);
-
-    outStreamSpec = new CBufPtrSeqOutStream;
-    outStream = outStreamSpec;
+    _nextBlock = 0;
+    _head = -1;
+    _tail = -1;
+    _cacheSize = 0;
+
+    _blockToChunk.ClearAndSetSize(File->Blocks.Size());
+    FOR_VECTOR (i, _blockToChunk)
+      _blockToChunk[i] = -1;
+    for (UInt32 t = 0; t < NumDecoders; t++)
+      _jobs.AddNew();
     return S_OK;
   }
 
@@ -1337,6 +1649,147 @@ int FindBlock(const CRecordVector<CBlock> &blocks, UInt64 pos)
   }
 }
 
+void CInStream::Unlink(int index)
+{
+  CChunk &chunk = _chunks[index];
+  if (chunk.Prev >= 0)
+    _chunks[chunk.Prev].Next = chunk.Next;
+  else
+    _head = chunk.Next;
+  if (chunk.Next >= 0)
+    _chunks[chunk.Next].Prev = chunk.Prev;
+  else
+    _tail = chunk.Prev;
+}
+
+void CInStream::LinkFirst(int index)
+{
+  CChunk &chunk = _chunks[index];
+  chunk.Prev = -1;
+  chunk.Next = _head;
+  if (_head >= 0)
+    _chunks[_head].Prev = index;
+  else
+    _tail = index;
+  _head = index;
+}
+
+void CInStream::LinkLast(int index)
+{
+  CChunk &chunk = _chunks[index];
+  chunk.Next = -1;
+  chunk.Prev = _tail;
+  if (_tail >= 0)
+    _chunks[_tail].Next = index;
+  else
+    _head = index;
+  _tail = index;
+}
+
+// it returns the chunk that is not linked to LRU list
+
+int CInStream::AllocChunk(size_t size)
+{
+  while (_tail >= 0 && _cacheSize + size > kCacheSizeMax)
+  {
+    int index = _tail;
+    Unlink(index);
+    CChunk &chunk = _chunks[index];
+    if (chunk.BlockIndex >= 0)
+    {
+      _blockToChunk[chunk.BlockIndex] = -1;
+      chunk.BlockIndex = -1;
+    }
+    if (chunk.Buf.Size() >= size)
+      return index;
+    _cacheSize -= chunk.Buf.Size();
+    chunk.Buf.Free();
+    _freeChunks.Add(index);
+  }
+  int index;
+  if (!_freeChunks.IsEmpty())
+  {
+    index = _freeChunks.Back();
+    _freeChunks.DeleteBack();
+  }
+  else
+  {
+    index = _chunks.Size();
+    _chunks.AddNew();
+  }
+  CChunk &chunk = _chunks[index];
+  chunk.BlockIndex = -1;
+  chunk.Buf.Alloc(size);
+  _cacheSize += size;
+  return index;
+}
+
+HRESULT CInStream::LoadBlocks(unsigned blockIndex)
+{
+  const CRecordVector<CBlock> &blocks = File->Blocks;
+  {
+    const CBlock &block = blocks[blockIndex];
+    if (!IsMemMethod(block.Type))
+      return E_FAIL;
+    if (block.UnpSize > ((UInt32)1 << 31) || block.PackSize > ((UInt32)1 << 31))
+      return E_FAIL;
+  }
+
+  unsigned numJobs = 0;
+  {
+    unsigned numJobsMax = (blockIndex == _nextBlock) ? _jobs.Size() : 1;
+    unsigned limit = blockIndex + numJobsMax * 2;
+    if (limit > blocks.Size())
+      limit = blocks.Size();
+    for (unsigned i = blockIndex; i < limit && numJobs < numJobsMax; i++)
+    {
+      const CBlock &block = blocks[i];
+      if (i != blockIndex && (_blockToChunk[i] >= 0 || !IsMemBlock(block)))
+        continue;
+      CBlockJob &job = _jobs[numJobs++];
+      job.Block = &block;
+      job.BlockIndex = i;
+      job.ChunkIndex = AllocChunk((size_t)block.UnpSize);
+      job.Dest = _chunks[job.ChunkIndex].Buf;
+      HRESULT res = job.ReadPackData(Stream, _startPos + File->StartPos + block.PackPos);
+      if (res != S_OK)
+      {
+        for (unsigned k = 0; k < numJobs; k++)
+          LinkLast(_jobs[k].ChunkIndex);
+        return res;
+      }
+    }
+  }
+
+  RINOK(_decoders.Decode(_jobs, numJobs));
+
+  // the requested block must be the head of LRU list, so we link the chunks in reverse order
+  HRESULT res = S_OK;
+  for (unsigned k = numJobs; k != 0;)
+  {
+    k--;
+    const CBlockJob &job = _jobs[k];
+    HRESULT jobRes = job.Result;
+    if (jobRes == S_OK && job.InputSizeError)
+      jobRes = S_FALSE;
+    if (jobRes == S_OK && job.OutSize != job.Block->UnpSize)
+      jobRes = E_FAIL;
+    if (jobRes == S_OK)
+    {
+      _chunks[job.ChunkIndex].BlockIndex = job.BlockIndex;
+      _blockToChunk[job.BlockIndex] = job.ChunkIndex;
+      LinkFirst(job.ChunkIndex);
+    }
+    else
+    {
+      LinkLast(job.ChunkIndex);
+      if (k == 0)
+        res = jobRes;
+    }
+  }
+  return res;
+}
+
 STDMETHODIMP CInStream::Read(void *data, UInt32 size, UInt32 *processedSize)
 {
   COM_TRY_BEGIN
@@ -1366,92 +1819,18 @@ STDMETHODIMP CInStream::Read(void *data, UInt32 size, UInt32 *processedSize)
     const CBlock &block = File->Blocks[blockIndex];
     if (!block.IsZeroMethod() && block.Type != METHOD_COPY)
     {
-      unsigned i;
-      for (i = 0; i < _chunks.Size(); i++)
-        if (_chunks[i].BlockIndex == blockIndex)
-          break;
-      if (i != _chunks.Size())
-        _latestChunk = i;
-      else
+      if (_blockToChunk[blockIndex] < 0)
       {
-        const int kNumChunksMax = 128;
-        int chunkIndex;
-        if (_chunks.Size() != kNumChunksMax)
-          chunkIndex = _chunks.Add(CChunk());
-        else
-        {
-          chunkIndex = 0;
-          for (i = 0; i < _chunks.Size(); i++)
-            if (_chunks[i].AccessMark < _chunks[chunkIndex].AccessMark)
-              chunkIndex = i;
-        }
-        CChunk &chunk = _chunks[chunkIndex];
-        chunk.BlockIndex = -1;
-        chunk.AccessMark = 0;
-        if (chunk.Buf.Size() < block.UnpSize)
-        {
-          chunk.Buf.Free();
-          if (block.UnpSize > ((UInt32)1 << 31))
-            return E_FAIL;
-          chunk.Buf.Alloc((size_t)block.UnpSize);
-        }
-        outStreamSpec->Init(chunk.Buf, (size_t)block.UnpSize);
-
-        RINOK(Stream->Seek(_startPos + File->StartPos + block.PackPos, STREAM_SEEK_SET, NULL));
-
-        limitedStreamSpec->Init(block.PackSize);
-        HRESULT res = S_OK;
-        switch (block.Type)
-        {
-          case METHOD_COPY:
-            if (block.PackSize != block.UnpSize)
-              return E_FAIL;
-            res = ReadStream_FAIL(inStream, chunk.Buf, (size_t)block.UnpSize);
-            break;
-
-          case METHOD_ADC:
-            if (!adcCoder)
-            {
-              adcCoderSpec = new CAdcDecoder();
-              adcCoder = adcCoderSpec;
-            }
-            res = adcCoder->Code(inStream, outStream, &block.PackSize, &block.UnpSize, NULL);
-            break;
-
-          case METHOD_ZLIB:
-            if (!zlibCoder)
-            {
-              zlibCoderSpec = new NCompress::NZlib::CDecoder();
-              zlibCoder = zlibCoderSpec;
-            }
-            res = zlibCoder->Code(inStream, outStream, NULL, NULL, NULL);
-            if (res == S_OK && zlibCoderSpec->GetInputProcessedSize() != block.PackSize)
-              res = S_FALSE;
-            break;
-
-          case METHOD_BZIP2:
-            if (!bzip2Coder)
-            {
-              bzip2CoderSpec = new NCompress::NBZip2::CDecoder();
-              bzip2Coder = bzip2CoderSpec;
-            }
-            res = bzip2Coder->Code(inStream, outStream, NULL, NULL, NULL);
-            if (res == S_OK && bzip2CoderSpec->GetInputProcessedSize() != block.PackSize)
-              res = S_FALSE;
-            break;
-
-          default:
-            return E_FAIL;
-        }
-        if (res != S_OK)
-          return res;
-        if (block.Type != METHOD_COPY && outStreamSpec->GetPos() != block.UnpSize)
-          return E_FAIL;
-        chunk.BlockIndex = blockIndex;
-        _latestChunk = chunkIndex;
+        RINOK(LoadBlocks(blockIndex));
+      }
+      else if (_head != _blockToChunk[blockIndex])
+      {
+        Unlink(_blockToChunk[blockIndex]);
+        LinkFirst(_blockToChunk[blockIndex]);
       }
-      _chunks[_latestChunk].AccessMark = _accessMark++;
+      _latestChunk = _blockToChunk[blockIndex];
     }
+    _nextBlock = blockIndex + 1;
     _latestBlock = blockIndex;
   }
 
@@ -1525,12 +1904,35 @@ STDMETHODIMP CHandler::GetStream(UInt32 index, ISequentialInStream **stream)
   }
   spec->Stream = _inStream;
   spec->Size = spec->File->Size;
+  spec->NumDecoders = GetNumDecoders();
   RINOK(spec->InitAndSeek(_startPos));
   *stream = specStream.Detach();
   return S_OK;
   COM_TRY_END
 }
 
+STDMETHODIMP CHandler::SetProperties(const wchar_t **names, const PROPVARIANT *values, UInt32 numProps)
+{
+  InitDefaults();
+  for (UInt32 i = 0; i < numProps; i++)
+  {
+    UString name = names[i];
+    name.MakeLower_Ascii();
+    if (name.IsEmpty())
+      return E_INVALIDARG;
+    const PROPVARIANT &prop = values[i];
+    if (name.IsPrefixedBy(L"mt"))
+    {
+      #ifndef _7ZIP_ST
+      RINOK(ParseMtProp(name.Ptr(2), prop, NWindows::NSystem::GetNumberOfProcessors(), _numThreads));
+      #endif
+    }
+    else
+      return E_INVALIDARG;
+  }
+  return S_OK;
+}
+
 IMP_CreateArcIn
 
 static CArcInfo g_ArcInfo =
@@ -23,6 +23,7 @@
 #include "../Compress/CopyCoder.h"
 
 #include "Common/DummyOutStream.h"
+#include "Common/ExtractOrder.h"
 
 #define Get16(p) GetUi16(p)
 #define Get32(p) GetUi32(p)
@@ -723,20 +724,37 @@ class CHandler:
   public CMyUnknownImp,
   CDatabase
 {
+  UInt64 GetPhyPos(UInt32 index) const;
+  HRESULT GetItemStream(IInStream *inStream, UInt32 index, ISequentialInStream **stream);
 public:
   MY_UNKNOWN_IMP2(IInArchive, IInArchiveGetStream)
   INTERFACE_IInArchive(;)
   STDMETHOD(GetStream)(UInt32 index, ISequentialInStream **stream);
 };
 
+UInt64 CHandler::GetPhyPos(UInt32 index) const
+{
+  const CItem &item = Items[index];
+  if (item.IsDir() || item.Size == 0 || !Header.IsValidCluster(item.Cluster))
+    return 0;
+  return ((UInt64)Header.DataSector << Header.SectorSizeLog) +
+      ((UInt64)(item.Cluster - 2) << Header.ClusterSizeLog);
+}
+
 STDMETHODIMP CHandler::GetStream(UInt32 index, ISequentialInStream **stream)
 {
   COM_TRY_BEGIN
+  return GetItemStream(InStream, index, stream);
+  COM_TRY_END
+}
+
+HRESULT CHandler::GetItemStream(IInStream *inStream, UInt32 index, ISequentialInStream **stream)
+{
   *stream = 0;
   const CItem &item = Items[index];
   CClusterInStream *streamSpec = new CClusterInStream;
   CMyComPtr<ISequentialInStream> streamTemp = streamSpec;
-  streamSpec->Stream = InStream;
+  streamSpec->Stream = inStream;
   streamSpec->StartOffset = Header.DataSector << Header.SectorSizeLog;
   streamSpec->BlockSizeLog = Header.ClusterSizeLog;
   streamSpec->Size = item.Size;
@@ -769,7 +787,6 @@ STDMETHODIMP CHandler::GetStream(UInt32 index, ISequentialInStream **stream)
   RINOK(streamSpec->InitAndSeek());
   *stream = streamTemp.Detach();
   return S_OK;
-  COM_TRY_END
 }
 
 static const Byte kProps[] =
@@ -943,12 +960,17 @@ STDMETHODIMP CHandler::Extract(const UInt32 *indices, UInt32 numItems,
     return S_OK;
   UInt32 i;
   UInt64 totalSize = 0;
+  CPhyOrder order;
+  order.Reserve(numItems);
   for (i = 0; i < numItems; i++)
   {
-    const CItem &item = Items[allFilesMode ? i : indices[i]];
+    UInt32 index = allFilesMode ? i : indices[i];
+    const CItem &item = Items[index];
     if (!item.IsDir())
       totalSize += item.Size;
+    order.Add(index, GetPhyPos(index), item.Size);
   }
+  order.Sort();
   RINOK(extractCallback->SetTotal(totalSize));
 
   UInt64 totalPackSize;
@@ -964,6 +986,11 @@ STDMETHODIMP CHandler::Extract(const UInt32 *indices, UInt32 numItems,
   CDummyOutStream *outStreamSpec = new CDummyOutStream;
   CMyComPtr<ISequentialOutStream> outStream(outStreamSpec);
 
+  CReadAheadInStream *readStreamSpec = new CReadAheadInStream;
+  CMyComPtr<IInStream> readStream = readStreamSpec;
+  readStreamSpec->SetStream(InStream);
+  RINOK(readStreamSpec->Init());
+
   for (i = 0; i < numItems; i++)
   {
     lps->InSize = totalPackSize;
@@ -973,7 +1000,8 @@ STDMETHODIMP CHandler::Extract(const UInt32 *indices, UInt32 numItems,
     Int32 askMode = testMode ?
         NExtract::NAskMode::kTest :
         NExtract::NAskMode::kExtract;
-    Int32 index = allFilesMode ? i : indices[i];
+    UInt32 index = order.GetIndex(i);
+    readStreamSpec->SetReadAheadEnd(order.GetSpanEnd(i));
     const CItem &item = Items[index];
     RINOK(extractCallback->GetStream(index, &realOutStream, askMode));
 
@@ -997,7 +1025,7 @@ STDMETHODIMP CHandler::Extract(const UInt32 *indices, UInt32 numItems,
 
     int res = NExtract::NOperationResult::kDataError;
     CMyComPtr<ISequentialInStream> inStream;
-    HRESULT hres = GetStream(index, &inStream);
+    HRESULT hres = GetItemStream(readStream, index, &inStream);
     if (hres != S_FALSE)
     {
       RINOK(hres);
@@ -16,6 +16,8 @@
 
 #include "../Compress/ZlibDecoder.h"
 
+#include "Common/ExtractOrder.h"
+
 /* if HFS_SHOW_ALT_STREAMS is defined, the handler will show attribute files
    and resource forks. In most cases it looks useless. So we disable it. */
 
@@ -1270,9 +1272,11 @@ class CHandler:
 {
   CMyComPtr<IInStream> _stream;
 
-  HRESULT GetForkStream(const CFork &fork, ISequentialInStream **stream);
+  UInt64 GetPhyPos(const CRef &ref, UInt64 &size) const;
+  HRESULT GetForkStream(IInStream *inStream, const CFork &fork, ISequentialInStream **stream);
 
   HRESULT ExtractZlibFile(
+      IInStream *inStream,
       ISequentialOutStream *realOutStream,
       const CItem &item,
       NCompress::NZlib::CDecoder *_zlibDecoderSpec,
@@ -1489,6 +1493,7 @@ STDMETHODIMP CHandler::Close()
 static const UInt32 kCompressionBlockSize = 1 << 16;
 
 HRESULT CHandler::ExtractZlibFile(
+    IInStream *forkInStream,
     ISequentialOutStream *outStream,
     const CItem &item,
     NCompress::NZlib::CDecoder *_zlibDecoderSpec,
@@ -1498,7 +1503,7 @@ HRESULT CHandler::ExtractZlibFile(
 {
   CMyComPtr<ISequentialInStream> inStream;
   const CFork &fork = item.ResourceFork;
-  RINOK(GetForkStream(fork, &inStream));
+  RINOK(GetForkStream(forkInStream, fork, &inStream));
   const unsigned kHeaderSize = 0x100 + 8;
   RINOK(ReadStream_FALSE(inStream, buf, kHeaderSize));
   UInt32 dataPos = Get32(buf);
@@ -1625,6 +1630,33 @@ HRESULT CHandler::ExtractZlibFile(
   return S_OK;
 }
 
+UInt64 CHandler::GetPhyPos(const CRef &ref, UInt64 &size) const
+{
+  size = 0;
+  if (ref.AttrIndex >= 0)
+    return 0;
+  const CItem &item = Items[ref.ItemIndex];
+  if (item.IsDir())
+    return 0;
+  const CFork *fork = &item.GetFork(ref.IsResource);
+  if (item.UseAttr)
+  {
+    if (item.UseInlineData || item.Method == kMethod_Attr)
+      return 0;
+    fork = &item.ResourceFork;
+  }
+  FOR_VECTOR (i, fork->Extents)
+  {
+    const CExtent &e = fork->Extents[i];
+    if (e.NumBlocks != 0)
+    {
+      size = fork->Size;
+      return (UInt64)e.Pos << Header.BlockSizeLog;
+    }
+  }
+  return 0;
+}
+
 STDMETHODIMP CHandler::Extract(const UInt32 *indices, UInt32 numItems,
     Int32 testMode, IArchiveExtractCallback *extractCallback)
 {
@@ -1636,11 +1668,18 @@ STDMETHODIMP CHandler::Extract(const UInt32 *indices, UInt32 numItems,
     return S_OK;
   UInt32 i;
   UInt64 totalSize = 0;
+  CPhyOrder order;
+  order.Reserve(numItems);
   for (i = 0; i < numItems; i++)
   {
-    const CRef &ref = Refs[allFilesMode ? i : indices[i]];
+    UInt32 index = allFilesMode ? i : indices[i];
+    const CRef &ref = Refs[index];
     totalSize += Get_UnpackSize_of_Ref(ref);
+    UInt64 phySize;
+    const UInt64 pos = GetPhyPos(ref, phySize);
+    order.Add(index, pos, phySize);
   }
+  order.Sort();
   RINOK(extractCallback->SetTotal(totalSize));
 
   UInt64 currentTotalSize = 0, currentItemSize = 0;
@@ -1651,10 +1690,16 @@ STDMETHODIMP CHandler::Extract(const UInt32 *indices, UInt32 numItems,
   NCompress::NZlib::CDecoder *_zlibDecoderSpec = NULL;
   CMyComPtr<ICompressCoder> _zlibDecoder;
 
+  CReadAheadInStream *readStreamSpec = new CReadAheadInStream;
+  CMyComPtr<IInStream> readStream = readStreamSpec;
+  readStreamSpec->SetStream(_stream);
+  RINOK(readStreamSpec->Init());
+
   for (i = 0; i < numItems; i++, currentTotalSize += currentItemSize)
   {
     RINOK(extractCallback->SetCompleted(&currentTotalSize));
-    UInt32 index = allFilesMode ? i : indices[i];
+    UInt32 index = order.GetIndex(i);
+    readStreamSpec->SetReadAheadEnd(order.GetSpanEnd(i));
     const CRef &ref = Refs[index];
     const CItem &item = Items[ref.ItemIndex];
     currentItemSize = Get_UnpackSize_of_Ref(ref);
@@ -1721,7 +1766,7 @@ STDMETHODIMP CHandler::Extract(const UInt32 *indices, UInt32 numItems,
         }
         else
         {
-          HRESULT hres = ExtractZlibFile(realOutStream, item, _zlibDecoderSpec, buf,
+          HRESULT hres = ExtractZlibFile(readStream, realOutStream, item, _zlibDecoderSpec, buf,
             currentTotalSize, extractCallback);
           if (hres != S_FALSE)
           {
@@ -1746,7 +1791,7 @@ STDMETHODIMP CHandler::Extract(const UInt32 *indices, UInt32 numItems,
           if (fork.Size == pos)
             break;
           const CExtent &e = fork.Extents[extentIndex];
-          RINOK(_stream->Seek((UInt64)e.Pos << Header.BlockSizeLog, STREAM_SEEK_SET, NULL));
+          RINOK(readStream->Seek((UInt64)e.Pos << Header.BlockSizeLog, STREAM_SEEK_SET, NULL));
           UInt64 extentRem = (UInt64)e.NumBlocks << Header.BlockSizeLog;
           while (extentRem != 0)
           {
@@ -1763,7 +1808,7 @@ STDMETHODIMP CHandler::Extract(const UInt32 *indices, UInt32 numItems,
               cur = (size_t)rem;
             if (cur > extentRem)
               cur = (size_t)extentRem;
-            RINOK(ReadStream(_stream, buf, &cur));
+            RINOK(ReadStream(readStream, buf, &cur));
             if (cur == 0)
             {
               res = NExtract::NOperationResult::kDataError;
@@ -1796,7 +1841,7 @@ STDMETHODIMP CHandler::GetNumberOfItems(UInt32 *numItems)
   return S_OK;
 }
 
-HRESULT CHandler::GetForkStream(const CFork &fork, ISequentialInStream **stream)
+HRESULT CHandler::GetForkStream(IInStream *inStream, const CFork &fork, ISequentialInStream **stream)
 {
   *stream = 0;
 
@@ -1836,7 +1881,7 @@ HRESULT CHandler::GetForkStream(const CFork &fork, ISequentialInStream **stream)
   se.Phy = 0;
   se.Virt = virt;
   extentStreamSpec->Extents.Add(se);
-  extentStreamSpec->Stream = _stream;
+  extentStreamSpec->Stream = inStream;
   extentStreamSpec->Init();
   *stream = extentStream.Detach();
   return S_OK;
@@ -1853,7 +1898,7 @@ STDMETHODIMP CHandler::GetStream(UInt32 index, ISequentialInStream **stream)
   if (item.IsDir() || item.UseAttr)
     return S_FALSE;
 
-  return GetForkStream(item.GetFork(ref.IsResource), stream);
+  return GetForkStream(_stream, item.GetFork(ref.IsResource), stream);
 }
 
 IMP_CreateArcIn
@@ -14,6 +14,7 @@
 
 #include "../../Compress/CopyCoder.h"
 
+#include "../Common/ExtractOrder.h"
 #include "../Common/ItemNameUtils.h"
 
 #include "IsoHandler.h"
@@ -241,20 +242,34 @@ STDMETHODIMP CHandler::Extract(const UInt32 *indices, UInt32 numItems,
   if (numItems == 0)
     return S_OK;
   UInt64 totalSize = 0;
+  CPhyOrder order;
+  order.Reserve(numItems);
   UInt32 i;
   for (i = 0; i < numItems; i++)
   {
     UInt32 index = (allFilesMode ? i : indices[i]);
+    UInt64 pos = 0;
+    UInt64 size = 0;
     if (index < (UInt32)_archive.Refs.Size())
     {
       const CRef &ref = _archive.Refs[index];
       const CDir &item = ref.Dir->_subItems[ref.Index];
       if (!item.IsDir())
-        totalSize += ref.TotalSize;
+      {
+        size = ref.TotalSize;
+        pos = (UInt64)item.ExtentLocation * _archive.BlockSize;
+      }
     }
     else
-      totalSize += _archive.GetBootItemSize(index - _archive.Refs.Size());
+    {
+      unsigned bootIndex = index - _archive.Refs.Size();
+      size = _archive.GetBootItemSize(bootIndex);
+      pos = (UInt64)_archive.BootEntries[bootIndex].LoadRBA * _archive.BlockSize;
+    }
+    totalSize += size;
+    order.Add(index, pos, size);
   }
+  order.Sort();
   extractCallback->SetTotal(totalSize);
 
   UInt64 currentTotalSize = 0;
@@ -267,9 +282,14 @@ STDMETHODIMP CHandler::Extract(const UInt32 *indices, UInt32 numItems,
   CMyComPtr<ICompressProgressInfo> progress = lps;
   lps->Init(extractCallback, false);
 
+  CReadAheadInStream *readStreamSpec = new CReadAheadInStream;
+  CMyComPtr<IInStream> readStream = readStreamSpec;
+  readStreamSpec->SetStream(_stream);
+  RINOK(readStreamSpec->Init());
+
   CLimitedSequentialInStream *streamSpec = new CLimitedSequentialInStream;
   CMyComPtr<ISequentialInStream> inStream(streamSpec);
-  streamSpec->SetStream(_stream);
+  streamSpec->SetStream(readStream);
 
   for (i = 0; i < numItems; i++, currentTotalSize += currentItemSize)
   {
@@ -280,7 +300,8 @@ STDMETHODIMP CHandler::Extract(const UInt32 *indices, UInt32 numItems,
     Int32 askMode = testMode ?
         NExtract::NAskMode::kTest :
         NExtract::NAskMode::kExtract;
-    UInt32 index = allFilesMode ? i : indices[i];
+    UInt32 index = order.GetIndex(i);
+    readStreamSpec->SetReadAheadEnd(order.GetSpanEnd(i));
 
     RINOK(extractCallback->GetStream(index, &realOutStream, askMode));
 
@@ -322,7 +343,7 @@ STDMETHODIMP CHandler::Extract(const UInt32 *indices, UInt32 numItems,
         if (e != 0)
           lps->InSize = lps->OutSize = currentTotalSize + offset;
         const CDir &item2 = ref.Dir->_subItems[ref.Index + e];
-        RINOK(_stream->Seek((UInt64)item2.ExtentLocation * _archive.BlockSize, STREAM_SEEK_SET, NULL));
+        RINOK(readStream->Seek((UInt64)item2.ExtentLocation * _archive.BlockSize, STREAM_SEEK_SET, NULL));
         streamSpec->Init(item2.Size);
         RINOK(copyCoder->Code(inStream, realOutStream, NULL, NULL, progress));
         if (copyCoderSpec->TotalSize != item2.Size)
@@ -335,7 +356,7 @@ STDMETHODIMP CHandler::Extract(const UInt32 *indices, UInt32 numItems,
     }
     else
     {
-      RINOK(_stream->Seek(blockIndex * _archive.BlockSize, STREAM_SEEK_SET, NULL));
+      RINOK(readStream->Seek(blockIndex * _archive.BlockSize, STREAM_SEEK_SET, NULL));
       streamSpec->Init(currentItemSize);
       RINOK(copyCoder->Code(inStream, realOutStream, NULL, NULL, progress));
       if (copyCoderSpec->TotalSize != currentItemSize)
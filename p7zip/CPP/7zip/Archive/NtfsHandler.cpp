@@ -27,6 +27,7 @@
 #include "../Compress/CopyCoder.h"
 
 #include "Common/DummyOutStream.h"
+#include "Common/ExtractOrder.h"
 
 #ifdef SHOW_DEBUG_INFO
 #define PRF(x) x
@@ -531,8 +532,10 @@ bool CAttr::ParseExtents(CRecordVector<CExtent> &extents, UInt64 numClustersMax,
 
 static const UInt64 kEmptyTag = (UInt64)(Int64)-1;
 
-static const unsigned kNumCacheChunksLog = 1;
-static const size_t kNumCacheChunks = (1 << kNumCacheChunksLog);
+// the number of cached decompressed compression units of each stream
+
+static const unsigned kNumCacheChunksDef = 16;
+static const unsigned kNumCacheChunksMax = 1 << 12;
 
 class CInStream:
   public IInStream,
@@ -544,34 +547,49 @@ class CInStream:
   bool _sparseMode;
   size_t _compressedPos;
 
-  UInt64 _tags[kNumCacheChunks];
+  CRecordVector<UInt64> _tags;
+  CRecordVector<UInt64> _lastUse;
+  UInt64 _useCounter;
   unsigned _chunkSizeLog;
   CByteBuffer _inBuf;
   CByteBuffer _outBuf;
+
+  unsigned FindExtent(UInt64 virt) const;
+  unsigned GetCacheIndex(UInt64 cacheTag) const;
+  void AllocCacheChunk(unsigned cacheIndex);
 public:
   CMyComPtr<IInStream> Stream;
   UInt64 Size;
   UInt64 InitializedSize;
   unsigned BlockSizeLog;
   unsigned CompressionUnit;
+  unsigned NumCacheChunks;
   bool InUse;
   CRecordVector<CExtent> Extents;
 
+  CInStream(): NumCacheChunks(kNumCacheChunksDef) {}
+
   HRESULT SeekToPhys() { return Stream->Seek(_physPos, STREAM_SEEK_SET, NULL); }
 
   UInt32 GetCuSize() const { return (UInt32)1 << (BlockSizeLog + CompressionUnit); }
   HRESULT InitAndSeek(unsigned compressionUnit)
   {
     CompressionUnit = compressionUnit;
+    _tags.Clear();
+    _lastUse.Clear();
+    _useCounter = 0;
     if (compressionUnit != 0)
     {
       UInt32 cuSize = GetCuSize();
       _inBuf.Alloc(cuSize);
       _chunkSizeLog = BlockSizeLog + CompressionUnit;
-      _outBuf.Alloc(kNumCacheChunks << _chunkSizeLog);
+      // _outBuf grows in AllocCacheChunk(), when the chunks are filled
+      for (unsigned i = 0; i < NumCacheChunks; i++)
+      {
+        _tags.Add(kEmptyTag);
+        _lastUse.Add(0);
+      }
     }
-    for (size_t i = 0; i < kNumCacheChunks; i++)
-      _tags[i] = kEmptyTag;
 
     _sparseMode = false;
     _curRem = 0;
@@ -654,7 +672,7 @@ static size_t Lznt1Dec(Byte *dest, size_t outBufLim, size_t destLen, const Byte
             Int32 offs = -1 - dist;
             Byte *p = dest + destSize;
             for (UInt32 t = 0; t < len; t++)
-              p[t] = p[t + offs];
+              p[t] = p[(Int32)t + offs];
             destSize += len;
             sbOffset += len;
           }
@@ -667,6 +685,56 @@ static size_t Lznt1Dec(Byte *dest, size_t outBufLim, size_t destLen, const Byte
   return destSize;
 }
 
+// it returns the index of extent that contains (virt) cluster. Extents are sorted by Virt.
+
+unsigned CInStream::FindExtent(UInt64 virt) const
+{
+  unsigned left = 0, right = Extents.Size();
+  for (;;)
+  {
+    unsigned mid = (left + right) / 2;
+    if (mid == left)
+      return left;
+    if (virt < Extents[mid].Virt)
+      right = mid;
+    else
+      left = mid;
+  }
+}
+
+// it returns the index of cache chunk for (cacheTag): the chunk that already contains it,
+// or the least recently used chunk that can be filled by the caller.
+// The caller updates (_lastUse) of chunk only, if it uses the data of chunk or fills it.
+
+unsigned CInStream::GetCacheIndex(UInt64 cacheTag) const
+{
+  unsigned best = 0;
+  FOR_VECTOR (i, _tags)
+  {
+    if (_tags[i] == cacheTag)
+      return i;
+    if (_lastUse[i] < _lastUse[best])
+      best = i;
+  }
+  return best;
+}
+
+// the free chunks are filled in order of index, so (_outBuf) contains only the used chunks
+
+void CInStream::AllocCacheChunk(unsigned cacheIndex)
+{
+  size_t size = (size_t)(cacheIndex + 1) << _chunkSizeLog;
+  if (_outBuf.Size() >= size)
+    return;
+  size_t newSize = _outBuf.Size() * 2;
+  if (newSize < size)
+    newSize = size;
+  const size_t sizeMax = (size_t)NumCacheChunks << _chunkSizeLog;
+  if (newSize > sizeMax)
+    newSize = sizeMax;
+  _outBuf.ChangeSize_KeepData(newSize, _outBuf.Size());
+}
+
 STDMETHODIMP CInStream::Read(void *data, UInt32 size, UInt32 *processedSize)
 {
   if (processedSize != NULL)
@@ -691,17 +759,23 @@ STDMETHODIMP CInStream::Read(void *data, UInt32 size, UInt32 *processedSize)
 
   while (_curRem == 0)
   {
-    UInt64 cacheTag = _virtPos >> _chunkSizeLog;
-    UInt32 cacheIndex = (UInt32)cacheTag & (kNumCacheChunks - 1);
-    if (_tags[cacheIndex] == cacheTag)
+    UInt64 cacheTag = kEmptyTag;
+    unsigned cacheIndex = 0;
+    if (CompressionUnit != 0)
     {
-      UInt32 chunkSize = (UInt32)1 << _chunkSizeLog;
-      UInt32 offset = (UInt32)_virtPos & (chunkSize - 1);
-      UInt32 cur = MyMin(chunkSize - offset, size);
-      memcpy(data, _outBuf + (cacheIndex << _chunkSizeLog) + offset, cur);
-      *processedSize = cur;
-      _virtPos += cur;
-      return S_OK;
+      cacheTag = _virtPos >> _chunkSizeLog;
+      cacheIndex = GetCacheIndex(cacheTag);
+      if (_tags[cacheIndex] == cacheTag)
+      {
+        _lastUse[cacheIndex] = ++_useCounter;
+        UInt32 chunkSize = (UInt32)1 << _chunkSizeLog;
+        UInt32 offset = (UInt32)_virtPos & (chunkSize - 1);
+        UInt32 cur = MyMin(chunkSize - offset, size);
+        memcpy(data, _outBuf + ((size_t)cacheIndex << _chunkSizeLog) + offset, cur);
+        *processedSize = cur;
+        _virtPos += cur;
+        return S_OK;
+      }
     }
 
     PRF2(printf("\nVirtPos = %6d", _virtPos));
@@ -710,17 +784,7 @@ STDMETHODIMP CInStream::Read(void *data, UInt32 size, UInt32 *processedSize)
     UInt64 virtBlock = _virtPos >> BlockSizeLog;
     UInt64 virtBlock2 = virtBlock & ~((UInt64)comprUnitSize - 1);
 
-    unsigned left = 0, right = Extents.Size();
-    for (;;)
-    {
-      unsigned mid = (left + right) / 2;
-      if (mid == left)
-        break;
-      if (virtBlock2 < Extents[mid].Virt)
-        right = mid;
-      else
-        left = mid;
-    }
+    unsigned left = FindExtent(virtBlock2);
 
     bool isCompressed = false;
     UInt64 virtBlock2End = virtBlock2 + comprUnitSize;
@@ -737,8 +801,7 @@ STDMETHODIMP CInStream::Read(void *data, UInt32 size, UInt32 *processedSize)
         }
       }
 
-    unsigned i;
-    for (i = left; Extents[i + 1].Virt <= virtBlock; i++);
+    unsigned i = FindExtent(virtBlock);
 
     _sparseMode = false;
     if (!isCompressed)
@@ -808,9 +871,11 @@ STDMETHODIMP CInStream::Read(void *data, UInt32 size, UInt32 *processedSize)
     if (destLen > rem)
       destLen = (size_t)rem;
 
-    Byte *dest = _outBuf + (cacheIndex << _chunkSizeLog);
+    AllocCacheChunk(cacheIndex);
+    Byte *dest = _outBuf + ((size_t)cacheIndex << _chunkSizeLog);
     size_t destSizeRes = Lznt1Dec(dest, destLenMax, destLen, _inBuf, offs);
     _tags[cacheIndex] = cacheTag;
+    _lastUse[cacheIndex] = ++_useCounter;
 
     // some files in Vista have destSize > destLen
     if (destSizeRes < destLen)
@@ -1011,8 +1076,9 @@ struct CMftRec
 
   void ParseDataNames();
   HRESULT GetStream(IInStream *mainStream, int dataIndex,
-      unsigned clusterSizeLog, UInt64 numPhysClusters, IInStream **stream) const;
+      unsigned clusterSizeLog, UInt64 numPhysClusters, unsigned numCacheChunks, IInStream **stream) const;
   unsigned GetNumExtents(int dataIndex, unsigned clusterSizeLog, UInt64 numPhysClusters) const;
+  UInt64 GetFirstPhyCluster(int dataIndex, UInt64 numPhysClusters) const;
 
   UInt64 GetSize(unsigned dataIndex) const { return DataAttrs[DataRefs[dataIndex].Start].GetSize(); }
 
@@ -1037,7 +1103,7 @@ void CMftRec::ParseDataNames()
 }
 
 HRESULT CMftRec::GetStream(IInStream *mainStream, int dataIndex,
-    unsigned clusterSizeLog, UInt64 numPhysClusters, IInStream **destStream) const
+    unsigned clusterSizeLog, UInt64 numPhysClusters, unsigned numCacheChunks, IInStream **destStream) const
 {
   *destStream = 0;
   CByteBufStream *streamSpec = new CByteBufStream;
@@ -1069,6 +1135,7 @@ HRESULT CMftRec::GetStream(IInStream *mainStream, int dataIndex,
       streamSpec->Stream = mainStream;
       streamSpec->BlockSizeLog = clusterSizeLog;
       streamSpec->InUse = InUse();
+      streamSpec->NumCacheChunks = numCacheChunks;
       RINOK(streamSpec->InitAndSeek(attr0.CompressionUnit));
       *destStream = streamTemp.Detach();
       return S_OK;
@@ -1109,6 +1176,28 @@ unsigned CMftRec::GetNumExtents(int dataIndex, unsigned clusterSizeLog, UInt64 n
   }
 }
 
+// it returns the first physical cluster of data stream. It returns 0 for resident and sparse data.
+
+UInt64 CMftRec::GetFirstPhyCluster(int dataIndex, UInt64 numPhysClusters) const
+{
+  if (dataIndex < 0 || (unsigned)dataIndex >= DataRefs.Size())
+    return 0;
+  const CAttr &attr0 = DataAttrs[DataRefs[dataIndex].Start];
+  if (!attr0.NonResident)
+    return 0;
+  CRecordVector<CExtent> extents;
+  CExtent e;
+  e.Virt = 0;
+  e.Phy = kEmptyExtent;
+  extents.Add(e);
+  if (!attr0.ParseExtents(extents, numPhysClusters, attr0.CompressionUnit))
+    return 0;
+  FOR_VECTOR (i, extents)
+    if (!extents[i].IsEmpty())
+      return extents[i].Phy;
+  return 0;
+}
+
 bool CMftRec::Parse(Byte *p, unsigned sectorSizeLog, UInt32 numSectors, UInt32 recNumber,
     CObjectVector<CAttr> *attrs)
 {
@@ -1276,6 +1365,7 @@ struct CDatabase
 
   bool _showSystemFiles;
   bool _showDeletedFiles;
+  unsigned _numCacheChunks;
   UStringVector VirtFolderNames;
   int _systemFolderIndex;
   int _lostFolderIndex_Normal;
@@ -1291,6 +1381,7 @@ struct CDatabase
     // we show SystemFiles by default since it's difficult to track $Extend\* system files
     // it must be fixed later
     _showDeletedFiles = false;
+    _numCacheChunks = kNumCacheChunksDef;
   }
 
   CDatabase() { InitProps(); }
@@ -1649,7 +1740,7 @@ HRESULT CDatabase::Open()
     mftRec.ParseDataNames();
     if (mftRec.DataRefs.IsEmpty())
       return S_FALSE;
-    RINOK(mftRec.GetStream(InStream, 0, Header.ClusterSizeLog, Header.NumClusters, &mftStream));
+    RINOK(mftRec.GetStream(InStream, 0, Header.ClusterSizeLog, Header.NumClusters, _numCacheChunks, &mftStream));
     if (!mftStream)
       return S_FALSE;
   }
@@ -1668,7 +1759,7 @@ HRESULT CDatabase::Open()
     RINOK(OpenCallback->SetTotal(&numFiles, &mftSize));
   }
 
-  const size_t kBufSize = (1 << 15);
+  const size_t kBufSize = (1 << 20);
   const size_t recSize = ((size_t)1 << RecSizeLog);
   if (kBufSize < recSize)
     return S_FALSE;
@@ -1925,7 +2016,7 @@ HRESULT CDatabase::Open()
       if (attr.Name == L"$SDS")
       {
         CMyComPtr<IInStream> sdsStream;
-        RINOK(rec.GetStream(InStream, di, Header.ClusterSizeLog, Header.NumClusters, &sdsStream));
+        RINOK(rec.GetStream(InStream, di, Header.ClusterSizeLog, Header.NumClusters, _numCacheChunks, &sdsStream));
         if (sdsStream)
         {
           UInt64 size64 = attr.GetSize();
@@ -2149,7 +2240,7 @@ STDMETHODIMP CHandler::GetStream(UInt32 index, ISequentialInStream **stream)
   IInStream *stream2;
   const CItem &item = Items[index];
   const CMftRec &rec = Recs[item.RecIndex];
-  HRESULT res = rec.GetStream(InStream, item.DataIndex, Header.ClusterSizeLog, Header.NumClusters, &stream2);
+  HRESULT res = rec.GetStream(InStream, item.DataIndex, Header.ClusterSizeLog, Header.NumClusters, _numCacheChunks, &stream2);
   *stream = (ISequentialInStream *)stream2;
   return res;
   COM_TRY_END
@@ -2557,6 +2648,34 @@ STDMETHODIMP CHandler::Extract(const UInt32 *indices, UInt32 numItems,
   }
   RINOK(extractCallback->SetTotal(totalSize));
 
+  // the files are extracted in order of their first clusters to reduce the seeks in big images.
+  CPhyOrder order;
+  order.Reserve(numItems);
+  for (i = 0; i < numItems; i++)
+  {
+    UInt32 index = allFilesMode ? i : indices[i];
+    UInt64 pos = 0;
+    UInt64 size = 0;
+    if (index < (UInt32)Items.Size())
+    {
+      const CItem &item = Items[index];
+      if (!item.IsDir())
+      {
+        const CMftRec &rec = Recs[item.RecIndex];
+        pos = rec.GetFirstPhyCluster(item.DataIndex, Header.NumClusters) << Header.ClusterSizeLog;
+        if (item.DataIndex >= 0)
+          size = rec.GetSize(item.DataIndex);
+      }
+    }
+    order.Add(index, pos, size);
+  }
+  order.Sort();
+
+  CReadAheadInStream *readStreamSpec = new CReadAheadInStream;
+  CMyComPtr<IInStream> readStream = readStreamSpec;
+  readStreamSpec->SetStream(InStream);
+  RINOK(readStreamSpec->Init());
+
   UInt64 totalPackSize;
   totalSize = totalPackSize = 0;
 
@@ -2582,7 +2701,8 @@ STDMETHODIMP CHandler::Extract(const UInt32 *indices, UInt32 numItems,
     Int32 askMode = testMode ?
         NExtract::NAskMode::kTest :
         NExtract::NAskMode::kExtract;
-    UInt32 index = allFilesMode ? i : indices[i];
+    UInt32 index = order.GetIndex(i);
+    readStreamSpec->SetReadAheadEnd(order.GetSpanEnd(i));
     RINOK(extractCallback->GetStream(index, &realOutStream, askMode));
 
     if (index >= (UInt32)Items.Size() || Items[index].IsDir())
@@ -2608,7 +2728,7 @@ STDMETHODIMP CHandler::Extract(const UInt32 *indices, UInt32 numItems,
     int res = NExtract::NOperationResult::kDataError;
     {
       CMyComPtr<IInStream> inStream;
-      HRESULT hres = rec.GetStream(InStream, item.DataIndex, Header.ClusterSizeLog, Header.NumClusters, &inStream);
+      HRESULT hres = rec.GetStream(readStream, item.DataIndex, Header.ClusterSizeLog, Header.NumClusters, _numCacheChunks, &inStream);
       if (hres == S_FALSE)
         res = NExtract::NOperationResult::kUnsupportedMethod;
       else
@@ -2662,6 +2782,15 @@ STDMETHODIMP CHandler::SetProperties(const wchar_t **names, const PROPVARIANT *v
     {
       RINOK(PROPVARIANT_to_bool(prop, _showSystemFiles));
     }
+    else if (name.IsPrefixedBy(L"cs"))
+    {
+      // number of decompressed compression units in cache of each stream
+      UInt32 v = kNumCacheChunksDef;
+      RINOK(ParsePropToUInt32(name.Ptr(2), prop, v));
+      if (v == 0 || v > kNumCacheChunksMax)
+        return E_INVALIDARG;
+      _numCacheChunks = v;
+    }
     else
       return E_INVALIDARG;
   }
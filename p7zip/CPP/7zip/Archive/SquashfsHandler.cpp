@@ -12,14 +12,20 @@
 #include "../../Common/StringConvert.h"
 
 #include "../../Windows/PropVariantUtils.h"
+#ifndef _7ZIP_ST
+#include "../../Windows/System.h"
+#endif
 #include "../../Windows/TimeUtils.h"
 
 #include "../Common/CWrappers.h"
-#include "../Common/LimitedStreams.h"
+#include "../Common/MethodProps.h"
 #include "../Common/ProgressUtils.h"
 #include "../Common/RegisterArc.h"
 #include "../Common/StreamObjects.h"
 #include "../Common/StreamUtils.h"
+#ifndef _7ZIP_ST
+#include "../Common/VirtThread.h"
+#endif
 
 #include "../Compress/CopyCoder.h"
 #include "../Compress/ZlibDecoder.h"
@@ -826,9 +832,104 @@ struct CFrag
   UInt32 Size;
 };
 
+// CBlockDecoder decodes one compressed block from memory to memory
+
+class CBlockDecoder
+{
+  NCompress::NLzma::CDecoder *_lzmaDecoderSpec;
+  CMyComPtr<ICompressCoder> _lzmaDecoder;
+
+  NCompress::NZlib::CDecoder *_zlibDecoderSpec;
+  CMyComPtr<ICompressCoder> _zlibDecoder;
+
+  CXzUnpacker _xz;
+
+  CBufInStream *_inStreamSpec;
+  CMyComPtr<ISequentialInStream> _inStream;
+
+  CBufPtrSeqOutStream *_outStreamSpec;
+  CMyComPtr<ISequentialOutStream> _outStream;
+public:
+  CBlockDecoder();
+  ~CBlockDecoder() { XzUnpacker_Free(&_xz); }
+
+  HRESULT Decode(UInt32 method, bool noPropsLZMA, UInt32 dicSize,
+      const Byte *src, size_t srcSize, Byte *dest, size_t destSize, size_t &destLen);
+};
+
+// the block of data that is decoded in parallel by Extract()
+
+struct CBlockJob
+{
+  UInt32 Method;
+  bool NoPropsLZMA;
+  bool NeedDecode;  // false, if the block is read via ReadBlock() in main thread
+  UInt32 DicSize;
+  CByteBuffer PackBuf;
+  size_t PackSize;
+  CByteBuffer Data;
+  size_t DataSize;
+  HRESULT Result;
+
+  void Decode(CBlockDecoder &decoder);
+};
+
+#ifndef _7ZIP_ST
+
+class CDecoderThread: public CVirtThread
+{
+public:
+  CBlockDecoder Decoder;
+  CBlockJob *Job;
+
+  ~CDecoderThread() { CVirtThread::WaitThreadFinish(); }
+  virtual void Execute() { Job->Decode(Decoder); }
+};
+
+#endif
+
+// CBlockDecoders::Decode() decodes jobs[0] in the calling thread and other jobs in the threads
+
+class CBlockDecoders
+{
+  CBlockDecoder _decoder;
+  #ifndef _7ZIP_ST
+  CObjectVector<CDecoderThread> _threads;
+  #endif
+public:
+  HRESULT Decode(CObjectVector<CBlockJob> &jobs, unsigned num);
+};
+
+struct CBlockPos
+{
+  UInt64 Offset;        // offset of packed block in archive
+  UInt32 PackSize;
+  UInt32 OffsetInBlock; // offset of file's data in fragment block
+  bool Compressed;
+};
+
+struct CCachedBlock
+{
+  UInt64 StartPos;
+  UInt32 PackSize;      // 0, if there is no valid data in block
+  UInt32 UnpackSize;
+  UInt64 LastUse;
+  CByteBuffer Data;
+};
+
+struct CCachedBlockRef
+{
+  UInt64 StartPos;
+  unsigned Index;       // index in (_cachedBlocks)
+};
+
+static const UInt32 kNumCachedBlocksDef = 16;
+static const UInt32 kNumCachedBlocksMax = 256; // the block size can be up to 1 MiB
+
 class CHandler:
   public IInArchive,
   public IInArchiveGetStream,
+  public ISetProperties,
   public CMyUnknownImp
 {
   CRecordVector<CItem> _items;
@@ -853,39 +954,43 @@ class CHandler:
   CRecordVector<bool> _blockCompressed;
   CRecordVector<UInt64> _blockOffsets;
 
-  CByteBuffer _cachedBlock;
-  UInt64 _cachedBlockStartPos;
-  UInt32 _cachedPackBlockSize;
-  UInt32 _cachedUnpackBlockSize;
-
-  CLimitedSequentialInStream *_limitedInStreamSpec;
-  CMyComPtr<ISequentialInStream> _limitedInStream;
-
-  CBufPtrSeqOutStream *_outStreamSpec;
-  CMyComPtr<ISequentialOutStream> _outStream;
-
-  NCompress::NLzma::CDecoder *_lzmaDecoderSpec;
-  CMyComPtr<ICompressCoder> _lzmaDecoder;
+  // decoded blocks: the least recently used block is replaced, if the cache is full
+  CObjectVector<CCachedBlock> _cachedBlocks;
+  CRecordVector<CCachedBlockRef> _cachedBlockRefs; // valid blocks, sorted by StartPos
+  UInt64 _cacheUseCounter;
+  UInt32 _numCachedBlocksMax;
 
-  NCompress::NZlib::CDecoder *_zlibDecoderSpec;
-  CMyComPtr<ICompressCoder> _zlibDecoder;
+  #ifndef _7ZIP_ST
+  UInt32 _numThreads;
+  #endif
 
-  CXzUnpacker _xz;
+  CBlockDecoder _decoder;
 
   CByteBuffer _inputBuffer;
 
   CDynBufSeqOutStream *_dynOutStreamSpec;
   CMyComPtr<ISequentialOutStream> _dynOutStream;
 
-  void ClearCache()
+  void InitDefaults()
   {
-    _cachedBlockStartPos = 0;
-    _cachedPackBlockSize = 0;
-    _cachedUnpackBlockSize = 0;
+    _numCachedBlocksMax = kNumCachedBlocksDef;
+    #ifndef _7ZIP_ST
+    _numThreads = NWindows::NSystem::GetNumberOfProcessors();
+    #endif
   }
 
-  HRESULT Decompress(ISequentialOutStream *outStream, Byte *outBuf, bool *outBufWasWritten, UInt32 *outBufWasWrittenSize,
-      UInt32 inSize, UInt32 outSizeMax);
+  UInt32 GetBlockMethod(Byte firstByte);
+  HRESULT DecodeBlock(const Byte *src, size_t srcSize, Byte *dest, size_t destSize, size_t &destLen);
+  bool GetBlockPos(UInt64 blockIndex, CBlockPos &pos) const;
+  unsigned FindCachedBlockRef(UInt64 startPos) const;
+  void ClearCache()
+  {
+    _cachedBlocks.Clear();
+    _cachedBlockRefs.Clear();
+  }
+  HRESULT LoadBlock(const CBlockPos &pos, const CCachedBlock *&block);
+  HRESULT ExtractFileMt(UInt32 index, ISequentialOutStream *outStream, ICompressProgressInfo *progress,
+      CBlockDecoders &decoders, CObjectVector<CBlockJob> &jobs, Int32 &opRes);
   HRESULT ReadMetadataBlock(UInt32 &packSize);
   HRESULT ReadData(CData &data, UInt64 start, UInt64 end);
 
@@ -898,30 +1003,20 @@ class CHandler:
 
 public:
   CHandler();
-  ~CHandler()
-  {
-    XzUnpacker_Free(&_xz);
-  }
 
-  MY_UNKNOWN_IMP2(IInArchive, IInArchiveGetStream)
+  MY_UNKNOWN_IMP3(IInArchive, IInArchiveGetStream, ISetProperties)
   INTERFACE_IInArchive(;)
   STDMETHOD(GetStream)(UInt32 index, ISequentialInStream **stream);
+  STDMETHOD(SetProperties)(const wchar_t **names, const PROPVARIANT *values, UInt32 numProps);
 
   HRESULT ReadBlock(UInt64 blockIndex, Byte *dest, size_t blockSize);
 };
 
-CHandler::CHandler()
+CHandler::CHandler(): _cacheUseCounter(0)
 {
-  XzUnpacker_Construct(&_xz, &g_Alloc);
-
-  _limitedInStreamSpec = new CLimitedSequentialInStream;
-  _limitedInStream = _limitedInStreamSpec;
-
-  _outStreamSpec = new CBufPtrSeqOutStream();
-  _outStream = _outStreamSpec;
-
   _dynOutStreamSpec = new CDynBufSeqOutStream;
   _dynOutStream = _dynOutStreamSpec;
+  InitDefaults();
 }
 
 static const Byte kProps[] =
@@ -1106,35 +1201,21 @@ static HRESULT LzoDecode(Byte *dest, SizeT *destLen, const Byte *src, SizeT *src
   }
 }
 
-HRESULT CHandler::Decompress(ISequentialOutStream *outStream, Byte *outBuf, bool *outBufWasWritten, UInt32 *outBufWasWrittenSize, UInt32 inSize, UInt32 outSizeMax)
+CBlockDecoder::CBlockDecoder()
 {
-  if (outBuf)
-  {
-    *outBufWasWritten = false;
-    *outBufWasWrittenSize = 0;
-  }
-  UInt32 method = _h.Method;
-  if (_h.SeveralMethods)
-  {
-    Byte b;
-    RINOK(ReadStream_FALSE(_stream, &b, 1));
-    RINOK(_stream->Seek(-1, STREAM_SEEK_CUR, NULL));
-    method = (b == 0x5D ? kMethod_LZMA : kMethod_ZLIB);
-  }
+  XzUnpacker_Construct(&_xz, &g_Alloc);
 
-  if (method == kMethod_ZLIB && _needCheckLzma)
-  {
-    Byte b;
-    RINOK(ReadStream_FALSE(_stream, &b, 1));
-    RINOK(_stream->Seek(-1, STREAM_SEEK_CUR, NULL));
-    if (b == 0)
-    {
-      _noPropsLZMA = true;
-      method = _h.Method = kMethod_LZMA;
-    }
-    _needCheckLzma = false;
-  }
+  _inStreamSpec = new CBufInStream;
+  _inStream = _inStreamSpec;
 
+  _outStreamSpec = new CBufPtrSeqOutStream;
+  _outStream = _outStreamSpec;
+}
+
+HRESULT CBlockDecoder::Decode(UInt32 method, bool noPropsLZMA, UInt32 dicSize,
+    const Byte *src, size_t srcSize, Byte *dest, size_t destSize, size_t &destLen)
+{
+  destLen = 0;
   if (method == kMethod_ZLIB)
   {
     if (!_zlibDecoder)
@@ -1142,8 +1223,12 @@ HRESULT CHandler::Decompress(ISequentialOutStream *outStream, Byte *outBuf, bool
       _zlibDecoderSpec = new NCompress::NZlib::CDecoder();
       _zlibDecoder = _zlibDecoderSpec;
     }
-    RINOK(_zlibDecoder->Code(_limitedInStream, outStream, NULL, NULL, NULL));
-    if (inSize != _zlibDecoderSpec->GetInputProcessedSize())
+    _inStreamSpec->Init(src, srcSize);
+    _outStreamSpec->Init(dest, destSize);
+    HRESULT res = _zlibDecoder->Code(_inStream, _outStream, NULL, NULL, NULL);
+    destLen = _outStreamSpec->GetPos();
+    RINOK(res);
+    if (srcSize != _zlibDecoderSpec->GetInputProcessedSize())
       return S_FALSE;
   }
   else if (method == kMethod_LZMA)
@@ -1158,67 +1243,127 @@ HRESULT CHandler::Decompress(ISequentialOutStream *outStream, Byte *outBuf, bool
     Byte props[kPropsSize];
     UInt32 propsSize;
     UInt64 outSize;
-    if (_noPropsLZMA)
+    if (noPropsLZMA)
     {
       props[0] = 0x5D;
-      SetUi32(&props[1], _h.BlockSize);
+      SetUi32(&props[1], dicSize);
       propsSize = 0;
-      outSize = outSizeMax;
+      outSize = destSize;
     }
     else
     {
-      RINOK(ReadStream_FALSE(_limitedInStream, props, kPropsSize));
+      if (srcSize < kPropsSize)
+        return S_FALSE;
+      memcpy(props, src, kPropsSize);
       propsSize = kPropsSize;
       outSize = GetUi64(&props[LZMA_PROPS_SIZE]);
-      if (outSize > outSizeMax)
+      if (outSize > destSize)
         return S_FALSE;
     }
     RINOK(_lzmaDecoderSpec->SetDecoderProperties2(props, LZMA_PROPS_SIZE));
-    RINOK(_lzmaDecoder->Code(_limitedInStream, outStream, NULL, &outSize, NULL));
-    if (inSize != propsSize + _lzmaDecoderSpec->GetInputProcessedSize())
+    _inStreamSpec->Init(src + propsSize, srcSize - propsSize);
+    _outStreamSpec->Init(dest, destSize);
+    HRESULT res = _lzmaDecoder->Code(_inStream, _outStream, NULL, &outSize, NULL);
+    destLen = _outStreamSpec->GetPos();
+    RINOK(res);
+    if (srcSize != propsSize + _lzmaDecoderSpec->GetInputProcessedSize())
       return S_FALSE;
   }
   else
   {
-    if (_inputBuffer.Size() < inSize)
-      _inputBuffer.Alloc(inSize);
-    RINOK(ReadStream_FALSE(_stream, _inputBuffer, inSize));
-
-    Byte *dest = outBuf;
-    if (!outBuf)
-    {
-      dest = _dynOutStreamSpec->GetBufPtrForWriting(outSizeMax);
-      if (!dest)
-        return E_OUTOFMEMORY;
-    }
-    SizeT destLen = outSizeMax, srcLen = inSize;
+    SizeT destLen2 = destSize, srcLen = srcSize;
     if (method == kMethod_LZO)
     {
-      RINOK(LzoDecode(dest, &destLen, _inputBuffer, &srcLen));
+      RINOK(LzoDecode(dest, &destLen2, src, &srcLen));
     }
     else
     {
       ECoderStatus status;
       XzUnpacker_Init(&_xz);
-      SRes res = XzUnpacker_Code(&_xz, dest, &destLen, _inputBuffer, &srcLen, CODER_FINISH_END, &status);
+      SRes res = XzUnpacker_Code(&_xz, dest, &destLen2, src, &srcLen, CODER_FINISH_END, &status);
       if (res != 0)
         return SResToHRESULT(res);
       if (status != CODER_STATUS_NEEDS_MORE_INPUT || !XzUnpacker_IsStreamWasFinished(&_xz))
         return S_FALSE;
     }
-    if (inSize != srcLen)
+    if (srcSize != srcLen)
       return S_FALSE;
-    if (outBuf)
+    destLen = destLen2;
+  }
+  return S_OK;
+}
+
+void CBlockJob::Decode(CBlockDecoder &decoder)
+{
+  DataSize = 0;
+  if (!NeedDecode)
+    return;
+  try { Result = decoder.Decode(Method, NoPropsLZMA, DicSize, PackBuf, PackSize, Data, Data.Size(), DataSize); }
+  catch(...) { Result = E_OUTOFMEMORY; }
+}
+
+HRESULT CBlockDecoders::Decode(CObjectVector<CBlockJob> &jobs, unsigned num)
+{
+  if (num == 0)
+    return S_OK;
+  unsigned i;
+  #ifndef _7ZIP_ST
+  while (_threads.Size() + 1 < num)
+  {
+    WRes wres = _threads.AddNew().Create();
+    if (wres != 0)
     {
-      *outBufWasWritten = true;
-      *outBufWasWrittenSize = (UInt32)destLen;
+      _threads.DeleteBack();
+      return wres;
     }
-    else
-      _dynOutStreamSpec->UpdateSize(destLen);
   }
+  for (i = 1; i < num; i++)
+  {
+    CDecoderThread &thread = _threads[i - 1];
+    thread.Job = &jobs[i];
+    thread.Start();
+  }
+  #endif
+  jobs[0].Decode(_decoder);
+  #ifndef _7ZIP_ST
+  for (i = 1; i < num; i++)
+    _threads[i - 1].WaitExecuteFinish();
+  #else
+  for (i = 1; i < num; i++)
+    jobs[i].Decode(_decoder);
+  #endif
   return S_OK;
 }
 
+// it returns the method of compressed block that starts with (firstByte)
+
+UInt32 CHandler::GetBlockMethod(Byte firstByte)
+{
+  UInt32 method = _h.Method;
+  if (_h.SeveralMethods)
+    method = (firstByte == 0x5D ? kMethod_LZMA : kMethod_ZLIB);
+
+  if (method == kMethod_ZLIB && _needCheckLzma)
+  {
+    if (firstByte == 0)
+    {
+      _noPropsLZMA = true;
+      method = _h.Method = kMethod_LZMA;
+    }
+    _needCheckLzma = false;
+  }
+  return method;
+}
+
+HRESULT CHandler::DecodeBlock(const Byte *src, size_t srcSize, Byte *dest, size_t destSize, size_t &destLen)
+{
+  destLen = 0;
+  if (srcSize == 0)
+    return S_FALSE;
+  UInt32 method = GetBlockMethod(src[0]);
+  return _decoder.Decode(method, _noPropsLZMA, _h.BlockSize, src, srcSize, dest, destSize, destLen);
+}
+
 HRESULT CHandler::ReadMetadataBlock(UInt32 &packSize)
 {
   Byte temp[3];
@@ -1238,8 +1383,14 @@ HRESULT CHandler::ReadMetadataBlock(UInt32 &packSize)
   packSize = offset + size;
   if (isCompressed)
   {
-    _limitedInStreamSpec->Init(size);
-    RINOK(Decompress(_dynOutStream, NULL, NULL, NULL, size, kMetadataBlockSize));
+    _inputBuffer.AllocAtLeast(size);
+    RINOK(ReadStream_FALSE(_stream, _inputBuffer, size));
+    Byte *dest = _dynOutStreamSpec->GetBufPtrForWriting(kMetadataBlockSize);
+    if (!dest)
+      return E_OUTOFMEMORY;
+    size_t destLen;
+    RINOK(DecodeBlock(_inputBuffer, size, dest, kMetadataBlockSize, destLen));
+    _dynOutStreamSpec->UpdateSize(destLen);
   }
   else
   {
@@ -1679,7 +1830,6 @@ STDMETHODIMP CHandler::Open(IInStream *stream, const UInt64 *, IArchiveOpenCallb
   COM_TRY_BEGIN
   {
     Close();
-    _limitedInStreamSpec->SetStream(stream);
     HRESULT res;
     try
     {
@@ -1706,7 +1856,6 @@ STDMETHODIMP CHandler::Close()
 {
   _sizeCalculated = 0;
 
-  _limitedInStreamSpec->ReleaseStream();
   _stream.Release();
 
   _items.Clear();
@@ -1720,7 +1869,6 @@ STDMETHODIMP CHandler::Close()
   // _uids.Free();
   // _gids.Free();;
 
-  _cachedBlock.Free();
   ClearCache();
 
   return S_OK;
@@ -1988,68 +2136,226 @@ HRESULT CSquashfsInStream::ReadBlock(UInt64 blockIndex, Byte *dest, size_t block
   return Handler->ReadBlock(blockIndex, dest, blockSize);
 }
 
-HRESULT CHandler::ReadBlock(UInt64 blockIndex, Byte *dest, size_t blockSize)
+bool CHandler::GetBlockPos(UInt64 blockIndex, CBlockPos &pos) const
 {
   const CNode &node = _nodes[_nodeIndex];
-  UInt64 blockOffset;
-  UInt32 packBlockSize;
-  UInt32 offsetInBlock = 0;
-  bool compressed;
+  pos.OffsetInBlock = 0;
   if (blockIndex < _blockCompressed.Size())
   {
-    compressed = _blockCompressed[(int)blockIndex];
-    blockOffset = _blockOffsets[(int)blockIndex];
-    packBlockSize = (UInt32)(_blockOffsets[(int)blockIndex + 1] - blockOffset);
-    blockOffset += node.StartBlock;
+    pos.Compressed = _blockCompressed[(int)blockIndex];
+    pos.Offset = _blockOffsets[(int)blockIndex];
+    pos.PackSize = (UInt32)(_blockOffsets[(int)blockIndex + 1] - pos.Offset);
+    pos.Offset += node.StartBlock;
   }
   else
   {
     if (!node.ThereAreFrags())
-      return S_FALSE;
+      return false;
     const CFrag &frag = _frags[node.Frag];
-    offsetInBlock = node.Offset;
-    blockOffset = frag.StartBlock;
-    packBlockSize = GET_COMPRESSED_BLOCK_SIZE(frag.Size);
-    compressed = IS_COMPRESSED_BLOCK(frag.Size);
+    pos.OffsetInBlock = node.Offset;
+    pos.Offset = frag.StartBlock;
+    pos.PackSize = GET_COMPRESSED_BLOCK_SIZE(frag.Size);
+    pos.Compressed = IS_COMPRESSED_BLOCK(frag.Size);
   }
+  return true;
+}
 
-  if (packBlockSize == 0)
+// returns the index of first ref with (StartPos >= startPos)
+
+unsigned CHandler::FindCachedBlockRef(UInt64 startPos) const
+{
+  unsigned left = 0, right = _cachedBlockRefs.Size();
+  while (left != right)
+  {
+    unsigned mid = (left + right) / 2;
+    if (_cachedBlockRefs[mid].StartPos < startPos)
+      left = mid + 1;
+    else
+      right = mid;
+  }
+  return left;
+}
+
+HRESULT CHandler::LoadBlock(const CBlockPos &pos, const CCachedBlock *&block)
+{
+  unsigned i;
+  unsigned refIndex = FindCachedBlockRef(pos.Offset);
+  if (refIndex < _cachedBlockRefs.Size() && _cachedBlockRefs[refIndex].StartPos == pos.Offset)
+  {
+    i = _cachedBlockRefs[refIndex].Index;
+    CCachedBlock &cb = _cachedBlocks[i];
+    if (cb.PackSize == pos.PackSize)
+    {
+      cb.LastUse = ++_cacheUseCounter;
+      block = &cb;
+      return S_OK;
+    }
+    // another block at same offset in broken archive: we replace it
+    _cachedBlockRefs.Delete(refIndex);
+  }
+  else if (_cachedBlocks.Size() < _numCachedBlocksMax)
+  {
+    i = _cachedBlocks.Size();
+    CCachedBlock &cb = _cachedBlocks.AddNew();
+    cb.StartPos = 0;
+    cb.Data.Alloc(_h.BlockSize);
+  }
+  else
+  {
+    i = 0;
+    for (unsigned k = 1; k < _cachedBlocks.Size(); k++)
+      if (_cachedBlocks[k].LastUse < _cachedBlocks[i].LastUse)
+        i = k;
+    refIndex = FindCachedBlockRef(_cachedBlocks[i].StartPos);
+    if (refIndex < _cachedBlockRefs.Size() && _cachedBlockRefs[refIndex].Index == i)
+      _cachedBlockRefs.Delete(refIndex);
+  }
+
+  CCachedBlock &cb = _cachedBlocks[i];
+  cb.PackSize = 0;
+  cb.LastUse = ++_cacheUseCounter;
+  if (pos.PackSize > _h.BlockSize)
+    return S_FALSE;
+  RINOK(_stream->Seek(pos.Offset, STREAM_SEEK_SET, NULL));
+  if (pos.Compressed)
+  {
+    _inputBuffer.AllocAtLeast(pos.PackSize);
+    RINOK(ReadStream_FALSE(_stream, _inputBuffer, pos.PackSize));
+    size_t destLen;
+    RINOK(DecodeBlock(_inputBuffer, pos.PackSize, cb.Data, _h.BlockSize, destLen));
+    cb.UnpackSize = (UInt32)destLen;
+  }
+  else
+  {
+    RINOK(ReadStream_FALSE(_stream, cb.Data, pos.PackSize));
+    cb.UnpackSize = pos.PackSize;
+  }
+  cb.StartPos = pos.Offset;
+  cb.PackSize = pos.PackSize;
+  CCachedBlockRef ref;
+  ref.StartPos = pos.Offset;
+  ref.Index = i;
+  _cachedBlockRefs.Insert(FindCachedBlockRef(pos.Offset), ref);
+  block = &cb;
+  return S_OK;
+}
+
+HRESULT CHandler::ReadBlock(UInt64 blockIndex, Byte *dest, size_t blockSize)
+{
+  CBlockPos pos;
+  if (!GetBlockPos(blockIndex, pos))
+    return S_FALSE;
+
+  if (pos.PackSize == 0)
   {
     // sparse file ???
     memset(dest, 0, blockSize);
     return S_OK;
   }
 
-  if (blockOffset != _cachedBlockStartPos ||
-      packBlockSize != _cachedPackBlockSize)
+  const CCachedBlock *cb;
+  RINOK(LoadBlock(pos, cb));
+  if (pos.OffsetInBlock + blockSize > cb->UnpackSize)
+    return S_FALSE;
+  memcpy(dest, cb->Data + pos.OffsetInBlock, blockSize);
+  return S_OK;
+}
+
+/* ExtractFileMt() reads the packed data of several compressed blocks of file,
+   decodes these blocks in parallel and writes the data in order of blocks.
+   Fragments, sparse and uncompressed blocks are read via ReadBlock().
+   The results are the same as for GetStream() stream in Extract(). */
+
+HRESULT CHandler::ExtractFileMt(UInt32 index, ISequentialOutStream *outStream, ICompressProgressInfo *progress,
+    CBlockDecoders &decoders, CObjectVector<CBlockJob> &jobs, Int32 &opRes)
+{
+  opRes = NExtract::NOperationResult::kDataError;
+  const CItem &item = _items[index];
+  UInt64 packSize;
+  if (!GetPackSize(index, packSize, true))
   {
-    ClearCache();
-    RINOK(_stream->Seek(blockOffset, STREAM_SEEK_SET, NULL));
-    _limitedInStreamSpec->Init(packBlockSize);
+    opRes = NExtract::NOperationResult::kUnsupportedMethod;
+    return S_OK;
+  }
+  _nodeIndex = item.Node;
+
+  const UInt64 fileSize = _nodes[item.Node].FileSize;
+  const UInt64 numBlocks = (fileSize + _h.BlockSize - 1) >> _h.BlockSizeLog;
+  UInt64 outSize = 0;
+  HRESULT res = S_OK;
 
-    if (compressed)
+  for (UInt64 blockIndex = 0; blockIndex < numBlocks && res == S_OK;)
+  {
+    unsigned numJobs;
+    for (numJobs = 0; numJobs < jobs.Size() && blockIndex + numJobs < numBlocks; numJobs++)
     {
-      _outStreamSpec->Init((Byte *)_cachedBlock, _h.BlockSize);
-      bool outBufWasWritten;
-      UInt32 outBufWasWrittenSize;
-      HRESULT res = Decompress(_outStream, _cachedBlock, &outBufWasWritten, &outBufWasWrittenSize, packBlockSize, _h.BlockSize);
-      if (outBufWasWritten)
-        _cachedUnpackBlockSize = outBufWasWrittenSize;
-      else
-        _cachedUnpackBlockSize = (UInt32)_outStreamSpec->GetPos();
-      RINOK(res);
+      CBlockJob &job = jobs[numJobs];
+      job.Data.AllocAtLeast(_h.BlockSize);
+      job.NeedDecode = false;
+      job.Result = S_OK;
+      UInt64 bi = blockIndex + numJobs;
+      CBlockPos pos;
+      if (bi >= _blockCompressed.Size()
+          || !GetBlockPos(bi, pos)
+          || !pos.Compressed
+          || pos.PackSize == 0
+          || pos.PackSize > _h.BlockSize)
+        continue;
+      job.PackBuf.AllocAtLeast(pos.PackSize);
+      job.PackSize = pos.PackSize;
+      job.Result = _stream->Seek(pos.Offset, STREAM_SEEK_SET, NULL);
+      if (job.Result == S_OK)
+        job.Result = ReadStream_FALSE(_stream, job.PackBuf, pos.PackSize);
+      if (job.Result != S_OK)
+        continue;
+      job.NeedDecode = true;
+      job.Method = GetBlockMethod(job.PackBuf[0]);
+      job.NoPropsLZMA = _noPropsLZMA;
+      job.DicSize = _h.BlockSize;
     }
-    else
+
+    RINOK(decoders.Decode(jobs, numJobs));
+
+    for (unsigned k = 0; k < numJobs; k++, blockIndex++)
     {
-      RINOK(ReadStream_FALSE(_limitedInStream, _cachedBlock, packBlockSize));
-      _cachedUnpackBlockSize = packBlockSize;
+      CBlockJob &job = jobs[k];
+      size_t blockSize = _h.BlockSize;
+      {
+        UInt64 rem = fileSize - (blockIndex << _h.BlockSizeLog);
+        if (blockSize > rem)
+          blockSize = (size_t)rem;
+      }
+      HRESULT jobRes = job.Result;
+      if (jobRes == S_OK)
+      {
+        if (!job.NeedDecode)
+          jobRes = ReadBlock(blockIndex, job.Data, blockSize);
+        else if (job.DataSize < blockSize)
+          jobRes = S_FALSE;
+      }
+      if (jobRes != S_OK)
+      {
+        res = jobRes;
+        break;
+      }
+      RINOK(WriteStream(outStream, job.Data, blockSize));
+      outSize += blockSize;
+      if (progress)
+      {
+        RINOK(progress->SetRatioInfo(&outSize, &outSize));
+      }
     }
-    _cachedBlockStartPos = blockOffset;
-    _cachedPackBlockSize = packBlockSize;
   }
-  if (offsetInBlock + blockSize > _cachedUnpackBlockSize)
-    return S_FALSE;
-  memcpy(dest, _cachedBlock + offsetInBlock, blockSize);
+
+  if (res == S_OK)
+  {
+    if (outSize == fileSize)
+      opRes = NExtract::NOperationResult::kOK;
+  }
+  else if (res == E_NOTIMPL)
+    opRes = NExtract::NOperationResult::kUnsupportedMethod;
+  else if (res != S_FALSE)
+    return res;
   return S_OK;
 }
 
@@ -2082,6 +2388,17 @@ STDMETHODIMP CHandler::Extract(const UInt32 *indices, UInt32 numItems,
   CMyComPtr<ICompressProgressInfo> progress = lps;
   lps->Init(extractCallback, false);
 
+  CBlockDecoders decoders;
+  CObjectVector<CBlockJob> jobs;
+  #ifndef _7ZIP_ST
+  {
+    const UInt32 kNumThreadsMax = 64;
+    UInt32 numThreads = MyMin(_numThreads, kNumThreadsMax);
+    for (UInt32 t = 0; numThreads > 1 && t < numThreads; t++)
+      jobs.AddNew();
+  }
+  #endif
+
   for (i = 0; i < numItems; i++)
   {
     lps->InSize = totalPackSize;
@@ -2113,7 +2430,12 @@ STDMETHODIMP CHandler::Extract(const UInt32 *indices, UInt32 numItems,
       continue;
     RINOK(extractCallback->PrepareOperation(askMode));
 
-    int res = NExtract::NOperationResult::kDataError;
+    Int32 res = NExtract::NOperationResult::kDataError;
+    if (!jobs.IsEmpty() && node.FileSize != 0 && !node.IsLink())
+    {
+      RINOK(ExtractFileMt(index, outStream, progress, decoders, jobs, res));
+    }
+    else
     {
       CMyComPtr<ISequentialInStream> inSeqStream;
       CMyComPtr<IInStream> inStream;
@@ -2185,13 +2507,6 @@ STDMETHODIMP CHandler::GetStream(UInt32 index, ISequentialInStream **stream)
 
   _nodeIndex = item.Node;
 
-  size_t cacheSize = _h.BlockSize;
-  if (_cachedBlock.Size() != cacheSize)
-  {
-    ClearCache();
-    _cachedBlock.Alloc(cacheSize);
-  }
-
   CSquashfsInStream *streamSpec = new CSquashfsInStream;
   CMyComPtr<IInStream> streamTemp = streamSpec;
   streamSpec->Handler = this;
@@ -2208,6 +2523,40 @@ STDMETHODIMP CHandler::GetStream(UInt32 index, ISequentialInStream **stream)
   COM_TRY_END
 }
 
+STDMETHODIMP CHandler::SetProperties(const wchar_t **names, const PROPVARIANT *values, UInt32 numProps)
+{
+  InitDefaults();
+  for (UInt32 i = 0; i < numProps; i++)
+  {
+    UString name = names[i];
+    name.MakeLower_Ascii();
+    if (name.IsEmpty())
+      return E_INVALIDARG;
+    const PROPVARIANT &prop = values[i];
+    if (name.IsPrefixedBy(L"cs"))
+    {
+      // number of decoded blocks in cache
+      UInt32 v = kNumCachedBlocksDef;
+      RINOK(ParsePropToUInt32(name.Ptr(2), prop, v));
+      if (v == 0)
+        v = 1;
+      if (v > kNumCachedBlocksMax)
+        v = kNumCachedBlocksMax;
+      _numCachedBlocksMax = v;
+    }
+    else if (name.IsPrefixedBy(L"mt"))
+    {
+      #ifndef _7ZIP_ST
+      RINOK(ParseMtProp(name.Ptr(2), prop, NWindows::NSystem::GetNumberOfProcessors(), _numThreads));
+      #endif
+    }
+    else
+      return E_INVALIDARG;
+  }
+  ClearCache();
+  return S_OK;
+}
+
 IMP_CreateArcIn
 
 static CArcInfo g_ArcInfo =
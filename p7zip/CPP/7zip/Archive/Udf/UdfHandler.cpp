@@ -14,6 +14,8 @@
 
 #include "../../Compress/CopyCoder.h"
 
+#include "../Common/ExtractOrder.h"
+
 #include "UdfHandler.h"
 
 namespace NArchive {
@@ -211,7 +213,32 @@ STDMETHODIMP CHandler::GetProperty(UInt32 index, PROPID propID, PROPVARIANT *val
   COM_TRY_END
 }
 
+UInt64 CHandler::GetPhyPos(UInt32 index) const
+{
+  const CRef2 &ref2 = _refs2[index];
+  const CLogVol &vol = _archive.LogVols[ref2.Vol];
+  const CRef &ref = vol.FileSets[ref2.Fs].Refs[ref2.Ref];
+  const CFile &file = _archive.Files[ref.FileIndex];
+  const CItem &item = _archive.Items[file.ItemIndex];
+  if (item.IsDir() || item.IsInline || !_archive.CheckItemExtents(ref2.Vol, item))
+    return 0;
+  FOR_VECTOR (extentIndex, item.Extents)
+  {
+    const CMyExtent &extent = item.Extents[extentIndex];
+    if (extent.GetLen() == 0)
+      continue;
+    const CPartition &partition = _archive.Partitions[vol.PartitionMaps[extent.PartitionRef].PartitionIndex];
+    return ((UInt64)partition.Pos << _archive.SecLogSize) + (UInt64)extent.Pos * vol.BlockSize;
+  }
+  return 0;
+}
+
 STDMETHODIMP CHandler::GetStream(UInt32 index, ISequentialInStream **stream)
+{
+  return GetItemStream(_inStream, index, stream);
+}
+
+HRESULT CHandler::GetItemStream(IInStream *inStream, UInt32 index, ISequentialInStream **stream)
 {
   *stream = 0;
 
@@ -227,20 +254,20 @@ STDMETHODIMP CHandler::GetStream(UInt32 index, ISequentialInStream **stream)
 
   if (item.IsInline)
   {
-    CBufInStream *inStreamSpec = new CBufInStream;
-    CMyComPtr<ISequentialInStream> inStream = inStreamSpec;
+    CBufInStream *bufStreamSpec = new CBufInStream;
+    CMyComPtr<ISequentialInStream> bufStream = bufStreamSpec;
     CReferenceBuf *referenceBuf = new CReferenceBuf;
     CMyComPtr<IUnknown> ref = referenceBuf;
     referenceBuf->Buf = item.InlineData;
-    inStreamSpec->Init(referenceBuf);
-    *stream = inStream.Detach();
+    bufStreamSpec->Init(referenceBuf);
+    *stream = bufStream.Detach();
     return S_OK;
   }
 
   CExtentsStream *extentStreamSpec = new CExtentsStream();
   CMyComPtr<ISequentialInStream> extentStream = extentStreamSpec;
 
-  extentStreamSpec->Stream = _inStream;
+  extentStreamSpec->Stream = inStream;
 
   UInt64 virtOffset = 0;
   FOR_VECTOR (extentIndex, item.Extents)
@@ -287,6 +314,8 @@ STDMETHODIMP CHandler::Extract(const UInt32 *indices, UInt32 numItems,
   if (numItems == 0)
     return S_OK;
   UInt64 totalSize = 0;
+  CPhyOrder order;
+  order.Reserve(numItems);
   UInt32 i;
 
   for (i = 0; i < numItems; i++)
@@ -298,7 +327,9 @@ STDMETHODIMP CHandler::Extract(const UInt32 *indices, UInt32 numItems,
     const CItem &item = _archive.Items[file.ItemIndex];
     if (!item.IsDir())
       totalSize += item.Size;
+    order.Add(index, GetPhyPos(index), item.Size);
   }
+  order.Sort();
   extractCallback->SetTotal(totalSize);
 
   UInt64 currentTotalSize = 0;
@@ -313,6 +344,11 @@ STDMETHODIMP CHandler::Extract(const UInt32 *indices, UInt32 numItems,
   CLimitedSequentialOutStream *outStreamSpec = new CLimitedSequentialOutStream;
   CMyComPtr<ISequentialOutStream> outStream(outStreamSpec);
 
+  CReadAheadInStream *readStreamSpec = new CReadAheadInStream;
+  CMyComPtr<IInStream> readStream = readStreamSpec;
+  readStreamSpec->SetStream(_inStream);
+  RINOK(readStreamSpec->Init());
+
   for (i = 0; i < numItems; i++)
   {
     lps->InSize = lps->OutSize = currentTotalSize;
@@ -321,7 +357,8 @@ STDMETHODIMP CHandler::Extract(const UInt32 *indices, UInt32 numItems,
     Int32 askMode = testMode ?
         NExtract::NAskMode::kTest :
         NExtract::NAskMode::kExtract;
-    UInt32 index = allFilesMode ? i : indices[i];
+    UInt32 index = order.GetIndex(i);
+    readStreamSpec->SetReadAheadEnd(order.GetSpanEnd(i));
 
     RINOK(extractCallback->GetStream(index, &realOutStream, askMode));
 
@@ -347,7 +384,7 @@ STDMETHODIMP CHandler::Extract(const UInt32 *indices, UInt32 numItems,
     outStreamSpec->Init(item.Size);
     Int32 opRes;
     CMyComPtr<ISequentialInStream> udfInStream;
-    HRESULT res = GetStream(index, &udfInStream);
+    HRESULT res = GetItemStream(readStream, index, &udfInStream);
     if (res == E_NOTIMPL)
       opRes = NExtract::NOperationResult::kUnsupportedMethod;
     else if (res != S_OK)
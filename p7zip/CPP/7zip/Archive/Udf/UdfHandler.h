@@ -27,6 +27,9 @@ class CHandler:
   CMyComPtr<IInStream> _inStream;
   CInArchive _archive;
   CRecordVector<CRef2> _refs2;
+
+  UInt64 GetPhyPos(UInt32 index) const;
+  HRESULT GetItemStream(IInStream *inStream, UInt32 index, ISequentialInStream **stream);
 public:
   MY_UNKNOWN_IMP2(IInArchive, IInArchiveGetStream)
   INTERFACE_IInArchive(;)
@@ -910,6 +910,9 @@ STDMETHODIMP CHandler::Extract(const UInt32 *indices, UInt32 numItems,
   int prevSuccessStreamIndex = -1;
 
   CUnpacker unpacker;
+  #ifndef _7ZIP_ST
+  unpacker.NumThreads = _numThreads;
+  #endif
 
   CLocalProgress *lps = new CLocalProgress;
   CMyComPtr<ICompressProgressInfo> progress = lps;
@@ -1046,6 +1049,12 @@ STDMETHODIMP CHandler::SetProperties(const wchar_t **names, const PROPVARIANT *v
       RINOK(ParsePropToUInt32(L"", prop, image));
       _defaultImageNumber = image;
     }
+    else if (name.IsPrefixedBy(L"mt"))
+    {
+      #ifndef _7ZIP_ST
+      RINOK(ParseMtProp(name.Ptr(2), prop, NWindows::NSystem::GetNumberOfProcessors(), _numThreads));
+      #endif
+    }
     else
       return E_INVALIDARG;
   }
@@ -5,6 +5,10 @@
 
 #include "../../../Common/MyCom.h"
 
+#ifndef _7ZIP_ST
+#include "../../../Windows/System.h"
+#endif
+
 #include "WimIn.h"
 
 namespace NArchive {
@@ -39,6 +43,10 @@ class CHandler:
   bool _set_showImageNumber;
   int _defaultImageNumber;
 
+  #ifndef _7ZIP_ST
+  UInt32 _numThreads;
+  #endif
+
   bool _showImageNumber;
 
   bool _keepMode_ShowImageNumber;
@@ -51,6 +59,9 @@ class CHandler:
     _set_use_ShowImageNumber = false;
     _set_showImageNumber = false;
     _defaultImageNumber = -1;
+    #ifndef _7ZIP_ST
+    _numThreads = NWindows::NSystem::GetNumberOfProcessors();
+    #endif
   }
 
   bool ThereIsError() const { return _xmlError || _db.ThereIsError(); }
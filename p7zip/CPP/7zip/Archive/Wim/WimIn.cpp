@@ -128,6 +128,218 @@ HRESULT CDecoder::Code(ISequentialInStream *inStream, ISequentialOutStream *outS
 
 }
 
+#ifndef _7ZIP_ST
+
+static const UInt64 kMtMinNumChunks = 8;
+static const unsigned kNumChunksInThreadBatch = 16;
+static const UInt32 kNumThreadsMax = 64;
+
+HRESULT CUnpackThread::DecodeChunk(const Byte *data, size_t packSize, Byte *dest, UInt32 unpackSize)
+{
+  if (packSize == unpackSize)
+  {
+    memcpy(dest, data, unpackSize);
+    return S_OK;
+  }
+  if (!inStream)
+  {
+    inStreamSpec = new CBufInStream;
+    inStream = inStreamSpec;
+    outStreamSpec = new CBufPtrSeqOutStream;
+    outStream = outStreamSpec;
+  }
+  inStreamSpec->Init(data, packSize);
+  outStreamSpec->Init(dest, unpackSize);
+  if (LzxMode)
+  {
+    if (!lzxDecoder)
+    {
+      lzxDecoderSpec = new NCompress::NLzx::CDecoder(true);
+      lzxDecoder = lzxDecoderSpec;
+      RINOK(lzxDecoderSpec->SetParams(kChunkSizeBits));
+    }
+    lzxDecoderSpec->SetKeepHistory(false);
+    UInt64 unpackSize64 = unpackSize;
+    RINOK(lzxDecoder->Code(inStream, outStream, NULL, &unpackSize64, NULL));
+  }
+  else
+  {
+    RINOK(xpressDecoder.Code(inStream, outStream, unpackSize));
+  }
+  return (outStreamSpec->GetPos() == unpackSize) ? S_OK : S_FALSE;
+}
+
+void CUnpackThread::Execute()
+{
+  try
+  {
+    Result = S_OK;
+    CUnpackBatch &b = *Batch;
+    for (unsigned i = StartChunk; i < EndChunk; i++)
+    {
+      size_t packPos = b.PackPos[i];
+      Result = DecodeChunk((const Byte *)b.PackBuf + packPos, b.PackPos[i + 1] - packPos,
+          (Byte *)b.UnpackBuf + ((size_t)i << kChunkSizeBits), b.GetChunkSize(i));
+      if (Result != S_OK)
+        break;
+    }
+  }
+  catch(...) { Result = E_OUTOFMEMORY; }
+}
+
+HRESULT CUnpacker::ReadBatch(IInStream *inStream, CUnpackBatch &batch, const CResource &resource,
+    UInt64 firstChunk, unsigned numChunks, unsigned entrySize, UInt64 sizesBufSize64)
+{
+  const Byte *p = (const Byte *)sizesBuf;
+  UInt64 numChunksTotal = (resource.UnpackSize + kChunkSize - 1) >> kChunkSizeBits;
+  if (resource.PackSize < sizesBufSize64)
+    return S_FALSE;
+
+  batch.PackPos.ClearAndSetSize(numChunks + 1);
+  UInt64 start = 0;
+  for (unsigned i = 0; i <= numChunks; i++)
+  {
+    UInt64 index = firstChunk + i;
+    UInt64 offset;
+    if (index == 0)
+      offset = 0;
+    else if (index == numChunksTotal)
+      offset = resource.PackSize - sizesBufSize64;
+    else
+    {
+      const Byte *p2 = p + (size_t)(index - 1) * entrySize;
+      offset = (entrySize == 4) ? Get32(p2): Get64(p2);
+    }
+    if (i == 0)
+      start = offset;
+    if (offset < start)
+      return S_FALSE;
+    UInt64 pos = offset - start;
+    // incompressible chunks are stored, so we use big limit for packed size of batch only as sanity check
+    if (pos > ((UInt64)i << (kChunkSizeBits + 1)) || (i != 0 && pos < batch.PackPos[i - 1]))
+      return S_FALSE;
+    batch.PackPos[i] = (size_t)pos;
+  }
+  batch.NumChunks = numChunks;
+
+  UInt64 rem = resource.UnpackSize - (firstChunk << kChunkSizeBits);
+  batch.UnpackSize = (size_t)numChunks << kChunkSizeBits;
+  if (batch.UnpackSize > rem)
+    batch.UnpackSize = (size_t)rem;
+
+  size_t packSize = batch.PackPos[numChunks];
+  batch.PackBuf.AllocAtLeast(packSize);
+  batch.UnpackBuf.AllocAtLeast(batch.UnpackSize);
+  RINOK(inStream->Seek(resource.Offset + sizesBufSize64 + start, STREAM_SEEK_SET, NULL));
+  return ReadStream_FALSE(inStream, (Byte *)batch.PackBuf, packSize);
+}
+
+void CUnpacker::StartDecoding(CUnpackBatch &batch, unsigned numThreads)
+{
+  for (unsigned t = 0; t < numThreads; t++)
+  {
+    CUnpackThread &thread = _threads[t];
+    thread.Batch = &batch;
+    thread.StartChunk = batch.NumChunks * t / numThreads;
+    thread.EndChunk = batch.NumChunks * (t + 1) / numThreads;
+    thread.Start();
+  }
+}
+
+HRESULT CUnpacker::WaitDecoding(unsigned numThreads)
+{
+  HRESULT res = S_OK;
+  for (unsigned t = 0; t < numThreads; t++)
+  {
+    CUnpackThread &thread = _threads[t];
+    thread.WaitExecuteFinish();
+    if (res == S_OK)
+      res = thread.Result;
+  }
+  return res;
+}
+
+HRESULT CUnpacker::UnpackMt(IInStream *inStream, const CResource &resource, bool lzxMode,
+    ISequentialOutStream *outStream, ICompressProgressInfo *progress,
+    UInt64 numChunks, unsigned entrySize, UInt64 sizesBufSize64)
+{
+  unsigned numThreads = (NumThreads < kNumThreadsMax) ? NumThreads : kNumThreadsMax;
+  while (_threads.Size() < numThreads)
+  {
+    WRes wres = _threads.AddNew().Create();
+    if (wres != 0)
+    {
+      _threads.DeleteBack();
+      return wres;
+    }
+  }
+  unsigned i;
+  for (i = 0; i < numThreads; i++)
+    _threads[i].LzxMode = lzxMode;
+  for (i = 0; i < 2; i++)
+    _batches[i].NumChunks = 0;
+
+  const unsigned numBatchChunks = numThreads * kNumChunksInThreadBatch;
+  UInt64 firstChunk = 0;
+  UInt64 inProcessed = 0;
+  UInt64 outProcessed = 0;
+  unsigned cur = 0;
+  bool decoding = false;
+  HRESULT res = S_OK;
+
+  /* the main thread reads batch (cur), while threads decode batch (cur ^ 1).
+     Then it writes batch (cur ^ 1), while threads decode batch (cur). */
+
+  for (;;)
+  {
+    CUnpackBatch &batch = _batches[cur];
+    batch.NumChunks = 0;
+    if (firstChunk < numChunks)
+    {
+      unsigned num = numBatchChunks;
+      if (num > numChunks - firstChunk)
+        num = (unsigned)(numChunks - firstChunk);
+      res = ReadBatch(inStream, batch, resource, firstChunk, num, entrySize, sizesBufSize64);
+      firstChunk += num;
+    }
+    if (decoding)
+    {
+      HRESULT res2 = WaitDecoding(numThreads);
+      decoding = false;
+      if (res == S_OK)
+        res = res2;
+    }
+    if (res != S_OK)
+      return res;
+    if (batch.NumChunks != 0)
+    {
+      StartDecoding(batch, numThreads);
+      decoding = true;
+    }
+
+    CUnpackBatch &prev = _batches[cur ^ 1];
+    if (prev.NumChunks != 0)
+    {
+      res = WriteStream(outStream, (const Byte *)prev.UnpackBuf, prev.UnpackSize);
+      inProcessed += prev.PackPos[prev.NumChunks];
+      outProcessed += prev.UnpackSize;
+      prev.NumChunks = 0;
+      if (res == S_OK && progress)
+        res = progress->SetRatioInfo(&inProcessed, &outProcessed);
+      if (res != S_OK)
+        break;
+    }
+    if (!decoding)
+      break;
+    cur ^= 1;
+  }
+  if (decoding)
+    WaitDecoding(numThreads);
+  return res;
+}
+
+#endif
+
 HRESULT CUnpacker::Unpack(IInStream *inStream, const CResource &resource, bool lzxMode,
     ISequentialOutStream *outStream, ICompressProgressInfo *progress)
 {
@@ -161,6 +373,11 @@ HRESULT CUnpacker::Unpack(IInStream *inStream, const CResource &resource, bool l
   RINOK(ReadStream_FALSE(inStream, (Byte *)sizesBuf, sizesBufSize));
   const Byte *p = (const Byte *)sizesBuf;
 
+  #ifndef _7ZIP_ST
+  if (NumThreads > 1 && numChunks >= kMtMinNumChunks)
+    return UnpackMt(inStream, resource, lzxMode, outStream, progress, numChunks, entrySize, sizesBufSize64);
+  #endif
+
   if (lzxMode && !lzxDecoder)
   {
     lzxDecoderSpec = new NCompress::NLzx::CDecoder(true);
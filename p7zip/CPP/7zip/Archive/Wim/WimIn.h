@@ -8,6 +8,11 @@
 
 #include "../../../Windows/PropVariant.h"
 
+#include "../../Common/StreamObjects.h"
+#ifndef _7ZIP_ST
+#include "../../Common/VirtThread.h"
+#endif
+
 #include "../../Compress/CopyCoder.h"
 #include "../../Compress/LzxDecoder.h"
 
@@ -484,6 +489,55 @@ public:
 
 HRESULT ReadHeader(IInStream *inStream, CHeader &header, UInt64 &phySize);
 
+#ifndef _7ZIP_ST
+
+/* Chunks of the resource are independent. Multithreaded unpacker reads the packed
+   data of a batch of chunks, the threads decode the chunks of batch to memory,
+   and the main thread writes the previous batch in order to the output stream
+   (and calculates SHA-1) in parallel with decoding of the next batch. */
+
+struct CUnpackBatch
+{
+  CByteBuffer PackBuf;
+  CByteBuffer UnpackBuf;
+  CRecordVector<size_t> PackPos; // offsets of the chunks in PackBuf. (NumChunks + 1) items
+  unsigned NumChunks;
+  size_t UnpackSize;
+
+  UInt32 GetChunkSize(unsigned index) const
+  {
+    size_t rem = UnpackSize - ((size_t)index << kChunkSizeBits);
+    return (rem < kChunkSize) ? (UInt32)rem : kChunkSize;
+  }
+};
+
+class CUnpackThread: public CVirtThread
+{
+  NCompress::NLzx::CDecoder *lzxDecoderSpec;
+  CMyComPtr<ICompressCoder> lzxDecoder;
+
+  NXpress::CDecoder xpressDecoder;
+
+  CBufInStream *inStreamSpec;
+  CMyComPtr<ISequentialInStream> inStream;
+  CBufPtrSeqOutStream *outStreamSpec;
+  CMyComPtr<ISequentialOutStream> outStream;
+
+  HRESULT DecodeChunk(const Byte *data, size_t packSize, Byte *dest, UInt32 unpackSize);
+public:
+  bool LzxMode;
+  CUnpackBatch *Batch;
+  unsigned StartChunk;
+  unsigned EndChunk;
+  HRESULT Result;
+
+  CUnpackThread(): lzxDecoderSpec(NULL), inStreamSpec(NULL), outStreamSpec(NULL) {}
+  ~CUnpackThread() { CVirtThread::WaitThreadFinish(); }
+  virtual void Execute();
+};
+
+#endif
+
 class CUnpacker
 {
   NCompress::CCopyCoder *copyCoderSpec;
@@ -496,9 +550,27 @@ class CUnpacker
 
   CByteBuffer sizesBuf;
 
+  #ifndef _7ZIP_ST
+  CObjectVector<CUnpackThread> _threads;
+  CUnpackBatch _batches[2];
+
+  HRESULT ReadBatch(IInStream *inStream, CUnpackBatch &batch, const CResource &resource,
+      UInt64 firstChunk, unsigned numChunks, unsigned entrySize, UInt64 sizesBufSize64);
+  void StartDecoding(CUnpackBatch &batch, unsigned numThreads);
+  HRESULT WaitDecoding(unsigned numThreads);
+  HRESULT UnpackMt(IInStream *inStream, const CResource &res, bool lzxMode,
+      ISequentialOutStream *outStream, ICompressProgressInfo *progress,
+      UInt64 numChunks, unsigned entrySize, UInt64 sizesBufSize64);
+  #endif
+
   HRESULT Unpack(IInStream *inStream, const CResource &res, bool lzxMode,
       ISequentialOutStream *outStream, ICompressProgressInfo *progress);
 public:
+  #ifndef _7ZIP_ST
+  UInt32 NumThreads;
+  CUnpacker(): NumThreads(1) {}
+  #endif
+
   HRESULT Unpack(IInStream *inStream, const CResource &res, bool lzxMode,
       ISequentialOutStream *outStream, ICompressProgressInfo *progress, Byte *digest);
 };
@@ -254,6 +254,7 @@ static const CMethodNamePair g_NamePairs[] =
   { XZ_ID_ARM, "ARM" },
   { XZ_ID_ARMT, "ARMT" },
   { XZ_ID_SPARC, "SPARC" },
+  { XZ_ID_ARM64, "ARM64" },
   { XZ_ID_LZMA2, "LZMA2" }
 };
 
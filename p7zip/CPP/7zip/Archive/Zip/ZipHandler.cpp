@@ -148,11 +148,26 @@ static const Byte kArcProps[] =
   kpidComment
 };
 
-CHandler::CHandler()
+CHandler::CHandler(): _lazyItemIndex(-1)
 {
   InitMethodProps();
 }
 
+const CItemEx &CHandler::GetItem(UInt32 index)
+{
+  const CItemEx &item = m_Items[index];
+  if (!item.IsLazy)
+    return item;
+  if (_lazyItemIndex != (int)index)
+  {
+    _lazyItemIndex = -1;
+    _lazyItem = item;
+    m_Archive.DecodeCdItem(_lazyItem);
+    _lazyItemIndex = index;
+  }
+  return _lazyItem;
+}
+
 static AString BytesToString(const CByteBuffer &data)
 {
   AString s;
@@ -236,7 +251,7 @@ STDMETHODIMP CHandler::GetProperty(UInt32 index, PROPID propID, PROPVARIANT *val
 {
   COM_TRY_BEGIN
   NWindows::NCOM::CPropVariant prop;
-  const CItemEx &item = m_Items[index];
+  const CItemEx &item = GetItem(index);
   switch (propID)
   {
     case kpidPath:
@@ -468,6 +483,7 @@ STDMETHODIMP CHandler::Open(IInStream *inStream,
 
 STDMETHODIMP CHandler::Close()
 {
+  _lazyItemIndex = -1;
   m_Items.Clear();
   m_Archive.Close();
   return S_OK;
@@ -893,6 +909,7 @@ STDMETHODIMP CHandler::Extract(const UInt32 *indices, UInt32 numItems,
     UInt32 index = allFilesMode ? i : indices[i];
 
     CItemEx item = m_Items[index];
+    m_Archive.DecodeCdItem(item);
     bool isLocalOffsetOK = m_Archive.IsLocalOffsetOK(item);
     bool skip = !isLocalOffsetOK && !item.IsDir();
     if (skip)
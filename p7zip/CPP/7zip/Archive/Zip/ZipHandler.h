@@ -42,6 +42,12 @@ private:
   CObjectVector<CItemEx> m_Items;
   CInArchive m_Archive;
 
+  // the last decoded lazy item for GetProperty()
+  CItemEx _lazyItem;
+  int _lazyItemIndex;
+
+  const CItemEx &GetItem(UInt32 index);
+
   CBaseProps _props;
 
   int m_MainMethod;
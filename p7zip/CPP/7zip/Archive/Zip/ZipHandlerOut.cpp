@@ -278,6 +278,8 @@ STDMETHODIMP CHandler::UpdateItems(ISequentialOutStream *outStream, UInt32 numIt
   if (mainMethod != NFileHeader::NCompressionMethod::kStored)
     options.MethodSequence.Add(NFileHeader::NCompressionMethod::kStored);
 
+  m_Archive.DecodeCdItems(m_Items);
+
   return Update(
       EXTERNAL_CODECS_VARS
       m_Items, updateItems, outStream,
@@ -104,6 +104,7 @@ void CInArchive::Close()
   NoCentralDir = false;
   IsZip64 = false;
   Stream.Release();
+  CdBuf.Free();
 }
 
 HRESULT CInArchive::Seek(UInt64 offset)
@@ -445,34 +446,34 @@ void CInArchive::ReadFileName(unsigned size, AString &s)
   s.ReleaseBuffer();
 }
 
-bool CInArchive::ReadExtra(unsigned extraSize, CExtraBlock &extraBlock,
+bool CInArchive::ParseExtra(const Byte *p, unsigned extraSize, CExtraBlock *extraBlock,
     UInt64 &unpackSize, UInt64 &packSize, UInt64 &localHeaderOffset, UInt32 &diskStartNumber)
 {
-  extraBlock.Clear();
+  if (extraBlock)
+    extraBlock->Clear();
   UInt32 remain = extraSize;
   while (remain >= 4)
   {
-    CExtraSubBlock subBlock;
-    subBlock.ID = ReadUInt16();
-    unsigned dataSize = ReadUInt16();
+    UInt16 id = Get16(p);
+    unsigned dataSize = Get16(p + 2);
+    p += 4;
     remain -= 4;
     if (dataSize > remain) // it's bug
     {
       HeadersWarning = true;
-      Skip(remain);
       return false;
     }
-    if (subBlock.ID == NFileHeader::NExtraID::kZip64)
+    if (id == NFileHeader::NExtraID::kZip64)
     {
       if (unpackSize == 0xFFFFFFFF)
       {
         if (dataSize < 8)
         {
           HeadersWarning = true;
-          Skip(remain);
           return false;
         }
-        unpackSize = ReadUInt64();
+        unpackSize = Get64(p);
+        p += 8;
         remain -= 8;
         dataSize -= 8;
       }
@@ -480,7 +481,8 @@ bool CInArchive::ReadExtra(unsigned extraSize, CExtraBlock &extraBlock,
       {
         if (dataSize < 8)
           break;
-        packSize = ReadUInt64();
+        packSize = Get64(p);
+        p += 8;
         remain -= 8;
         dataSize -= 8;
       }
@@ -488,7 +490,8 @@ bool CInArchive::ReadExtra(unsigned extraSize, CExtraBlock &extraBlock,
       {
         if (dataSize < 8)
           break;
-        localHeaderOffset = ReadUInt64();
+        localHeaderOffset = Get64(p);
+        p += 8;
         remain -= 8;
         dataSize -= 8;
       }
@@ -496,17 +499,19 @@ bool CInArchive::ReadExtra(unsigned extraSize, CExtraBlock &extraBlock,
       {
         if (dataSize < 4)
           break;
-        diskStartNumber = ReadUInt32();
+        diskStartNumber = Get32(p);
+        p += 4;
         remain -= 4;
         dataSize -= 4;
       }
-      Skip(dataSize);
     }
-    else
+    else if (extraBlock)
     {
-      ReadBuffer(subBlock.Data, dataSize);
-      extraBlock.SubBlocks.Add(subBlock);
+      CExtraSubBlock &subBlock = extraBlock->SubBlocks.AddNew();
+      subBlock.ID = id;
+      subBlock.Data.CopyFrom(p, dataSize);
     }
+    p += dataSize;
     remain -= dataSize;
   }
   if (remain != 0)
@@ -516,10 +521,17 @@ bool CInArchive::ReadExtra(unsigned extraSize, CExtraBlock &extraBlock,
     // so we don't return false, but just set warning flag
     // return false;
   }
-  Skip(remain);
   return true;
 }
 
+bool CInArchive::ReadExtra(unsigned extraSize, CExtraBlock &extraBlock,
+    UInt64 &unpackSize, UInt64 &packSize, UInt64 &localHeaderOffset, UInt32 &diskStartNumber)
+{
+  CByteBuffer buf;
+  ReadBuffer(buf, extraSize);
+  return ParseExtra(buf, extraSize, &extraBlock, unpackSize, packSize, localHeaderOffset, diskStartNumber);
+}
+
 bool CInArchive::ReadLocalItem(CItemEx &item)
 {
   const unsigned kPureHeaderSize = kLocalHeaderSize - 4;
@@ -714,12 +726,34 @@ HRESULT CInArchive::ReadLocalItemAfterCdItemFull(CItemEx &item)
   return S_OK;
 }
 
-HRESULT CInArchive::ReadCdItem(CItemEx &item)
+static const unsigned kCdItemFixedSize = kCentralHeaderSize - 4;
+
+// it returns the size of Name, Extra and Comment of central directory record
+static UInt32 GetCdItemVarSize(const Byte *p)
 {
-  item.FromCentral = true;
-  Byte p[kCentralHeaderSize - 4];
-  SafeReadBytes(p, kCentralHeaderSize - 4);
+  return (UInt32)Get16(p + 24) + Get16(p + 26) + Get16(p + 28);
+}
 
+static void CopyName(const Byte *p, unsigned size, AString &s)
+{
+  if (size == 0)
+  {
+    s.Empty();
+    return;
+  }
+  char *dest = s.GetBuffer(size);
+  memcpy(dest, p, size);
+  dest[size] = 0;
+  s.ReleaseBuffer();
+}
+
+/* p points to central directory record after signature.
+   if (!decodeAll), it doesn't fill Name, CentralExtra and Comment,
+   and it parses only ZIP64 fields from extra. */
+
+HRESULT CInArchive::ParseCdItem(const Byte *p, CItemEx &item, bool decodeAll)
+{
+  item.FromCentral = true;
   item.MadeByVersion.Version = p[0];
   item.MadeByVersion.HostOS = p[1];
   item.ExtractVersion.Version = p[2];
@@ -731,19 +765,23 @@ HRESULT CInArchive::ReadCdItem(CItemEx &item)
   item.PackSize = Get32(p + 16);
   item.Size = Get32(p + 20);
   unsigned nameSize = Get16(p + 24);
-  UInt16 extraSize = Get16(p + 26);
-  UInt16 commentSize = Get16(p + 28);
+  unsigned extraSize = Get16(p + 26);
+  unsigned commentSize = Get16(p + 28);
   UInt32 diskNumberStart = Get16(p + 30);
   item.InternalAttrib = Get16(p + 32);
   item.ExternalAttrib = Get32(p + 34);
   item.LocalHeaderPos = Get32(p + 38);
-  ReadFileName(nameSize, item.Name);
+  p += kCdItemFixedSize;
+  if (decodeAll)
+    CopyName(p, nameSize, item.Name);
+  p += nameSize;
 
   if (extraSize > 0)
   {
-    ReadExtra(extraSize, item.CentralExtra, item.Size, item.PackSize,
+    ParseExtra(p, extraSize, decodeAll ? &item.CentralExtra : NULL, item.Size, item.PackSize,
         item.LocalHeaderPos, diskNumberStart);
   }
+  p += extraSize;
 
   if (diskNumberStart != 0)
     return E_NOTIMPL;
@@ -754,10 +792,36 @@ HRESULT CInArchive::ReadCdItem(CItemEx &item)
     item.Size = 0;
   */
 
-  ReadBuffer(item.Comment, commentSize);
+  if (decodeAll)
+    item.Comment.CopyFrom(p, commentSize);
   return S_OK;
 }
 
+HRESULT CInArchive::ReadCdItem(CItemEx &item)
+{
+  Byte p[kCdItemFixedSize];
+  SafeReadBytes(p, kCdItemFixedSize);
+  UInt32 varSize = GetCdItemVarSize(p);
+  CByteBuffer buf(kCdItemFixedSize + varSize);
+  memcpy(buf, p, kCdItemFixedSize);
+  SafeReadBytes(buf + kCdItemFixedSize, varSize);
+  return ParseCdItem(buf, item, true);
+}
+
+void CInArchive::DecodeCdItem(CItemEx &item)
+{
+  if (!item.IsLazy)
+    return;
+  ParseCdItem(CdBuf + item.CdPos + 4, item, true);
+  item.IsLazy = false;
+}
+
+void CInArchive::DecodeCdItems(CObjectVector<CItemEx> &items)
+{
+  FOR_VECTOR (i, items)
+    DecodeCdItem(items[i]);
+}
+
 void CCdInfo::ParseEcd(const Byte *p)
 {
   NumEntries = Get16(p + 10);
@@ -892,13 +956,73 @@ HRESULT CInArchive::FindCd(CCdInfo &cdInfo)
 }
 
 
+static const UInt32 kCdBufSizeMax = ((UInt32)1 << (sizeof(size_t) > 4 ? 31 : 28));
+static const UInt32 kCdProgressMask = ((UInt32)1 << 12) - 1;
+
 HRESULT CInArchive::TryReadCd(CObjectVector<CItemEx> &items, UInt64 cdOffset, UInt64 cdSize, CProgressVirt *progress)
 {
   items.Clear();
+  CdBuf.Free();
+  UInt64 endPos;
+  RINOK(Stream->Seek(0, STREAM_SEEK_END, &endPos));
   RINOK(Stream->Seek(cdOffset, STREAM_SEEK_SET, &m_Position));
   if (m_Position != cdOffset)
     return S_FALSE;
 
+  if (cdSize <= kCdBufSizeMax)
+  {
+    /* we read full central directory with one read,
+       and we create lazy items that refer to records in CdBuf. */
+    size_t size = (size_t)cdSize;
+    if (cdOffset >= endPos)
+      size = 0;
+    else if (size > endPos - cdOffset)
+      size = (size_t)(endPos - cdOffset);
+    CdBuf.Alloc(size);
+    RINOK(ReadStream(Stream, CdBuf, &size));
+    m_Position += size;
+
+    items.ClearAndReserve((unsigned)(size / kCentralHeaderSize));
+
+    const Byte *buf = CdBuf;
+    size_t pos = 0;
+    while (pos < cdSize)
+    {
+      // the record that crosses the end of data is a truncated record,
+      // if the stream is shorter than central directory.
+      // Otherwise it's a record with incorrect size.
+      if (size - pos < kCentralHeaderSize)
+      {
+        if (size < cdSize)
+          throw CUnexpectEnd();
+        return S_FALSE;
+      }
+      const Byte *p = buf + pos;
+      if (Get32(p) != NSignature::kCentralFileHeader)
+        return S_FALSE;
+      UInt32 recordSize = kCentralHeaderSize + GetCdItemVarSize(p + 4);
+      if (size - pos < recordSize)
+      {
+        if (size < cdSize)
+          throw CUnexpectEnd();
+        return S_FALSE;
+      }
+      CItemEx &cdItem = items.AddNew();
+      RINOK(ParseCdItem(p + 4, cdItem, false));
+      cdItem.IsLazy = true;
+      cdItem.CdPos = (UInt32)pos;
+      pos += recordSize;
+      if (progress && (items.Size() & kCdProgressMask) == 0)
+        RINOK(progress->SetCompletedCD(items.Size()));
+    }
+    if (progress)
+      RINOK(progress->SetCompletedCD(items.Size()));
+
+    _inBuffer.Init();
+    _inBufMode = true;
+    return (pos == cdSize) ? S_OK : S_FALSE;
+  }
+
   _inBuffer.Init();
   _inBufMode = true;
 
@@ -909,7 +1033,7 @@ HRESULT CInArchive::TryReadCd(CObjectVector<CItemEx> &items, UInt64 cdOffset, UI
     CItemEx cdItem;
     RINOK(ReadCdItem(cdItem));
     items.Add(cdItem);
-    if (progress && items.Size() % 1 == 0)
+    if (progress && (items.Size() & kCdProgressMask) == 0)
       RINOK(progress->SetCompletedCD(items.Size()));
   }
   return (m_Position - cdOffset == cdSize) ? S_OK : S_FALSE;
@@ -1071,8 +1195,13 @@ HRESULT CInArchive::ReadHeaders2(CObjectVector<CItemEx> &items, CProgressVirt *p
       int index = FindItem(items, firstItem.LocalHeaderPos);
       if (index == -1)
         res = S_FALSE;
-      else if (!AreItemsEqual(firstItem, items[index]))
-        res = S_FALSE;
+      else
+      {
+        CItemEx cdItem = items[index];
+        DecodeCdItem(cdItem);
+        if (!AreItemsEqual(firstItem, cdItem))
+          res = S_FALSE;
+      }
       ArcInfo.CdWasRead = true;
       ArcInfo.FirstItemRelatOffset = items[0].LocalHeaderPos;
     }
@@ -1087,6 +1216,7 @@ HRESULT CInArchive::ReadHeaders2(CObjectVector<CItemEx> &items, CProgressVirt *p
   {
     // CD doesn't match firstItem so we clear items and read Locals.
     items.Clear();
+    CdBuf.Free();
     localsWereRead = true;
     _inBufMode = false;
     ArcInfo.Base = ArcInfo.MarkerPos;
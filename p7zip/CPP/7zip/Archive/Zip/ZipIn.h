@@ -22,6 +22,14 @@ class CItemEx: public CItem
 public:
   UInt32 LocalFullHeaderSize; // including Name and Extra
 
+  /* if (IsLazy), Name, CentralExtra and Comment of item are not decoded still.
+     They are in central directory record at CdPos in CInArchive::CdBuf.
+     CInArchive::DecodeCdItem() decodes them. */
+  bool IsLazy;
+  UInt32 CdPos;
+
+  CItemEx(): IsLazy(false), CdPos(0) {}
+
   UInt64 GetLocalFullSize() const
     { return LocalFullHeaderSize + PackSize + (HasDescriptor() ? kDataDescriptorSize : 0); }
   UInt64 GetDataPosition() const
@@ -120,10 +128,13 @@ class CInArchive
   void Skip64(UInt64 num);
   void ReadFileName(unsigned nameSize, AString &dest);
 
+  bool ParseExtra(const Byte *p, unsigned extraSize, CExtraBlock *extraBlock,
+      UInt64 &unpackSize, UInt64 &packSize, UInt64 &localHeaderOffset, UInt32 &diskStartNumber);
   bool ReadExtra(unsigned extraSize, CExtraBlock &extraBlock,
       UInt64 &unpackSize, UInt64 &packSize, UInt64 &localHeaderOffset, UInt32 &diskStartNumber);
   bool ReadLocalItem(CItemEx &item);
   HRESULT ReadLocalItemDescriptor(CItemEx &item);
+  HRESULT ParseCdItem(const Byte *p, CItemEx &item, bool decodeAll);
   HRESULT ReadCdItem(CItemEx &item);
   HRESULT TryEcd64(UInt64 offset, CCdInfo &cdInfo);
   HRESULT FindCd(CCdInfo &cdInfo);
@@ -145,6 +156,10 @@ public:
 
   CMyComPtr<IInStream> Stream;
 
+  /* the central directory is read to CdBuf by one read.
+     The items from CdBuf are lazy, and CdBuf is kept while archive is open. */
+  CByteBuffer CdBuf;
+
   void Close();
   HRESULT Open(IInStream *stream, const UInt64 *searchHeaderSizeLimit);
   HRESULT ReadHeaders(CObjectVector<CItemEx> &items, CProgressVirt *progress);
@@ -159,6 +174,9 @@ public:
     return /* ArcInfo.Base >= 0 || */ ArcInfo.Base + (Int64)item.LocalHeaderPos >= 0;
   }
 
+  void DecodeCdItem(CItemEx &item);
+  void DecodeCdItems(CObjectVector<CItemEx> &items);
+
   HRESULT ReadLocalItemAfterCdItem(CItemEx &item);
   HRESULT ReadLocalItemAfterCdItemFull(CItemEx &item);
 
@@ -0,0 +1,211 @@
+// DicPool.cpp
+
+#include "StdAfx.h"
+
+#include "../../../C/Alloc.h"
+
+#ifndef _7ZIP_ST
+#include "../../Windows/Synchronization.h"
+#endif
+
+#include "DicPool.h"
+
+namespace NDicPool {
+
+/* Each block starts with CBlock header. kHeaderSize keeps the alignment
+   of the data returned by BigAlloc / MyAlloc. */
+
+struct CBlock
+{
+  CBlock *Prev;
+  CBlock *Next;
+  size_t Size; // size of bucket. 0 for small blocks that are not pooled
+};
+
+static const size_t kHeaderSize = 64;
+
+static const UInt64 kDefaultLimit = (sizeof(size_t) > 4) ? ((UInt64)1 << 29) : ((UInt64)1 << 27);
+
+#ifndef _7ZIP_ST
+static NWindows::NSynchronization::CCriticalSection g_CriticalSection;
+#define LOCK_POOL NWindows::NSynchronization::CCriticalSectionLock lock(g_CriticalSection);
+#else
+#define LOCK_POOL
+#endif
+
+// g_List is sentinel of the list of cached blocks: (g_List.Next) is most recently released block
+
+static CBlock g_List = { &g_List, &g_List, 0 };
+static UInt64 g_Limit = kDefaultLimit;
+static UInt64 g_CachedSize = 0;
+static UInt64 g_UsedSize = 0;
+static UInt32 g_NumCached = 0;
+static UInt64 g_NumHits = 0;
+static UInt64 g_NumMisses = 0;
+static UInt64 g_NumTrimmed = 0;
+
+static size_t GetBucketSize(size_t size)
+{
+  for (unsigned i = 18; i < sizeof(size_t) * 8 - 1; i++)
+  {
+    size_t s = (size_t)1 << i;
+    if (size <= s)
+      return s;
+    if (size <= s + (s >> 1))
+      return s + (s >> 1);
+  }
+  return size;
+}
+
+static void Unlink(CBlock *b)
+{
+  b->Prev->Next = b->Next;
+  b->Next->Prev = b->Prev;
+}
+
+// it moves least recently released blocks to (freeList) while (g_CachedSize > maxCachedSize)
+
+static void CutCached(UInt64 maxCachedSize, CBlock *&freeList)
+{
+  while (g_CachedSize > maxCachedSize)
+  {
+    CBlock *b = g_List.Prev;
+    Unlink(b);
+    g_CachedSize -= b->Size;
+    g_NumCached--;
+    g_NumTrimmed++;
+    b->Next = freeList;
+    freeList = b;
+  }
+}
+
+static void FreeList(CBlock *freeList)
+{
+  while (freeList)
+  {
+    CBlock *next = freeList->Next;
+    ::BigFree(freeList);
+    freeList = next;
+  }
+}
+
+void *Alloc(size_t size)
+{
+  if (size == 0)
+    return 0;
+  if (size < kMinPoolSize)
+  {
+    CBlock *b = (CBlock *)::MyAlloc(size + kHeaderSize);
+    if (!b)
+      return 0;
+    b->Size = 0;
+    return (Byte *)b + kHeaderSize;
+  }
+
+  size_t bucketSize = GetBucketSize(size);
+  if (bucketSize + kHeaderSize < bucketSize)
+    return 0;
+  {
+    LOCK_POOL
+    for (CBlock *b = g_List.Next; b != &g_List; b = b->Next)
+      if (b->Size == bucketSize)
+      {
+        Unlink(b);
+        g_CachedSize -= bucketSize;
+        g_NumCached--;
+        g_UsedSize += bucketSize;
+        g_NumHits++;
+        return (Byte *)b + kHeaderSize;
+      }
+    g_NumMisses++;
+  }
+
+  CBlock *b = (CBlock *)::BigAlloc(bucketSize + kHeaderSize);
+  if (!b)
+  {
+    // we free the cached blocks and try again
+    Trim(0);
+    b = (CBlock *)::BigAlloc(bucketSize + kHeaderSize);
+    if (!b)
+      return 0;
+  }
+  b->Size = bucketSize;
+  {
+    LOCK_POOL
+    g_UsedSize += bucketSize;
+  }
+  return (Byte *)b + kHeaderSize;
+}
+
+void Free(void *address)
+{
+  if (!address)
+    return;
+  CBlock *b = (CBlock *)((Byte *)address - kHeaderSize);
+  if (b->Size == 0)
+  {
+    ::MyFree(b);
+    return;
+  }
+  CBlock *freeList = 0;
+  {
+    LOCK_POOL
+    g_UsedSize -= b->Size;
+    if (b->Size > g_Limit)
+    {
+      g_NumTrimmed++;
+      b->Next = freeList;
+      freeList = b;
+    }
+    else
+    {
+      b->Prev = &g_List;
+      b->Next = g_List.Next;
+      g_List.Next->Prev = b;
+      g_List.Next = b;
+      g_CachedSize += b->Size;
+      g_NumCached++;
+      CutCached(g_Limit, freeList);
+    }
+  }
+  FreeList(freeList);
+}
+
+void SetLimit(UInt64 limit)
+{
+  CBlock *freeList = 0;
+  {
+    LOCK_POOL
+    g_Limit = limit;
+    CutCached(limit, freeList);
+  }
+  FreeList(freeList);
+}
+
+void Trim(UInt64 maxCachedSize)
+{
+  CBlock *freeList = 0;
+  {
+    LOCK_POOL
+    CutCached(maxCachedSize, freeList);
+  }
+  FreeList(freeList);
+}
+
+void GetStats(CStats &stats)
+{
+  LOCK_POOL
+  stats.Limit = g_Limit;
+  stats.CachedSize = g_CachedSize;
+  stats.UsedSize = g_UsedSize;
+  stats.NumCached = g_NumCached;
+  stats.NumHits = g_NumHits;
+  stats.NumMisses = g_NumMisses;
+  stats.NumTrimmed = g_NumTrimmed;
+}
+
+// it frees the cached blocks, when the library gets unloaded
+
+static struct CPoolCleaner { ~CPoolCleaner() { Trim(0); } } g_PoolCleaner;
+
+}
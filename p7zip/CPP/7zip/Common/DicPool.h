@@ -0,0 +1,44 @@
+// DicPool.h
+
+#ifndef __DIC_POOL_H
+#define __DIC_POOL_H
+
+#include "../../Common/MyTypes.h"
+
+/* Process-wide pool of dictionary and stream buffers of decoders.
+   Decoders get created for each extraction and free their buffers at the end.
+   For archives with big dictionaries the allocation and the page faults of
+   the dictionary cost more than the decoding of small files. The pool keeps
+   released buffers of (size >= kMinPoolSize) in size buckets, so the next
+   decoder with a dictionary of the same bucket gets an already touched buffer.
+
+   The sizes are rounded up to (2^n) or (3 * 2^(n-1)), like the dictionary sizes
+   of 7z archives. The total size of cached buffers is limited by Limit.
+   The least recently released buffers are freed first, if the limit is exceeded.
+   Limit == 0 disables the pool. */
+
+namespace NDicPool {
+
+const size_t kMinPoolSize = (size_t)1 << 18;
+
+struct CStats
+{
+  UInt64 Limit;
+  UInt64 CachedSize;  // size of released buffers in the pool
+  UInt64 UsedSize;    // size of pooled buffers in use by decoders
+  UInt32 NumCached;
+  UInt64 NumHits;     // allocations satisfied from the pool
+  UInt64 NumMisses;   // allocations of new buffers
+  UInt64 NumTrimmed;  // buffers freed due to limit or Trim()
+};
+
+void *Alloc(size_t size);
+void Free(void *address);
+
+void SetLimit(UInt64 limit);
+void Trim(UInt64 maxCachedSize);
+void GetStats(CStats &stats);
+
+}
+
+#endif
@@ -270,6 +270,22 @@ STDMETHODIMP CInFileStream::GetSize(UInt64 *size)
   return ConvertBoolToHRESULT(File.GetLength(*size));
 }
 
+#ifdef USE_FILE_FD
+
+STDMETHODIMP CInFileStream::GetFd(int *fd, UInt64 *rem)
+{
+  *fd = File.GetFd();
+  *rem = (UInt64)(Int64)-1;
+  return (*fd < 0) ? S_FALSE : S_OK;
+}
+
+STDMETHODIMP CInFileStream::FdTransferred(UInt64 /* size */)
+{
+  return S_OK;
+}
+
+#endif
+
 #ifdef _WIN32 // FIXME #ifdef USE_WIN_FILE
 
 STDMETHODIMP CInFileStream::GetProps(UInt64 *size, FILETIME *cTime, FILETIME *aTime, FILETIME *mTime, UInt32 *attrib)
@@ -381,6 +397,23 @@ STDMETHODIMP COutFileStream::SetSize(UInt64 newSize)
   #endif
 }
 
+#ifdef USE_FILE_FD
+
+STDMETHODIMP COutFileStream::GetFd(int *fd, UInt64 *rem)
+{
+  *fd = File.GetFd();
+  *rem = (UInt64)(Int64)-1;
+  return (*fd < 0) ? S_FALSE : S_OK;
+}
+
+STDMETHODIMP COutFileStream::FdTransferred(UInt64 size)
+{
+  ProcessedSize += size;
+  return S_OK;
+}
+
+#endif
+
 #ifdef UNDER_CE
 STDMETHODIMP CStdOutFileStream::Write(const void *data, UInt32 size, UInt32 *processedSize)
 {
@@ -7,6 +7,10 @@
 #define USE_WIN_FILE
 #endif
 
+#if defined(USE_WIN_FILE) && !defined(_WIN32)
+#define USE_FILE_FD
+#endif
+
 #include "../../Common/MyString.h"
 
 #ifdef USE_WIN_FILE
@@ -25,6 +29,9 @@ class CInFileStream:
 #ifdef _WIN32
   public IStreamGetProps,
   public IStreamGetProps2,
+#endif
+#ifdef USE_FILE_FD
+  public IStreamGetFd,
 #endif
   public CMyUnknownImp
 {
@@ -85,6 +92,9 @@ public:
   MY_QUERYINTERFACE_ENTRY(IStreamGetProps)
   MY_QUERYINTERFACE_ENTRY(IStreamGetProps2)
   #endif
+  #ifdef USE_FILE_FD
+  MY_QUERYINTERFACE_ENTRY(IStreamGetFd)
+  #endif
   MY_QUERYINTERFACE_END
   MY_ADDREF_RELEASE
 
@@ -96,6 +106,10 @@ public:
   STDMETHOD(GetProps)(UInt64 *size, FILETIME *cTime, FILETIME *aTime, FILETIME *mTime, UInt32 *attrib);
   STDMETHOD(GetProps2)(CStreamFileProps *props);
   #endif
+  #ifdef USE_FILE_FD
+  STDMETHOD(GetFd)(int *fd, UInt64 *rem);
+  STDMETHOD(FdTransferred)(UInt64 size);
+  #endif
 };
 
 class CStdInFileStream:
@@ -111,6 +125,9 @@ public:
 
 class COutFileStream:
   public IOutStream,
+  #ifdef USE_FILE_FD
+  public IStreamGetFd,
+  #endif
   public CMyUnknownImp
 {
 public:
@@ -144,11 +161,20 @@ public:
   #endif
 
 
-  MY_UNKNOWN_IMP1(IOutStream)
+  MY_QUERYINTERFACE_BEGIN2(IOutStream)
+  #ifdef USE_FILE_FD
+  MY_QUERYINTERFACE_ENTRY(IStreamGetFd)
+  #endif
+  MY_QUERYINTERFACE_END
+  MY_ADDREF_RELEASE
 
   STDMETHOD(Write)(const void *data, UInt32 size, UInt32 *processedSize);
   STDMETHOD(Seek)(Int64 offset, UInt32 seekOrigin, UInt64 *newPosition);
   STDMETHOD(SetSize)(UInt64 newSize);
+  #ifdef USE_FILE_FD
+  STDMETHOD(GetFd)(int *fd, UInt64 *rem);
+  STDMETHOD(FdTransferred)(UInt64 size);
+  #endif
 };
 
 class CStdOutFileStream:
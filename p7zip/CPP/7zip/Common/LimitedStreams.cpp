@@ -22,6 +22,44 @@ STDMETHODIMP CLimitedSequentialInStream::Read(void *data, UInt32 size, UInt32 *p
   return result;
 }
 
+// CLimitedSequentialInStream and CLimitedSequentialOutStream give the file descriptor of the inner stream
+
+static HRESULT GetStreamFd(IUnknown *stream, int *fd, UInt64 *rem)
+{
+  *fd = -1;
+  *rem = 0;
+  if (!stream)
+    return S_FALSE;
+  CMyComPtr<IStreamGetFd> getFd;
+  stream->QueryInterface(IID_IStreamGetFd, (void **)&getFd);
+  if (!getFd)
+    return S_FALSE;
+  return getFd->GetFd(fd, rem);
+}
+
+static HRESULT StreamFdTransferred(IUnknown *stream, UInt64 size)
+{
+  CMyComPtr<IStreamGetFd> getFd;
+  stream->QueryInterface(IID_IStreamGetFd, (void **)&getFd);
+  if (!getFd)
+    return E_FAIL;
+  return getFd->FdTransferred(size);
+}
+
+STDMETHODIMP CLimitedSequentialInStream::GetFd(int *fd, UInt64 *rem)
+{
+  RINOK(GetStreamFd(_stream, fd, rem));
+  if (*rem > _size - _pos)
+    *rem = _size - _pos;
+  return S_OK;
+}
+
+STDMETHODIMP CLimitedSequentialInStream::FdTransferred(UInt64 size)
+{
+  _pos += size;
+  return StreamFdTransferred(_stream, size);
+}
+
 STDMETHODIMP CLimitedInStream::Read(void *data, UInt32 size, UInt32 *processedSize)
 {
   if (processedSize)
@@ -221,6 +259,20 @@ STDMETHODIMP CLimitedSequentialOutStream::Write(const void *data, UInt32 size, U
   return result;
 }
 
+STDMETHODIMP CLimitedSequentialOutStream::GetFd(int *fd, UInt64 *rem)
+{
+  RINOK(GetStreamFd(_stream, fd, rem));
+  if (*rem > _size)
+    *rem = _size;
+  return S_OK;
+}
+
+STDMETHODIMP CLimitedSequentialOutStream::FdTransferred(UInt64 size)
+{
+  _size -= size;
+  return StreamFdTransferred(_stream, size);
+}
+
 
 STDMETHODIMP CTailInStream::Read(void *data, UInt32 size, UInt32 *processedSize)
 {
@@ -10,6 +10,7 @@
 
 class CLimitedSequentialInStream:
   public ISequentialInStream,
+  public IStreamGetFd,
   public CMyUnknownImp
 {
   CMyComPtr<ISequentialInStream> _stream;
@@ -26,9 +27,11 @@ public:
     _wasFinished = false;
   }
 
-  MY_UNKNOWN_IMP1(ISequentialInStream)
+  MY_UNKNOWN_IMP2(ISequentialInStream, IStreamGetFd)
 
   STDMETHOD(Read)(void *data, UInt32 size, UInt32 *processedSize);
+  STDMETHOD(GetFd)(int *fd, UInt64 *rem);
+  STDMETHOD(FdTransferred)(UInt64 size);
   UInt64 GetSize() const { return _pos; }
   bool WasFinished() const { return _wasFinished; }
 };
@@ -135,6 +138,7 @@ public:
 
 class CLimitedSequentialOutStream:
   public ISequentialOutStream,
+  public IStreamGetFd,
   public CMyUnknownImp
 {
   CMyComPtr<ISequentialOutStream> _stream;
@@ -142,8 +146,10 @@ class CLimitedSequentialOutStream:
   bool _overflow;
   bool _overflowIsAllowed;
 public:
-  MY_UNKNOWN_IMP1(ISequentialOutStream)
+  MY_UNKNOWN_IMP2(ISequentialOutStream, IStreamGetFd)
   STDMETHOD(Write)(const void *data, UInt32 size, UInt32 *processedSize);
+  STDMETHOD(GetFd)(int *fd, UInt64 *rem);
+  STDMETHOD(FdTransferred)(UInt64 size);
   void SetStream(ISequentialOutStream *stream) { _stream = stream; }
   void ReleaseStream() { _stream.Release(); }
   void Init(UInt64 size, bool overflowIsAllowed = false)
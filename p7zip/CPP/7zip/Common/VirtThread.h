@@ -13,7 +13,7 @@ struct CVirtThread
   NWindows::CThread Thread;
   bool Exit;
 
-  ~CVirtThread() { WaitThreadFinish(); }
+  virtual ~CVirtThread() { WaitThreadFinish(); }
   void WaitThreadFinish(); // call it in destructor of child class !
   WRes Create();
   void Start();
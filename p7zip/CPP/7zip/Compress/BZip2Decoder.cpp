@@ -13,7 +13,7 @@ namespace NBZip2 {
 #undef NO_INLINE
 #define NO_INLINE
 
-static const UInt32 kNumThreadsMax = 4;
+static const UInt32 kNumThreadsMax = 32;
 
 static const UInt32 kBufferSize = (1 << 17);
 
@@ -79,10 +79,27 @@ bool CState::Alloc()
   return (Counters != 0);
 }
 
+bool CState::AllocBwt()
+{
+  if (!Alloc())
+    return false;
+  if (!Lf)
+  {
+    Lf = (UInt32 *)::BigAlloc(kBlockSizeMax * sizeof(UInt32) + kBlockSizeMax);
+    if (!Lf)
+      return false;
+    Bwt = (Byte *)(Lf + kBlockSizeMax);
+  }
+  return true;
+}
+
 void CState::Free()
 {
   ::BigFree(Counters);
   Counters = 0;
+  ::BigFree(Lf);
+  Lf = 0;
+  Bwt = 0;
 }
 
 Byte CDecoder::ReadByte() { return (Byte)Base.ReadBits(8); }
@@ -243,7 +260,13 @@ HRESULT CBase::ReadBlock(UInt32 *charCounters, UInt32 blockSizeMax, CBlockProps
   return (props->origPtr < props->blockSize) ? S_OK : S_FALSE;
 }
 
-static void NO_INLINE DecodeBlock1(UInt32 *charCounters, UInt32 blockSize)
+/*
+  DecodeBlock1() computes the T^(-1) vector in (tt).
+  If (lf != NULL), it also writes the LF vector: lf[i] = (LF(i) << 8) | L[i].
+  The writes to (lf) are sequential, so it's cheap.
+*/
+
+static void NO_INLINE DecodeBlock1(UInt32 *charCounters, UInt32 blockSize, UInt32 *lf)
 {
   {
     UInt32 sum = 0;
@@ -257,25 +280,61 @@ static void NO_INLINE DecodeBlock1(UInt32 *charCounters, UInt32 blockSize)
   UInt32 *tt = charCounters + 256;
   // Compute the T^(-1) vector
   UInt32 i = 0;
+  if (!lf)
+  {
+    do
+      tt[charCounters[tt[i] & 0xFF]++] |= (i << 8);
+    while (++i < blockSize);
+    return;
+  }
   do
-    tt[charCounters[tt[i] & 0xFF]++] |= (i << 8);
+  {
+    unsigned b = (unsigned)(tt[i] & 0xFF);
+    UInt32 k = charCounters[b]++;
+    tt[k] |= (i << 8);
+    lf[i] = (k << 8) | b;
+  }
   while (++i < blockSize);
 }
 
-static UInt32 NO_INLINE DecodeBlock2(const UInt32 *tt, UInt32 blockSize, UInt32 OrigPtr, COutBuffer &m_OutStream)
+/*
+  DecodeBwt() writes the output of inverse BWT to (dest).
+  The walk over (tt) has one cache miss per byte, and each access depends on previous one.
+  So it walks forward from the start of block over (tt) and backward from the end
+  of block over (lf) at same time: two independent chains of cache misses overlap.
+*/
+
+static void NO_INLINE DecodeBwt(const UInt32 *tt, const UInt32 *lf, UInt32 blockSize, UInt32 origPtr, Byte *dest)
 {
-  CBZip2Crc crc;
+  UInt32 next = tt[origPtr] >> 8;
+  UInt32 prev = origPtr;
+  Byte *destLim = dest + blockSize;
+  for (UInt32 i = blockSize >> 1; i != 0; i--)
+  {
+    UInt32 v1 = tt[next];
+    UInt32 v2 = lf[prev];
+    *dest++ = (Byte)v1;
+    *--destLim = (Byte)v2;
+    next = v1 >> 8;
+    prev = v2 >> 8;
+  }
+  if (dest != destLim)
+    *dest = (Byte)tt[next];
+}
 
-  // it's for speed optimization: prefetch & prevByte_init;
-  UInt32 tPos = tt[tt[OrigPtr] >> 8];
-  unsigned prevByte = (unsigned)(tPos & 0xFF);
+// DecodeRle() decodes the runs of 4 bytes and count, and it returns CRC of block
 
+static UInt32 NO_INLINE DecodeRle(const Byte *src, UInt32 blockSize, COutBuffer &m_OutStream)
+{
+  CBZip2Crc crc;
+
+  const Byte *srcLim = src + blockSize;
+  unsigned prevByte = *src;
   unsigned numReps = 0;
 
   do
   {
-    unsigned b = (unsigned)(tPos & 0xFF);
-    tPos = tt[tPos >> 8];
+    unsigned b = *src++;
 
     if (numReps == kRleModeRepSize)
     {
@@ -293,83 +352,25 @@ static UInt32 NO_INLINE DecodeBlock2(const UInt32 *tt, UInt32 blockSize, UInt32
     prevByte = b;
     crc.UpdateByte(b);
     m_OutStream.WriteByte((Byte)b);
-
-    /*
-    prevByte = b;
-    crc.UpdateByte(b);
-    m_OutStream.WriteByte((Byte)b);
-    for (; --blockSize != 0;)
-    {
-      b = (unsigned)(tPos & 0xFF);
-      tPos = tt[tPos >> 8];
-      crc.UpdateByte(b);
-      m_OutStream.WriteByte((Byte)b);
-      if (b != prevByte)
-      {
-        prevByte = b;
-        continue;
-      }
-      if (--blockSize == 0)
-        break;
-
-      b = (unsigned)(tPos & 0xFF);
-      tPos = tt[tPos >> 8];
-      crc.UpdateByte(b);
-      m_OutStream.WriteByte((Byte)b);
-      if (b != prevByte)
-      {
-        prevByte = b;
-        continue;
-      }
-      if (--blockSize == 0)
-        break;
-
-      b = (unsigned)(tPos & 0xFF);
-      tPos = tt[tPos >> 8];
-      crc.UpdateByte(b);
-      m_OutStream.WriteByte((Byte)b);
-      if (b != prevByte)
-      {
-        prevByte = b;
-        continue;
-      }
-      --blockSize;
-      break;
-    }
-    if (blockSize == 0)
-      break;
-
-    b = (unsigned)(tPos & 0xFF);
-    tPos = tt[tPos >> 8];
-
-    for (; b > 0; b--)
-    {
-      crc.UpdateByte(prevByte);
-      m_OutStream.WriteByte((Byte)prevByte);
-    }
-    */
   }
-  while (--blockSize != 0);
+  while (src != srcLim);
   return crc.GetDigest();
 }
 
-static UInt32 NO_INLINE DecodeBlock2Rand(const UInt32 *tt, UInt32 blockSize, UInt32 OrigPtr, COutBuffer &m_OutStream)
+static UInt32 NO_INLINE DecodeRleRand(const Byte *src, UInt32 blockSize, COutBuffer &m_OutStream)
 {
   CBZip2Crc crc;
 
   UInt32 randIndex = 1;
   UInt32 randToGo = kRandNums[0] - 2;
 
+  const Byte *srcLim = src + blockSize;
+  unsigned prevByte = *src;
   unsigned numReps = 0;
 
-  // it's for speed optimization: prefetch & prevByte_init;
-  UInt32 tPos = tt[tt[OrigPtr] >> 8];
-  unsigned prevByte = (unsigned)(tPos & 0xFF);
-
   do
   {
-    unsigned b = (unsigned)(tPos & 0xFF);
-    tPos = tt[tPos >> 8];
+    unsigned b = *src++;
 
     {
       if (randToGo == 0)
@@ -398,90 +399,28 @@ static UInt32 NO_INLINE DecodeBlock2Rand(const UInt32 *tt, UInt32 blockSize, UIn
     crc.UpdateByte(b);
     m_OutStream.WriteByte((Byte)b);
   }
-  while (--blockSize != 0);
+  while (src != srcLim);
   return crc.GetDigest();
 }
 
-static UInt32 NO_INLINE DecodeBlock(const CBlockProps &props, UInt32 *tt, COutBuffer &m_OutStream)
+static UInt32 NO_INLINE DecodeBlock(const CBlockProps &props, CState &state, COutBuffer &m_OutStream)
 {
+  DecodeBlock1(state.Counters, props.blockSize, state.Lf);
+  DecodeBwt(state.Counters + 256, state.Lf, props.blockSize, props.origPtr, state.Bwt);
   if (props.randMode)
-    return DecodeBlock2Rand(tt, props.blockSize, props.origPtr, m_OutStream);
+    return DecodeRleRand(state.Bwt, props.blockSize, m_OutStream);
   else
-    return DecodeBlock2    (tt, props.blockSize, props.origPtr, m_OutStream);
+    return DecodeRle    (state.Bwt, props.blockSize, m_OutStream);
 }
 
 CDecoder::CDecoder()
 {
   #ifndef _7ZIP_ST
-  m_States = 0;
-  m_NumThreadsPrev = 0;
   NumThreads = 1;
   #endif
   _needInStreamInit = true;
 }
 
-#ifndef _7ZIP_ST
-
-CDecoder::~CDecoder()
-{
-  Free();
-}
-
-#define RINOK_THREAD(x) { WRes __result_ = (x); if (__result_ != 0) return __result_; }
-
-HRESULT CDecoder::Create()
-{
-  RINOK_THREAD(CanProcessEvent.CreateIfNotCreated());
-  RINOK_THREAD(CanStartWaitingEvent.CreateIfNotCreated());
-  if (m_States != 0 && m_NumThreadsPrev == NumThreads)
-    return S_OK;
-  Free();
-  MtMode = (NumThreads > 1);
-  m_NumThreadsPrev = NumThreads;
-  try
-  {
-    m_States = new CState[NumThreads];
-    if (!m_States)
-      return E_OUTOFMEMORY;
-  }
-  catch(...) { return E_OUTOFMEMORY; }
-  for (UInt32 t = 0; t < NumThreads; t++)
-  {
-    CState &ti = m_States[t];
-    ti.Decoder = this;
-    if (MtMode)
-    {
-      HRESULT res = ti.Create();
-      if (res != S_OK)
-      {
-        NumThreads = t;
-        Free();
-        return res;
-      }
-    }
-  }
-  return S_OK;
-}
-
-void CDecoder::Free()
-{
-  if (!m_States)
-    return;
-  CloseThreads = true;
-  CanProcessEvent.Set();
-  for (UInt32 t = 0; t < NumThreads; t++)
-  {
-    CState &s = m_States[t];
-    if (MtMode)
-      s.Thread.Wait();
-    s.Free();
-  }
-  delete []m_States;
-  m_States = 0;
-}
-
-#endif
-
 bool IsEndSig(const Byte *p) throw()
 {
   return
@@ -549,24 +488,6 @@ HRESULT CDecoder::ReadSignature(UInt32 &crc)
 HRESULT CDecoder::DecodeFile(ICompressProgressInfo *progress)
 {
   Progress = progress;
-  #ifndef _7ZIP_ST
-  RINOK(Create());
-  for (UInt32 t = 0; t < NumThreads; t++)
-  {
-    CState &s = m_States[t];
-    if (!s.Alloc())
-      return E_OUTOFMEMORY;
-    if (MtMode)
-    {
-      RINOK(s.StreamWasFinishedEvent.Reset());
-      RINOK(s.WaitingWasStartedEvent.Reset());
-      RINOK(s.CanWriteEvent.Reset());
-    }
-  }
-  #else
-  if (!m_States[0].Alloc())
-    return E_OUTOFMEMORY;
-  #endif
 
   IsBz = false;
 
@@ -592,52 +513,33 @@ HRESULT CDecoder::DecodeFile(ICompressProgressInfo *progress)
   UInt32 dicSize = (UInt32)(s[3] - kArSig3) * kBlockSizeStep;
 
   CombinedCrc.Init();
+
   #ifndef _7ZIP_ST
-  if (MtMode)
-  {
-    NextBlockIndex = 0;
-    StreamWasFinished1 = StreamWasFinished2 = false;
-    CloseThreads = false;
-    CanStartWaitingEvent.Reset();
-    m_States[0].CanWriteEvent.Set();
-    BlockSizeMax = dicSize;
-    Result1 = Result2 = S_OK;
-    CanProcessEvent.Set();
-    UInt32 t;
-    for (t = 0; t < NumThreads; t++)
-      m_States[t].StreamWasFinishedEvent.Lock();
-    CanProcessEvent.Reset();
-    CanStartWaitingEvent.Set();
-    for (t = 0; t < NumThreads; t++)
-      m_States[t].WaitingWasStartedEvent.Lock();
-    CanStartWaitingEvent.Reset();
-    RINOK(Result2);
-    RINOK(Result1);
-  }
-  else
+  if (NumThreads > 1)
+    return DecodeFileMt(dicSize);
   #endif
+
+  CState &state = m_State;
+  if (!state.AllocBwt())
+    return E_OUTOFMEMORY;
+
+  for (;;)
   {
-    CState &state = m_States[0];
-    for (;;)
-    {
-      RINOK(SetRatioProgress(Base.BitDecoder.GetProcessedSize()));
-      UInt32 crc;
-      RINOK(ReadSignature(crc));
-      if (BzWasFinished)
-        return S_OK;
+    RINOK(SetRatioProgress(Base.BitDecoder.GetProcessedSize()));
+    UInt32 crc;
+    RINOK(ReadSignature(crc));
+    if (BzWasFinished)
+      return S_OK;
 
-      CBlockProps props;
-      props.randMode = true;
-      RINOK(Base.ReadBlock(state.Counters, dicSize, &props));
-      DecodeBlock1(state.Counters, props.blockSize);
-      if (DecodeBlock(props, state.Counters + 256, m_OutStream) != crc)
-      {
-        CrcError = true;
-        return S_FALSE;
-      }
+    CBlockProps props;
+    props.randMode = true;
+    RINOK(Base.ReadBlock(state.Counters, dicSize, &props));
+    if (DecodeBlock(props, state, m_OutStream) != crc)
+    {
+      CrcError = true;
+      return S_FALSE;
     }
   }
-  return SetRatioProgress(Base.BitDecoder.GetProcessedSize());
 }
 
 HRESULT CDecoder::CodeReal(ISequentialInStream *inStream, ISequentialOutStream *outStream,
@@ -709,119 +611,328 @@ STDMETHODIMP CDecoder::ReleaseInStream()
 
 #ifndef _7ZIP_ST
 
-static THREAD_FUNC_DECL MFThread(void *p) { ((CState *)p)->ThreadFunc(); return 0; }
+#define RINOK_THREAD(x) { WRes __result_ = (x); if (__result_ != 0) return __result_; }
+
+static const unsigned kSigBits = 48;
+static const unsigned kCrcBits = 32;
+static const UInt64 kSigMask = ((UInt64)1 << kSigBits) - 1;
+static const UInt64 kNoSig = (UInt64)(Int64)-1;
+
+static const UInt64 kBlockSig =
+    ((UInt64)kBlockSig0 << 40) | ((UInt64)kBlockSig1 << 32) | ((UInt32)kBlockSig2 << 24) |
+    ((UInt32)kBlockSig3 << 16) | ((UInt32)kBlockSig4 << 8) | kBlockSig5;
+static const UInt64 kEndSig =
+    ((UInt64)kFinSig0 << 40) | ((UInt64)kFinSig1 << 32) | ((UInt32)kFinSig2 << 24) |
+    ((UInt32)kFinSig3 << 16) | ((UInt32)kFinSig4 << 8) | kFinSig5;
+
+/* If there are no signatures in (kMtSegmentSizeMax) bytes after last signature,
+   the main thread stops reading of batch. The compressed block can't be so big. */
 
-HRESULT CState::Create()
+static const size_t kMtSegmentSizeMax = (size_t)1 << 22;
+
+// the bytes that ReadBatch() can read over (sizeLimit) to get the CRC after end signature
+static const size_t kMtEndSlack = 16;
+
+/* The byte before the last byte of signature is inside the signature at any bit position.
+   (g_SigBytes[b] != 0), if (b) can be such byte of block or end signature.
+   So ReadBatch() checks all bit positions only for 16 values of that byte. */
+
+static Byte g_SigBytes[256];
+
+static class CSigBytesInit
 {
-  RINOK_THREAD(StreamWasFinishedEvent.CreateIfNotCreated());
-  RINOK_THREAD(WaitingWasStartedEvent.CreateIfNotCreated());
-  RINOK_THREAD(CanWriteEvent.CreateIfNotCreated());
-  RINOK_THREAD(Thread.Create(MFThread, this));
-  return S_OK;
+public:
+  CSigBytesInit()
+  {
+    for (unsigned shift = 0; shift < 8; shift++)
+    {
+      g_SigBytes[(Byte)((kBlockSig << shift) >> 8)] = 1;
+      g_SigBytes[(Byte)((kEndSig << shift) >> 8)] = 1;
+    }
+  }
+} g_SigBytesInit;
+
+CMtThread::CMtThread()
+{
+  OutStreamSpec = new CDynBufSeqOutStream;
+  OutStream = OutStreamSpec;
+  InStreamSpec = new CBufInStream;
+  InStream = InStreamSpec;
 }
 
-void CState::FinishStream()
+void CMtThread::Execute()
 {
-  Decoder->StreamWasFinished1 = true;
-  StreamWasFinishedEvent.Set();
-  Decoder->CS.Leave();
-  Decoder->CanStartWaitingEvent.Lock();
-  WaitingWasStartedEvent.Set();
+  Res = S_OK;
+  NeedMoreInput = false;
+  CrcError = false;
+  EndBit = 0;
+  try
+  {
+    if (!State.AllocBwt()
+        || !Base.BitDecoder.Create(kBufferSize)
+        || !OutBuf.Create(kBufferSize))
+    {
+      Res = E_OUTOFMEMORY;
+      return;
+    }
+    InStreamSpec->Init(Data, DataSize);
+    Base.BitDecoder.SetStream(InStream);
+    Base.BitDecoder.Init();
+    Base.ReadBits(StartBit);
+    // the signature was checked by main thread
+    Base.ReadBits(kSigBits / 2);
+    Base.ReadBits(kSigBits / 2);
+    Crc = Base.ReadBits(kCrcBits / 2) << (kCrcBits / 2);
+    Crc |= Base.ReadBits(kCrcBits / 2);
+
+    CBlockProps props;
+    props.randMode = true;
+    Res = Base.ReadBlock(State.Counters, BlockSizeMax, &props);
+    if (Base.BitDecoder.ExtraBitsWereRead())
+    {
+      NeedMoreInput = true;
+      return;
+    }
+    if (Res != S_OK)
+      return;
+    EndBit = Base.BitDecoder.GetProcessedBits();
+
+    OutStreamSpec->Init();
+    OutBuf.SetStream(OutStream);
+    OutBuf.Init();
+    CrcError = (DecodeBlock(props, State, OutBuf) != Crc);
+    Res = OutBuf.Flush();
+  }
+  catch(const CInBufferException &e) { Res = e.ErrorCode; if (Res == S_OK) Res = E_FAIL; }
+  catch(const COutBufferException &e) { Res = e.ErrorCode; if (Res == S_OK) Res = E_FAIL; }
+  catch(...) { Res = E_FAIL; }
 }
 
-void CState::ThreadFunc()
+/*
+  ReadBatch() reads the bytes of stream to (_mtBuf) and finds the signatures at any bit position.
+  It stops, if it finds (numSigs) block signatures,
+  or if it reads the CRC after end signature,
+  or if (_mtSize) reaches (sizeLimit) before end signature. The threads read (_mtBuf)
+  while the main thread reads ahead, so (sizeLimit) must not exceed (_mtBuf.Size() - kMtEndSlack).
+*/
+
+HRESULT CDecoder::ReadBatch(unsigned numSigs, size_t sizeLimit)
 {
   for (;;)
   {
-    Decoder->CanProcessEvent.Lock();
-    Decoder->CS.Enter();
-    if (Decoder->CloseThreads)
+    const UInt64 numBits = (UInt64)_mtSize << 3;
+    if (numBits >= _mtStart + kSigBits)
     {
-      Decoder->CS.Leave();
-      return;
+      // the block or end signature must be at the start of batch
+      if ((_mtSigs.IsEmpty() || _mtSigs[0] != _mtStart) && _mtEndSig != _mtStart)
+        return S_FALSE;
+    }
+    if (_mtEndSig != kNoSig)
+    {
+      if (numBits >= _mtEndSig + kSigBits + kCrcBits)
+      {
+        _mtEndCrc = (UInt32)(_mtScan >> (numBits - (_mtEndSig + kSigBits + kCrcBits)));
+        return S_OK;
+      }
     }
-    if (Decoder->StreamWasFinished1)
+    else if (_mtSigs.Size() >= numSigs
+        || (!_mtSigs.IsEmpty() && _mtSize - (size_t)(_mtSigs.Back() >> 3) > kMtSegmentSizeMax)
+        || _mtSize >= sizeLimit)
+      return S_OK;
+    if (_mtEof)
+      return S_OK;
+
+    Byte b = ReadByte();
+    if (Base.BitDecoder.ExtraBitsWereRead())
     {
-      FinishStream();
+      _mtEof = true;
+      return S_OK;
+    }
+    if (_mtSize == _mtBuf.Size())
+      _mtBuf.ChangeSize_KeepData(_mtSize < ((size_t)1 << 20) ? ((size_t)1 << 20) : _mtSize * 2, _mtSize);
+    _mtBuf[_mtSize++] = b;
+    _mtScan = (_mtScan << 8) | b;
+
+    if (_mtSize < kSigBits / 8 || g_SigBytes[(Byte)(_mtScan >> 8)] == 0)
       continue;
+    // the positions of signatures that end in this byte
+    const UInt64 pos = ((UInt64)_mtSize << 3) - kSigBits;
+    for (unsigned shift = 8; shift != 0;)
+    {
+      shift--;
+      if (pos < shift || pos - shift < _mtStart)
+        continue;
+      const UInt64 v = (_mtScan >> shift) & kSigMask;
+      if (v == kBlockSig)
+        _mtSigs.Add(pos - shift);
+      else if (v == kEndSig && _mtEndSig == kNoSig)
+        _mtEndSig = pos - shift;
     }
-    HRESULT res = S_OK;
+  }
+}
 
-    UInt32 blockIndex = Decoder->NextBlockIndex;
-    UInt32 nextBlockIndex = blockIndex + 1;
-    if (nextBlockIndex == Decoder->NumThreads)
-      nextBlockIndex = 0;
-    Decoder->NextBlockIndex = nextBlockIndex;
-    UInt32 crc;
-    UInt64 packSize = 0;
-    CBlockProps props;
+HRESULT CDecoder::DecodeFileMt(UInt32 blockSizeMax)
+{
+  const unsigned numThreads = NumThreads;
+  while (_threads.Size() < numThreads)
+  {
+    WRes wres = _threads.AddNew().Create();
+    if (wres != 0)
+    {
+      _threads.DeleteBack();
+      return wres;
+    }
+  }
+
+  _mtSize = 0;
+  _mtSigs.Clear();
+  _mtEndSig = kNoSig;
+  _mtEndCrc = 0;
+  _mtStart = 0;
+  _mtScan = 0;
+  _mtEof = false;
+
+  for (;;)
+  {
+    RINOK(ReadBatch(numThreads + 1, (size_t)(Int64)-1));
+
+    unsigned numSegments = 0;
+    while (numSegments < _mtSigs.Size() && numSegments < numThreads && _mtSigs[numSegments] < _mtEndSig)
+      numSegments++;
+
+    // the space for reading ahead: the next batch is about as big as the current one
+    {
+      size_t need = _mtSize * 2 + kMtEndSlack;
+      if (need < ((size_t)1 << 20))
+        need = ((size_t)1 << 20);
+      if (_mtBuf.Size() < need)
+        _mtBuf.ChangeSize_KeepData(need, _mtSize);
+    }
+    const UInt64 batchBits = (UInt64)_mtSize << 3;
 
-    try
+    unsigned i;
+    for (i = 0; i < numSegments; i++)
     {
-      res = Decoder->ReadSignature(crc);
-      if (res != S_OK)
+      CMtThread &thread = _threads[i];
+      const size_t offset = (size_t)(_mtSigs[i] >> 3);
+      thread.Data = _mtBuf + offset;
+      thread.DataSize = _mtSize - offset;
+      thread.StartBit = (unsigned)_mtSigs[i] & 7;
+      thread.BlockSizeMax = blockSizeMax;
+      thread.Start();
+    }
+
+    /* The main thread reads and scans the data of next batch after the end of current batch,
+       while the threads decode the blocks. The threads don't see these new data. */
+    HRESULT readRes = S_OK;
+    if (numSegments != 0)
+    {
+      try
       {
-        Decoder->Result1 = res;
-        FinishStream();
-        continue;
+        readRes = ReadBatch(_mtSigs.Size() + numThreads, _mtBuf.Size() - kMtEndSlack);
       }
-      if (Decoder->BzWasFinished)
+      catch(...)
       {
-        Decoder->Result1 = res;
-        FinishStream();
-        continue;
+        // the threads must not use (_mtBuf) after exception
+        for (i = 0; i < numSegments; i++)
+          _threads[i].WaitExecuteFinish();
+        throw;
       }
+    }
+
+    for (i = 0; i < numSegments; i++)
+      _threads[i].WaitExecuteFinish();
+    RINOK(readRes);
+    const bool newData = (((UInt64)_mtSize << 3) != batchBits);
+
+    // we write the blocks that start exactly at the end of previous block
 
-      props.randMode = true;
-      res = Decoder->Base.ReadBlock(Counters, Decoder->BlockSizeMax, &props);
-      if (res != S_OK)
+    HRESULT res = S_OK;
+    bool needMoreInput = false;
+    unsigned numWritten = 0;
+
+    for (i = 0; i < numSegments; i++)
+    {
+      const UInt64 pos = _mtSigs[i];
+      if (pos < _mtStart)
+        continue; // it's false signature inside previous block
+      if (pos != _mtStart)
       {
-        Decoder->Result1 = res;
-        FinishStream();
-        continue;
+        res = S_FALSE;
+        break;
       }
-      packSize = Decoder->Base.BitDecoder.GetProcessedSize();
-    }
-    catch(const CInBufferException &e) { res = e.ErrorCode;  if (res != S_OK) res = E_FAIL; }
-    catch(...) { res = E_FAIL; }
-    if (res != S_OK)
-    {
-      Decoder->Result1 = res;
-      FinishStream();
-      continue;
+      const CMtThread &thread = _threads[i];
+      if (thread.NeedMoreInput)
+      {
+        needMoreInput = true;
+        break;
+      }
+      if (thread.Res != S_OK)
+      {
+        res = thread.Res;
+        break;
+      }
+      IsBz = true;
+      Base.NumBlocks++;
+      CombinedCrc.Update(thread.Crc);
+      m_OutStream.WriteBytes(thread.OutStreamSpec->GetBuffer(), thread.OutStreamSpec->GetSize());
+      numWritten++;
+      if (thread.CrcError)
+      {
+        CrcError = true;
+        res = S_FALSE;
+        break;
+      }
+      _mtStart = (pos & ~(UInt64)7) + thread.EndBit;
     }
 
-    Decoder->CS.Leave();
+    RINOK(res);
+    RINOK(SetRatioProgress(Base.BitDecoder.GetProcessedSize()));
 
-    DecodeBlock1(Counters, props.blockSize);
-
-    bool needFinish = true;
-    try
+    if (!needMoreInput && _mtStart == _mtEndSig)
     {
-      Decoder->m_States[blockIndex].CanWriteEvent.Lock();
-      needFinish = Decoder->StreamWasFinished2;
-      if (!needFinish)
+      IsBz = true;
+      BzWasFinished = true;
+      if (_mtEndCrc != CombinedCrc.GetDigest())
       {
-        if (DecodeBlock(props, Counters + 256, Decoder->m_OutStream) == crc)
-          res = Decoder->SetRatioProgress(packSize);
-        else
-          res = S_FALSE;
+        CrcError = true;
+        return S_FALSE;
       }
+      return S_OK;
     }
-    catch(const COutBufferException &e) { res = e.ErrorCode; if (res != S_OK) res = E_FAIL; }
-    catch(...) { res = E_FAIL; }
-    if (res != S_OK)
+
+    if (_mtEndSig != kNoSig && _mtEndSig < _mtStart)
+      _mtEndSig = kNoSig; // it was false end signature inside block
+
+    /* The next batch starts at (_mtStart).
+       If the block is not finished in batch, all next signatures in batch are false.
+       The signatures found by reading ahead are after the end of batch, so they are kept. */
+
+    const size_t offset = (size_t)(_mtStart >> 3);
+    const UInt64 offsetBits = (UInt64)offset << 3;
+    unsigned k = 0;
+    for (i = 0; i < _mtSigs.Size(); i++)
     {
-      Decoder->Result2 = res;
-      Decoder->StreamWasFinished2 = true;
+      const UInt64 pos = _mtSigs[i];
+      if (pos == _mtStart || (pos > _mtStart && (!needMoreInput || pos >= batchBits)))
+        _mtSigs[k++] = pos - offsetBits;
     }
-    Decoder->m_States[nextBlockIndex].CanWriteEvent.Set();
-    if (res != S_OK || needFinish)
+    _mtSigs.DeleteFrom(k);
+    if (_mtEndSig != kNoSig)
     {
-      StreamWasFinishedEvent.Set();
-      Decoder->CanStartWaitingEvent.Lock();
-      WaitingWasStartedEvent.Set();
+      if (needMoreInput && _mtEndSig < batchBits)
+        _mtEndSig = kNoSig;
+      else
+        _mtEndSig -= offsetBits;
     }
+    if (needMoreInput && _mtSize - offset > kMtSegmentSizeMax)
+      return S_FALSE;
+    memmove(_mtBuf, _mtBuf + offset, _mtSize - offset);
+    _mtSize -= offset;
+    _mtStart -= offsetBits;
+
+    if (_mtEof && !newData && (needMoreInput || numWritten == 0))
+      return S_FALSE;
   }
 }
 
@@ -917,7 +1028,7 @@ STDMETHODIMP CNsisDecoder::Read(void *data, UInt32 size, UInt32 *processedSize)
     props.randMode = false;
     RINOK(Base.ReadBlock(state.Counters, 9 * kBlockSizeStep, &props));
     _blockSize = props.blockSize;
-    DecodeBlock1(state.Counters, props.blockSize);
+    DecodeBlock1(state.Counters, props.blockSize, NULL);
     const UInt32 *tt = state.Counters + 256;
     _tPos = tt[tt[props.origPtr] >> 8];
     _prevByte = (unsigned)(_tPos & 0xFF);
@@ -3,18 +3,20 @@
 #ifndef __COMPRESS_BZIP2_DECODER_H
 #define __COMPRESS_BZIP2_DECODER_H
 
+#include "../../Common/MyBuffer.h"
 #include "../../Common/MyCom.h"
-
-#ifndef _7ZIP_ST
-#include "../../Windows/Synchronization.h"
-#include "../../Windows/Thread.h"
-#endif
+#include "../../Common/MyVector.h"
 
 #include "../ICoder.h"
 
 #include "../Common/InBuffer.h"
 #include "../Common/OutBuffer.h"
 
+#ifndef _7ZIP_ST
+#include "../Common/StreamObjects.h"
+#include "../Common/VirtThread.h"
+#endif
+
 #include "BitmDecoder.h"
 #include "BZip2Const.h"
 #include "BZip2Crc.h"
@@ -28,35 +30,16 @@ bool IsBlockSig(const Byte *p) throw();
 
 typedef NCompress::NHuffman::CDecoder<kMaxHuffmanLen, kMaxAlphaSize> CHuffmanDecoder;
 
-class CDecoder;
-
 struct CState
 {
-  UInt32 *Counters;
-
-  #ifndef _7ZIP_ST
-
-  CDecoder *Decoder;
-  NWindows::CThread Thread;
-  bool m_OptimizeNumTables;
-
-  NWindows::NSynchronization::CAutoResetEvent StreamWasFinishedEvent;
-  NWindows::NSynchronization::CAutoResetEvent WaitingWasStartedEvent;
+  UInt32 *Counters; // charCounters[256] and tt[kBlockSizeMax]
+  UInt32 *Lf;       // the LF vector for backward walk: (LF(i) << 8) | L[i]
+  Byte *Bwt;        // the output of inverse BWT
 
-  // it's not member of this thread. We just need one event per thread
-  NWindows::NSynchronization::CAutoResetEvent CanWriteEvent;
-
-  Byte MtPad[1 << 8]; // It's pad for Multi-Threading. Must be >= Cache_Line_Size.
-
-  HRESULT Create();
-  void FinishStream();
-  void ThreadFunc();
-
-  #endif
-
-  CState(): Counters(0) {}
+  CState(): Counters(0), Lf(0), Bwt(0) {}
   ~CState() { Free(); }
   bool Alloc();
+  bool AllocBwt();
   void Free();
 };
 
@@ -94,6 +77,47 @@ public:
   HRESULT ReadBlock(UInt32 *charCounters, UInt32 blockSizeMax, CBlockProps *props);
 };
 
+#ifndef _7ZIP_ST
+
+/* The multithreaded decoder doesn't depend on the block structure of encoder:
+   the main thread scans the input stream for the 48-bit signatures of blocks
+   at any bit position and reads the batch of data to memory. Each thread decodes
+   one block starting from the position of one signature (segment).
+   The block can continue after the next signature, if that signature is
+   the false one inside the compressed data. So the main thread uses only the blocks
+   that start exactly at the end of the previous block. */
+
+class CMtThread: public CVirtThread
+{
+public:
+  CBase Base;
+  CState State;
+  COutBuffer OutBuf;
+  CDynBufSeqOutStream *OutStreamSpec;
+  CMyComPtr<ISequentialOutStream> OutStream;
+  CBufInStream *InStreamSpec;
+  CMyComPtr<ISequentialInStream> InStream;
+
+  // the segment
+  const Byte *Data;
+  size_t DataSize;
+  unsigned StartBit;
+  UInt32 BlockSizeMax;
+
+  // the results
+  HRESULT Res;
+  bool NeedMoreInput; // the block is not finished in the data of batch
+  bool CrcError;
+  UInt32 Crc;
+  UInt64 EndBit;      // the position after the block, relative to (Data)
+
+  CMtThread();
+  ~CMtThread() { CVirtThread::WaitThreadFinish(); }
+  virtual void Execute();
+};
+
+#endif
+
 class CDecoder :
   public ICompressCoder,
   #ifndef _7ZIP_ST
@@ -103,7 +127,6 @@ class CDecoder :
 {
 public:
   COutBuffer m_OutStream;
-  Byte MtPad[1 << 8]; // It's pad for Multi-Threading. Must be >= Cache_Line_Size.
 
   CBase Base;
 
@@ -116,6 +139,23 @@ private:
   Byte ReadByte();
 
   HRESULT DecodeFile(ICompressProgressInfo *progress);
+
+  #ifndef _7ZIP_ST
+  UInt32 NumThreads;
+  CObjectVector<CMtThread> _threads;
+
+  CByteBuffer _mtBuf;           // the data of batch
+  size_t _mtSize;
+  CRecordVector<UInt64> _mtSigs; // the bit positions of block signatures in (_mtBuf)
+  UInt64 _mtEndSig;             // the bit position of end signature, or (UInt64)(Int64)-1
+  UInt32 _mtEndCrc;             // the CRC of stream after end signature
+  UInt64 _mtStart;              // the bit position of the block (or end signature) expected next
+  UInt64 _mtScan;               // the last 64 bits of data
+  bool _mtEof;
+
+  HRESULT ReadBatch(unsigned numSigs, size_t sizeLimit);
+  HRESULT DecodeFileMt(UInt32 blockSizeMax);
+  #endif
   HRESULT CodeReal(ISequentialInStream *inStream, ISequentialOutStream *outStream, ICompressProgressInfo *progress);
 
   class CDecoderFlusher
@@ -135,37 +175,12 @@ public:
   CBZip2CombinedCrc CombinedCrc;
   ICompressProgressInfo *Progress;
 
-  #ifndef _7ZIP_ST
-  CState *m_States;
-  UInt32 m_NumThreadsPrev;
-
-  NWindows::NSynchronization::CManualResetEvent CanProcessEvent;
-  NWindows::NSynchronization::CCriticalSection CS;
-  UInt32 NumThreads;
-  bool MtMode;
-  UInt32 NextBlockIndex;
-  bool CloseThreads;
-  bool StreamWasFinished1;
-  bool StreamWasFinished2;
-  NWindows::NSynchronization::CManualResetEvent CanStartWaitingEvent;
-
-  HRESULT Result1;
-  HRESULT Result2;
-
-  UInt32 BlockSizeMax;
+  CState m_State;
 
   bool IsBz;
   bool BzWasFinished; // bzip stream was finished with end signature
   bool CrcError; // it can CRC error of block or CRC error of whole stream.
 
-  ~CDecoder();
-  HRESULT Create();
-  void Free();
-
-  #else
-  CState m_States[1];
-  #endif
-
   CDecoder();
 
   HRESULT SetRatioProgress(UInt64 packSize);
@@ -16,6 +16,7 @@
 
 SUB_FILTER_IMP(ARM_)
 SUB_FILTER_IMP(ARMT_)
+SUB_FILTER_IMP(ARM64_)
 SUB_FILTER_IMP(PPC_)
 SUB_FILTER_IMP(SPARC_)
 SUB_FILTER_IMP(IA64_)
@@ -16,6 +16,7 @@ CREATE_CODEC(BC_IA64)
 CREATE_CODEC(BC_ARM)
 CREATE_CODEC(BC_ARMT)
 CREATE_CODEC(BC_SPARC)
+CREATE_CODEC(BC_ARM64)
 
 #define METHOD_ITEM(x, id1, id2, name) { CreateCodec ## x, CreateCodec ## x ## Out, 0x03030000 + (id1 * 256) + id2, name, 1, true  }
 
@@ -25,7 +26,9 @@ static CCodecInfo g_CodecsInfo[] =
   METHOD_ITEM(BC_IA64,  0x04, 1, L"IA64"),
   METHOD_ITEM(BC_ARM,   0x05, 1, L"ARM"),
   METHOD_ITEM(BC_ARMT,  0x07, 1, L"ARMT"),
-  METHOD_ITEM(BC_SPARC, 0x08, 0x05, L"SPARC")
+  METHOD_ITEM(BC_SPARC, 0x08, 0x05, L"SPARC"),
+  // ARM64 filter uses the short method ID of 7-Zip
+  { CreateCodecBC_ARM64, CreateCodecBC_ARM64Out, 0xA, L"ARM64", 1, true }
 };
 
 REGISTER_CODECS(Branch)
@@ -2,8 +2,18 @@
 
 #include "StdAfx.h"
 
+#ifdef __linux__
+#include <errno.h>
+#include <unistd.h>
+#include <sys/sendfile.h>
+#include <sys/syscall.h>
+#define USE_FD_COPY
+#endif
+
 #include "../../../C/Alloc.h"
 
+#include "../../Common/Defs.h"
+
 #include "../Common/StreamUtils.h"
 
 #include "CopyCoder.h"
@@ -12,6 +22,84 @@ namespace NCompress {
 
 static const UInt32 kBufferSize = 1 << 17;
 
+#ifdef USE_FD_COPY
+
+static const size_t kFdCopyStepSize = (size_t)1 << 22;
+
+/* If both streams are files, it copies the data in kernel with copy_file_range(),
+   that also can share the blocks (reflink) on some file systems.
+   If copy_file_range() is not supported for these files, it uses sendfile().
+   It returns S_OK without error, if the kernel stops copying for any reason:
+   the caller continues with Read() / Write() that also report the error. */
+
+static HRESULT CopyFd(ISequentialInStream *inStream, ISequentialOutStream *outStream,
+    const UInt64 *outSize, UInt64 &totalSize, ICompressProgressInfo *progress)
+{
+  CMyComPtr<IStreamGetFd> inGetFd;
+  inStream->QueryInterface(IID_IStreamGetFd, (void **)&inGetFd);
+  if (!inGetFd)
+    return S_OK;
+  CMyComPtr<IStreamGetFd> outGetFd;
+  outStream->QueryInterface(IID_IStreamGetFd, (void **)&outGetFd);
+  if (!outGetFd)
+    return S_OK;
+
+  int inFd, outFd;
+  UInt64 inRem, outRem;
+  if (inGetFd->GetFd(&inFd, &inRem) != S_OK
+      || outGetFd->GetFd(&outFd, &outRem) != S_OK)
+    return S_OK;
+  UInt64 rem = MyMin(inRem, outRem);
+
+  #ifdef __NR_copy_file_range
+  bool useSendFile = false;
+  #else
+  bool useSendFile = true;
+  #endif
+
+  for (;;)
+  {
+    if (outSize && rem > *outSize - totalSize)
+      rem = *outSize - totalSize;
+    if (rem == 0)
+      return S_OK;
+    size_t cur = kFdCopyStepSize;
+    if (cur > rem)
+      cur = (size_t)rem;
+    ssize_t res;
+    #ifdef __NR_copy_file_range
+    if (!useSendFile)
+      res = (ssize_t)syscall(__NR_copy_file_range, inFd, NULL, outFd, NULL, cur, 0);
+    else
+    #endif
+      res = sendfile(outFd, inFd, NULL, cur);
+    if (res <= 0)
+    {
+      if (res < 0)
+      {
+        if (errno == EINTR)
+          continue;
+        if (!useSendFile && (errno == EXDEV || errno == EINVAL || errno == ENOSYS || errno == EOPNOTSUPP))
+        {
+          useSendFile = true;
+          continue;
+        }
+      }
+      return S_OK;
+    }
+    RINOK(inGetFd->FdTransferred(res));
+    RINOK(outGetFd->FdTransferred(res));
+    totalSize += res;
+    rem -= res;
+    if (progress)
+    {
+      RINOK(progress->SetRatioInfo(&totalSize, &totalSize));
+    }
+  }
+}
+
+#endif
+
 CCopyCoder::~CCopyCoder()
 {
   ::MidFree(_buffer);
@@ -30,6 +118,14 @@ STDMETHODIMP CCopyCoder::Code(ISequentialInStream *inStream,
   }
 
   TotalSize = 0;
+
+  #ifdef USE_FD_COPY
+  if (outStream)
+  {
+    RINOK(CopyFd(inStream, outStream, outSize, TotalSize, progress));
+  }
+  #endif
+
   for (;;)
   {
     UInt32 size = kBufferSize;
@@ -3,10 +3,13 @@
 #include "StdAfx.h"
 
 #include "../../../C/Alloc.h"
+#include "../../../C/CpuArch.h"
 #include "../../../C/HuffEnc.h"
 
 #include "../../Common/ComTry.h"
 
+#include "../Common/StreamUtils.h"
+
 #include "DeflateEncoder.h"
 
 #undef NO_INLINE
@@ -37,6 +40,30 @@ static const UInt32 kBlockUncompressedSizeThreshold = kMaxUncompressedBlockSize
 static const int kMaxCodeBitLength = 11;
 static const int kMaxLevelBitLength = 7;
 
+/* The levels 1 - 3 use the hash parser: it finds the matches of 4 or more bytes
+   in hash table (level 1) or in short hash chains (levels 2, 3) without CMatchFinder,
+   and the blocks are coded with one pass. */
+
+static const int kHashLevelMax = 3;
+static const UInt32 kHashBlockSize = kMaxUncompressedBlockSize;
+static const UInt32 kHashMatchMinLen = 4;
+static const UInt32 kHashBufPadding = 8;
+
+struct CHashLevelProps
+{
+  unsigned HashBits;
+  UInt32 NumAttempts; // 1 - there are no hash chains
+  UInt32 LazyLen;     // the parser checks the match at next position, if the length of match is smaller
+};
+
+static const CHashLevelProps g_HashLevels[kHashLevelMax + 1] =
+{
+  {  0, 0,  0 },
+  { 14, 1,  0 },
+  { 15, 4,  0 },
+  { 15, 8, 16 }
+};
+
 static const Byte kNoLiteralStatPrice = 11;
 static const Byte kNoLenStatPrice = 11;
 static const Byte kNoPosStatPrice = 6;
@@ -100,6 +127,12 @@ void CCoder::SetProps(const CEncProps *props2)
   CEncProps props = *props2;
   props.Normalize();
 
+  // the hash parser doesn't support the parameters of match finder and optimal parser
+  _hashLevel = 0;
+  if (props2->algo < 0 && props2->btMode < 0 && props2->fb < 0 && props2->mc == 0
+      && props2->numPasses == (UInt32)(Int32)-1 && props.Level >= 1 && props.Level <= kHashLevelMax)
+    _hashLevel = props.Level;
+
   m_MatchFinderCycles = props.mc;
   {
     unsigned fb = props.fb;
@@ -132,7 +165,10 @@ CCoder::CCoder(bool deflate64Mode):
   m_DistanceMemory(0),
   m_Created(false),
   m_Values(0),
-  m_Tables(0)
+  m_Tables(0),
+  _hashBuf(0),
+  _hashHead(0),
+  _hashPrev(0)
 {
   {
     CEncProps props;
@@ -233,6 +269,9 @@ void CCoder::Free()
   ::MyFree(m_DistanceMemory); m_DistanceMemory = 0;
   ::MyFree(m_Values); m_Values = 0;
   ::MyFree(m_Tables); m_Tables = 0;
+  ::MidFree(_hashBuf); _hashBuf = 0;
+  ::MidFree(_hashHead); _hashHead = 0;
+  ::MidFree(_hashPrev); _hashPrev = 0;
 }
 
 CCoder::~CCoder()
@@ -694,29 +733,54 @@ NO_INLINE void Huffman_ReverseBits(UInt32 *codes, const Byte *lens, UInt32 num)
   }
 }
 
-NO_INLINE void CCoder::WriteBlock()
-{
-  Huffman_ReverseBits(mainCodes, m_NewLevels.litLenLevels, kFixedMainTableSize);
-  Huffman_ReverseBits(distCodes, m_NewLevels.distLevels, kDistTableSize64);
+/* WriteValues() writes (m_Values) with reversed codes.
+   The code of symbol and its direct bits are written with one WriteBits() call. */
 
+NO_INLINE void CCoder::WriteValues(const Byte *mainLevels, const UInt32 *mainCodes, const Byte *distLevels, const UInt32 *distCodes)
+{
   for (UInt32 i = 0; i < m_ValueIndex; i++)
   {
     const CCodeValue &codeValue = m_Values[i];
     if (codeValue.IsLiteral())
-      WRITE_HF2(mainCodes, m_NewLevels.litLenLevels, codeValue.Pos);
+      WRITE_HF2(mainCodes, mainLevels, codeValue.Pos);
     else
     {
       UInt32 len = codeValue.Len;
       UInt32 lenSlot = g_LenSlots[len];
-      WRITE_HF2(mainCodes, m_NewLevels.litLenLevels, kSymbolMatch + lenSlot);
-      m_OutStream.WriteBits(len - m_LenStart[lenSlot], m_LenDirectBits[lenSlot]);
+      unsigned numBits = mainLevels[kSymbolMatch + lenSlot];
+      m_OutStream.WriteBits(mainCodes[kSymbolMatch + lenSlot] | ((len - m_LenStart[lenSlot]) << numBits),
+          numBits + m_LenDirectBits[lenSlot]);
       UInt32 dist = codeValue.Pos;
       UInt32 posSlot = GetPosSlot(dist);
-      WRITE_HF2(distCodes, m_NewLevels.distLevels, posSlot);
-      m_OutStream.WriteBits(dist - kDistStart[posSlot], kDistDirectBits[posSlot]);
+      numBits = distLevels[posSlot];
+      m_OutStream.WriteBits(distCodes[posSlot] | ((dist - kDistStart[posSlot]) << numBits),
+          numBits + kDistDirectBits[posSlot]);
     }
   }
-  WRITE_HF2(mainCodes, m_NewLevels.litLenLevels, kSymbolEndOfBlock);
+  WRITE_HF2(mainCodes, mainLevels, kSymbolEndOfBlock);
+}
+
+NO_INLINE void CCoder::WriteBlock()
+{
+  Huffman_ReverseBits(mainCodes, m_NewLevels.litLenLevels, kFixedMainTableSize);
+  Huffman_ReverseBits(distCodes, m_NewLevels.distLevels, kDistTableSize64);
+  WriteValues(m_NewLevels.litLenLevels, mainCodes, m_NewLevels.distLevels, distCodes);
+}
+
+// WriteDynLevels() writes the header of dynamic block after block type field
+
+void CCoder::WriteDynLevels()
+{
+  WriteBits(m_NumLitLenLevels - kNumLitLenCodesMin, kNumLenCodesFieldSize);
+  WriteBits(m_NumDistLevels - kNumDistCodesMin, kNumDistCodesFieldSize);
+  WriteBits(m_NumLevelCodes - kNumLevelCodesMin, kNumLevelCodesFieldSize);
+
+  for (UInt32 i = 0; i < m_NumLevelCodes; i++)
+    WriteBits(m_LevelLevels[i], kLevelFieldSize);
+
+  Huffman_ReverseBits(levelCodes, levelLens, kLevelTableSize);
+  LevelTableCode(m_NewLevels.litLenLevels, m_NumLitLenLevels, levelLens, levelCodes);
+  LevelTableCode(m_NewLevels.distLevels, m_NumDistLevels, levelLens, levelCodes);
 }
 
 static UInt32 GetStorePrice(UInt32 blockSize, int bitPosition)
@@ -735,7 +799,7 @@ static UInt32 GetStorePrice(UInt32 blockSize, int bitPosition)
   return price;
 }
 
-void CCoder::WriteStoreBlock(UInt32 blockSize, UInt32 additionalOffset, bool finalBlock)
+void CCoder::WriteStoreData(const Byte *data, UInt32 blockSize, bool finalBlock)
 {
   do
   {
@@ -746,14 +810,18 @@ void CCoder::WriteStoreBlock(UInt32 blockSize, UInt32 additionalOffset, bool fin
     m_OutStream.FlushByte();
     WriteBits((UInt16)curBlockSize, kStoredBlockLengthFieldSize);
     WriteBits((UInt16)~curBlockSize, kStoredBlockLengthFieldSize);
-    const Byte *data = Inline_MatchFinder_GetPointerToCurrentPos(&_lzInWindow)- additionalOffset;
     for (UInt32 i = 0; i < curBlockSize; i++)
       m_OutStream.WriteByte(data[i]);
-    additionalOffset -= curBlockSize;
+    data += curBlockSize;
   }
   while (blockSize != 0);
 }
 
+void CCoder::WriteStoreBlock(UInt32 blockSize, UInt32 additionalOffset, bool finalBlock)
+{
+  WriteStoreData(Inline_MatchFinder_GetPointerToCurrentPos(&_lzInWindow) - additionalOffset, blockSize, finalBlock);
+}
+
 NO_INLINE UInt32 CCoder::TryDynBlock(int tableIndex, UInt32 numPasses)
 {
   CTables &t = m_Tables[tableIndex];
@@ -774,7 +842,13 @@ NO_INLINE UInt32 CCoder::TryDynBlock(int tableIndex, UInt32 numPasses)
   }
 
   (CLevels &)t = m_NewLevels;
+  return MakeLevelTables();
+}
 
+// MakeLevelTables() makes the tables for (m_NewLevels) and returns the price of dynamic block
+
+NO_INLINE UInt32 CCoder::MakeLevelTables()
+{
   m_NumLitLenLevels = kMainTableSize;
   while (m_NumLitLenLevels > kNumLitLenCodesMin && m_NewLevels.litLenLevels[m_NumLitLenLevels - 1] == 0)
     m_NumLitLenLevels--;
@@ -901,16 +975,7 @@ void CCoder::CodeBlock(int tableIndex, bool finalBlock)
         if (m_NumDivPasses > 1 || m_CheckStatic)
           TryDynBlock(tableIndex, 1);
         WriteBits(NBlockType::kDynamicHuffman, kBlockTypeFieldSize);
-        WriteBits(m_NumLitLenLevels - kNumLitLenCodesMin, kNumLenCodesFieldSize);
-        WriteBits(m_NumDistLevels - kNumDistCodesMin, kNumDistCodesFieldSize);
-        WriteBits(m_NumLevelCodes - kNumLevelCodesMin, kNumLevelCodesFieldSize);
-
-        for (UInt32 i = 0; i < m_NumLevelCodes; i++)
-          WriteBits(m_LevelLevels[i], kLevelFieldSize);
-
-        Huffman_ReverseBits(levelCodes, levelLens, kLevelTableSize);
-        LevelTableCode(m_NewLevels.litLenLevels, m_NumLitLenLevels, levelLens, levelCodes);
-        LevelTableCode(m_NewLevels.distLevels, m_NumDistLevels, levelLens, levelCodes);
+        WriteDynLevels();
       }
       WriteBlock();
     }
@@ -918,6 +983,294 @@ void CCoder::CodeBlock(int tableIndex, bool finalBlock)
   }
 }
 
+// ---------- Hash parser ----------
+
+static CLevels g_FixedLevels;
+static UInt32 g_FixedMainCodes[kFixedMainTableSize];
+static UInt32 g_FixedDistCodes[kFixedDistTableSize];
+
+// the reversed codes of fixed Huffman block are calculated once
+
+class CFixedCodesInit
+{
+public:
+  CFixedCodesInit()
+  {
+    const unsigned kMaxStaticHuffLen = 9;
+    UInt32 freqs[kFixedMainTableSize];
+    Byte lens[kFixedMainTableSize];
+    unsigned i;
+    g_FixedLevels.SetFixedLevels();
+    for (i = 0; i < kFixedMainTableSize; i++)
+      freqs[i] = (UInt32)1 << (kMaxStaticHuffLen - g_FixedLevels.litLenLevels[i]);
+    Huffman_Generate(freqs, g_FixedMainCodes, lens, kFixedMainTableSize, kMaxStaticHuffLen);
+    Huffman_ReverseBits(g_FixedMainCodes, g_FixedLevels.litLenLevels, kFixedMainTableSize);
+    for (i = 0; i < kFixedDistTableSize; i++)
+      freqs[i] = (UInt32)1 << (kMaxStaticHuffLen - g_FixedLevels.distLevels[i]);
+    Huffman_Generate(freqs, g_FixedDistCodes, lens, kFixedDistTableSize, kMaxStaticHuffLen);
+    Huffman_ReverseBits(g_FixedDistCodes, g_FixedLevels.distLevels, kFixedDistTableSize);
+  }
+};
+
+static CFixedCodesInit g_FixedCodesInit;
+
+#define HASH4(p, hashBits) ((GetUi32(p) * 0x9E3779B1) >> (32 - (hashBits)))
+
+static inline UInt32 GetMatchLen(const Byte *a, const Byte *b, const Byte *lim)
+{
+  const Byte *start = a;
+  #if defined(MY_CPU_LE_UNALIGN) && defined(MY_CPU_64BIT) && defined(__GNUC__)
+  for (; lim - a >= 8; a += 8, b += 8)
+  {
+    UInt64 x = GetUi64(a) ^ GetUi64(b);
+    if (x != 0)
+      return (UInt32)(a - start) + ((UInt32)__builtin_ctzll(x) >> 3);
+  }
+  #endif
+  for (; a != lim && *a == *b; a++, b++);
+  return (UInt32)(a - start);
+}
+
+/* HashParse() parses buf[pos ... lim) to (m_Values) and calculates the frequencies of symbols.
+   The hash table contains (base + position in buf).
+   It returns the number of values. */
+
+NO_INLINE UInt32 CCoder::HashParse(const Byte *buf, UInt32 pos, UInt32 lim, UInt32 base)
+{
+  const CHashLevelProps &lp = g_HashLevels[_hashLevel];
+  const unsigned hashBits = lp.HashBits;
+  const UInt32 histSize = m_Deflate64Mode ? kHistorySize64 : kHistorySize32;
+  const UInt32 prevMask = kHistorySize64 - 1;
+  const bool useChains = (lp.NumAttempts > 1);
+  UInt32 *head = _hashHead;
+  UInt32 *prev = _hashPrev;
+  UInt32 numValues = 0;
+  UInt32 cur = pos;
+  UInt32 insertPos = pos;
+
+  memset(mainFreqs, 0, sizeof(mainFreqs));
+  memset(distFreqs, 0, sizeof(distFreqs));
+
+  while (cur + kHashMatchMinLen <= lim)
+  {
+    UInt32 len = kHashMatchMinLen - 1;
+    UInt32 dist = 0;
+    const Byte *p = buf + cur;
+    const Byte *matchLim = (lim - cur > m_MatchMaxLen) ? p + m_MatchMaxLen : buf + lim;
+
+    if (!useChains)
+    {
+      UInt32 h = HASH4(p, hashBits);
+      UInt32 cand = head[h];
+      head[h] = base + cur;
+      UInt32 d = base + cur - cand;
+      if (d - 1 < histSize && GetUi32(p - d) == GetUi32(p))
+      {
+        dist = d;
+        len = kHashMatchMinLen + GetMatchLen(p + kHashMatchMinLen, p - d + kHashMatchMinLen, matchLim);
+      }
+    }
+    else
+    {
+      UInt32 lazyPos = cur;
+      for (;;)
+      {
+        const Byte *p2 = buf + lazyPos;
+        const UInt32 abs = base + lazyPos;
+        for (; insertPos <= lazyPos; insertPos++)
+        {
+          UInt32 h = HASH4(buf + insertPos, hashBits);
+          prev[(base + insertPos) & prevMask] = head[h];
+          head[h] = base + insertPos;
+        }
+        UInt32 cand = prev[abs & prevMask];
+        UInt32 bestLen = len;
+        UInt32 bestDist = 0;
+        for (UInt32 n = lp.NumAttempts; n != 0; n--)
+        {
+          const UInt32 d = abs - cand;
+          if (d - 1 >= histSize)
+            break;
+          const Byte *m = p2 - d;
+          if (m[bestLen] == p2[bestLen] && GetUi32(m) == GetUi32(p2))
+          {
+            UInt32 curLen = kHashMatchMinLen + GetMatchLen(p2 + kHashMatchMinLen, m + kHashMatchMinLen, matchLim);
+            if (curLen > bestLen)
+            {
+              bestLen = curLen;
+              bestDist = d;
+              if (p2 + curLen == matchLim)
+                break;
+            }
+          }
+          const UInt32 next = prev[cand & prevMask];
+          if (next >= cand)
+            break;
+          cand = next;
+        }
+        if (bestDist == 0)
+          break;
+        if (lazyPos != cur)
+        {
+          // the match at next position is longer, so we write the literal
+          CCodeValue &codeValue = m_Values[numValues++];
+          codeValue.SetAsLiteral();
+          codeValue.Pos = buf[cur];
+          mainFreqs[buf[cur]]++;
+          cur = lazyPos;
+          p = p2;
+        }
+        len = bestLen;
+        dist = bestDist;
+        if (len >= lp.LazyLen || lazyPos + 1 + kHashMatchMinLen > lim)
+          break;
+        lazyPos++;
+        if (matchLim != buf + lim)
+          matchLim++;
+      }
+    }
+
+    CCodeValue &codeValue = m_Values[numValues++];
+    if (dist == 0)
+    {
+      codeValue.SetAsLiteral();
+      codeValue.Pos = *p;
+      mainFreqs[*p]++;
+      cur++;
+      continue;
+    }
+    UInt32 newLen = len - kMatchMinLen;
+    codeValue.Len = (UInt16)newLen;
+    mainFreqs[kSymbolMatch + g_LenSlots[newLen]]++;
+    codeValue.Pos = (UInt16)(dist - 1);
+    distFreqs[GetPosSlot(dist - 1)]++;
+    cur += len;
+  }
+
+  for (; cur < lim; cur++)
+  {
+    CCodeValue &codeValue = m_Values[numValues++];
+    codeValue.SetAsLiteral();
+    codeValue.Pos = buf[cur];
+    mainFreqs[buf[cur]]++;
+  }
+
+  m_ValueIndex = numValues;
+  return numValues;
+}
+
+/* WriteHashBlock() writes (m_Values) of HashParse() as dynamic, fixed or stored block.
+   The block type with smaller price is selected. */
+
+void CCoder::WriteHashBlock(const Byte *data, UInt32 blockSize, bool finalBlock)
+{
+  mainFreqs[kSymbolEndOfBlock]++;
+
+  unsigned numHuffBits =
+      (m_ValueIndex > 18000 ? 12 :
+      (m_ValueIndex >  7000 ? 11 :
+      (m_ValueIndex >  2000 ? 10 : 9)));
+  MakeTables(numHuffBits);
+  const UInt32 dynPrice = MakeLevelTables();
+  const UInt32 fixedPrice = kFinalBlockFieldSize + kBlockTypeFieldSize +
+      Huffman_GetPrice_Spec(mainFreqs, g_FixedLevels.litLenLevels, kFixedMainTableSize, m_LenDirectBits, kSymbolMatch) +
+      Huffman_GetPrice_Spec(distFreqs, g_FixedLevels.distLevels, kFixedDistTableSize, kDistDirectBits, 0);
+  const UInt32 storePrice = GetStorePrice(blockSize, 0);
+
+  if (storePrice <= dynPrice && storePrice <= fixedPrice)
+  {
+    WriteStoreData(data, blockSize, finalBlock);
+    return;
+  }
+  WriteBits((finalBlock ? NFinalBlockField::kFinalBlock: NFinalBlockField::kNotFinalBlock), kFinalBlockFieldSize);
+  if (fixedPrice < dynPrice)
+  {
+    WriteBits(NBlockType::kFixedHuffman, kBlockTypeFieldSize);
+    WriteValues(g_FixedLevels.litLenLevels, g_FixedMainCodes, g_FixedLevels.distLevels, g_FixedDistCodes);
+  }
+  else
+  {
+    WriteBits(NBlockType::kDynamicHuffman, kBlockTypeFieldSize);
+    WriteDynLevels();
+    WriteBlock();
+  }
+}
+
+HRESULT CCoder::CodeHash(ISequentialInStream *inStream, ISequentialOutStream *outStream, ICompressProgressInfo *progress)
+{
+  const CHashLevelProps &lp = g_HashLevels[_hashLevel];
+  const UInt32 histSize = m_Deflate64Mode ? kHistorySize64 : kHistorySize32;
+  const size_t headSize = ((size_t)1 << lp.HashBits) * sizeof(UInt32);
+
+  if (m_Values == 0)
+  {
+    m_Values = (CCodeValue *)MyAlloc((kMaxUncompressedBlockSize) * sizeof(CCodeValue));
+    if (m_Values == 0)
+      return E_OUTOFMEMORY;
+  }
+  if (_hashBuf == 0)
+  {
+    _hashBuf = (Byte *)::MidAlloc(kHistorySize64 + kHashBlockSize + kHashBufPadding);
+    if (_hashBuf == 0)
+      return E_OUTOFMEMORY;
+  }
+  if (_hashHead == 0)
+  {
+    _hashHead = (UInt32 *)::MidAlloc(((size_t)1 << g_HashLevels[kHashLevelMax].HashBits) * sizeof(UInt32));
+    if (_hashHead == 0)
+      return E_OUTOFMEMORY;
+  }
+  if (lp.NumAttempts > 1 && _hashPrev == 0)
+  {
+    _hashPrev = (UInt32 *)::MidAlloc(kHistorySize64 * sizeof(UInt32));
+    if (_hashPrev == 0)
+      return E_OUTOFMEMORY;
+  }
+  if (!m_OutStream.Create(1 << 20))
+    return E_OUTOFMEMORY;
+
+  m_OutStream.SetStream(outStream);
+  m_OutStream.Init();
+
+  /* The buffer contains (histSize) bytes of history and the current block.
+     The zero items of hash table are out of window, because (base > histSize). */
+
+  UInt32 base = histSize + 1;
+  UInt32 pos = 0;
+  UInt64 nowPos = 0;
+  memset(_hashHead, 0, headSize);
+
+  for (;;)
+  {
+    if (pos > histSize)
+    {
+      memmove(_hashBuf, _hashBuf + pos - histSize, histSize);
+      base += pos - histSize;
+      pos = histSize;
+    }
+    if (base > ((UInt32)1 << 31))
+    {
+      memset(_hashHead, 0, headSize);
+      base = histSize + 1;
+    }
+    size_t size = kHashBlockSize;
+    RINOK(ReadStream(inStream, _hashBuf + pos, &size));
+    const bool finalBlock = (size != kHashBlockSize);
+    HashParse(_hashBuf, pos, pos + (UInt32)size, base);
+    WriteHashBlock(_hashBuf + pos, (UInt32)size, finalBlock);
+    pos += (UInt32)size;
+    nowPos += size;
+    if (progress != NULL)
+    {
+      UInt64 packSize = m_OutStream.GetProcessedSize();
+      RINOK(progress->SetRatioInfo(&nowPos, &packSize));
+    }
+    if (finalBlock)
+      break;
+  }
+  return m_OutStream.Flush();
+}
+
 SRes Read(void *object, void *data, size_t *size)
 {
   const UInt32 kStepSize = (UInt32)1 << 31;
@@ -930,6 +1283,9 @@ SRes Read(void *object, void *data, size_t *size)
 HRESULT CCoder::CodeReal(ISequentialInStream *inStream, ISequentialOutStream *outStream,
     const UInt64 * /* inSize */ , const UInt64 * /* outSize */ , ICompressProgressInfo *progress)
 {
+  if (_hashLevel != 0)
+    return CodeHash(inStream, outStream, progress);
+
   m_CheckStatic = (m_NumPasses != 1 || m_NumDivPasses != 1);
   m_IsMultiPass = (m_CheckStatic || (m_NumPasses != 1 || m_NumDivPasses != 1));
 
@@ -136,6 +136,12 @@ public:
 
   UInt32 m_MatchFinderCycles;
 
+  // the hash parser of fast levels, that doesn't use CMatchFinder
+  int _hashLevel; // 0 - the parser with match finder is used
+  Byte *_hashBuf;
+  UInt32 *_hashHead;
+  UInt32 *_hashPrev;
+
   void GetMatches();
   void MovePos(UInt32 num);
   UInt32 Backward(UInt32 &backRes, UInt32 cur);
@@ -153,13 +159,17 @@ public:
   UInt32 TryDynBlock(int tableIndex, UInt32 numPasses);
 
   UInt32 TryFixedBlock(int tableIndex);
+  UInt32 MakeLevelTables();
 
   void SetPrices(const CLevels &levels);
+  void WriteValues(const Byte *mainLevels, const UInt32 *mainCodes, const Byte *distLevels, const UInt32 *distCodes);
   void WriteBlock();
+  void WriteDynLevels();
 
   HRESULT Create();
   void Free();
 
+  void WriteStoreData(const Byte *data, UInt32 blockSize, bool finalBlock);
   void WriteStoreBlock(UInt32 blockSize, UInt32 additionalOffset, bool finalBlock);
   void WriteTables(bool writeMode, bool finalBlock);
 
@@ -168,6 +178,10 @@ public:
   UInt32 GetBlockPrice(int tableIndex, int numDivPasses);
   void CodeBlock(int tableIndex, bool finalBlock);
 
+  UInt32 HashParse(const Byte *buf, UInt32 pos, UInt32 lim, UInt32 base);
+  void WriteHashBlock(const Byte *data, UInt32 blockSize, bool finalBlock);
+  HRESULT CodeHash(ISequentialInStream *inStream, ISequentialOutStream *outStream, ICompressProgressInfo *progress);
+
   void SetProps(const CEncProps *props2);
 public:
   CCoder(bool deflate64Mode = false);
@@ -0,0 +1,524 @@
+// Lz4Decoder.cpp
+
+#include "StdAfx.h"
+
+#include "../../../C/CpuArch.h"
+
+#include "../Common/DicPool.h"
+#include "../Common/StreamUtils.h"
+
+#include "Lz4Decoder.h"
+
+namespace NCompress {
+namespace NLz4 {
+
+// the input buffer must contain the biggest block with block header and block checksum
+static const size_t kInBufSize = ((size_t)1 << 22) + ((size_t)1 << 16);
+
+CDecoder::CDecoder(): _inBuf(NULL), _win(NULL), _winSize(0)
+  #ifndef _7ZIP_ST
+  , _numThreads(1)
+  #endif
+{
+}
+
+CDecoder::~CDecoder()
+{
+  NDicPool::Free(_inBuf);
+  NDicPool::Free(_win);
+}
+
+STDMETHODIMP CDecoder::SetDecoderProperties2(const Byte * /* data */, UInt32 size)
+{
+  if (size != 3 && size != kPropsSize)
+    return E_NOTIMPL;
+  return S_OK;
+}
+
+HRESULT CDecoder::ReadIn(ISequentialInStream *inStream, size_t size)
+{
+  size_t rem = _inLim - _inPos;
+  if (rem >= size || _inEof)
+    return S_OK;
+  if (_inPos != 0)
+  {
+    memmove(_inBuf, _inBuf + _inPos, rem);
+    _inProcessed += _inPos;
+    _inPos = 0;
+    _inLim = rem;
+  }
+  size_t cur = kInBufSize - _inLim;
+  HRESULT res = ReadStream(inStream, _inBuf + _inLim, &cur);
+  if (cur != kInBufSize - _inLim)
+    _inEof = true;
+  _inLim += cur;
+  return res;
+}
+
+HRESULT CDecoder::SkipIn(ISequentialInStream *inStream, UInt64 size)
+{
+  for (;;)
+  {
+    size_t rem = _inLim - _inPos;
+    if (rem >= size)
+    {
+      _inPos += (size_t)size;
+      return S_OK;
+    }
+    _inPos = _inLim;
+    size -= rem;
+    if (_inEof)
+    {
+      UnexpectedEnd = true;
+      return S_FALSE;
+    }
+    RINOK(ReadIn(inStream, 1));
+  }
+}
+
+/* DecodeBlock() decodes the block with block header (bh) to dest[destPos ... destLim) */
+
+static SRes DecodeBlock(UInt32 bh, const Byte *src, Byte *dest, size_t destPos, size_t destLim, size_t *outSize)
+{
+  const size_t size = bh & ~LZ4_BLOCK_UNCOMPRESSED_FLAG;
+  if (bh & LZ4_BLOCK_UNCOMPRESSED_FLAG)
+  {
+    *outSize = 0;
+    if (size > destLim - destPos)
+      return SZ_ERROR_DATA;
+    memcpy(dest + destPos, src, size);
+    *outSize = size;
+    return SZ_OK;
+  }
+  return Lz4_DecodeBlock(src, size, dest, destPos, destLim, outSize);
+}
+
+HRESULT CDecoder::DecodeFrame(ISequentialInStream *inStream, ISequentialOutStream *outStream,
+    const CLz4FrameHeader &header, ICompressProgressInfo *progress)
+{
+  const size_t blockSizeMax = header.blockSizeMax;
+  const size_t checksumSize = Lz4FrameHeader_HasBlockChecksum(&header) ? LZ4_CHECKSUM_SIZE : 0;
+
+  /* The window buffer keeps the history of linked blocks and the next block.
+     Independent blocks are decoded to the start of buffer. */
+
+  const size_t histSize = Lz4FrameHeader_IsBlockIndep(&header) ? 0 : LZ4_WINDOW_SIZE;
+  const size_t capacity = histSize + blockSizeMax;
+  if (!_win || _winSize < capacity + LZ4_PADDING_SIZE)
+  {
+    NDicPool::Free(_win);
+    _winSize = 0;
+    _win = (Byte *)NDicPool::Alloc(capacity + LZ4_PADDING_SIZE);
+    if (!_win)
+      return E_OUTOFMEMORY;
+    _winSize = capacity + LZ4_PADDING_SIZE;
+  }
+
+  size_t pos = 0;
+
+  for (;;)
+  {
+    RINOK(ReadIn(inStream, LZ4_BLOCK_HEADER_SIZE));
+    if (_inLim - _inPos < LZ4_BLOCK_HEADER_SIZE)
+    {
+      UnexpectedEnd = true;
+      return S_FALSE;
+    }
+    const UInt32 bh = GetUi32(_inBuf + _inPos);
+    _inPos += LZ4_BLOCK_HEADER_SIZE;
+    if (bh == 0)
+      return S_OK;
+
+    const size_t blockSize = bh & ~LZ4_BLOCK_UNCOMPRESSED_FLAG;
+    if (blockSize > blockSizeMax)
+    {
+      DataError = true;
+      return S_FALSE;
+    }
+    RINOK(ReadIn(inStream, blockSize + checksumSize));
+    if (_inLim - _inPos < blockSize + checksumSize)
+    {
+      UnexpectedEnd = true;
+      return S_FALSE;
+    }
+    const Byte *src = _inBuf + _inPos;
+    if (checksumSize != 0 && GetUi32(src + blockSize) != Xxh32_Calc(src, blockSize))
+      ChecksumError = true;
+
+    if (pos + blockSizeMax > capacity)
+    {
+      const size_t keep = (pos < histSize) ? pos : histSize;
+      memmove(_win, _win + pos - keep, keep);
+      pos = keep;
+    }
+
+    size_t outSize;
+    if (DecodeBlock(bh, src, _win, pos, pos + blockSizeMax, &outSize) != SZ_OK)
+    {
+      DataError = true;
+      return S_FALSE;
+    }
+    _inPos += blockSize + checksumSize;
+    NumBlocks++;
+
+    if (outSize != 0)
+    {
+      Xxh32_Update(&_xxh, _win + pos, outSize);
+      RINOK(WriteStream(outStream, _win + pos, outSize));
+      pos += outSize;
+      _frameSize += outSize;
+      _outProcessed += outSize;
+    }
+
+    if (progress)
+    {
+      const UInt64 inProcessed = GetInputProcessedSize();
+      RINOK(progress->SetRatioInfo(&inProcessed, &_outProcessed));
+    }
+  }
+}
+
+#ifndef _7ZIP_ST
+
+static const UInt32 kNumThreadsMax = 64;
+static const size_t kMtSegmentSize = (size_t)1 << 22;
+
+Byte *CMtSegment::AddPack(size_t size)
+{
+  size_t newSize = PackSize + size;
+  if (newSize + LZ4_PADDING_SIZE > PackBuf.Size())
+  {
+    size_t newCap = PackBuf.Size() * 2;
+    if (newCap < newSize + LZ4_PADDING_SIZE)
+      newCap = newSize + LZ4_PADDING_SIZE;
+    PackBuf.ChangeSize_KeepData(newCap, PackSize);
+  }
+  Byte *p = (Byte *)PackBuf + PackSize;
+  PackSize = newSize;
+  return p;
+}
+
+void CMtThread::Execute()
+{
+  CMtSegment &seg = *Segment;
+  try
+  {
+    seg.UnpackBuf.AllocAtLeast(seg.UnpackSize + LZ4_PADDING_SIZE);
+  }
+  catch(...) { seg.Res = SZ_ERROR_MEM; return; }
+
+  const Byte *p = seg.PackBuf;
+  const size_t checksumSize = BlockChecksum ? LZ4_CHECKSUM_SIZE : 0;
+  for (unsigned i = 0; i < seg.NumBlocks; i++)
+  {
+    const UInt32 bh = GetUi32(p);
+    const size_t size = bh & ~LZ4_BLOCK_UNCOMPRESSED_FLAG;
+    p += LZ4_BLOCK_HEADER_SIZE;
+    if (checksumSize != 0 && GetUi32(p + size) != Xxh32_Calc(p, size))
+      seg.ChecksumError = true;
+    size_t outSize;
+    seg.Res = DecodeBlock(bh, p, (Byte *)seg.UnpackBuf + seg.OutSize, 0, BlockSizeMax, &outSize);
+    if (seg.Res != SZ_OK)
+      return;
+    seg.OutSize += outSize;
+    seg.NumDecodedBlocks++;
+    p += size + checksumSize;
+  }
+}
+
+STDMETHODIMP CDecoder::SetNumberOfThreads(UInt32 numThreads)
+{
+  _numThreads = numThreads;
+  return S_OK;
+}
+
+HRESULT CDecoder::ReadSegment(ISequentialInStream *inStream, CMtSegment &seg, const CLz4FrameHeader &header)
+{
+  const size_t checksumSize = Lz4FrameHeader_HasBlockChecksum(&header) ? LZ4_CHECKSUM_SIZE : 0;
+  seg.Init();
+  while (seg.UnpackSize < kMtSegmentSize)
+  {
+    RINOK(ReadIn(inStream, LZ4_BLOCK_HEADER_SIZE));
+    if (_inLim - _inPos < LZ4_BLOCK_HEADER_SIZE)
+    {
+      UnexpectedEnd = true;
+      _mtFrameEnd = true;
+      return S_OK;
+    }
+    const UInt32 bh = GetUi32(_inBuf + _inPos);
+    if (bh == 0)
+    {
+      _inPos += LZ4_BLOCK_HEADER_SIZE;
+      _mtFrameEnd = true;
+      return S_OK;
+    }
+    const size_t blockSize = bh & ~LZ4_BLOCK_UNCOMPRESSED_FLAG;
+    if (blockSize > header.blockSizeMax)
+    {
+      DataError = true;
+      _mtFrameEnd = true;
+      return S_OK;
+    }
+    const size_t size = LZ4_BLOCK_HEADER_SIZE + blockSize + checksumSize;
+    RINOK(ReadIn(inStream, size));
+    if (_inLim - _inPos < size)
+    {
+      UnexpectedEnd = true;
+      _mtFrameEnd = true;
+      return S_OK;
+    }
+    memcpy(seg.AddPack(size), _inBuf + _inPos, size);
+    _inPos += size;
+    seg.UnpackSize += header.blockSizeMax;
+    seg.NumBlocks++;
+  }
+  return S_OK;
+}
+
+HRESULT CDecoder::ReadBatch(ISequentialInStream *inStream, CMtBatch &batch, unsigned numThreads, const CLz4FrameHeader &header)
+{
+  batch.NumSegments = 0;
+  while (batch.NumSegments < numThreads && !_mtFrameEnd)
+  {
+    if (batch.NumSegments == batch.Segments.Size())
+      batch.Segments.AddNew();
+    CMtSegment &seg = batch.Segments[batch.NumSegments];
+    RINOK(ReadSegment(inStream, seg, header));
+    if (seg.NumBlocks == 0)
+      break;
+    batch.NumSegments++;
+  }
+  return S_OK;
+}
+
+void CDecoder::StartDecoding(CMtBatch &batch, const CLz4FrameHeader &header)
+{
+  for (unsigned i = 0; i < batch.NumSegments; i++)
+  {
+    CMtThread &thread = _threads[i];
+    thread.Segment = &batch.Segments[i];
+    thread.BlockSizeMax = header.blockSizeMax;
+    thread.BlockChecksum = Lz4FrameHeader_HasBlockChecksum(&header);
+    thread.Start();
+  }
+}
+
+void CDecoder::WaitDecoding(CMtBatch &batch)
+{
+  for (unsigned i = 0; i < batch.NumSegments; i++)
+    _threads[i].WaitExecuteFinish();
+}
+
+HRESULT CDecoder::WriteBatch(ISequentialOutStream *outStream, CMtBatch &batch, ICompressProgressInfo *progress)
+{
+  unsigned numSegments = batch.NumSegments;
+  batch.NumSegments = 0;
+  for (unsigned i = 0; i < numSegments; i++)
+  {
+    const CMtSegment &seg = batch.Segments[i];
+    Xxh32_Update(&_xxh, seg.UnpackBuf, seg.OutSize);
+    RINOK(WriteStream(outStream, seg.UnpackBuf, seg.OutSize));
+    _frameSize += seg.OutSize;
+    _outProcessed += seg.OutSize;
+    NumBlocks += seg.NumDecodedBlocks;
+    if (seg.ChecksumError)
+      ChecksumError = true;
+    if (seg.Res != SZ_OK)
+    {
+      if (seg.Res == SZ_ERROR_MEM)
+        return E_OUTOFMEMORY;
+      DataError = true;
+      return S_FALSE;
+    }
+    if (progress)
+    {
+      const UInt64 inProcessed = GetInputProcessedSize();
+      RINOK(progress->SetRatioInfo(&inProcessed, &_outProcessed));
+    }
+  }
+  return S_OK;
+}
+
+HRESULT CDecoder::DecodeFrameMt(ISequentialInStream *inStream, ISequentialOutStream *outStream,
+    const CLz4FrameHeader &header, ICompressProgressInfo *progress)
+{
+  unsigned numThreads = (_numThreads < kNumThreadsMax) ? _numThreads : kNumThreadsMax;
+  while (_threads.Size() < numThreads)
+  {
+    WRes wres = _threads.AddNew().Create();
+    if (wres != 0)
+    {
+      _threads.DeleteBack();
+      return wres;
+    }
+  }
+
+  _mtFrameEnd = false;
+  _batches[0].NumSegments = 0;
+  _batches[1].NumSegments = 0;
+
+  unsigned cur = 0;
+  bool decoding = false;
+  HRESULT res = S_OK;
+
+  /* the main thread reads batch (cur), while threads decode batch (cur ^ 1).
+     Then it writes batch (cur ^ 1), while threads decode batch (cur). */
+
+  for (;;)
+  {
+    CMtBatch &batch = _batches[cur];
+    batch.NumSegments = 0;
+    if (!_mtFrameEnd)
+      res = ReadBatch(inStream, batch, numThreads, header);
+    if (decoding)
+    {
+      WaitDecoding(_batches[cur ^ 1]);
+      decoding = false;
+    }
+    if (res != S_OK)
+      return res;
+    if (batch.NumSegments != 0)
+    {
+      StartDecoding(batch, header);
+      decoding = true;
+    }
+
+    CMtBatch &prev = _batches[cur ^ 1];
+    if (prev.NumSegments != 0)
+    {
+      res = WriteBatch(outStream, prev, progress);
+      if (res != S_OK)
+        break;
+    }
+    if (!decoding)
+      break;
+    cur ^= 1;
+  }
+  if (decoding)
+    WaitDecoding(_batches[cur]);
+  if (res != S_OK)
+    return res;
+  if (UnexpectedEnd || DataError)
+    return S_FALSE;
+  return S_OK;
+}
+
+#endif
+
+HRESULT CDecoder::CodeReal(ISequentialInStream *inStream, ISequentialOutStream *outStream, ICompressProgressInfo *progress)
+{
+  if (!_inBuf)
+  {
+    _inBuf = (Byte *)NDicPool::Alloc(kInBufSize + LZ4_PADDING_SIZE);
+    if (!_inBuf)
+      return E_OUTOFMEMORY;
+  }
+
+  for (;;)
+  {
+    RINOK(ReadIn(inStream, LZ4_FRAME_HEADER_SIZE_MAX));
+    const size_t avail = _inLim - _inPos;
+    if (avail == 0)
+      break;
+    const Byte *p = _inBuf + _inPos;
+    const UInt32 sig = (avail < LZ4_SIG_SIZE) ? 0 : GetUi32(p);
+
+    if ((sig & LZ4_SKIP_MAGIC_MASK) == LZ4_SKIP_MAGIC)
+    {
+      if (avail < LZ4_SKIP_HEADER_SIZE)
+      {
+        UnexpectedEnd = true;
+        break;
+      }
+      const UInt32 size = GetUi32(p + 4);
+      _inPos += LZ4_SKIP_HEADER_SIZE;
+      NumSkipFrames++;
+      IsArc = true;
+      RINOK(SkipIn(inStream, size));
+      continue;
+    }
+
+    if (sig != LZ4_MAGIC)
+    {
+      if (NumFrames == 0 && NumSkipFrames == 0)
+        IsArc = false;
+      else
+        DataAfterEnd = true;
+      break;
+    }
+
+    IsArc = true;
+    if (avail < LZ4_FRAME_HEADER_SIZE_MIN || avail < Lz4FrameHeader_GetSize(p[4]))
+    {
+      UnexpectedEnd = true;
+      break;
+    }
+    CLz4FrameHeader header;
+    if (Lz4FrameHeader_Parse(&header, p) != SZ_OK)
+    {
+      Unsupported = true;
+      break;
+    }
+    _inPos += Lz4FrameHeader_GetSize(p[4]);
+
+    Xxh32_Init(&_xxh);
+    _frameSize = 0;
+    HRESULT res;
+    #ifndef _7ZIP_ST
+    if (_numThreads > 1 && Lz4FrameHeader_IsBlockIndep(&header))
+      res = DecodeFrameMt(inStream, outStream, header, progress);
+    else
+    #endif
+      res = DecodeFrame(inStream, outStream, header, progress);
+    if (res != S_OK)
+      return res;
+
+    if (header.contentSize != LZ4_CONTENT_SIZE_UNKNOWN && header.contentSize != _frameSize)
+    {
+      DataError = true;
+      return S_FALSE;
+    }
+    if (Lz4FrameHeader_HasChecksum(&header))
+    {
+      RINOK(ReadIn(inStream, LZ4_CHECKSUM_SIZE));
+      if (_inLim - _inPos < LZ4_CHECKSUM_SIZE)
+      {
+        UnexpectedEnd = true;
+        return S_FALSE;
+      }
+      if (GetUi32(_inBuf + _inPos) != Xxh32_Digest(&_xxh))
+        ChecksumError = true;
+      _inPos += LZ4_CHECKSUM_SIZE;
+    }
+    NumFrames++;
+  }
+
+  if (!IsArc || UnexpectedEnd || DataAfterEnd || Unsupported || DataError || ChecksumError)
+    return S_FALSE;
+  return S_OK;
+}
+
+STDMETHODIMP CDecoder::Code(ISequentialInStream *inStream, ISequentialOutStream *outStream,
+    const UInt64 * /* inSize */, const UInt64 * /* outSize */, ICompressProgressInfo *progress)
+{
+  _inPos = 0;
+  _inLim = 0;
+  _inEof = false;
+  _inProcessed = 0;
+  _outProcessed = 0;
+
+  NumFrames = 0;
+  NumSkipFrames = 0;
+  NumBlocks = 0;
+  IsArc = false;
+  UnexpectedEnd = false;
+  DataAfterEnd = false;
+  Unsupported = false;
+  DataError = false;
+  ChecksumError = false;
+
+  try { return CodeReal(inStream, outStream, progress); }
+  catch(...) { return E_OUTOFMEMORY; }
+}
+
+}}
@@ -0,0 +1,148 @@
+// Lz4Decoder.h
+
+#ifndef __LZ4_DECODER_H
+#define __LZ4_DECODER_H
+
+#include "../../../C/Lz4.h"
+
+#include "../../Common/MyBuffer.h"
+#include "../../Common/MyCom.h"
+#include "../../Common/MyVector.h"
+
+#ifndef _7ZIP_ST
+#include "../Common/VirtThread.h"
+#endif
+
+#include "../ICoder.h"
+
+namespace NCompress {
+namespace NLz4 {
+
+/* 7z coder properties of LZ4 method: { version major, version minor, level [, 0, 0] }.
+   The decoder doesn't need them, it accepts 3 or 5 bytes. */
+
+const unsigned kPropsSize = 5;
+
+#ifndef _7ZIP_ST
+
+/* If the frame has independent blocks (LZ4_FLG_BLOCK_INDEP), the main thread
+   reads the runs of blocks (segments) to memory, the threads check block checksums
+   and decode the segments of a batch, and the main thread writes the previous batch
+   in order in parallel with decoding. */
+
+struct CMtSegment
+{
+  CByteBuffer PackBuf;
+  CByteBuffer UnpackBuf;
+  size_t PackSize;
+  size_t UnpackSize; // maximum size of decoded data
+  size_t OutSize;    // size of decoded data
+  unsigned NumBlocks;
+  unsigned NumDecodedBlocks;
+  SRes Res;
+  bool ChecksumError;
+
+  void Init() { PackSize = 0; UnpackSize = 0; OutSize = 0; NumBlocks = 0; NumDecodedBlocks = 0; Res = SZ_OK; ChecksumError = false; }
+  Byte *AddPack(size_t size);
+};
+
+class CMtThread: public CVirtThread
+{
+public:
+  CMtSegment *Segment;
+  size_t BlockSizeMax;
+  bool BlockChecksum;
+
+  ~CMtThread() { CVirtThread::WaitThreadFinish(); }
+  virtual void Execute();
+};
+
+struct CMtBatch
+{
+  CObjectVector<CMtSegment> Segments;
+  unsigned NumSegments;
+};
+
+#endif
+
+class CDecoder:
+  public ICompressCoder,
+  public ICompressSetDecoderProperties2,
+  #ifndef _7ZIP_ST
+  public ICompressSetCoderMt,
+  #endif
+  public CMyUnknownImp
+{
+  Byte *_inBuf;
+  size_t _inPos;
+  size_t _inLim;
+  bool _inEof;
+  UInt64 _inProcessed; // size of input data before _inBuf
+
+  Byte *_win;
+  size_t _winSize;
+
+  UInt64 _outProcessed;
+
+  // the state of current frame
+  CXxh32 _xxh;
+  UInt64 _frameSize;
+
+  HRESULT ReadIn(ISequentialInStream *inStream, size_t size);
+  HRESULT SkipIn(ISequentialInStream *inStream, UInt64 size);
+  HRESULT DecodeFrame(ISequentialInStream *inStream, ISequentialOutStream *outStream,
+      const CLz4FrameHeader &header, ICompressProgressInfo *progress);
+  HRESULT CodeReal(ISequentialInStream *inStream, ISequentialOutStream *outStream, ICompressProgressInfo *progress);
+
+  #ifndef _7ZIP_ST
+  UInt32 _numThreads;
+  CObjectVector<CMtThread> _threads;
+  CMtBatch _batches[2];
+  bool _mtFrameEnd;
+
+  HRESULT ReadSegment(ISequentialInStream *inStream, CMtSegment &seg, const CLz4FrameHeader &header);
+  HRESULT ReadBatch(ISequentialInStream *inStream, CMtBatch &batch, unsigned numThreads, const CLz4FrameHeader &header);
+  void StartDecoding(CMtBatch &batch, const CLz4FrameHeader &header);
+  void WaitDecoding(CMtBatch &batch);
+  HRESULT WriteBatch(ISequentialOutStream *outStream, CMtBatch &batch, ICompressProgressInfo *progress);
+  HRESULT DecodeFrameMt(ISequentialInStream *inStream, ISequentialOutStream *outStream,
+      const CLz4FrameHeader &header, ICompressProgressInfo *progress);
+  #endif
+public:
+  // the results of last Code() call
+  UInt64 NumFrames;
+  UInt64 NumSkipFrames;
+  UInt64 NumBlocks;
+  bool IsArc;
+  bool UnexpectedEnd;
+  bool DataAfterEnd;
+  bool Unsupported;
+  bool DataError;
+  bool ChecksumError;
+
+  MY_QUERYINTERFACE_BEGIN2(ICompressCoder)
+  MY_QUERYINTERFACE_ENTRY(ICompressSetDecoderProperties2)
+  #ifndef _7ZIP_ST
+  MY_QUERYINTERFACE_ENTRY(ICompressSetCoderMt)
+  #endif
+  MY_QUERYINTERFACE_END
+  MY_ADDREF_RELEASE
+
+  STDMETHOD(Code)(ISequentialInStream *inStream, ISequentialOutStream *outStream,
+      const UInt64 *inSize, const UInt64 *outSize, ICompressProgressInfo *progress);
+  STDMETHOD(SetDecoderProperties2)(const Byte *data, UInt32 size);
+
+  #ifndef _7ZIP_ST
+  STDMETHOD(SetNumberOfThreads)(UInt32 numThreads);
+  #endif
+
+  UInt64 GetInputProcessedSize() const { return _inProcessed + _inPos; }
+  UInt64 GetOutputProcessedSize() const { return _outProcessed; }
+
+  CDecoder();
+  virtual ~CDecoder();
+};
+
+}}
+
+#endif
@@ -0,0 +1,112 @@
+// Lz4Encoder.cpp
+
+#include "StdAfx.h"
+
+#include "../../../C/Alloc.h"
+
+#include "../Common/CWrappers.h"
+#include "../Common/StreamUtils.h"
+
+#include "Lz4Decoder.h"
+#include "Lz4Encoder.h"
+
+namespace NCompress {
+namespace NLz4 {
+
+static const Byte kVersionMajor = 1;
+static const Byte kVersionMinor = 10;
+
+static void *SzBigAlloc(void *, size_t size) { return BigAlloc(size); }
+static void SzBigFree(void *, void *address) { BigFree(address); }
+static ISzAlloc g_BigAlloc = { SzBigAlloc, SzBigFree };
+
+static void *SzAlloc(void *, size_t size) { return MyAlloc(size); }
+static void SzFree(void *, void *address) { MyFree(address); }
+static ISzAlloc g_Alloc = { SzAlloc, SzFree };
+
+CEncoder::CEncoder()
+{
+  Lz4EncProps_Init(&_props);
+  _encoder = 0;
+  _encoder = Lz4Enc_Create(&g_Alloc, &g_BigAlloc);
+  if (_encoder == 0)
+    throw 1;
+}
+
+CEncoder::~CEncoder()
+{
+  if (_encoder != 0)
+    Lz4Enc_Destroy(_encoder);
+}
+
+STDMETHODIMP CEncoder::SetCoderProperties(const PROPID *propIDs,
+    const PROPVARIANT *coderProps, UInt32 numProps)
+{
+  CLz4EncProps props;
+  Lz4EncProps_Init(&props);
+
+  for (UInt32 i = 0; i < numProps; i++)
+  {
+    const PROPVARIANT &prop = coderProps[i];
+    PROPID propID = propIDs[i];
+    if (propID > NCoderPropID::kReduceSize)
+      continue;
+    if (propID == NCoderPropID::kReduceSize)
+    {
+      if (prop.vt == VT_UI8)
+        props.reduceSize = prop.uhVal.QuadPart;
+      continue;
+    }
+    if (prop.vt != VT_UI4)
+      return E_INVALIDARG;
+    UInt32 v = (UInt32)prop.ulVal;
+    switch (propID)
+    {
+      case NCoderPropID::kLevel: props.level = (v > LZ4_ENC_LEVEL_MAX) ? LZ4_ENC_LEVEL_MAX : (int)v; break;
+      case NCoderPropID::kNumThreads: props.numThreads = (int)v; break;
+      case NCoderPropID::kBlockSize:
+        props.blockSize = (v > Lz4_GetBlockSizeMax(LZ4_BLOCK_SIZE_ID_MAX)) ? Lz4_GetBlockSizeMax(LZ4_BLOCK_SIZE_ID_MAX) : v;
+        break;
+      // the window of LZ4 is fixed (64 KiB)
+      case NCoderPropID::kDictionarySize:
+      case NCoderPropID::kDefaultProp:
+      case NCoderPropID::kEndMarker:
+        break;
+      default: return E_INVALIDARG;
+    }
+  }
+  RINOK(SResToHRESULT(Lz4Enc_SetProps(_encoder, &props)));
+  Lz4EncProps_Normalize(&props);
+  _props = props;
+  return S_OK;
+}
+
+STDMETHODIMP CEncoder::WriteCoderProperties(ISequentialOutStream *outStream)
+{
+  Byte props[kPropsSize];
+  props[0] = kVersionMajor;
+  props[1] = kVersionMinor;
+  props[2] = (Byte)_props.level;
+  props[3] = 0;
+  props[4] = 0;
+  return WriteStream(outStream, props, kPropsSize);
+}
+
+STDMETHODIMP CEncoder::Code(ISequentialInStream *inStream, ISequentialOutStream *outStream,
+    const UInt64 * /* inSize */, const UInt64 * /* outSize */, ICompressProgressInfo *progress)
+{
+  CSeqInStreamWrap inWrap(inStream);
+  CSeqOutStreamWrap outWrap(outStream);
+  CCompressProgressWrap progressWrap(progress);
+
+  SRes res = Lz4Enc_Encode(_encoder, &outWrap.p, &inWrap.p, progress ? &progressWrap.p : NULL);
+  if (res == SZ_ERROR_READ && inWrap.Res != S_OK)
+    return inWrap.Res;
+  if (res == SZ_ERROR_WRITE && outWrap.Res != S_OK)
+    return outWrap.Res;
+  if (res == SZ_ERROR_PROGRESS && progressWrap.Res != S_OK)
+    return progressWrap.Res;
+  return SResToHRESULT(res);
+}
+
+}}
@@ -0,0 +1,20 @@
+// Lz4Register.cpp
+
+#include "StdAfx.h"
+
+#include "../Common/RegisterCodec.h"
+
+#include "Lz4Decoder.h"
+
+static void *CreateCodec() { return (void *)(ICompressCoder *)(new NCompress::NLz4::CDecoder); }
+#ifndef EXTRACT_ONLY
+#include "Lz4Encoder.h"
+static void *CreateCodecOut() { return (void *)(ICompressCoder *)(new NCompress::NLz4::CEncoder);  }
+#else
+#define CreateCodecOut 0
+#endif
+
+static CCodecInfo g_CodecInfo =
+  { CreateCodec, CreateCodecOut, 0x4F71104, L"LZ4", 1, false };
+
+REGISTER_CODEC(LZ4)
@@ -2,12 +2,22 @@
 
 #include "StdAfx.h"
 
-#include "../../../C/Alloc.h"
+#ifndef _7ZIP_ST
+#include "../../Windows/System.h"
+#endif
 
+#include "../Common/DicPool.h"
 #include "../Common/StreamUtils.h"
 
 #include "Lzma2Decoder.h"
 
+#ifdef SHOW_DEBUG_INFO
+#include <stdio.h>
+#define PRF(x) x
+#else
+#define PRF(x)
+#endif
+
 static HRESULT SResToHRESULT(SRes res)
 {
   switch(res)
@@ -26,28 +36,35 @@ namespace NLzma2 {
 
 static const UInt32 kInBufSize = 1 << 20;
 
-CDecoder::CDecoder(): _inBuf(0), _outSizeDefined(false)
+CDecoder::CDecoder(): _inBuf(0), _outSizeDefined(false), _prefixSize(0)
+  #ifndef _7ZIP_ST
+  , _numThreads(1)
+  , _mtMemUsage(0)
+  #endif
 {
   Lzma2Dec_Construct(&_state);
 }
 
-static void *SzAlloc(void *p, size_t size) { p = p; return MyAlloc(size); }
-static void SzFree(void *p, void *address) { p = p; MyFree(address); }
+static void *SzAlloc(void *p, size_t size) { p = p; return NDicPool::Alloc(size); }
+static void SzFree(void *p, void *address) { p = p; NDicPool::Free(address); }
 static ISzAlloc g_Alloc = { SzAlloc, SzFree };
 
 CDecoder::~CDecoder()
 {
   Lzma2Dec_Free(&_state, &g_Alloc);
-  MyFree(_inBuf);
+  NDicPool::Free(_inBuf);
 }
 
 STDMETHODIMP CDecoder::SetDecoderProperties2(const Byte *prop, UInt32 size)
 {
   if (size != 1) return SZ_ERROR_UNSUPPORTED;
   RINOK(SResToHRESULT(Lzma2Dec_Allocate(&_state, prop[0], &g_Alloc)));
+  #ifndef _7ZIP_ST
+  _prop = prop[0];
+  #endif
   if (_inBuf == 0)
   {
-    _inBuf = (Byte *)MyAlloc(kInBufSize);
+    _inBuf = (Byte *)NDicPool::Alloc(kInBufSize);
     if (_inBuf == 0)
       return E_OUTOFMEMORY;
   }
@@ -68,24 +85,33 @@ STDMETHODIMP CDecoder::SetOutStreamSize(const UInt64 *outSize)
   Lzma2Dec_Init(&_state);
 
   _inPos = _inSize = 0;
+  _prefixSize = 0;
   _inSizeProcessed = _outSizeProcessed = 0;
   return S_OK;
 }
 
-STDMETHODIMP CDecoder::Code(ISequentialInStream *inStream,
-    ISequentialOutStream *outStream, const UInt64 * /* inSize */,
-    const UInt64 *outSize, ICompressProgressInfo *progress)
+HRESULT CDecoder::ReadInBuf(ISequentialInStream *inStream)
 {
-  if (_inBuf == 0)
-    return S_FALSE;
-  SetOutStreamSize(outSize);
+  _inPos = _inSize = 0;
+  if (_prefixSize != 0)
+  {
+    _inSize = (_prefixSize < kInBufSize) ? (UInt32)_prefixSize : kInBufSize;
+    memcpy(_inBuf, _prefix, _inSize);
+    _prefix += _inSize;
+    _prefixSize -= _inSize;
+    return S_OK;
+  }
+  return inStream->Read(_inBuf, kInBufSize, &_inSize);
+}
 
+HRESULT CDecoder::CodeSpec(ISequentialInStream *inStream,
+    ISequentialOutStream *outStream, ICompressProgressInfo *progress)
+{
   for (;;)
   {
     if (_inPos == _inSize)
     {
-      _inPos = _inSize = 0;
-      RINOK(inStream->Read(_inBuf, kInBufSize, &_inSize));
+      RINOK(ReadInBuf(inStream));
     }
 
     SizeT dicPos = _state.decoder.dicPos;
@@ -141,6 +167,435 @@ STDMETHODIMP CDecoder::Code(ISequentialInStream *inStream,
   }
 }
 
+#ifndef _7ZIP_ST
+
+static const UInt32 kNumThreadsMax = 64;
+static const size_t kMtSegmentSizeMin = (size_t)1 << 20;
+static const size_t kMtSegmentSizeMax = (size_t)1 << 28;
+// the default budget is (RAM size / 4), but not more than that
+static const UInt64 kMtMemUsageDefaultMax = (sizeof(size_t) > 4) ? ((UInt64)1 << 31) : ((UInt64)1 << 29);
+
+Byte *CMtSegment::AddPack(size_t size, size_t capMax)
+{
+  size_t newSize = PackSize + size;
+  if (newSize > PackBuf.Size())
+  {
+    size_t newCap = PackBuf.Size() * 2;
+    if (newCap > capMax)
+      newCap = capMax;
+    if (newCap < newSize)
+      newCap = newSize;
+    if (newCap < ((size_t)1 << 16))
+      newCap = (size_t)1 << 16;
+    PackBuf.ChangeSize_KeepData(newCap, PackSize);
+  }
+  Byte *p = (Byte *)PackBuf + PackSize;
+  PackSize = newSize;
+  return p;
+}
+
+CMtThread::~CMtThread()
+{
+  CVirtThread::WaitThreadFinish();
+  Lzma2Dec_FreeProbs(&Dec, &g_Alloc);
+}
+
+void CMtThread::Execute()
+{
+  CMtSegment &seg = *Segment;
+  seg.OutSize = 0;
+  try
+  {
+    seg.UnpackBuf.AllocAtLeast(seg.UnpackSize);
+  }
+  catch(...) { seg.Res = SZ_ERROR_MEM; return; }
+  seg.Res = Lzma2Dec_AllocateProbs(&Dec, Prop, &g_Alloc);
+  if (seg.Res != SZ_OK)
+    return;
+  Dec.decoder.dic = seg.UnpackBuf;
+  Dec.decoder.dicBufSize = seg.UnpackSize;
+  Lzma2Dec_Init(&Dec);
+  SizeT inSize = seg.PackSize;
+  ELzmaStatus status;
+  seg.Res = Lzma2Dec_DecodeToDic(&Dec, seg.UnpackSize, seg.PackBuf, &inSize, LZMA_FINISH_END, &status);
+  seg.OutSize = Dec.decoder.dicPos;
+  Dec.decoder.dic = NULL;
+  // the segment contains only whole chunks, so the decoder must wait for next control byte
+  if (seg.Res == SZ_OK && (inSize != seg.PackSize || seg.OutSize != seg.UnpackSize
+      || status != LZMA_STATUS_NEEDS_MORE_INPUT))
+    seg.Res = SZ_ERROR_DATA;
+}
+
+STDMETHODIMP CDecoder::SetNumberOfThreads(UInt32 numThreads)
+{
+  _numThreads = numThreads;
+  return S_OK;
+}
+
+// kUsedMemorySize sets the memory budget of multithreaded decoding. Other properties are ignored.
+
+STDMETHODIMP CDecoder::SetCoderProperties(const PROPID *propIDs, const PROPVARIANT *props, UInt32 numProps)
+{
+  for (UInt32 i = 0; i < numProps; i++)
+  {
+    if (propIDs[i] != NCoderPropID::kUsedMemorySize)
+      continue;
+    const PROPVARIANT &prop = props[i];
+    if (prop.vt == VT_UI4)
+      _mtMemUsage = prop.ulVal;
+    else if (prop.vt == VT_UI8)
+      _mtMemUsage = prop.uhVal.QuadPart;
+    else
+      return E_INVALIDARG;
+  }
+  return S_OK;
+}
+
+HRESULT CDecoder::ReadInBytes(ISequentialInStream *inStream, Byte *data, size_t size, size_t &processed)
+{
+  processed = 0;
+  while (size != 0)
+  {
+    if (_inPos == _inSize)
+    {
+      RINOK(ReadInBuf(inStream));
+      if (_inSize == 0)
+        break;
+    }
+    size_t cur = _inSize - _inPos;
+    if (cur > size)
+      cur = size;
+    memcpy(data, _inBuf + _inPos, cur);
+    _inPos += (UInt32)cur;
+    data += cur;
+    size -= cur;
+    processed += cur;
+  }
+  return S_OK;
+}
+
+static void GetChunkSizes(const Byte *header, UInt32 &packSize, UInt32 &unpackSize)
+{
+  unpackSize = ((UInt32)header[1] << 8) + header[2] + 1;
+  if (header[0] < 0x80)
+    packSize = unpackSize;
+  else
+  {
+    unpackSize += (UInt32)(header[0] & 0x1F) << 16;
+    packSize = ((UInt32)header[3] << 8) + header[4] + 1;
+  }
+}
+
+HRESULT CDecoder::ReadChunkHeader(ISequentialInStream *inStream)
+{
+  _headerSize = 0;
+  size_t processed;
+  RINOK(ReadInBytes(inStream, _header, 1, processed));
+  if (processed == 0)
+  {
+    _mtStreamEnd = _mtStreamError = true;
+    return S_OK;
+  }
+  Byte control = _header[0];
+  if (control == 0)
+  {
+    _mtStreamEnd = _mtEndMark = true;
+    return S_OK;
+  }
+  unsigned size;
+  if (control >= 0x80)
+    size = (control >= 0xC0) ? 6 : 5;
+  else if (control <= 2)
+    size = 3;
+  else
+  {
+    // the sequential decoder reports data error here too
+    _mtStreamEnd = _mtStreamError = true;
+    return S_OK;
+  }
+  RINOK(ReadInBytes(inStream, _header + 1, size - 1, processed));
+  if (processed != size - 1)
+  {
+    _mtStreamEnd = _mtStreamError = true;
+    return S_OK;
+  }
+  _headerSize = size;
+  return S_OK;
+}
+
+HRESULT CDecoder::ReadSegment(ISequentialInStream *inStream, CMtSegment &seg)
+{
+  seg.Init();
+  for (;;)
+  {
+    if (_headerSize == 0)
+    {
+      RINOK(ReadChunkHeader(inStream));
+      if (_headerSize == 0)
+        return S_OK;
+    }
+    Byte control = _header[0];
+    if (seg.PackSize != 0 && (control == 1 || control >= 0xE0))
+      return S_OK;
+    UInt32 packSize, unpackSize;
+    GetChunkSizes(_header, packSize, unpackSize);
+    if (seg.UnpackSize + unpackSize > _mtSegmentSizeMax)
+    {
+      PRF(printf("\nLZMA2: the segment is larger than %u KB, switching to sequential decoding",
+          (unsigned)(_mtSegmentSizeMax >> 10)));
+      _mtSwitchToSt = true;
+      return S_OK;
+    }
+    // the packed size of segment is not much larger than unpacked size
+    const size_t packCapMax = _mtSegmentSizeMax + (_mtSegmentSizeMax >> 10) + ((size_t)1 << 16);
+    memcpy(seg.AddPack(_headerSize, packCapMax), _header, _headerSize);
+    _headerSize = 0;
+    seg.UnpackSize += unpackSize;
+    _mtUnpackTotal += unpackSize;
+    size_t processed;
+    RINOK(ReadInBytes(inStream, seg.AddPack(packSize, packCapMax), packSize, processed));
+    if (processed != packSize)
+    {
+      seg.PackSize -= packSize - processed;
+      _mtStreamEnd = _mtStreamError = true;
+      return S_OK;
+    }
+    if (_outSizeDefined && _mtUnpackTotal >= _outSize)
+    {
+      _mtStreamEnd = true;
+      return S_OK;
+    }
+  }
+}
+
+HRESULT CDecoder::ReadBatch(ISequentialInStream *inStream, CMtBatch &batch, unsigned numThreads)
+{
+  batch.NumSegments = 0;
+  batch.UnpackSize = 0;
+  batch.MemSize = 0;
+  // the last segment can exceed _mtBatchMemMax by the size of one segment
+  while (batch.NumSegments < numThreads && (batch.NumSegments == 0 || batch.MemSize < _mtBatchMemMax)
+      && !_mtStreamEnd)
+  {
+    if (batch.NumSegments == batch.Segments.Size())
+      batch.Segments.AddNew();
+    CMtSegment &seg = batch.Segments[batch.NumSegments];
+    RINOK(ReadSegment(inStream, seg));
+    if (_mtSwitchToSt)
+    {
+      _mtPartial = &seg;
+      break;
+    }
+    if (seg.PackSize == 0)
+      break;
+    batch.NumSegments++;
+    batch.UnpackSize += seg.UnpackSize;
+    batch.MemSize += seg.PackBuf.Size() + seg.UnpackSize;
+  }
+  return S_OK;
+}
+
+void CDecoder::StartDecoding(CMtBatch &batch)
+{
+  for (unsigned i = 0; i < batch.NumSegments; i++)
+  {
+    CMtThread &thread = _threads[i];
+    thread.Prop = _prop;
+    thread.Segment = &batch.Segments[i];
+    thread.Start();
+  }
+}
+
+void CDecoder::WaitDecoding(CMtBatch &batch)
+{
+  for (unsigned i = 0; i < batch.NumSegments; i++)
+    _threads[i].WaitExecuteFinish();
+}
+
+HRESULT CDecoder::WriteBatch(ISequentialOutStream *outStream, CMtBatch &batch, ICompressProgressInfo *progress)
+{
+  unsigned numSegments = batch.NumSegments;
+  batch.NumSegments = 0;
+  for (unsigned i = 0; i < numSegments; i++)
+  {
+    const CMtSegment &seg = batch.Segments[i];
+    size_t size = seg.OutSize;
+    bool stopDecoding = false;
+    if (_outSizeDefined)
+    {
+      const UInt64 rem = _outSize - _outSizeProcessed;
+      if (size >= rem)
+      {
+        size = (size_t)rem;
+        stopDecoding = true;
+      }
+    }
+    RINOK(WriteStream(outStream, seg.UnpackBuf, size));
+    _outSizeProcessed += size;
+    _inSizeProcessed += seg.PackSize;
+    // the sequential decoder doesn't decode the data after (outSize)
+    if (stopDecoding)
+      return S_OK;
+    if (seg.Res != SZ_OK)
+      return SResToHRESULT(seg.Res);
+    if (progress)
+    {
+      RINOK(progress->SetRatioInfo(&_inSizeProcessed, &_outSizeProcessed));
+    }
+  }
+  return S_OK;
+}
+
+HRESULT CDecoder::CodeMt(ISequentialInStream *inStream,
+    ISequentialOutStream *outStream, ICompressProgressInfo *progress)
+{
+  unsigned numThreads = (_numThreads < kNumThreadsMax) ? _numThreads : kNumThreadsMax;
+  while (_threads.Size() < numThreads)
+  {
+    WRes wres = _threads.AddNew().Create();
+    if (wres != 0)
+    {
+      _threads.DeleteBack();
+      return wres;
+    }
+  }
+
+  _headerSize = 0;
+  _mtStreamEnd = false;
+  _mtStreamError = false;
+  _mtEndMark = false;
+  _mtSwitchToSt = false;
+  _mtPartial = NULL;
+  _mtUnpackTotal = 0;
+  _batches[0].NumSegments = 0;
+  _batches[1].NumSegments = 0;
+
+  /* Two batches are in memory. A batch reads segments while the pack and unpack
+     buffers of its segments take less than _mtBatchMemMax, so the buffers of
+     a batch take up to (_mtBatchMemMax + segMemMax) = (budget / 2).
+     The stream of single-threaded encoder is one big segment: the decoder switches
+     to sequential decoding after (4 * dictSize) bytes instead of buffering the whole stream. */
+  {
+    UInt64 budget = _mtMemUsage;
+    if (budget == 0)
+    {
+      budget = NWindows::NSystem::GetRamSize() / 4;
+      if (budget > kMtMemUsageDefaultMax)
+        budget = kMtMemUsageDefaultMax;
+    }
+    const UInt32 dicSize = (_prop >= 40) ? 0xFFFFFFFF : (((UInt32)2 | (_prop & 1)) << (_prop / 2 + 11));
+    UInt64 segSizeMax = (UInt64)dicSize << 2;
+    if (segSizeMax < kMtSegmentSizeMin)
+      segSizeMax = kMtSegmentSizeMin;
+    if (segSizeMax > kMtSegmentSizeMax)
+      segSizeMax = kMtSegmentSizeMax;
+    if (segSizeMax > budget / 8)
+      segSizeMax = budget / 8;
+    // unpack buffer and pack buffer (see packCapMax in ReadSegment)
+    const UInt64 segMemMax = segSizeMax * 2 + (segSizeMax >> 10) + ((UInt32)1 << 16);
+    _mtSegmentSizeMax = (size_t)segSizeMax;
+    _mtBatchMemMax = (budget / 2 > segMemMax) ? (size_t)(budget / 2 - segMemMax) : 0;
+    PRF(printf("\nLZMA2: budget = %u MB, segment = %u KB, batch = %u KB",
+        (unsigned)(budget >> 20), (unsigned)(_mtSegmentSizeMax >> 10), (unsigned)(_mtBatchMemMax >> 10)));
+  }
+
+  unsigned cur = 0;
+  bool decoding = false;
+  HRESULT res = S_OK;
+
+  /* the main thread reads batch (cur), while threads decode batch (cur ^ 1).
+     Then it writes batch (cur ^ 1), while threads decode batch (cur). */
+
+  for (;;)
+  {
+    CMtBatch &batch = _batches[cur];
+    batch.NumSegments = 0;
+    if (!_mtStreamEnd && !_mtSwitchToSt)
+      res = ReadBatch(inStream, batch, numThreads);
+    if (decoding)
+    {
+      WaitDecoding(_batches[cur ^ 1]);
+      decoding = false;
+    }
+    if (res != S_OK)
+      return res;
+    if (batch.NumSegments != 0)
+    {
+      StartDecoding(batch);
+      decoding = true;
+    }
+
+    CMtBatch &prev = _batches[cur ^ 1];
+    if (prev.NumSegments != 0)
+    {
+      res = WriteBatch(outStream, prev, progress);
+      if (res != S_OK || (_outSizeDefined && _outSizeProcessed >= _outSize))
+        break;
+    }
+    if (!decoding)
+      break;
+    cur ^= 1;
+  }
+  if (decoding)
+    WaitDecoding(_batches[cur]);
+  if (res != S_OK)
+    return res;
+  if (_outSizeDefined && _outSizeProcessed >= _outSize)
+    return S_OK;
+
+  if (_mtSwitchToSt)
+  {
+    /* we decode the data of partial segment, the header of next chunk
+       and the rest of input buffer before the data from stream */
+    CMtSegment &seg = *_mtPartial;
+    size_t inRem = _inSize - _inPos;
+    seg.PackBuf.ChangeSize_KeepData(seg.PackSize + _headerSize + inRem, seg.PackSize);
+    Byte *p = (Byte *)seg.PackBuf + seg.PackSize;
+    memcpy(p, _header, _headerSize);
+    memcpy(p + _headerSize, _inBuf + _inPos, inRem);
+    _prefix = seg.PackBuf;
+    _prefixSize = seg.PackSize + _headerSize + inRem;
+    _inPos = _inSize = 0;
+    Lzma2Dec_Init(&_state);
+    res = CodeSpec(inStream, outStream, progress);
+    _prefixSize = 0;
+    return res;
+  }
+
+  if (_mtStreamError)
+    return S_FALSE;
+  if (_mtEndMark)
+    _inSizeProcessed++;
+  return S_OK;
+}
+
+void CDecoder::FreeMtBuffers()
+{
+  _mtPartial = NULL;
+  _batches[0].Segments.Clear();
+  _batches[1].Segments.Clear();
+}
+
+#endif
+
+STDMETHODIMP CDecoder::Code(ISequentialInStream *inStream,
+    ISequentialOutStream *outStream, const UInt64 * /* inSize */,
+    const UInt64 *outSize, ICompressProgressInfo *progress)
+{
+  if (_inBuf == 0)
+    return S_FALSE;
+  SetOutStreamSize(outSize);
+  #ifndef _7ZIP_ST
+  if (_numThreads > 1)
+  {
+    HRESULT res = CodeMt(inStream, outStream, progress);
+    FreeMtBuffers();
+    return res;
+  }
+  #endif
+  return CodeSpec(inStream, outStream, progress);
+}
+
 #ifndef NO_READ_FROM_CODER
 
 STDMETHODIMP CDecoder::Read(void *data, UInt32 size, UInt32 *processedSize)
@@ -151,8 +606,7 @@ STDMETHODIMP CDecoder::Read(void *data, UInt32 size, UInt32 *processedSize)
   {
     if (_inPos == _inSize)
     {
-      _inPos = _inSize = 0;
-      RINOK(_inStream->Read(_inBuf, kInBufSize, &_inSize));
+      RINOK(ReadInBuf(_inStream));
     }
     {
       SizeT inProcessed = _inSize - _inPos;
@@ -5,13 +5,68 @@
 
 #include "../../../C/Lzma2Dec.h"
 
+#include "../../Common/MyBuffer.h"
 #include "../../Common/MyCom.h"
+#include "../../Common/MyVector.h"
+
+#ifndef _7ZIP_ST
+#include "../Common/VirtThread.h"
+#endif
 
 #include "../ICoder.h"
 
 namespace NCompress {
 namespace NLzma2 {
 
+#ifndef _7ZIP_ST
+
+/* Each chunk of LZMA2 stream that resets the dictionary (control byte 0x01
+   or 0xE0-0xFF) starts a segment that doesn't depend on previous data.
+   Multithreaded Lzma2Enc starts each block with such chunk.
+   In multithreaded mode the decoder parses the chunk headers and reads whole
+   segments to memory, the threads decode the segments of a batch, and the main
+   thread writes the previous batch in order in parallel with decoding.
+   The size of segment is limited by the block size of multithreaded Lzma2Enc for
+   the dictionary, and the buffers of both batches are limited by the memory
+   budget of decoder (NCoderPropID::kUsedMemorySize, RAM size / 4 by default).
+   If some segment is too big for the budget, the decoder switches to sequential
+   decoding. */
+
+struct CMtSegment
+{
+  CByteBuffer PackBuf;
+  CByteBuffer UnpackBuf;
+  size_t PackSize;
+  size_t UnpackSize;
+  size_t OutSize; // size of decoded data
+  SRes Res;
+
+  void Init() { PackSize = 0; UnpackSize = 0; OutSize = 0; Res = SZ_OK; }
+  Byte *AddPack(size_t size, size_t capMax);
+};
+
+class CMtThread: public CVirtThread
+{
+public:
+  CLzma2Dec Dec;
+  Byte Prop;
+  CMtSegment *Segment;
+
+  CMtThread() { Lzma2Dec_Construct(&Dec); }
+  ~CMtThread();
+  virtual void Execute();
+};
+
+struct CMtBatch
+{
+  CObjectVector<CMtSegment> Segments;
+  unsigned NumSegments;
+  size_t UnpackSize;
+  size_t MemSize; // pack and unpack buffers of segments
+};
+
+#endif
+
 class CDecoder:
   public ICompressCoder,
   public ICompressSetDecoderProperties2,
@@ -21,6 +76,10 @@ class CDecoder:
   public ICompressSetOutStreamSize,
   public ISequentialInStream,
   #endif
+  #ifndef _7ZIP_ST
+  public ICompressSetCoderMt,
+  public ICompressSetCoderProperties,
+  #endif
   public CMyUnknownImp
 {
   CMyComPtr<ISequentialInStream> _inStream;
@@ -32,20 +91,60 @@ class CDecoder:
   UInt64 _outSize;
   UInt64 _inSizeProcessed;
   UInt64 _outSizeProcessed;
+
+  // the data that must be decoded before the data from stream
+  const Byte *_prefix;
+  size_t _prefixSize;
+
+  HRESULT ReadInBuf(ISequentialInStream *inStream);
+  HRESULT CodeSpec(ISequentialInStream *inStream, ISequentialOutStream *outStream,
+      ICompressProgressInfo *progress);
+
+  #ifndef _7ZIP_ST
+  Byte _prop;
+  UInt32 _numThreads;
+  CObjectVector<CMtThread> _threads;
+  CMtBatch _batches[2];
+
+  Byte _header[6];   // header of next chunk
+  unsigned _headerSize;
+  bool _mtStreamEnd;
+  bool _mtStreamError;
+  bool _mtEndMark;
+  bool _mtSwitchToSt;
+  CMtSegment *_mtPartial; // the segment that was read before switching to sequential decoding
+  UInt64 _mtUnpackTotal;
+  UInt64 _mtMemUsage; // 0 means default
+  size_t _mtSegmentSizeMax;
+  size_t _mtBatchMemMax;
+
+  HRESULT ReadInBytes(ISequentialInStream *inStream, Byte *data, size_t size, size_t &processed);
+  HRESULT ReadChunkHeader(ISequentialInStream *inStream);
+  HRESULT ReadSegment(ISequentialInStream *inStream, CMtSegment &seg);
+  HRESULT ReadBatch(ISequentialInStream *inStream, CMtBatch &batch, unsigned numThreads);
+  void StartDecoding(CMtBatch &batch);
+  void WaitDecoding(CMtBatch &batch);
+  HRESULT WriteBatch(ISequentialOutStream *outStream, CMtBatch &batch, ICompressProgressInfo *progress);
+  HRESULT CodeMt(ISequentialInStream *inStream, ISequentialOutStream *outStream,
+      ICompressProgressInfo *progress);
+  void FreeMtBuffers();
+  #endif
 public:
 
+  MY_QUERYINTERFACE_BEGIN2(ICompressCoder)
+  MY_QUERYINTERFACE_ENTRY(ICompressSetDecoderProperties2)
+  MY_QUERYINTERFACE_ENTRY(ICompressGetInStreamProcessedSize)
   #ifndef NO_READ_FROM_CODER
-  MY_UNKNOWN_IMP5(
-      ICompressSetDecoderProperties2,
-      ICompressGetInStreamProcessedSize,
-      ICompressSetInStream,
-      ICompressSetOutStreamSize,
-      ISequentialInStream)
-  #else
-  MY_UNKNOWN_IMP2(
-      ICompressSetDecoderProperties2,
-      ICompressGetInStreamProcessedSize)
+  MY_QUERYINTERFACE_ENTRY(ICompressSetInStream)
+  MY_QUERYINTERFACE_ENTRY(ICompressSetOutStreamSize)
+  MY_QUERYINTERFACE_ENTRY(ISequentialInStream)
   #endif
+  #ifndef _7ZIP_ST
+  MY_QUERYINTERFACE_ENTRY(ICompressSetCoderMt)
+  MY_QUERYINTERFACE_ENTRY(ICompressSetCoderProperties)
+  #endif
+  MY_QUERYINTERFACE_END
+  MY_ADDREF_RELEASE
 
   STDMETHOD(Code)(ISequentialInStream *inStream,
       ISequentialOutStream *outStream, const UInt64 *_inSize, const UInt64 *outSize,
@@ -63,6 +162,11 @@ public:
   STDMETHOD(Read)(void *data, UInt32 size, UInt32 *processedSize);
   #endif
 
+  #ifndef _7ZIP_ST
+  STDMETHOD(SetNumberOfThreads)(UInt32 numThreads);
+  STDMETHOD(SetCoderProperties)(const PROPID *propIDs, const PROPVARIANT *props, UInt32 numProps);
+  #endif
+
   CDecoder();
   virtual ~CDecoder();
 
@@ -2,8 +2,7 @@
 
 #include "StdAfx.h"
 
-#include "../../../C/Alloc.h"
-
+#include "../Common/DicPool.h"
 #include "../Common/StreamUtils.h"
 
 #include "LzmaDecoder.h"
@@ -35,25 +34,42 @@ CDecoder::CDecoder(): _inBuf(0), _propsWereSet(false), _outSizeDefined(false),
   LzmaDec_Construct(&_state);
 }
 
-static void *SzAlloc(void *p, size_t size) { p = p; return MyAlloc(size); }
-static void SzFree(void *p, void *address) { p = p; MyFree(address); }
+static void *SzAlloc(void *p, size_t size) { p = p; return NDicPool::Alloc(size); }
+static void SzFree(void *p, void *address) { p = p; NDicPool::Free(address); }
 static ISzAlloc g_Alloc = { SzAlloc, SzFree };
 
 CDecoder::~CDecoder()
 {
   LzmaDec_Free(&_state, &g_Alloc);
-  MyFree(_inBuf);
+  NDicPool::Free(_inBuf);
 }
 
 STDMETHODIMP CDecoder::SetInBufSize(UInt32 , UInt32 size) { _inBufSize = size; return S_OK; }
 STDMETHODIMP CDecoder::SetOutBufSize(UInt32 , UInt32 size) { _outBufSize = size; return S_OK; }
 
+// kAlgorithm selects the decoder core (LZMA_DEC_CORE_REF / LZMA_DEC_CORE_FAST).
+// Other properties are for encoder, and they are ignored.
+
+STDMETHODIMP CDecoder::SetCoderProperties(const PROPID *propIDs, const PROPVARIANT *props, UInt32 numProps)
+{
+  for (UInt32 i = 0; i < numProps; i++)
+  {
+    if (propIDs[i] != NCoderPropID::kAlgorithm)
+      continue;
+    const PROPVARIANT &prop = props[i];
+    if (prop.vt != VT_UI4 || prop.ulVal > LZMA_DEC_CORE_FAST)
+      return E_INVALIDARG;
+    LzmaDec_SetCore(&_state, (int)prop.ulVal);
+  }
+  return S_OK;
+}
+
 HRESULT CDecoder::CreateInputBuffer()
 {
   if (_inBuf == 0 || _inBufSize != _inBufSizeAllocated)
   {
-    MyFree(_inBuf);
-    _inBuf = (Byte *)MyAlloc(_inBufSize);
+    NDicPool::Free(_inBuf);
+    _inBuf = (Byte *)NDicPool::Alloc(_inBufSize);
     if (_inBuf == 0)
       return E_OUTOFMEMORY;
     _inBufSizeAllocated = _inBufSize;
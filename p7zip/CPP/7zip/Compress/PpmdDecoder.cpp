@@ -6,6 +6,7 @@
 #include "../../../C/Alloc.h"
 #include "../../../C/CpuArch.h"
 
+#include "../Common/DicPool.h"
 #include "../Common/StreamUtils.h"
 
 #include "PpmdDecoder.h"
@@ -23,8 +24,8 @@ enum
   kStatus_Error
 };
 
-static void *SzBigAlloc(void *, size_t size) { return BigAlloc(size); }
-static void SzBigFree(void *, void *address) { BigFree(address); }
+static void *SzBigAlloc(void *, size_t size) { return NDicPool::Alloc(size); }
+static void SzBigFree(void *, void *address) { NDicPool::Free(address); }
 static ISzAlloc g_BigAlloc = { SzBigAlloc, SzBigFree };
 
 CDecoder::~CDecoder()
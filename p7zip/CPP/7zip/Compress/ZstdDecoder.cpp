@@ -0,0 +1,332 @@
+// ZstdDecoder.cpp
+
+#include "StdAfx.h"
+
+#include "../../../C/CpuArch.h"
+
+#include "../Common/DicPool.h"
+#include "../Common/StreamUtils.h"
+
+#include "ZstdDecoder.h"
+
+namespace NCompress {
+namespace NZstd {
+
+static const size_t kInBufSize = (size_t)1 << 20;
+
+// the default limit is the same as in reference zstd (ZSTD_WINDOWLOG_LIMIT_DEFAULT)
+static const unsigned kWindowLogMaxDefault = 27;
+static const unsigned kWindowLogMaxLimit = (sizeof(size_t) > 4) ? 31 : 28;
+
+static void *SzAlloc(void *p, size_t size) { p = p; return NDicPool::Alloc(size); }
+static void SzFree(void *p, void *address) { p = p; NDicPool::Free(address); }
+static ISzAlloc g_Alloc = { SzAlloc, SzFree };
+
+CDecoder::CDecoder(): _inBuf(NULL), _win(NULL), _winSize(0), WindowLogMax(kWindowLogMaxDefault)
+{
+  ZstdDec_Construct(&_dec);
+}
+
+CDecoder::~CDecoder()
+{
+  ZstdDec_Free(&_dec, &g_Alloc);
+  NDicPool::Free(_inBuf);
+  NDicPool::Free(_win);
+}
+
+STDMETHODIMP CDecoder::SetDecoderProperties2(const Byte * /* data */, UInt32 size)
+{
+  if (size != 3 && size != kPropsSize)
+    return E_NOTIMPL;
+  return S_OK;
+}
+
+HRESULT CDecoder::ReadIn(ISequentialInStream *inStream, size_t size)
+{
+  size_t rem = _inLim - _inPos;
+  if (rem >= size || _inEof)
+    return S_OK;
+  if (_inPos != 0)
+  {
+    memmove(_inBuf, _inBuf + _inPos, rem);
+    _inProcessed += _inPos;
+    _inPos = 0;
+    _inLim = rem;
+  }
+  size_t cur = kInBufSize - _inLim;
+  HRESULT res = ReadStream(inStream, _inBuf + _inLim, &cur);
+  if (cur != kInBufSize - _inLim)
+    _inEof = true;
+  _inLim += cur;
+  return res;
+}
+
+HRESULT CDecoder::SkipIn(ISequentialInStream *inStream, UInt64 size)
+{
+  for (;;)
+  {
+    size_t rem = _inLim - _inPos;
+    if (rem >= size)
+    {
+      _inPos += (size_t)size;
+      return S_OK;
+    }
+    _inPos = _inLim;
+    size -= rem;
+    if (_inEof)
+    {
+      UnexpectedEnd = true;
+      return S_FALSE;
+    }
+    RINOK(ReadIn(inStream, 1));
+  }
+}
+
+HRESULT CDecoder::DecodeFrame(ISequentialInStream *inStream, ISequentialOutStream *outStream,
+    const CZstdFrameHeader &header, ICompressProgressInfo *progress)
+{
+  const UInt64 windowSize = header.windowSize;
+  unsigned windowLogMax = WindowLogMax;
+  if (windowLogMax > kWindowLogMaxLimit)
+    windowLogMax = kWindowLogMaxLimit;
+  if (windowSize > ((UInt64)1 << windowLogMax))
+  {
+    Unsupported = true;
+    return S_FALSE;
+  }
+
+  size_t blockSizeMax = ZSTD_BLOCK_SIZE_MAX;
+  if (windowSize < blockSizeMax)
+    blockSizeMax = (size_t)windowSize;
+
+  /* The window buffer keeps (windowSize) bytes of history and the next block.
+     The history is moved to the start of buffer, when the free space after it is smaller than block.
+     (margin) is the data decoded between two moves: half of window, so each decoded byte
+     is moved about 2 times, and the buffer is 1.5 of window instead of 2.
+     If the size of frame is known and small, the whole frame is decoded to buffer without moving. */
+
+  size_t margin = (size_t)windowSize / 2;
+  if (margin < blockSizeMax)
+    margin = blockSizeMax;
+  size_t capacity = (size_t)windowSize + blockSizeMax + margin;
+  bool needMove = true;
+  if (header.contentSize <= capacity)
+  {
+    capacity = (size_t)header.contentSize;
+    needMove = false;
+  }
+  if (!_win || _winSize < capacity + ZSTD_PADDING_SIZE)
+  {
+    NDicPool::Free(_win);
+    _winSize = 0;
+    _win = (Byte *)NDicPool::Alloc(capacity + ZSTD_PADDING_SIZE);
+    if (!_win)
+      return E_OUTOFMEMORY;
+    _winSize = capacity + ZSTD_PADDING_SIZE;
+  }
+
+  ZstdDec_InitFrame(&_dec);
+  const bool checksum = ZstdFrameHeader_HasChecksum(&header);
+  CXxh64 xxh;
+  Xxh64_Init(&xxh);
+
+  size_t pos = 0;
+  UInt64 frameSize = 0;
+
+  for (;;)
+  {
+    RINOK(ReadIn(inStream, ZSTD_BLOCK_HEADER_SIZE));
+    if (_inLim - _inPos < ZSTD_BLOCK_HEADER_SIZE)
+    {
+      UnexpectedEnd = true;
+      return S_FALSE;
+    }
+    const Byte *p = _inBuf + _inPos;
+    const UInt32 bh = (UInt32)p[0] | ((UInt32)p[1] << 8) | ((UInt32)p[2] << 16);
+    const unsigned type = (bh >> 1) & 3;
+    const size_t blockSize = bh >> 3;
+    _inPos += ZSTD_BLOCK_HEADER_SIZE;
+
+    if (type > ZSTD_BLOCK_TYPE_COMPRESSED || blockSize > blockSizeMax)
+    {
+      DataError = true;
+      return S_FALSE;
+    }
+
+    if (needMove && pos + blockSizeMax > capacity)
+    {
+      const size_t keep = (size_t)windowSize;
+      memmove(_win, _win + pos - keep, keep);
+      pos = keep;
+    }
+    size_t outLim = capacity - pos;
+    if (outLim > blockSizeMax)
+      outLim = blockSizeMax;
+
+    const size_t inSize = (type == ZSTD_BLOCK_TYPE_RLE) ? 1 : blockSize;
+    RINOK(ReadIn(inStream, inSize));
+    if (_inLim - _inPos < inSize)
+    {
+      UnexpectedEnd = true;
+      return S_FALSE;
+    }
+
+    size_t outSize;
+    if (type == ZSTD_BLOCK_TYPE_COMPRESSED)
+    {
+      SRes res = ZstdDec_DecodeBlock(&_dec, _inBuf + _inPos, blockSize, _win, pos, pos, outLim, &outSize);
+      if (res != SZ_OK)
+      {
+        DataError = true;
+        return S_FALSE;
+      }
+    }
+    else
+    {
+      outSize = blockSize;
+      if (outSize > outLim)
+      {
+        DataError = true;
+        return S_FALSE;
+      }
+      if (type == ZSTD_BLOCK_TYPE_RAW)
+        memcpy(_win + pos, _inBuf + _inPos, outSize);
+      else
+        memset(_win + pos, _inBuf[_inPos], outSize);
+    }
+    _inPos += inSize;
+    NumBlocks++;
+
+    if (outSize != 0)
+    {
+      if (checksum)
+        Xxh64_Update(&xxh, _win + pos, outSize);
+      RINOK(WriteStream(outStream, _win + pos, outSize));
+      pos += outSize;
+      frameSize += outSize;
+      _outProcessed += outSize;
+    }
+
+    if (progress)
+    {
+      const UInt64 inProcessed = GetInputProcessedSize();
+      RINOK(progress->SetRatioInfo(&inProcessed, &_outProcessed));
+    }
+
+    if (bh & 1)
+      break;
+  }
+
+  if (header.contentSize != ZSTD_CONTENT_SIZE_UNKNOWN && header.contentSize != frameSize)
+  {
+    DataError = true;
+    return S_FALSE;
+  }
+
+  if (checksum)
+  {
+    RINOK(ReadIn(inStream, ZSTD_CHECKSUM_SIZE));
+    if (_inLim - _inPos < ZSTD_CHECKSUM_SIZE)
+    {
+      UnexpectedEnd = true;
+      return S_FALSE;
+    }
+    if (GetUi32(_inBuf + _inPos) != (UInt32)Xxh64_Digest(&xxh))
+      ChecksumError = true;
+    _inPos += ZSTD_CHECKSUM_SIZE;
+  }
+  return S_OK;
+}
+
+HRESULT CDecoder::CodeReal(ISequentialInStream *inStream, ISequentialOutStream *outStream, ICompressProgressInfo *progress)
+{
+  if (!_inBuf)
+  {
+    _inBuf = (Byte *)NDicPool::Alloc(kInBufSize + ZSTD_PADDING_SIZE);
+    if (!_inBuf)
+      return E_OUTOFMEMORY;
+  }
+  if (ZstdDec_Allocate(&_dec, &g_Alloc) != SZ_OK)
+    return E_OUTOFMEMORY;
+
+  for (;;)
+  {
+    RINOK(ReadIn(inStream, ZSTD_FRAME_HEADER_SIZE_MAX));
+    const size_t avail = _inLim - _inPos;
+    if (avail == 0)
+      break;
+    const Byte *p = _inBuf + _inPos;
+    const UInt32 sig = (avail < ZSTD_SIG_SIZE) ? 0 : GetUi32(p);
+
+    if ((sig & ZSTD_SKIP_MAGIC_MASK) == ZSTD_SKIP_MAGIC)
+    {
+      if (avail < ZSTD_SKIP_HEADER_SIZE)
+      {
+        UnexpectedEnd = true;
+        break;
+      }
+      const UInt32 size = GetUi32(p + 4);
+      _inPos += ZSTD_SKIP_HEADER_SIZE;
+      NumSkipFrames++;
+      IsArc = true;
+      RINOK(SkipIn(inStream, size));
+      continue;
+    }
+
+    if (sig != ZSTD_MAGIC)
+    {
+      if (NumFrames == 0 && NumSkipFrames == 0)
+        IsArc = false;
+      else
+        DataAfterEnd = true;
+      break;
+    }
+
+    IsArc = true;
+    if (avail < ZSTD_FRAME_HEADER_SIZE_MIN || avail < ZstdFrameHeader_GetSize(p[4]))
+    {
+      UnexpectedEnd = true;
+      break;
+    }
+    CZstdFrameHeader header;
+    if (ZstdFrameHeader_Parse(&header, p) != SZ_OK)
+    {
+      Unsupported = true;
+      break;
+    }
+    _inPos += ZstdFrameHeader_GetSize(p[4]);
+    HRESULT res = DecodeFrame(inStream, outStream, header, progress);
+    if (res != S_OK)
+      return res;
+    NumFrames++;
+  }
+
+  if (!IsArc || UnexpectedEnd || DataAfterEnd || Unsupported || DataError || ChecksumError)
+    return S_FALSE;
+  return S_OK;
+}
+
+STDMETHODIMP CDecoder::Code(ISequentialInStream *inStream, ISequentialOutStream *outStream,
+    const UInt64 * /* inSize */, const UInt64 * /* outSize */, ICompressProgressInfo *progress)
+{
+  _inPos = 0;
+  _inLim = 0;
+  _inEof = false;
+  _inProcessed = 0;
+  _outProcessed = 0;
+
+  NumFrames = 0;
+  NumSkipFrames = 0;
+  NumBlocks = 0;
+  IsArc = false;
+  UnexpectedEnd = false;
+  DataAfterEnd = false;
+  Unsupported = false;
+  DataError = false;
+  ChecksumError = false;
+
+  try { return CodeReal(inStream, outStream, progress); }
+  catch(...) { return E_OUTOFMEMORY; }
+}
+
+}}
@@ -0,0 +1,72 @@
+// ZstdDecoder.h
+
+#ifndef __ZSTD_DECODER_H
+#define __ZSTD_DECODER_H
+
+#include "../../../C/Zstd.h"
+
+#include "../../Common/MyCom.h"
+#include "../ICoder.h"
+
+namespace NCompress {
+namespace NZstd {
+
+/* 7z coder properties of Zstandard method: { version major, version minor, level [, 0, 0] }.
+   The decoder doesn't need them, it accepts 3 or 5 bytes. */
+
+const unsigned kPropsSize = 5;
+
+class CDecoder:
+  public ICompressCoder,
+  public ICompressSetDecoderProperties2,
+  public CMyUnknownImp
+{
+  CZstdDec _dec;
+
+  Byte *_inBuf;
+  size_t _inPos;
+  size_t _inLim;
+  bool _inEof;
+  UInt64 _inProcessed; // size of input data before _inBuf
+
+  Byte *_win;
+  size_t _winSize;
+
+  UInt64 _outProcessed;
+
+  HRESULT ReadIn(ISequentialInStream *inStream, size_t size);
+  HRESULT SkipIn(ISequentialInStream *inStream, UInt64 size);
+  HRESULT DecodeFrame(ISequentialInStream *inStream, ISequentialOutStream *outStream,
+      const CZstdFrameHeader &header, ICompressProgressInfo *progress);
+  HRESULT CodeReal(ISequentialInStream *inStream, ISequentialOutStream *outStream, ICompressProgressInfo *progress);
+public:
+  // frames with larger window are reported as unsupported. The buffer is about 1.5 of window.
+  unsigned WindowLogMax;
+
+  // the results of last Code() call
+  UInt64 NumFrames;
+  UInt64 NumSkipFrames;
+  UInt64 NumBlocks;
+  bool IsArc;
+  bool UnexpectedEnd;
+  bool DataAfterEnd;
+  bool Unsupported;
+  bool DataError;
+  bool ChecksumError;
+
+  MY_UNKNOWN_IMP1(ICompressSetDecoderProperties2)
+
+  STDMETHOD(Code)(ISequentialInStream *inStream, ISequentialOutStream *outStream,
+      const UInt64 *inSize, const UInt64 *outSize, ICompressProgressInfo *progress);
+  STDMETHOD(SetDecoderProperties2)(const Byte *data, UInt32 size);
+
+  UInt64 GetInputProcessedSize() const { return _inProcessed + _inPos; }
+  UInt64 GetOutputProcessedSize() const { return _outProcessed; }
+
+  CDecoder();
+  virtual ~CDecoder();
+};
+
+}}
+
+#endif
@@ -0,0 +1,20 @@
+// ZstdRegister.cpp
+
+#include "StdAfx.h"
+
+#include "../Common/RegisterCodec.h"
+
+#include "ZstdDecoder.h"
+
+static void *CreateCodec() { return (void *)(ICompressCoder *)(new NCompress::NZstd::CDecoder); }
+#ifndef EXTRACT_ONLY
+#include "ZstdEncoder.h"
+static void *CreateCodecOut() { return (void *)(ICompressCoder *)(new NCompress::NZstd::CEncoder);  }
+#else
+#define CreateCodecOut 0
+#endif
+
+static CCodecInfo g_CodecInfo =
+  { CreateCodec, CreateCodecOut, 0x4F71101, L"ZSTD", 1, false };
+
+REGISTER_CODEC(ZSTD)
@@ -124,4 +124,20 @@ STREAM_INTERFACE(IStreamGetProps2, 0x09)
   STDMETHOD(GetProps2)(CStreamFileProps *props) PURE;
 };
 
+/* IStreamGetFd allows the in-kernel copying (copy_file_range / sendfile) between file streams.
+  GetFd() returns S_FALSE, if there is no file descriptor for stream.
+  Otherwise (*fd) is file descriptor, whose file offset is the current position of stream,
+  and (*rem) is the maximum number of bytes that can be transferred via (*fd)
+  ((UInt64)(Int64)-1 means no limit).
+  The caller that has transferred data via (*fd) calls FdTransferred(size) for that stream,
+  so the stream can update its state.
+  The ID is far from the IDs of 7-Zip (0x0A is IStreamGetProp there), so the interface
+  doesn't conflict with the stream interfaces of newer 7-Zip versions. */
+
+STREAM_INTERFACE(IStreamGetFd, 0xA0)
+{
+  STDMETHOD(GetFd)(int *fd, UInt64 *rem) PURE;
+  STDMETHOD(FdTransferred)(UInt64 size) PURE;
+};
+
 #endif
@@ -29,6 +29,7 @@
 #include "../../../../C/7zCrc.h"
 #include "../../../../C/Alloc.h"
 #include "../../../../C/CpuArch.h"
+#include "../../../../C/LzmaDec.h"
 
 #if !defined(_7ZIP_ST) || defined(_WIN32)
 #include "../../../Windows/System.h"
@@ -544,7 +545,9 @@ struct CBenchProps
   UInt32 DecComplexCompr;
   UInt32 DecComplexUnc;
 
-  CBenchProps(): LzmaRatingMode(false) {}
+  int LzmaDecCore;
+
+  CBenchProps(): LzmaRatingMode(false), LzmaDecCore(LZMA_DEC_CORE_REF) {}
   void SetLzmaCompexity();
 
   UInt64 GeComprCommands(UInt64 unpackSize)
@@ -1092,6 +1095,18 @@ static HRESULT MethodBench(
         encoder._decoderFilter, decoder, coder2de, false, false));
       if (!encoder._decoderFilter && !decoder)
         return E_NOTIMPL;
+      if (benchProps->LzmaDecCore != LZMA_DEC_CORE_REF && decoder)
+      {
+        // LZMA decoder selects the core with kAlgorithm property
+        CMyComPtr<ICompressSetCoderProperties> scp;
+        decoder.QueryInterface(IID_ICompressSetCoderProperties, &scp);
+        if (scp)
+        {
+          PROPID propID = NCoderPropID::kAlgorithm;
+          NCOM::CPropVariant prop = (UInt32)benchProps->LzmaDecCore;
+          RINOK(scp->SetCoderProperties(&propID, &prop, 1));
+        }
+      }
     }
   }
 
@@ -1480,27 +1495,40 @@ struct CBenchMethod
   UInt32 DecComplexCompr;
   UInt32 DecComplexUnc;
   const char *Name;
+  int LzmaDecCore; // for comparison of LZMA decoder cores, other methods ignore it
 };
 
 static const CBenchMethod g_Bench[] =
 {
-  { 17,  357,  145,   20, "LZMA:x1" },
-  { 24, 1220,  145,   20, "LZMA:x5:mt1" },
-  { 24, 1220,  145,   20, "LZMA:x5:mt2" },
-  { 16,  124,   40,   14, "Deflate:x1" },
-  { 16,  376,   40,   14, "Deflate:x5" },
-  { 16, 1082,   40,   14, "Deflate:x7" },
-  { 17,  422,   40,   14, "Deflate64:x5" },
-  { 15,  590,   69,   69, "BZip2:x1" },
-  { 19,  815,  122,  122, "BZip2:x5" },
-  { 19,  815,  122,  122, "BZip2:x5:mt2" },
-  { 19, 2530,  122,  122, "BZip2:x7" },
-  { 18, 1010,    0, 1150, "PPMD:x1" },
-  { 22, 1655,    0, 1830, "PPMD:x5" },
-  {  0,    6,    0,    6, "Delta:4" },
-  {  0,    4,    0,    4, "BCJ" },
-  {  0,   24,    0,   24, "AES256CBC:1" },
-  {  0,    8,    0,    2, "AES256CBC:2" }
+  { 17,  357,  145,   20, "LZMA:x1", LZMA_DEC_CORE_REF },
+  { 24, 1220,  145,   20, "LZMA:x5:mt1", LZMA_DEC_CORE_REF },
+  { 24, 1220,  145,   20, "LZMA:x5:mt2", LZMA_DEC_CORE_REF },
+  { 24, 1220,  145,   20, "LZMA:x5", LZMA_DEC_CORE_FAST },
+  { 16,   66,   40,   14, "Deflate:x1", LZMA_DEC_CORE_REF },
+  { 16,   93,   40,   14, "Deflate:x3", LZMA_DEC_CORE_REF },
+  { 16,  376,   40,   14, "Deflate:x5", LZMA_DEC_CORE_REF },
+  { 16, 1082,   40,   14, "Deflate:x7", LZMA_DEC_CORE_REF },
+  { 17,  422,   40,   14, "Deflate64:x5", LZMA_DEC_CORE_REF },
+  { 19,   37,    6,    2, "ZSTD:x1", LZMA_DEC_CORE_REF },
+  { 21,   41,    6,    2, "ZSTD:x3", LZMA_DEC_CORE_REF },
+  { 21,   41,    6,    2, "ZSTD:x3:mt2", LZMA_DEC_CORE_REF },
+  { 22,  212,    6,    2, "ZSTD:x9", LZMA_DEC_CORE_REF },
+  { 16,   20,    6,    1, "LZ4:x1", LZMA_DEC_CORE_REF },
+  { 16,   90,    6,    1, "LZ4:x9", LZMA_DEC_CORE_REF },
+  { 15,  590,   69,   69, "BZip2:x1", LZMA_DEC_CORE_REF },
+  { 19,  815,  122,  122, "BZip2:x5", LZMA_DEC_CORE_REF },
+  { 19,  815,  122,  122, "BZip2:x5:mt2", LZMA_DEC_CORE_REF },
+  { 19, 2530,  122,  122, "BZip2:x7", LZMA_DEC_CORE_REF },
+  { 18, 1010,    0, 1150, "PPMD:x1", LZMA_DEC_CORE_REF },
+  { 22, 1655,    0, 1830, "PPMD:x5", LZMA_DEC_CORE_REF },
+  {  0,    2,    0,    2, "Copy", LZMA_DEC_CORE_REF },
+  {  0,    6,    0,    6, "Delta:1", LZMA_DEC_CORE_REF },
+  {  0,    6,    0,    6, "Delta:4", LZMA_DEC_CORE_REF },
+  {  0,    4,    0,    4, "BCJ", LZMA_DEC_CORE_REF },
+  {  0,    4,    0,    4, "ARM", LZMA_DEC_CORE_REF },
+  {  0,    4,    0,    4, "ARM64", LZMA_DEC_CORE_REF },
+  {  0,   24,    0,   24, "AES256CBC:1", LZMA_DEC_CORE_REF },
+  {  0,    8,    0,    2, "AES256CBC:2", LZMA_DEC_CORE_REF }
 };
 
 struct CBenchHash
@@ -1760,7 +1788,10 @@ static HRESULT TotalBench(
   for (unsigned i = 0; i < ARRAY_SIZE(g_Bench); i++)
   {
     CBenchMethod bench = g_Bench[i];
-    PrintLeft(*callback->_file, bench.Name, kFieldSize_Name);
+    AString name = bench.Name;
+    if (bench.LzmaDecCore == LZMA_DEC_CORE_FAST)
+      name += ":fast";
+    PrintLeft(*callback->_file, name, kFieldSize_Name);
     callback->BenchProps.DecComplexUnc = bench.DecComplexUnc;
     callback->BenchProps.DecComplexCompr = bench.DecComplexCompr;
     callback->BenchProps.EncComplex = bench.EncComplex;
@@ -1773,11 +1804,13 @@ static HRESULT TotalBench(
     if (!forceUnpackSize && bench.DictBits == 0)
       unpackSize2 = kFilterUnpackSize;
 
+    callback->BenchProps.LzmaDecCore = bench.LzmaDecCore;
     HRESULT res = MethodBench(
         EXTERNAL_CODECS_LOC_VARS
         complexInCommands,
         false, numThreads, method, unpackSize2, bench.DictBits,
         printCallback, callback, &callback->BenchProps);
+    callback->BenchProps.LzmaDecCore = LZMA_DEC_CORE_REF;
     if (res == E_NOTIMPL)
     {
       // callback->Print(" ---");
@@ -2100,6 +2133,77 @@ static bool AreSameMethodNames(const char *fullName, const wchar_t *shortName)
   }
 }
 
+/* HugePagesBench() compares the speed with transparent huge pages for
+   dictionary and match finder buffers (hp+) and without them (hp-).
+   The last line shows the rating with huge pages in percents of the rating without them. */
+
+static HRESULT HugePagesBench(
+    DECL_EXTERNAL_CODECS_LOC_VARS
+    UInt64 complexInCommands,
+    UInt32 numThreads,
+    const COneMethodInfo &method,
+    UInt32 dict,
+    IBenchPrintCallback &f,
+    const CBenchProps &benchProps)
+{
+  f.NewLine();
+  unsigned pow = 0;
+  while (pow < 31 && ((UInt32)2 << pow) <= dict)
+    pow++;
+  size_t threshold = GetHugePagesThreshold();
+  if (threshold == 0)
+    threshold = (size_t)1 << 22;
+
+  CBenchCallbackToPrint callbacks[2];
+  for (unsigned i = 0; i < 2; i++)
+  {
+    CBenchCallbackToPrint &callback = callbacks[i];
+    callback.Init();
+    callback._file = &f;
+    callback.NameFieldSize = kFieldSize_SmallName;
+    callback.Use2Columns = true;
+    callback.BenchProps = benchProps;
+    callback.DictSize = (UInt32)1 << pow;
+    PrintLeft(f, i == 0 ? "hp+:" : "hp-:", kFieldSize_SmallName);
+
+    COneMethodInfo method2 = method;
+    if (StringsAreEqualNoCase_Ascii(method2.MethodName, L"LZMA"))
+    {
+      NCOM::CPropVariant propVariant = (UInt32)pow;
+      RINOK(method2.ParseMethodFromPROPVARIANT(L"d", propVariant));
+    }
+    UInt32 uncompressedDataSize = callback.DictSize;
+    if (uncompressedDataSize >= (1 << 18))
+      uncompressedDataSize += kAdditionalSize;
+
+    SetHugePagesThreshold(i == 0 ? threshold : 0);
+    HRESULT res = MethodBench(
+        EXTERNAL_CODECS_LOC_VARS
+        complexInCommands,
+        true, numThreads,
+        method2, uncompressedDataSize,
+        kOldLzmaDictBits, &f, &callback, &callback.BenchProps);
+    SetHugePagesThreshold(threshold);
+    f.NewLine();
+    RINOK(res);
+  }
+
+  UInt64 encRating = callbacks[1].EncodeRes.Rating;
+  UInt64 decRating = callbacks[1].DecodeRes.Rating;
+  if (encRating == 0)
+    encRating = 1;
+  if (decRating == 0)
+    decRating = 1;
+  PrintLeft(f, "hp%:", kFieldSize_SmallName);
+  PrintSpaces(f, 1 + kFieldSize_Speed + 1 + kFieldSize_Usage + 1 + kFieldSize_RU);
+  PrintPercents(f, callbacks[0].EncodeRes.Rating, encRating, kFieldSize_Rating);
+  f.Print(kSep);
+  PrintSpaces(f, 1 + kFieldSize_Speed + 1 + kFieldSize_Usage + 1 + kFieldSize_RU);
+  PrintPercents(f, callbacks[0].DecodeRes.Rating, decRating, kFieldSize_Rating);
+  f.NewLine();
+  return S_OK;
+}
+
 HRESULT Bench(
     DECL_EXTERNAL_CODECS_LOC_VARS
     IBenchPrintCallback *printCallback,
@@ -2122,6 +2226,7 @@ HRESULT Bench(
   UInt32 numThreads = numCPUs;
 
   UInt32 testTime = kComplexInSeconds;
+  bool hugePagesTest = false;
 
   COneMethodInfo method;
   unsigned i;
@@ -2138,6 +2243,11 @@ HRESULT Bench(
       RINOK(ParsePropToUInt32(L"", propVariant, testTime));
       continue;
     }
+    if (name.IsEqualTo("hp"))
+    {
+      RINOK(PROPVARIANT_to_bool(propVariant, hugePagesTest));
+      continue;
+    }
     if (name.IsPrefixedBy(L"mt"))
     {
       #ifndef _7ZIP_ST
@@ -2540,5 +2650,11 @@ HRESULT Bench(
   midRes.SetSum(callback.EncodeRes, callback.DecodeRes);
   PrintTotals(f, showFreq, cpuFreq, midRes);
   f.NewLine();
+
+  if (hugePagesTest && !totalBenchMode)
+  {
+    RINOK(HugePagesBench(EXTERNAL_CODECS_LOC_VARS complexInCommands, numThreads,
+        method, dict, f, callback.BenchProps));
+  }
   return S_OK;
 }
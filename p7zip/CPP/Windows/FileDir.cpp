@@ -353,7 +353,7 @@ bool SetFileAttrib(CFSTR fileName, DWORD fileAttributes)
 #ifdef _UNICODE
   AString name = nameWindowToUnix2(fileName);
 #else
-  const char * name = nameWindowToUnix(UnicodeStringToMultiByte(fileName));
+  AString name = nameWindowToUnix(UnicodeStringToMultiByte(fileName));
 #endif
   struct stat stat_info;
 #ifdef ENV_HAVE_LSTAT
@@ -422,7 +422,7 @@ bool RemoveDir(CFSTR path)
 #ifdef _UNICODE
   AString name = nameWindowToUnix2(path);
 #else
-  const char * name = nameWindowToUnix(UnicodeStringToMultiByte(path));
+  AString name = nameWindowToUnix(UnicodeStringToMultiByte(path));
 #endif
 
 
@@ -440,8 +440,8 @@ bool MyMoveFile(CFSTR existFileName, CFSTR newFileName)
   AString src = nameWindowToUnix2(existFileName);
   AString dst = nameWindowToUnix2(newFileName);
 #else
-  const char * src = nameWindowToUnix(UnicodeStringToMultiByte(existFileName));
-  const char * dst = nameWindowToUnix(UnicodeStringToMultiByte(newFileName));
+  AString src = nameWindowToUnix(UnicodeStringToMultiByte(existFileName));
+  AString dst = nameWindowToUnix(UnicodeStringToMultiByte(newFileName));
 #endif
 
   TRACEN((printf("MyMoveFile(%s,%s)\n",(const char *)src,(const char *)dst)))
@@ -480,7 +480,7 @@ bool CreateDir(CFSTR path)
 #ifdef _UNICODE
   AString name = nameWindowToUnix2(path);
 #else
-  const char * name = nameWindowToUnix(UnicodeStringToMultiByte(path));
+  AString name = nameWindowToUnix(UnicodeStringToMultiByte(path));
 #endif
   bool bret = false;
   if (mkdir( name, 0700 ) == 0) bret = true;
@@ -494,7 +494,7 @@ bool CreateComplexDir(CFSTR _aPathName)
 #ifdef _UNICODE
   AString name = nameWindowToUnix2(_aPathName);
 #else
-  const char * name = nameWindowToUnix(UnicodeStringToMultiByte(_aPathName));
+  AString name = nameWindowToUnix(UnicodeStringToMultiByte(_aPathName));
 #endif
   TRACEN((printf("CreateComplexDir(%s)\n",(const char *)name)))
 
@@ -554,7 +554,7 @@ bool DeleteFileAlways(CFSTR name)
 #ifdef _UNICODE
    AString unixname = nameWindowToUnix2(name);
 #else
-   const char * unixname = nameWindowToUnix(UnicodeStringToMultiByte(name));
+   AString unixname = nameWindowToUnix(UnicodeStringToMultiByte(name));
 #endif
    bool bret = false;
    if (remove(unixname) == 0) bret = true;
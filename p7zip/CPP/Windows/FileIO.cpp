@@ -336,6 +336,42 @@ bool CInFile::Read(void *buffer, UINT32 bytesToRead, UINT32 &bytesRead)
   return FALSE;
 }
 
+bool CInFile::ReadAt(UINT64 position, void *buffer, UINT32 bytesToRead, UINT32 &bytesRead)
+{
+  bytesRead = 0;
+  if (_fd == -1)
+  {
+     SetLastError( ERROR_INVALID_HANDLE );
+     return false;
+  }
+
+  if (bytesToRead == 0)
+    return TRUE;
+
+#ifdef ENV_HAVE_LSTAT
+  if (_fd == FD_LINK) {
+    if (position >= (UINT64)_size)
+      return TRUE;
+    UINT32 len = (UINT32)((UINT64)_size - position);
+    if (len > bytesToRead) len = bytesToRead;
+    memcpy(buffer,_buffer+(size_t)position,len);
+    bytesRead = len;
+    return TRUE;
+  }
+#endif
+
+  ssize_t  ret;
+  do {
+    ret = pread(_fd,buffer,bytesToRead,(off_t)position);
+  } while (ret < 0 && (errno == EINTR));
+
+  if (ret != -1) {
+    bytesRead = ret;
+    return TRUE;
+  }
+  return FALSE;
+}
+
 /////////////////////////
 // COutFile
 
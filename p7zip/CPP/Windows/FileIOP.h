@@ -79,6 +79,9 @@ public:
 
   bool Seek(INT64 distanceToMove, DWORD moveMethod, UINT64 &newPosition);
   bool Seek(UINT64 position, UINT64 &newPosition);
+
+  // it's negative, if there is no open file or if it's symbolic link that is read from _buffer
+  int GetFd() const { return _fd; }
 };
 
 class CInFile: public CFileBase
@@ -98,6 +101,8 @@ public:
   #endif
   bool ReadPart(void *data, UINT32 size, UINT32 &processedSize);
   bool Read(void *data, UINT32 size, UINT32 &processedSize);
+  // positional read: it doesn't change the current file position
+  bool ReadAt(UINT64 position, void *data, UINT32 size, UINT32 &processedSize);
 };
 
 class COutFile: public CFileBase
@@ -370,6 +370,22 @@ bool CInFile::Read(void *data, UInt32 size, UInt32 &processedSize) throw()
   return true;
 }
 
+bool CInFile::ReadAt(UInt64 position, void *data, UInt32 size, UInt32 &processedSize) throw()
+{
+  if (size > kChunkSizeMax)
+    size = kChunkSizeMax;
+  OVERLAPPED overlapped;
+  memset(&overlapped, 0, sizeof(overlapped));
+  overlapped.Offset = (DWORD)position;
+  overlapped.OffsetHigh = (DWORD)(position >> 32);
+  DWORD processedLoc = 0;
+  bool res = BOOLToBool(::ReadFile(_handle, data, size, &processedLoc, &overlapped));
+  processedSize = (UInt32)processedLoc;
+  if (!res && ::GetLastError() == ERROR_HANDLE_EOF)
+    return true;
+  return res;
+}
+
 // ---------- COutFile ---------
 
 static inline DWORD GetCreationDisposition(bool createAlways)
@@ -182,6 +182,9 @@ public:
   bool Read1(void *data, UInt32 size, UInt32 &processedSize) throw();
   bool ReadPart(void *data, UInt32 size, UInt32 &processedSize) throw();
   bool Read(void *data, UInt32 size, UInt32 &processedSize) throw();
+  // positional read: ReadFile() with OVERLAPPED offset on synchronous handle
+  // moves the file pointer after the read data, so Seek() before next Read()
+  bool ReadAt(UInt64 position, void *data, UInt32 size, UInt32 &processedSize) throw();
 };
 
 class COutFile: public CFileBase
@@ -0,0 +1,173 @@
+#include "NativeTests.h"
+
+#include "7zip/Common/StreamObjects.h"
+#include "7zip/Compress/LzmaDecoder.h"
+#include "7zip/Compress/LzmaEncoder.h"
+#include "Windows/PropVariant.h"
+
+/**
+ * Differential tests of the LZMA decoder cores: LZMA_DEC_CORE_FAST must give
+ * the same results as LZMA_DEC_CORE_REF for valid, truncated and corrupted streams.
+ */
+
+static UInt32 g_lzmaTestRandom = 1;
+
+static Byte nextRandomByte() {
+	g_lzmaTestRandom = g_lzmaTestRandom * 1103515245 + 12345;
+	return (Byte) (g_lzmaTestRandom >> 16);
+}
+
+/**
+ * kind 0: random bytes (mostly literals), kind 1: text with short matches,
+ * kind 2: long repeated runs (long matches and rep matches)
+ */
+static void fillLzmaTestData(Byte * data, size_t size, int kind) {
+	for (size_t i = 0; i < size;) {
+		if (kind == 0 || i < 16) {
+			data[i++] = nextRandomByte();
+			continue;
+		}
+		if (kind == 1) {
+			data[i++] = (Byte) ("LZMA decoder core test "[nextRandomByte() % 23]);
+			continue;
+		}
+		size_t distance = 1 + nextRandomByte() % 16 * (nextRandomByte() & 0x3F);
+		size_t length = 2 + nextRandomByte();
+		if (distance > i) {
+			distance = i;
+		}
+		for (size_t k = 0; k < length && i < size; k++, i++) {
+			data[i] = data[i - distance];
+		}
+		if (i < size) {
+			data[i++] = nextRandomByte();
+		}
+	}
+}
+
+static HRESULT encodeLzma(const Byte * data, size_t size, UInt32 lc, UInt32 lp, UInt32 pb,
+		bool endMarker, CByteBuffer & properties, CByteBuffer & packed) {
+	NCompress::NLzma::CEncoder * encoderSpec = new NCompress::NLzma::CEncoder;
+	CMyComPtr<ICompressCoder> encoder = encoderSpec;
+
+	const PROPID propIDs[] = {
+		NCoderPropID::kDictionarySize,
+		NCoderPropID::kLitContextBits,
+		NCoderPropID::kLitPosBits,
+		NCoderPropID::kPosStateBits,
+		NCoderPropID::kEndMarker };
+	NWindows::NCOM::CPropVariant values[5];
+	values[0] = (UInt32) 1 << 16;
+	values[1] = lc;
+	values[2] = lp;
+	values[3] = pb;
+	values[4] = endMarker;
+	RINOK(encoderSpec->SetCoderProperties(propIDs, values, 5));
+
+	CDynBufSeqOutStream * propertiesStreamSpec = new CDynBufSeqOutStream;
+	CMyComPtr<ISequentialOutStream> propertiesStream = propertiesStreamSpec;
+	RINOK(encoderSpec->WriteCoderProperties(propertiesStream));
+	propertiesStreamSpec->CopyToBuffer(properties);
+
+	CBufInStream * inStreamSpec = new CBufInStream;
+	CMyComPtr<ISequentialInStream> inStream = inStreamSpec;
+	inStreamSpec->Init(data, size);
+	CDynBufSeqOutStream * outStreamSpec = new CDynBufSeqOutStream;
+	CMyComPtr<ISequentialOutStream> outStream = outStreamSpec;
+	RINOK(encoder->Code(inStream, outStream, NULL, NULL, NULL));
+	outStreamSpec->CopyToBuffer(packed);
+	return S_OK;
+}
+
+struct CLzmaDecodeResult {
+	HRESULT Result;
+	bool NeedMoreInput;
+	UInt64 InProcessed;
+	CByteBuffer Data;
+};
+
+static void decodeLzma(UInt32 core, const CByteBuffer & properties, const Byte * packed, size_t packedSize,
+		const UInt64 * outSize, CLzmaDecodeResult & result) {
+	NCompress::NLzma::CDecoder * decoderSpec = new NCompress::NLzma::CDecoder;
+	CMyComPtr<ICompressCoder> decoder = decoderSpec;
+
+	const PROPID propID = NCoderPropID::kAlgorithm;
+	NWindows::NCOM::CPropVariant value(core);
+	NATIVE_TEST_CHECK(decoderSpec->SetCoderProperties(&propID, &value, 1) == S_OK);
+	NATIVE_TEST_CHECK(decoderSpec->SetDecoderProperties2(properties, (UInt32) properties.Size()) == S_OK);
+	decoderSpec->FinishStream = true;
+
+	CBufInStream * inStreamSpec = new CBufInStream;
+	CMyComPtr<ISequentialInStream> inStream = inStreamSpec;
+	inStreamSpec->Init(packed, packedSize);
+	CDynBufSeqOutStream * outStreamSpec = new CDynBufSeqOutStream;
+	CMyComPtr<ISequentialOutStream> outStream = outStreamSpec;
+
+	result.Result = decoder->Code(inStream, outStream, NULL, outSize, NULL);
+	result.NeedMoreInput = decoderSpec->NeedMoreInput;
+	result.InProcessed = decoderSpec->GetInputProcessedSize();
+	outStreamSpec->CopyToBuffer(result.Data);
+}
+
+/**
+ * Decode the stream with both cores and compare everything, that the caller can see.
+ * Returns true, if the stream was decoded without errors.
+ */
+static bool compareLzmaCores(const CByteBuffer & properties, const Byte * packed, size_t packedSize,
+		const UInt64 * outSize) {
+	CLzmaDecodeResult ref;
+	CLzmaDecodeResult fast;
+	decodeLzma(LZMA_DEC_CORE_REF, properties, packed, packedSize, outSize, ref);
+	decodeLzma(LZMA_DEC_CORE_FAST, properties, packed, packedSize, outSize, fast);
+
+	NATIVE_TEST_CHECK(ref.Result == fast.Result);
+	NATIVE_TEST_CHECK(ref.NeedMoreInput == fast.NeedMoreInput);
+	NATIVE_TEST_CHECK(ref.InProcessed == fast.InProcessed);
+	NATIVE_TEST_CHECK(ref.Data.Size() == fast.Data.Size()
+			&& memcmp(ref.Data, fast.Data, ref.Data.Size()) == 0);
+	return ref.Result == S_OK && !ref.NeedMoreInput;
+}
+
+static void testLzmaCores(size_t size, int kind, UInt32 lc, UInt32 lp, UInt32 pb, bool endMarker) {
+	CByteBuffer data(size);
+	fillLzmaTestData(data, size, kind);
+
+	CByteBuffer properties;
+	CByteBuffer packed;
+	NATIVE_TEST_CHECK(encodeLzma(data, size, lc, lp, pb, endMarker, properties, packed) == S_OK);
+
+	UInt64 unpackSize = size;
+	const UInt64 * outSize = endMarker ? NULL : &unpackSize;
+
+	// Valid stream: both cores must also return the original data
+	NATIVE_TEST_CHECK(compareLzmaCores(properties, packed, packed.Size(), outSize));
+	CLzmaDecodeResult decoded;
+	decodeLzma(LZMA_DEC_CORE_FAST, properties, packed, packed.Size(), outSize, decoded);
+	NATIVE_TEST_CHECK(decoded.Data.Size() == size && memcmp(decoded.Data, data, size) == 0);
+
+	// Truncated streams
+	for (unsigned i = 1; i <= 4; i++) {
+		compareLzmaCores(properties, packed, packed.Size() * i / 5, outSize);
+	}
+	compareLzmaCores(properties, packed, packed.Size() - 1, outSize);
+
+	// Corrupted streams
+	for (unsigned i = 0; i < 16; i++) {
+		CByteBuffer corrupted;
+		corrupted.CopyFrom(packed, packed.Size());
+		size_t pos = 1 + (size_t) (((UInt64) (packed.Size() - 1) * i) / 16);
+		corrupted[pos] ^= (Byte) (1 << (i & 7));
+		compareLzmaCores(properties, corrupted, corrupted.Size(), outSize);
+	}
+}
+
+void lzmaCoreTest() {
+	for (int kind = 0; kind < 3; kind++) {
+		testLzmaCores(100000, kind, 3, 0, 2, false);
+		testLzmaCores(100000, kind, 0, 2, 0, true);
+		testLzmaCores(50000, kind, 4, 0, 2, false);
+		testLzmaCores(50000, kind, 1, 3, 1, true);
+		testLzmaCores(8000, kind, 8, 4, 4, false);
+	}
+	testLzmaCores(1, 1, 3, 0, 2, false);
+}
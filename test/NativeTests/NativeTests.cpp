@@ -0,0 +1,251 @@
+#include "NativeTests.h"
+
+#include "7zip/Common/StreamObjects.h"
+#include "7zip/IPassword.h"
+#include "7zip/UI/Common/LoadCodecs.h"
+
+int g_nativeTestFailures = 0;
+
+/**
+ * Seekable output stream in memory
+ */
+class CTestOutStream : public IOutStream, public CMyUnknownImp {
+	CByteDynBuffer _buffer;
+	size_t _size;
+	UInt64 _pos;
+public:
+	CTestOutStream() : _size(0), _pos(0) {}
+
+	MY_UNKNOWN_IMP1(IOutStream)
+
+	STDMETHOD(Write)(const void * data, UInt32 size, UInt32 * processedSize) {
+		if (processedSize) {
+			*processedSize = 0;
+		}
+		if (size == 0) {
+			return S_OK;
+		}
+		size_t end = (size_t)_pos + size;
+		if (!_buffer.EnsureCapacity(end)) {
+			return E_OUTOFMEMORY;
+		}
+		if (_pos > _size) {
+			memset((Byte *)_buffer + _size, 0, (size_t)_pos - _size);
+		}
+		memcpy((Byte *)_buffer + (size_t)_pos, data, size);
+		_pos = end;
+		if (_size < end) {
+			_size = end;
+		}
+		if (processedSize) {
+			*processedSize = size;
+		}
+		return S_OK;
+	}
+
+	STDMETHOD(Seek)(Int64 offset, UInt32 seekOrigin, UInt64 * newPosition) {
+		switch (seekOrigin) {
+		case STREAM_SEEK_SET: break;
+		case STREAM_SEEK_CUR: offset += _pos; break;
+		case STREAM_SEEK_END: offset += _size; break;
+		default: return STG_E_INVALIDFUNCTION;
+		}
+		if (offset < 0) {
+			return HRESULT_WIN32_ERROR_NEGATIVE_SEEK;
+		}
+		_pos = offset;
+		if (newPosition) {
+			*newPosition = _pos;
+		}
+		return S_OK;
+	}
+
+	STDMETHOD(SetSize)(UInt64 newSize) {
+		if (!_buffer.EnsureCapacity((size_t)newSize)) {
+			return E_OUTOFMEMORY;
+		}
+		_size = (size_t)newSize;
+		return S_OK;
+	}
+
+	void CopyTo(CByteBuffer & dest) const {
+		dest.CopyFrom(_buffer, _size);
+	}
+};
+
+class CTestUpdateCallback : public IArchiveUpdateCallback, public ICryptoGetTextPassword2,
+		public CMyUnknownImp {
+	const Byte * _data;
+	size_t _size;
+	const wchar_t * _password;
+public:
+	CTestUpdateCallback(const Byte * data, size_t size, const wchar_t * password) :
+		_data(data), _size(size), _password(password) {}
+
+	MY_UNKNOWN_IMP1(ICryptoGetTextPassword2)
+
+	STDMETHOD(SetTotal)(UInt64 /* size */) {
+		return S_OK;
+	}
+	STDMETHOD(SetCompleted)(const UInt64 * /* completeValue */) {
+		return S_OK;
+	}
+	STDMETHOD(GetUpdateItemInfo)(UInt32 /* index */, Int32 * newData, Int32 * newProps, UInt32 * indexInArchive) {
+		*newData = 1;
+		*newProps = 1;
+		*indexInArchive = (UInt32)(Int32)-1;
+		return S_OK;
+	}
+	STDMETHOD(GetProperty)(UInt32 /* index */, PROPID propID, PROPVARIANT * value) {
+		NWindows::NCOM::CPropVariant prop;
+		switch (propID) {
+		case kpidPath: prop = L"file"; break;
+		case kpidIsDir: prop = false; break;
+		case kpidSize: prop = (UInt64)_size; break;
+		}
+		prop.Detach(value);
+		return S_OK;
+	}
+	STDMETHOD(GetStream)(UInt32 /* index */, ISequentialInStream ** inStream) {
+		CBufInStream * streamSpec = new CBufInStream;
+		CMyComPtr<ISequentialInStream> stream = streamSpec;
+		streamSpec->Init(_data, _size);
+		*inStream = stream.Detach();
+		return S_OK;
+	}
+	STDMETHOD(SetOperationResult)(Int32 /* operationResult */) {
+		return S_OK;
+	}
+	STDMETHOD(CryptoGetTextPassword2)(Int32 * passwordIsDefined, BSTR * password) {
+		*passwordIsDefined = BoolToInt(_password != NULL);
+		return StringToBstr(_password ? _password : L"", password);
+	}
+};
+
+class CTestExtractCallback : public IArchiveExtractCallback, public ICryptoGetTextPassword,
+		public CMyUnknownImp {
+	const wchar_t * _password;
+public:
+	CDynBufSeqOutStream * OutStreamSpec;
+	CMyComPtr<ISequentialOutStream> OutStream;
+	Int32 OperationResult;
+
+	CTestExtractCallback(const wchar_t * password) :
+		_password(password), OperationResult(-1) {
+		OutStreamSpec = new CDynBufSeqOutStream;
+		OutStream = OutStreamSpec;
+	}
+
+	MY_UNKNOWN_IMP1(ICryptoGetTextPassword)
+
+	STDMETHOD(SetTotal)(UInt64 /* total */) {
+		return S_OK;
+	}
+	STDMETHOD(SetCompleted)(const UInt64 * /* completeValue */) {
+		return S_OK;
+	}
+	STDMETHOD(GetStream)(UInt32 /* index */, ISequentialOutStream ** outStream, Int32 /* askExtractMode */) {
+		CMyComPtr<ISequentialOutStream> stream = OutStream;
+		*outStream = stream.Detach();
+		return S_OK;
+	}
+	STDMETHOD(PrepareOperation)(Int32 /* askExtractMode */) {
+		return S_OK;
+	}
+	STDMETHOD(SetOperationResult)(Int32 operationResult) {
+		OperationResult = operationResult;
+		return S_OK;
+	}
+	STDMETHOD(CryptoGetTextPassword)(BSTR * password) {
+		if (!_password) {
+			return E_ABORT;
+		}
+		return StringToBstr(_password, password);
+	}
+};
+
+static int findFormat(CCodecs * codecs, const wchar_t * formatName) {
+	int index = codecs->FindFormatForArchiveType(formatName);
+	if (index < 0) {
+		printf("Not registered archive format: '%ls'\n", formatName);
+	}
+	return index;
+}
+
+HRESULT createTestArchive(const wchar_t * formatName, const Byte * data, size_t size,
+		const wchar_t * password, const wchar_t ** names, const PROPVARIANT * values, int numProperties,
+		CByteBuffer & archive) {
+	CCodecs * codecs = new CCodecs;
+	CMyComPtr<IUnknown> codecsRef = codecs;
+	RINOK(codecs->Load());
+	int index = findFormat(codecs, formatName);
+	if (index < 0) {
+		return E_NOTIMPL;
+	}
+	CMyComPtr<IOutArchive> outArchive;
+	RINOK(codecs->CreateOutArchive(index, outArchive));
+	if (!outArchive) {
+		return E_NOTIMPL;
+	}
+	if (numProperties != 0) {
+		CMyComPtr<ISetProperties> setProperties;
+		outArchive.QueryInterface(IID_ISetProperties, &setProperties);
+		if (!setProperties) {
+			return E_NOTIMPL;
+		}
+		RINOK(setProperties->SetProperties(names, values, numProperties));
+	}
+
+	CTestOutStream * outStreamSpec = new CTestOutStream;
+	CMyComPtr<IOutStream> outStream = outStreamSpec;
+	CMyComPtr<IArchiveUpdateCallback> updateCallback = new CTestUpdateCallback(data, size, password);
+	RINOK(outArchive->UpdateItems(outStream, 1, updateCallback));
+	outStreamSpec->CopyTo(archive);
+	return S_OK;
+}
+
+HRESULT extractTestArchive(const wchar_t * formatName, const Byte * archive, size_t archiveSize,
+		const wchar_t * password, CByteBuffer & data, Int32 & operationResult) {
+	operationResult = -1;
+	CCodecs * codecs = new CCodecs;
+	CMyComPtr<IUnknown> codecsRef = codecs;
+	RINOK(codecs->Load());
+	int index = findFormat(codecs, formatName);
+	if (index < 0) {
+		return E_NOTIMPL;
+	}
+	CMyComPtr<IInArchive> inArchive;
+	RINOK(codecs->CreateInArchive(index, inArchive));
+	if (!inArchive) {
+		return E_NOTIMPL;
+	}
+
+	CBufInStream * inStreamSpec = new CBufInStream;
+	CMyComPtr<IInStream> inStream = inStreamSpec;
+	inStreamSpec->Init(archive, archiveSize);
+	UInt64 maxCheckStartPosition = 0;
+	RINOK(inArchive->Open(inStream, &maxCheckStartPosition, NULL));
+
+	CTestExtractCallback * extractCallbackSpec = new CTestExtractCallback(password);
+	CMyComPtr<IArchiveExtractCallback> extractCallback = extractCallbackSpec;
+	UInt32 index0 = 0;
+	HRESULT result = inArchive->Extract(&index0, 1, 0, extractCallback);
+	inArchive->Close();
+	RINOK(result);
+	extractCallbackSpec->OutStreamSpec->CopyToBuffer(data);
+	operationResult = extractCallbackSpec->OperationResult;
+	return S_OK;
+}
+
+int main() {
+	unicodeHelperTest();
+	zstdTest();
+	lzmaCoreTest();
+
+	if (g_nativeTestFailures != 0) {
+		printf("%i check(s) failed\n", g_nativeTestFailures);
+		return 1;
+	}
+	printf("All native tests passed\n");
+	return 0;
+}
@@ -0,0 +1,44 @@
+#ifndef NATIVETESTS_H_
+#define NATIVETESTS_H_
+
+#include "SevenZipJBinding.h"
+
+#include "Common/MyBuffer.h"
+
+/**
+ * Tests of the native part, that don't need a JVM. They are linked with
+ * the 7-Zip-JBinding library and run by CTest as "Native-tests".
+ */
+
+extern int g_nativeTestFailures;
+
+#define NATIVE_TEST_CHECK(condition)												\
+	{																				\
+		if (!(condition)) {															\
+			printf("%s:%i: check failed: %s\n", __FILE__, __LINE__, #condition);	\
+			fflush(stdout);															\
+			g_nativeTestFailures++;													\
+		}																			\
+	}
+
+/**
+ * Create an archive of format <code>formatName</code> with one item <code>data</code>.
+ * <code>password</code> may be NULL. <code>names</code> and <code>values</code>
+ * are passed to ISetProperties.
+ */
+HRESULT createTestArchive(const wchar_t * formatName, const Byte * data, size_t size,
+		const wchar_t * password, const wchar_t ** names, const PROPVARIANT * values, int numProperties,
+		CByteBuffer & archive);
+
+/**
+ * Extract the first item of the archive. <code>operationResult</code> gets
+ * the NArchive::NExtract::NOperationResult of the item.
+ */
+HRESULT extractTestArchive(const wchar_t * formatName, const Byte * archive, size_t archiveSize,
+		const wchar_t * password, CByteBuffer & data, Int32 & operationResult);
+
+void unicodeHelperTest();
+void zstdTest();
+void lzmaCoreTest();
+
+#endif /* NATIVETESTS_H_ */
@@ -0,0 +1,168 @@
+#include "NativeTests.h"
+
+#include "UnicodeHelper.h"
+
+#include "7zip/Archive/IArchive.h"
+
+static bool equalJChars(const jchar * a, const jchar * b, size_t len) {
+	return memcmp(a, b, len * sizeof(jchar)) == 0;
+}
+
+static bool equalWChars(const wchar_t * a, const wchar_t * b, size_t len) {
+	return memcmp(a, b, len * sizeof(wchar_t)) == 0;
+}
+
+/**
+ * BMP strings of every length around the 8-char SSE2 blocks must convert both ways unchanged.
+ */
+static void testBmpRoundTrip() {
+	jchar jchars[40];
+	wchar_t wchars[40];
+	for (size_t len = 0; len < 40; len++) {
+		for (size_t i = 0; i < len; i++) {
+			// Mix ASCII, high BMP and the edges of the surrogate range
+			static const jchar samples[] = { 'a', 0x7F, 0xFF, 0x100, 0xD7FF, 0xE000, 0xFFFD, 0xFFFF };
+			jchars[i] = samples[(i * 3 + len) % (sizeof(samples) / sizeof(samples[0]))];
+			wchars[i] = (wchar_t) jchars[i];
+		}
+		jchars[len] = 0;
+		wchars[len] = 0;
+
+		UnicodeHelper fromJChars(jchars, len);
+		const wchar_t * unicode = fromJChars;
+		NATIVE_TEST_CHECK(equalWChars(unicode, wchars, len + 1));
+
+		UnicodeHelper fromWChars(wchars, len);
+		const jchar * converted = fromWChars;
+		NATIVE_TEST_CHECK(fromWChars.getJCharLength() == len);
+		NATIVE_TEST_CHECK(equalJChars(converted, jchars, len));
+	}
+}
+
+/**
+ * A non-BMP character takes two jchar and one 4-byte wchar_t.
+ */
+static void testSurrogatePairs() {
+	const jchar jchars[] = { 'p', 0xD83D, 0xDE00, 'w', 0 };
+	UnicodeHelper fromJChars(jchars, 4);
+	const wchar_t * unicode = fromJChars;
+	if (sizeof(wchar_t) == 4) {
+		const wchar_t expected[] = { L'p', (wchar_t) 0x1F600, L'w', 0 };
+		NATIVE_TEST_CHECK(equalWChars(unicode, expected, 4));
+	} else {
+		NATIVE_TEST_CHECK(equalWChars(unicode, (const wchar_t *)(const void *) jchars, 5));
+	}
+
+	UnicodeHelper fromWChars(unicode);
+	const jchar * converted = fromWChars;
+	NATIVE_TEST_CHECK(fromWChars.getJCharLength() == 4);
+	NATIVE_TEST_CHECK(equalJChars(converted, jchars, 5));
+}
+
+/**
+ * Strings longer than the stack buffer with surrogates after the first SSE2 blocks
+ */
+static void testLongString() {
+	const size_t len = 1000;
+	jchar * jchars = new jchar[len + 1];
+	for (size_t i = 0; i < len; i++) {
+		jchars[i] = (jchar)('A' + i % 26);
+	}
+	for (size_t i = 300; i + 1 < len; i += 97) {
+		jchars[i] = 0xD800 + (jchar)(i % 0x400);
+		jchars[i + 1] = 0xDC00 + (jchar)(i % 0x3FF);
+	}
+	jchars[len] = 0;
+
+	UnicodeHelper fromJChars(jchars, len);
+	const wchar_t * unicode = fromJChars;
+	UnicodeHelper fromWChars(unicode);
+	const jchar * converted = fromWChars;
+	NATIVE_TEST_CHECK(fromWChars.getJCharLength() == len);
+	NATIVE_TEST_CHECK(equalJChars(converted, jchars, len + 1));
+	delete[] jchars;
+}
+
+/**
+ * Unpaired surrogates survive the round trip. Code points above U+10FFFF become U+FFFD.
+ */
+static void testInvalidInput() {
+	const jchar unpaired[] = { 0xDC00, 'a', 0xD800, 0xD800, 'b', 0xD800, 0 };
+	UnicodeHelper fromJChars(unpaired, 6);
+	const wchar_t * unicode = fromJChars;
+	for (int i = 0; i < 6; i++) {
+		NATIVE_TEST_CHECK((UInt32) unicode[i] == unpaired[i]);
+	}
+	UnicodeHelper fromWChars(unicode);
+	const jchar * converted = fromWChars;
+	NATIVE_TEST_CHECK(fromWChars.getJCharLength() == 6);
+	NATIVE_TEST_CHECK(equalJChars(converted, unpaired, 6));
+
+	if (sizeof(wchar_t) == 4) {
+		const wchar_t tooLarge[] = { L'x', (wchar_t) 0x110000, L'y', 0 };
+		const jchar expected[] = { 'x', 0xFFFD, 'y' };
+		UnicodeHelper helper(tooLarge);
+		const jchar * jchars = helper;
+		NATIVE_TEST_CHECK(helper.getJCharLength() == 3);
+		NATIVE_TEST_CHECK(equalJChars(jchars, expected, 3));
+	}
+}
+
+/**
+ * Passwords are serialized by the 7z and RAR handlers as two bytes per wchar_t, so
+ * toCodeUnits() must give the UTF-16LE bytes of the Java string.
+ */
+static void testPasswordCodeUnits() {
+	const jchar jchars[] = { 'p', 0xD83D, 0xDE00, 0xE9 };
+	const Byte utf16le[] = { 'p', 0, 0x3D, 0xD8, 0x00, 0xDE, 0xE9, 0 };
+	wchar_t password[4];
+	UnicodeHelper::toCodeUnits(password, jchars, 4);
+	Byte bytes[8];
+	for (int i = 0; i < 4; i++) {
+		bytes[i * 2] = (Byte) password[i];
+		bytes[i * 2 + 1] = (Byte) (password[i] >> 8);
+	}
+	NATIVE_TEST_CHECK(memcmp(bytes, utf16le, sizeof(utf16le)) == 0);
+}
+
+/**
+ * 7z AES round trip with a non-BMP password, as it comes from Java
+ */
+static void testNonBmpPassword7z() {
+	const jchar jchars[] = { 's', 'e', 'c', 0xD83D, 0xDE00, 'r', 'e', 't' };
+	const size_t len = sizeof(jchars) / sizeof(jchars[0]);
+	wchar_t password[len + 1];
+	UnicodeHelper::toCodeUnits(password, jchars, len);
+	password[len] = 0;
+
+	Byte data[1000];
+	for (size_t i = 0; i < sizeof(data); i++) {
+		data[i] = (Byte) (i * 7 + i / 13);
+	}
+
+	CByteBuffer archive;
+	NATIVE_TEST_CHECK(createTestArchive(L"7z", data, sizeof(data), password, NULL, NULL, 0, archive) == S_OK);
+
+	CByteBuffer extracted;
+	Int32 operationResult;
+	NATIVE_TEST_CHECK(extractTestArchive(L"7z", archive, archive.Size(), password, extracted, operationResult) == S_OK);
+	NATIVE_TEST_CHECK(operationResult == NArchive::NExtract::NOperationResult::kOK);
+	NATIVE_TEST_CHECK(extracted.Size() == sizeof(data) && memcmp(extracted, data, sizeof(data)) == 0);
+
+	if (sizeof(wchar_t) == 4) {
+		// The joined UTF-32 password gives another key
+		UnicodeHelper helper(jchars, len);
+		const wchar_t * joined = helper;
+		HRESULT result = extractTestArchive(L"7z", archive, archive.Size(), joined, extracted, operationResult);
+		NATIVE_TEST_CHECK(result != S_OK || operationResult != NArchive::NExtract::NOperationResult::kOK);
+	}
+}
+
+void unicodeHelperTest() {
+	testBmpRoundTrip();
+	testSurrogatePairs();
+	testLongString();
+	testInvalidInput();
+	testPasswordCodeUnits();
+	testNonBmpPassword7z();
+}
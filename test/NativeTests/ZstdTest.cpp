@@ -0,0 +1,76 @@
+#include "NativeTests.h"
+
+#include "7zip/Archive/IArchive.h"
+#include "7zip/UI/Common/LoadCodecs.h"
+#include "Windows/PropVariant.h"
+
+static void fillTestData(Byte * data, size_t size) {
+	for (size_t i = 0; i < size; i++) {
+		// Repeating text with some noise, so that the codec finds matches
+		data[i] = (Byte) ("Zstandard native test "[i % 22] + ((i / 1000) & 3));
+	}
+}
+
+/**
+ * The .zst format must be found by its name and by its extension.
+ */
+static void testFormatIndex() {
+	CCodecs * codecs = new CCodecs;
+	CMyComPtr<IUnknown> codecsRef = codecs;
+	NATIVE_TEST_CHECK(codecs->Load() == S_OK);
+	int index = codecs->FindFormatForArchiveType(L"zstd");
+	NATIVE_TEST_CHECK(index >= 0);
+	NATIVE_TEST_CHECK(codecs->FindFormatForExtension(L"zst") == index);
+	NATIVE_TEST_CHECK(codecs->FindFormatForExtension(L"tzst") == index);
+}
+
+/**
+ * Round trip of one item through the "zstd" format
+ */
+static void testZstdFormat() {
+	Byte data[100000];
+	fillTestData(data, sizeof(data));
+
+	CByteBuffer archive;
+	NATIVE_TEST_CHECK(createTestArchive(L"zstd", data, sizeof(data), NULL, NULL, NULL, 0, archive) == S_OK);
+	static const Byte signature[] = { 0x28, 0xB5, 0x2F, 0xFD };
+	NATIVE_TEST_CHECK(archive.Size() > sizeof(signature) && memcmp(archive, signature, sizeof(signature)) == 0);
+	NATIVE_TEST_CHECK(archive.Size() < sizeof(data) / 4);
+
+	CByteBuffer extracted;
+	Int32 operationResult;
+	NATIVE_TEST_CHECK(extractTestArchive(L"zstd", archive, archive.Size(), NULL, extracted, operationResult) == S_OK);
+	NATIVE_TEST_CHECK(operationResult == NArchive::NExtract::NOperationResult::kOK);
+	NATIVE_TEST_CHECK(extracted.Size() == sizeof(data) && memcmp(extracted, data, sizeof(data)) == 0);
+
+	// A truncated frame must not be reported as OK
+	HRESULT result = extractTestArchive(L"zstd", archive, archive.Size() - 3, NULL, extracted, operationResult);
+	NATIVE_TEST_CHECK(result != S_OK || operationResult != NArchive::NExtract::NOperationResult::kOK);
+}
+
+/**
+ * Round trip of 7z archive with ZSTD method, that is found by the codec name
+ */
+static void testZstdMethodIn7z() {
+	Byte data[50000];
+	fillTestData(data, sizeof(data));
+
+	const wchar_t * names[] = { L"0" };
+	NWindows::NCOM::CPropVariant values[1];
+	values[0] = L"ZSTD";
+
+	CByteBuffer archive;
+	NATIVE_TEST_CHECK(createTestArchive(L"7z", data, sizeof(data), NULL, names, values, 1, archive) == S_OK);
+
+	CByteBuffer extracted;
+	Int32 operationResult;
+	NATIVE_TEST_CHECK(extractTestArchive(L"7z", archive, archive.Size(), NULL, extracted, operationResult) == S_OK);
+	NATIVE_TEST_CHECK(operationResult == NArchive::NExtract::NOperationResult::kOK);
+	NATIVE_TEST_CHECK(extracted.Size() == sizeof(data) && memcmp(extracted, data, sizeof(data)) == 0);
+}
+
+void zstdTest() {
+	testFormatIndex();
+	testZstdFormat();
+	testZstdMethodIn7z();
+}